@@ -0,0 +1,105 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+// Times the frame allocation of buffer misses with 0%, 50% and 95% of the
+// frames pinned. Every read is of a page that is not in the pool, so each one
+// evicts an unpinned frame. Then times allocPage failing with every frame
+// pinned. Run from src/ as ./badgerdb_bench [frames].
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include "buffer.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+int main(int argc, char **argv) {
+  const std::uint32_t frames = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const std::uint32_t misses = 20000;
+  const std::string filename = "bench.db";
+
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &) {
+  }
+
+  {
+    // a few more pages than frames is enough for every read of a page that
+    // is not pinned to miss, as they are read in a cycle
+    File file = File::create(filename);
+    const PageId numPages = frames + frames / 16 + 1;
+    for (PageId i = 0; i < numPages; i++) {
+      file.allocatePage();
+    }
+
+    std::cout << frames << " frames, " << misses << " misses\n";
+    const int percents[] = {0, 50, 95};
+    for (int percent : percents) {
+      std::shared_ptr<BufMgr> bufMgr = std::make_shared<BufMgr>(frames);
+      const PageId numPinned = (PageId)((std::uint64_t)frames * percent / 100);
+      Page *page;
+      // pages are numbered from 1; the first numPinned stay pinned
+      for (PageId i = 1; i <= frames; i++) {
+        bufMgr->readPage(file, i, page);
+        if (i > numPinned) {
+          bufMgr->unPinPage(file, i, false);
+        }
+      }
+
+      PageId next = frames + 1;
+      auto start = std::chrono::steady_clock::now();
+      for (std::uint32_t m = 0; m < misses; m++) {
+        bufMgr->readPage(file, next, page);
+        bufMgr->unPinPage(file, next, false);
+        // cycle over the pages that are not pinned
+        next = next == numPages ? numPinned + 1 : next + 1;
+      }
+      auto end = std::chrono::steady_clock::now();
+
+      const double ns =
+          std::chrono::duration<double, std::nano>(end - start).count() /
+          misses;
+      std::cout << percent << "% pinned: " << ns << " ns per miss\n";
+
+      for (PageId i = 1; i <= numPinned; i++) {
+        bufMgr->unPinPage(file, i, false);
+      }
+    }
+
+    // with every frame pinned allocPage fails before it touches the file
+    std::shared_ptr<BufMgr> bufMgr = std::make_shared<BufMgr>(frames);
+    Page *page;
+    for (PageId i = 1; i <= frames; i++) {
+      bufMgr->readPage(file, i, page);
+    }
+    const std::uint32_t failures = 10000;
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t m = 0; m < failures; m++) {
+      PageId pageNo;
+      try {
+        bufMgr->allocPage(file, pageNo, page);
+      } catch (const BufferExceededException &) {
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    const double ns =
+        std::chrono::duration<double, std::nano>(end - start).count() /
+        failures;
+    std::cout << "100% pinned: " << ns << " ns per failed allocation\n";
+    for (PageId i = 1; i <= frames; i++) {
+      bufMgr->unPinPage(file, i, false);
+    }
+  }
+
+  File::remove(filename);
+  return 0;
+}
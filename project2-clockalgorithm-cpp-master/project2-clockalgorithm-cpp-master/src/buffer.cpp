@@ -33,66 +33,95 @@ namespace badgerdb
       : numBufs(bufs),
         hashTable(HASHTABLE_SZ(bufs)),
         bufDescTable(bufs),
+        freeFrames(bufs),
+        nextCandidate(bufs),
+        prevCandidate(bufs),
+        numCandidates(0),
         bufPool(bufs)
   {
     for (FrameId i = 0; i < bufs; i++)
     {
       bufDescTable[i].frameNo = i;
       bufDescTable[i].valid = false;
+      // frames are handed out from the top of the stack, lowest first
+      freeFrames[i] = bufs - 1 - i;
     }
 
-    clockHand = bufs - 1;
+    clockHand = 0;
   }
 
   void BufMgr::advanceClock()
   {
-    if (clockHand + 1 >= numBufs)
+    clockHand = nextCandidate[clockHand];
+  }
+
+  void BufMgr::addCandidate(FrameId frame)
+  {
+    if (numCandidates == 0)
     {
-      clockHand = 0;
+      nextCandidate[frame] = frame;
+      prevCandidate[frame] = frame;
+      clockHand = frame;
     }
     else
     {
-      clockHand++;
+      FrameId last = prevCandidate[clockHand];
+      nextCandidate[last] = frame;
+      prevCandidate[frame] = last;
+      nextCandidate[frame] = clockHand;
+      prevCandidate[clockHand] = frame;
     }
+    numCandidates++;
+  }
+
+  void BufMgr::removeCandidate(FrameId frame)
+  {
+    numCandidates--;
+    if (numCandidates == 0)
+    {
+      return;
+    }
+    nextCandidate[prevCandidate[frame]] = nextCandidate[frame];
+    prevCandidate[nextCandidate[frame]] = prevCandidate[frame];
+    if (clockHand == frame)
+    {
+      clockHand = nextCandidate[frame];
+    }
+  }
+
+  void BufMgr::freeFrame(FrameId frame)
+  {
+    bufDescTable[frame].clear();
+    freeFrames.push_back(frame);
   }
 
   void BufMgr::allocBuf(FrameId &frame)
   {
-    advanceClock();
-    bool allocated = false;
-    std::vector<bool> pinned(numBufs, false);
-    uint32_t numPinned = 0;
-    while (!allocated)
+    if (!freeFrames.empty())
     {
-      if (numPinned >= numBufs)
-      {
-        throw BufferExceededException();
-      }
-      if (bufDescTable[clockHand].valid) {
-        if (bufDescTable[clockHand].refbit)
-        {
-          bufDescTable[clockHand].refbit = false;
-          advanceClock();
-          continue;
-        }
-        else if (bufDescTable[clockHand].pinCnt > 0)
-        {
-          if (!pinned[clockHand]) {
-            pinned[clockHand] = true;
-            numPinned++;
-          }
-          advanceClock();
-          continue;
-        }
-        else if (bufDescTable[clockHand].dirty)
-        {
-          bufDescTable[clockHand].file.writePage(bufPool[clockHand]);
-        }
-        hashTable.remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-      } 
-        frame = bufDescTable[clockHand].frameNo;
-        allocated = true;
+      frame = freeFrames.back();
+      freeFrames.pop_back();
+      return;
+    }
+    if (numCandidates == 0)
+    {
+      throw BufferExceededException();
+    }
+    // every candidate is unpinned, so one lap clears all the refbits and
+    // the next frame is the victim
+    while (bufDescTable[clockHand].refbit)
+    {
+      bufDescTable[clockHand].refbit = false;
+      advanceClock();
     }
+    frame = clockHand;
+    if (bufDescTable[frame].dirty)
+    {
+      bufDescTable[frame].file.writePage(bufPool[frame]);
+    }
+    hashTable.remove(bufDescTable[frame].file, bufDescTable[frame].pageNo);
+    removeCandidate(frame);
+    bufDescTable[frame].clear();
   }
 
   
@@ -106,6 +135,10 @@ namespace badgerdb
       hashTable.lookup(file, pageNo, f);
       // page is in the buffer pool:
       bufDescTable[f].refbit = true;
+      if (bufDescTable[f].pinCnt == 0)
+      {
+        removeCandidate(f);
+      }
       bufDescTable[f].pinCnt += 1;
       page = &bufPool[f];
     }
@@ -140,6 +173,10 @@ namespace badgerdb
       {
         bufDescTable[fid].dirty = true;
       }
+      if (bufDescTable[fid].pinCnt == 0)
+      {
+        addCandidate(fid);
+      }
     }
     else
     {
@@ -151,7 +188,15 @@ namespace badgerdb
   {
     FrameId fid;
     allocBuf(fid);
-    bufPool[fid] = file.allocatePage();
+    try
+    {
+      bufPool[fid] = file.allocatePage();
+    }
+    catch (...)
+    {
+      freeFrames.push_back(fid);
+      throw;
+    }
     page = &bufPool[fid];
     pageNo = bufPool[fid].page_number();
     hashTable.insert(file, pageNo, fid);
@@ -173,7 +218,8 @@ namespace badgerdb
           bufDescTable[i].dirty = false;
         }
         hashTable.remove(file, bufDescTable[i].pageNo);
-        bufDescTable[i].clear();
+        removeCandidate(i);
+        freeFrame(i);
       }
     }
   }
@@ -193,7 +239,11 @@ namespace badgerdb
     }
     if (frameAllocated)
     {
-      bufDescTable[fid].clear();
+      if (bufDescTable[fid].pinCnt == 0)
+      {
+        removeCandidate(fid);
+      }
+      freeFrame(fid);
       hashTable.remove(file, PageNo);
     }
     file.deletePage(PageNo);
@@ -148,7 +148,7 @@ struct BufStats {
 class BufMgr {
  private:
   /**
-   * Current position of clockhand in our buffer pool
+   * Current position of clockhand in the ring of candidate frames
    */
   FrameId clockHand;
 
@@ -168,18 +168,62 @@ class BufMgr {
    */
   std::vector<BufDesc> bufDescTable;
 
+  /**
+   * Frames which hold no page, used as a stack. allocBuf takes a frame from
+   * here before it runs the clock.
+   */
+  std::vector<FrameId> freeFrames;
+
+  /**
+   * Next and previous frame in the ring of candidate frames, the valid frames
+   * with a pin count of 0. The clock only runs over this ring, so pinned
+   * frames cost nothing when a victim is chosen.
+   */
+  std::vector<FrameId> nextCandidate;
+  std::vector<FrameId> prevCandidate;
+
+  /**
+   * Number of frames in the ring of candidate frames
+   */
+  std::uint32_t numCandidates;
+
   /**
    * Maintains Buffer pool usage statistics
    */
   BufStats bufStats;
 
   /**
-   * Advance clock to next frame in the buffer pool
+   * Advance clock to next frame in the ring of candidate frames
    */
   void advanceClock();
 
   /**
-   * Allocate a free frame.
+   * Add a frame whose pin count dropped to 0 to the ring of candidate frames,
+   * just behind the clock hand so that it is looked at last.
+   *
+   * @param frame   	Frame ID
+   */
+  void addCandidate(FrameId frame);
+
+  /**
+   * Take a frame out of the ring of candidate frames, when it is pinned or
+   * stops holding a page.
+   *
+   * @param frame   	Frame ID
+   */
+  void removeCandidate(FrameId frame);
+
+  /**
+   * Clear a frame and put it on the stack of free frames.
+   *
+   * @param frame   	Frame ID
+   */
+  void freeFrame(FrameId frame);
+
+  /**
+   * Allocate a free frame. A frame from the stack of free frames is used if
+   * there is one, otherwise the clock picks an unpinned frame to evict. If
+   * every frame is pinned, this fails without looking at any of them.
    *
    * @param frame   	Frame reference, frame ID of allocated frame returned
    * via this variable
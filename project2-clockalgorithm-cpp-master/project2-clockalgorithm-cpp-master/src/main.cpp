@@ -40,6 +40,7 @@ void test3(File &file4);
 void test4(File &file4);
 void test5(File &file4);
 void test6(File &file1);
+void test7(File &file4);
 // Calls the above tests
 void testBufMgr();
 
@@ -144,6 +145,7 @@ void testBufMgr() {
     test4(file4);
     test5(file5);
     test6(file1);
+    test7(file4);
 
     // Close the files by going out of scope
   }
@@ -300,3 +302,43 @@ void test6(File &file1) {
 
   bufMgr->flushFile(file1);
 }
+
+void test7(File &file4) {
+  // With every frame pinned allocation fails, and a frame freed by
+  // disposePage is the one handed out next
+  for (i = 0; i < num; i++) {
+    bufMgr->allocPage(file4, pid[i], page);
+  }
+
+  PageId tmp;
+  try {
+    bufMgr->allocPage(file4, tmp, page);
+    PRINT_ERROR(
+        "ERROR :: No more frames left for allocation. Exception should "
+        "have been thrown before execution reaches this point.");
+  } catch (const BufferExceededException &e) {
+  }
+
+  Page *disposed = page;
+  bufMgr->unPinPage(file4, pid[num - 1], false);
+  bufMgr->disposePage(file4, pid[num - 1]);
+  bufMgr->allocPage(file4, pid[num - 1], page);
+  if (page != disposed) {
+    PRINT_ERROR("ERROR :: The frame of the disposed page was not reused.");
+  }
+
+  try {
+    bufMgr->allocPage(file4, tmp, page);
+    PRINT_ERROR(
+        "ERROR :: No more frames left for allocation. Exception should "
+        "have been thrown before execution reaches this point.");
+  } catch (const BufferExceededException &e) {
+  }
+
+  std::cout << "Test 7 passed"
+            << "\n";
+
+  for (i = 0; i < num; i++) bufMgr->unPinPage(file4, pid[i], false);
+
+  bufMgr->flushFile(file4);
+}
@@ -0,0 +1,1477 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "btree.h"
+#include "hash_index.h"
+#include "page.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "filescan.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Globals
+// -----------------------------------------------------------------------------
+const std::string relationName = "benchRel";
+
+// Same tuple layout as the relation used by main.cpp
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+BufMgr * bufMgr = new BufMgr(1000);
+
+typedef std::chrono::steady_clock Clock;
+
+// Storage for one key of any of the attribute types
+struct KeyBuffer {
+	int i;
+	double d;
+	char s[64];
+};
+
+// -----------------------------------------------------------------------------
+// Forward declarations
+// -----------------------------------------------------------------------------
+
+void createRelation();
+const void *makeKey(Datatype type, int i, KeyBuffer &key);
+const char *makePrefixKey(int i, KeyBuffer &key);
+std::vector<int> shuffledKeys(int numKeys);
+void fillIndex(BTreeIndex *index, Datatype type, int numKeys);
+void removeFile(const std::string &name);
+double elapsedNs(Clock::time_point start);
+int lookup(BTreeIndex *index, const void *key);
+void lookupBench(int numKeys);
+void prefixBench(int numKeys);
+void churnBench(int numKeys);
+void fullScan(BTreeIndex *index, int &found, double &scanNs);
+void reportFile(const std::string &indexName, BTreeIndex *&index, const char *label);
+void compactBench(int numKeys);
+void ycsbWorker(BTreeIndex *index, int numKeys, int readPercent, int numOps, unsigned int seed);
+void ycsbBench(int numKeys);
+void scanBench(int numKeys);
+void batchBench(int numKeys);
+double rangeSum(BTreeIndex *index, File *relation, int lowVal, int highVal, bool indexOnly);
+void coveringBench(int numKeys);
+const void *makePairKey(BTreeIndex *index, bool composite, int item, int seq, KeyBuffer &key);
+void compositeBench(int numKeys);
+void hashBench(int numKeys);
+void dropFileCache(const std::string &name);
+void appendRows(const std::string &name, int first, int numRows);
+void reopenBench(int numKeys);
+void maintainBench(int numKeys);
+void walBench(int numKeys);
+double relationScan(const std::string &name, BufMgr *scanBufMgr, int &found);
+void checksumBench(int numKeys);
+void mmapBench(int numKeys);
+double readPages(PageFile &file, Page &frame, bool into, int &numPages);
+void readIntoBench(int numKeys);
+void poolBench(int poolMb);
+void scanLoop(const std::string &name, BufMgr *scanBufMgr, std::atomic<bool> *done);
+void poolsBench(int numKeys);
+
+int main(int argc, char **argv)
+{
+	std::string which = argc > 1 ? argv[1] : "all";
+	int numKeys = argc > 2 ? atoi(argv[2]) : 1000000;
+
+	createRelation();
+
+	if (which == "all" || which == "lookup")
+		lookupBench(numKeys);
+	if (which == "all" || which == "prefix")
+		prefixBench(numKeys);
+	if (which == "all" || which == "churn")
+		churnBench(numKeys);
+	if (which == "all" || which == "compact")
+		compactBench(numKeys);
+	if (which == "all" || which == "ycsb")
+		ycsbBench(numKeys);
+	if (which == "all" || which == "scan")
+		scanBench(numKeys);
+	if (which == "all" || which == "batch")
+		batchBench(numKeys);
+	if (which == "all" || which == "covering")
+		coveringBench(numKeys);
+	if (which == "all" || which == "composite")
+		compositeBench(numKeys);
+	if (which == "all" || which == "hash")
+		hashBench(numKeys);
+	if (which == "all" || which == "reopen")
+		reopenBench(numKeys);
+	if (which == "all" || which == "maintain")
+		maintainBench(numKeys);
+	if (which == "all" || which == "wal")
+		walBench(numKeys);
+	if (which == "all" || which == "checksum")
+		checksumBench(numKeys);
+	if (which == "all" || which == "mmap")
+		mmapBench(numKeys);
+	if (which == "all" || which == "readinto")
+		readIntoBench(numKeys);
+	// the pool benchmark takes the size of the pool in MB rather than a number of keys
+	if (which == "pool")
+		poolBench(numKeys);
+	else if (which == "all")
+		poolBench(1024);
+	if (which == "all" || which == "pools")
+		poolsBench(numKeys);
+
+	removeFile(relationName);
+	delete bufMgr;
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+void removeFile(const std::string &name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+double elapsedNs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Creates an empty relation. Benchmarks insert their keys into the index directly, so that
+// building the base relation does not dominate the run time.
+void createRelation()
+{
+	removeFile(relationName);
+	PageFile file = PageFile::create(relationName);
+	PageId pageNo;
+	Page page = file.allocatePage(pageNo);
+	file.writePage(pageNo, page);
+}
+
+// Fills key with the value i converted to the given attribute type
+const void *makeKey(Datatype type, int i, KeyBuffer &key)
+{
+	switch (type)
+	{
+		case INTEGER:
+			key.i = i;
+			return &key.i;
+		case DOUBLE:
+			key.d = i;
+			return &key.d;
+		default:
+			sprintf(key.s, "%08d string record", i);
+			return key.s;
+	}
+}
+
+// Fills key with a URL-like STRING key for i. Keys share a long prefix, cut so that the key fits
+// into STRINGSIZE bytes, followed by the zero-padded number i.
+const char *makePrefixKey(int i, KeyBuffer &key)
+{
+	static const char prefix[] = "https://www.example.com/catalog/item-";
+	int prefixLength = std::min<int>(sizeof(prefix) - 1, std::max(0, STRINGSIZE - 10));
+	sprintf(key.s, "%.*s%010d", prefixLength, prefix, i);
+	return key.s;
+}
+
+// Returns 0..numKeys-1 in random order
+std::vector<int> shuffledKeys(int numKeys)
+{
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++)
+		keys[i] = i;
+	for (int i = numKeys - 1; i > 0; i--)
+		std::swap(keys[i], keys[random() % (i + 1)]);
+	return keys;
+}
+
+// Inserts the keys 0..numKeys-1 in random order, using the key as the rid page number
+void fillIndex(BTreeIndex *index, Datatype type, int numKeys)
+{
+	std::vector<int> keys = shuffledKeys(numKeys);
+
+	KeyBuffer key;
+	for (int i = 0; i < numKeys; i++)
+	{
+		RecordId rid = { (PageId)keys[i] + 1, 1, 0 };
+		index->insertEntry(makeKey(type, keys[i], key), rid);
+	}
+}
+
+// Point lookup through the scan interface; returns the number of matches
+int lookup(BTreeIndex *index, const void *key)
+{
+	int found = 0;
+	try
+	{
+		index->startScan(key, GTE, key, LTE);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+	try
+	{
+		RecordId rid;
+		while (1)
+		{
+			index->scanNext(rid);
+			found++;
+		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index->endScan();
+	return found;
+}
+
+// -----------------------------------------------------------------------------
+// lookupBench: random point lookups on INTEGER, DOUBLE and STRING indexes
+// -----------------------------------------------------------------------------
+
+void lookupBench(int numKeys)
+{
+	const int numLookups = 100000;
+	const char *typeNames[] = { "INTEGER", "DOUBLE", "STRING" };
+	const int offsets[] = { offsetof(tuple, i), offsetof(tuple, d), offsetof(tuple, s) };
+
+	std::cout << "lookup: " << numKeys << " keys, " << numLookups << " random lookups" << std::endl;
+	for (int type = INTEGER; type <= STRING; type++)
+	{
+		std::string indexName;
+		BTreeIndex *index = new BTreeIndex(relationName, indexName, bufMgr, offsets[type], (Datatype)type);
+
+		Clock::time_point start = Clock::now();
+		fillIndex(index, (Datatype)type, numKeys);
+		double buildNs = elapsedNs(start);
+
+		KeyBuffer key;
+		int found = 0;
+		start = Clock::now();
+		for (int n = 0; n < numLookups; n++)
+		{
+			found += lookup(index, makeKey((Datatype)type, random() % numKeys, key));
+		}
+		double lookupNs = elapsedNs(start);
+
+		std::cout << "  " << typeNames[type] << ": build " << buildNs / 1e6 << " ms, "
+			<< lookupNs / numLookups << " ns/lookup, " << found << " found" << std::endl;
+
+		delete index;
+		removeFile(indexName);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// prefixBench: fixed-width versus prefix-compressed STRING nodes
+// -----------------------------------------------------------------------------
+
+void prefixBench(int numKeys)
+{
+	const int numLookups = 100000;
+	KeyBuffer key;
+
+	std::cout << "prefix: " << numKeys << " keys like \"" << makePrefixKey(0, key) << "\", STRINGSIZE "
+		<< STRINGSIZE << ", " << numLookups << " random lookups" << std::endl;
+	for (int compressed = 0; compressed <= 1; compressed++)
+	{
+		std::string indexName;
+		BTreeIndex *index = new BTreeIndex(relationName, indexName, bufMgr, offsetof(tuple, s), STRING, compressed);
+
+		std::vector<int> keys = shuffledKeys(numKeys);
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < numKeys; i++)
+		{
+			RecordId rid = { (PageId)keys[i] + 1, 1, 0 };
+			index->insertEntry(makePrefixKey(keys[i], key), rid);
+		}
+		double buildNs = elapsedNs(start);
+
+		int height, nodes;
+		index->computeShape(height, nodes);
+
+		int found = 0;
+		start = Clock::now();
+		for (int n = 0; n < numLookups; n++)
+		{
+			found += lookup(index, makePrefixKey(random() % numKeys, key));
+		}
+		double lookupNs = elapsedNs(start);
+
+		std::cout << "  " << (compressed ? "prefix-compressed" : "fixed-width") << ": height " << height
+			<< ", " << nodes << " nodes, build " << buildNs / 1e6 << " ms, "
+			<< lookupNs / numLookups << " ns/lookup, " << found << " found" << std::endl;
+
+		delete index;
+		removeFile(indexName);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// churnBench: random deletes and inserts on an INTEGER index of constant size
+// -----------------------------------------------------------------------------
+
+void churnBench(int numKeys)
+{
+	const int numRounds = 10;
+	const int numLookups = 100000;
+	const int keySpace = 4 * numKeys;
+
+	std::cout << "churn: " << numKeys << " live keys out of " << keySpace << ", "
+		<< numKeys / 2 << " deletes and inserts per round" << std::endl;
+
+	std::string indexName;
+	BTreeIndex *index = new BTreeIndex(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+
+	// live holds the keys in the index; position maps a key to its place in live, or -1
+	std::vector<int> live = shuffledKeys(keySpace);
+	live.resize(numKeys);
+	std::vector<int> position(keySpace, -1);
+	for (int i = 0; i < numKeys; i++)
+	{
+		RecordId rid = { (PageId)live[i] + 1, 1, 0 };
+		index->insertEntry(&live[i], rid);
+		position[live[i]] = i;
+	}
+
+	for (int round = 0; round <= numRounds; round++)
+	{
+		Clock::time_point start = Clock::now();
+		if (round > 0)
+		{
+			for (int n = 0; n < numKeys / 2; n++)
+			{
+				// replace a random live key with a random absent one
+				int i = random() % numKeys;
+				int oldKey = live[i];
+				RecordId oldRid = { (PageId)oldKey + 1, 1, 0 };
+				index->deleteEntry(&oldKey, oldRid);
+				position[oldKey] = -1;
+
+				int newKey;
+				do
+				{
+					newKey = random() % keySpace;
+				} while (position[newKey] != -1);
+				RecordId newRid = { (PageId)newKey + 1, 1, 0 };
+				index->insertEntry(&newKey, newRid);
+				live[i] = newKey;
+				position[newKey] = i;
+			}
+		}
+		double churnNs = elapsedNs(start);
+
+		int found = 0;
+		start = Clock::now();
+		for (int n = 0; n < numLookups; n++)
+		{
+			found += lookup(index, &live[random() % numKeys]);
+		}
+		double lookupNs = elapsedNs(start);
+
+		int height, nodes;
+		index->computeShape(height, nodes);
+		std::ifstream indexFile(indexName.c_str(), std::ios::binary | std::ios::ate);
+
+		std::cout << "  round " << round << ": " << (round > 0 ? churnNs / (numKeys / 2) : 0) << " ns/delete+insert, height " << height
+			<< ", " << nodes << " nodes, file " << indexFile.tellg() / 1024 << " KB, "
+			<< lookupNs / numLookups << " ns/lookup, " << found << " found" << std::endl;
+	}
+
+	delete index;
+	removeFile(indexName);
+}
+
+// -----------------------------------------------------------------------------
+// compactBench: full scans of an INTEGER index before and after compaction
+// -----------------------------------------------------------------------------
+
+// Scans the whole index, counting the entries and timing the scan
+void fullScan(BTreeIndex *index, int &found, double &scanNs)
+{
+	int low = 0;
+	int high = INT32_MAX;
+	found = 0;
+	Clock::time_point start = Clock::now();
+	index->startScan(&low, GTE, &high, LTE);
+	try
+	{
+		RecordId rid;
+		while (1)
+		{
+			index->scanNext(rid);
+			found++;
+		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index->endScan();
+	scanNs = elapsedNs(start);
+}
+
+// Closes the index and reports the size and free pages of its file, then a full scan of the
+// reopened index, which starts with none of its pages in the buffer pool
+void reportFile(const std::string &indexName, BTreeIndex *&index, const char *label)
+{
+	delete index;
+
+	PageId numFreePages;
+	{
+		BlobFile file(indexName, false);
+		numFreePages = file.getNumFreePages();
+	}
+	std::ifstream indexFile(indexName.c_str(), std::ios::binary | std::ios::ate);
+	long long fileKB = indexFile.tellg() / 1024;
+
+	std::string name;
+	index = new BTreeIndex(relationName, name, bufMgr, offsetof(tuple, i), INTEGER);
+	int found;
+	double scanNs;
+	fullScan(index, found, scanNs);
+
+	std::cout << "  " << label << ": file " << fileKB << " KB, " << numFreePages << " free pages, cold full scan "
+		<< scanNs / 1e6 << " ms, " << found << " found" << std::endl;
+}
+
+void compactBench(int numKeys)
+{
+	std::cout << "compact: " << numKeys << " keys in random order, then every other key deleted" << std::endl;
+
+	std::string indexName;
+	BTreeIndex *index = new BTreeIndex(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	fillIndex(index, INTEGER, numKeys);
+	for (int i = 0; i < numKeys; i += 2)
+	{
+		RecordId rid = { (PageId)i + 1, 1, 0 };
+		index->deleteEntry(&i, rid);
+	}
+	reportFile(indexName, index, "before");
+
+	Clock::time_point start = Clock::now();
+	index->compact();
+	double compactNs = elapsedNs(start);
+	std::cout << "  compact " << compactNs / 1e6 << " ms" << std::endl;
+	reportFile(indexName, index, "after");
+
+	delete index;
+	removeFile(indexName);
+}
+
+// -----------------------------------------------------------------------------
+// ycsbBench: lookups and inserts from several threads on one INTEGER index
+// -----------------------------------------------------------------------------
+
+// Next key to insert; every insert takes a new one above the preloaded keys
+std::atomic<int> nextInsertKey;
+
+void ycsbWorker(BTreeIndex *index, int numKeys, int readPercent, int numOps, unsigned int seed)
+{
+	for (int n = 0; n < numOps; n++)
+	{
+		if ((int)(rand_r(&seed) % 100) < readPercent)
+		{
+			int key = rand_r(&seed) % numKeys;
+			RecordId rid;
+			index->lookupEntry(&key, rid);
+		}
+		else
+		{
+			int key = nextInsertKey++;
+			RecordId rid = { (PageId)key + 1, 1, 0 };
+			index->insertEntry(&key, rid);
+		}
+	}
+}
+
+void ycsbBench(int numKeys)
+{
+	const int numOps = 400000;
+	const int readPercents[] = { 95, 50, 5 };
+	const char *workloadNames[] = { "read-heavy", "50/50", "insert-heavy" };
+	const int threadCounts[] = { 1, 2, 4, 8 };
+
+	std::cout << "ycsb: " << numKeys << " preloaded keys, " << numOps << " operations per run, "
+		<< std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+	std::string indexName;
+	BTreeIndex *index = new BTreeIndex(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	fillIndex(index, INTEGER, numKeys);
+	nextInsertKey = numKeys;
+
+	for (int w = 0; w < 3; w++)
+	{
+		std::cout << "  " << workloadNames[w] << " (" << readPercents[w] << "% lookups):";
+		for (int c = 0; c < 4; c++)
+		{
+			const int numThreads = threadCounts[c];
+			std::vector<std::thread> threads;
+			Clock::time_point start = Clock::now();
+			for (int t = 0; t < numThreads; t++)
+			{
+				threads.push_back(std::thread(ycsbWorker, index, numKeys, readPercents[w], numOps / numThreads, 31 * t + w + 1));
+			}
+			for (int t = 0; t < numThreads; t++)
+			{
+				threads[t].join();
+			}
+			double runNs = elapsedNs(start);
+			std::cout << " " << numThreads << "t " << numOps / runNs * 1e3 << " Mops/s" << (c < 3 ? "," : "");
+		}
+		std::cout << std::endl;
+	}
+
+	delete index;
+	removeFile(indexName);
+}
+
+// -----------------------------------------------------------------------------
+// scanBench: one range scan over the whole index, one entry or one batch at a time
+// -----------------------------------------------------------------------------
+
+void scanBench(int numKeys)
+{
+	const int numScans = 10;
+	const size_t batchSizes[] = { 1, 64, 1024 };
+
+	std::cout << "scan: " << numKeys << " keys, " << numScans << " scans of the whole range" << std::endl;
+	std::string indexName;
+	BTreeIndex *index = new BTreeIndex(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	fillIndex(index, INTEGER, numKeys);
+
+	int found;
+	double scanNs = 0, ns;
+	fullScan(index, found, ns);
+	for (int n = 0; n < numScans; n++)
+	{
+		fullScan(index, found, ns);
+		scanNs += ns;
+	}
+	std::cout << "  scanNext: " << scanNs / numScans / 1e6 << " ms/scan, " << scanNs / numScans / found
+		<< " ns/entry, " << found << " found" << std::endl;
+
+	int low = 0;
+	int high = INT32_MAX;
+	for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++)
+	{
+		std::vector<RecordId> rids(batchSizes[b]);
+		scanNs = 0;
+		for (int n = 0; n < numScans; n++)
+		{
+			found = 0;
+			Clock::time_point start = Clock::now();
+			index->startScan(&low, GTE, &high, LTE);
+			size_t numRids;
+			while ((numRids = index->scanNextBatch(&rids[0], rids.size())) > 0)
+			{
+				found += numRids;
+			}
+			index->endScan();
+			scanNs += elapsedNs(start);
+		}
+		std::cout << "  scanNextBatch(" << batchSizes[b] << "): " << scanNs / numScans / 1e6 << " ms/scan, "
+			<< scanNs / numScans / found << " ns/entry, " << found << " found" << std::endl;
+	}
+
+	delete index;
+	removeFile(indexName);
+}
+
+// -----------------------------------------------------------------------------
+// batchBench: point lookups one at a time and in batches, with random and clustered keys
+// -----------------------------------------------------------------------------
+
+void batchBench(int numKeys)
+{
+	const int numProbes = 1 << 17;
+	const size_t batchSizes[] = { 1, 64, 1024 };
+	const char *patterns[] = { "random", "clustered" };
+
+	std::cout << "batch: " << numKeys << " keys, " << numProbes << " probes" << std::endl;
+	std::string indexName;
+	BTreeIndex *index = new BTreeIndex(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	fillIndex(index, INTEGER, numKeys);
+
+	for (int pattern = 0; pattern < 2; pattern++)
+	{
+		// clustered probes of a batch fall within a window a few times the batch size
+		for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++)
+		{
+			const size_t batchSize = batchSizes[b];
+			std::vector<int> keys(numProbes);
+			for (int n = 0; n < numProbes; n += batchSize)
+			{
+				const int window = 4 * batchSize;
+				const int base = random() % (numKeys - window);
+				for (size_t k = 0; k < batchSize; k++)
+					keys[n + k] = pattern == 0 ? random() % numKeys : base + random() % window;
+			}
+			std::vector<const void*> keyPtrs(numProbes);
+			for (int n = 0; n < numProbes; n++)
+				keyPtrs[n] = &keys[n];
+
+			// the same probes through lookupEntry first, for comparison; the batches then run on a buffer pool
+			// that holds the pages of the last probes rather than their own
+			RecordId rid;
+			Clock::time_point start = Clock::now();
+			for (int n = 0; n < numProbes; n++)
+			{
+				index->lookupEntry(keyPtrs[n], rid);
+			}
+			double singleNs = elapsedNs(start);
+
+			std::vector<RecordId> rids(batchSize);
+			bool *found = new bool[batchSize];
+			size_t numFound = 0;
+			start = Clock::now();
+			for (int n = 0; n < numProbes; n += batchSize)
+			{
+				numFound += index->lookupBatch(&keyPtrs[n], batchSize, &rids[0], found);
+			}
+			double batchNs = elapsedNs(start);
+			delete [] found;
+
+			std::cout << "  " << patterns[pattern] << ", batch " << batchSize << ": lookupBatch "
+				<< numProbes / batchNs * 1e3 << " Mprobes/s, lookupEntry " << numProbes / singleNs * 1e3
+				<< " Mprobes/s, " << numFound << " found" << std::endl;
+		}
+	}
+
+	delete index;
+	removeFile(indexName);
+}
+
+// -----------------------------------------------------------------------------
+// coveringBench: range aggregates through the base relation and from a covering index
+// -----------------------------------------------------------------------------
+
+// Sums the DOUBLE field over the INTEGER keys in [lowVal,highVal), from the included attributes of the index or
+// from the records
+double rangeSum(BTreeIndex *index, File *relation, int lowVal, int highVal, bool indexOnly)
+{
+	const size_t batchSize = 256;
+	RecordId rids[batchSize];
+	double payloads[batchSize];
+	double sum = 0;
+	size_t numRids;
+
+	index->startScan(&lowVal, GTE, &highVal, LT);
+	while ((numRids = indexOnly ? index->scanNextBatch(rids, payloads, batchSize) : index->scanNextBatch(rids, batchSize)) > 0)
+	{
+		for (size_t i = 0; i < numRids; i++)
+		{
+			if (indexOnly)
+			{
+				sum += payloads[i];
+				continue;
+			}
+			Page *page;
+			bufMgr->readPage(relation, rids[i].page_number, page);
+			sum += reinterpret_cast<const RECORD*>(page->getRecord(rids[i]).data())->d;
+			bufMgr->unPinPage(relation, rids[i].page_number, false);
+		}
+	}
+	index->endScan();
+	return sum;
+}
+
+void coveringBench(int numKeys)
+{
+	const std::string coveredName = "benchCovered";
+	const int numQueries = 20;
+	const int rangeSizes[] = { 1000, 100000 };
+
+	// a relation of numKeys records in random key order, so that neighbouring keys are on different pages
+	removeFile(coveredName);
+	{
+		PageFile file = PageFile::create(coveredName);
+		std::vector<int> keys = shuffledKeys(numKeys);
+		PageId pageNo;
+		Page page = file.allocatePage(pageNo);
+		for (int n = 0; n < numKeys; n++)
+		{
+			RECORD record;
+			memset(&record, 0, sizeof(record));
+			record.i = keys[n];
+			record.d = keys[n];
+			std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+			if (!page.hasSpaceForRecord(data))
+			{
+				file.writePage(pageNo, page);
+				page = file.allocatePage(pageNo);
+			}
+			page.insertRecord(data);
+		}
+		file.writePage(pageNo, page);
+	}
+
+	std::cout << "covering: " << numKeys << " records, sum of the DOUBLE field over INTEGER key ranges" << std::endl;
+	PageFile *relation = new PageFile(coveredName, false);
+	for (int covering = 0; covering < 2; covering++)
+	{
+		// both indexes answer the same queries
+		srandom(1);
+
+		std::string indexName;
+		Clock::time_point start = Clock::now();
+		BTreeIndex *index = new BTreeIndex(coveredName, indexName, bufMgr, offsetof(tuple, i), INTEGER, false,
+		                                   covering ? offsetof(tuple, d) : 0, covering ? sizeof(double) : 0);
+		double buildNs = elapsedNs(start);
+		int height, nodes;
+		index->computeShape(height, nodes);
+		std::cout << "  " << (covering ? "covering index, index-only" : "plain index, records fetched") << ": build "
+			<< buildNs / 1e6 << " ms, " << nodes << " nodes" << std::endl;
+
+		for (size_t r = 0; r < sizeof(rangeSizes) / sizeof(rangeSizes[0]); r++)
+		{
+			const int rangeSize = std::min(rangeSizes[r], numKeys);
+			double sum = 0;
+			start = Clock::now();
+			for (int q = 0; q < numQueries; q++)
+			{
+				const int low = random() % (numKeys - rangeSize + 1);
+				sum += rangeSum(index, relation, low, low + rangeSize, covering);
+			}
+			double queryNs = elapsedNs(start);
+			std::cout << "    range " << rangeSize << ": " << queryNs / numQueries / 1e3 << " us/query, "
+				<< queryNs / numQueries / rangeSize << " ns/entry, checksum " << sum << std::endl;
+		}
+
+		delete index;
+		removeFile(indexName);
+	}
+	bufMgr->flushFile(relation);
+	delete relation;
+	removeFile(coveredName);
+}
+
+// -----------------------------------------------------------------------------
+// compositeBench: (INTEGER, INTEGER) composite keys versus the same pairs concatenated into a STRING key
+// -----------------------------------------------------------------------------
+
+// Fills key with the pair (item, seq), encoded by a composite index or printed as two zero-padded numbers of
+// STRINGSIZE / 2 digits each
+const void *makePairKey(BTreeIndex *index, bool composite, int item, int seq, KeyBuffer &key)
+{
+	if (composite)
+	{
+		const void *values[2] = { &item, &seq };
+		index->encodeKey(values, 2, key.s);
+	}
+	else
+	{
+		sprintf(key.s, "%0*d%0*d", STRINGSIZE / 2, item, STRINGSIZE - STRINGSIZE / 2, seq);
+	}
+	return key.s;
+}
+
+void compositeBench(int numKeys)
+{
+	const int groupSize = 16;
+	const int numLookups = 100000;
+	const int numPrefixScans = 10000;
+	const int numItems = (numKeys + groupSize - 1) / groupSize;
+
+	std::cout << "composite: " << numKeys << " (item, seq) keys, " << groupSize << " per item, " << numLookups
+		<< " random lookups, " << numPrefixScans << " scans of one item" << std::endl;
+	for (int composite = 0; composite < 2; composite++)
+	{
+		srandom(1);
+
+		// keys are inserted directly, so the attribute offsets only name the index file
+		std::string indexName;
+		BTreeIndex *index;
+		if (composite)
+		{
+			std::vector<KeyPart> parts(2);
+			parts[0].byteOffset = offsetof(tuple, i);
+			parts[0].type = INTEGER;
+			parts[1].byteOffset = offsetof(tuple, s);
+			parts[1].type = INTEGER;
+			index = new BTreeIndex(relationName, indexName, bufMgr, parts);
+		}
+		else
+		{
+			index = new BTreeIndex(relationName, indexName, bufMgr, offsetof(tuple, s), STRING);
+		}
+
+		std::vector<int> keys = shuffledKeys(numKeys);
+		KeyBuffer key;
+		Clock::time_point start = Clock::now();
+		for (int n = 0; n < numKeys; n++)
+		{
+			RecordId rid = { (PageId)keys[n] + 1, 1, 0 };
+			index->insertEntry(makePairKey(index, composite, keys[n] / groupSize, keys[n] % groupSize, key), rid);
+		}
+		double buildNs = elapsedNs(start);
+		int height, nodes;
+		index->computeShape(height, nodes);
+
+		int found = 0;
+		start = Clock::now();
+		for (int n = 0; n < numLookups; n++)
+		{
+			const int k = random() % numKeys;
+			RecordId rid;
+			try
+			{
+				index->lookupEntry(makePairKey(index, composite, k / groupSize, k % groupSize, key), rid);
+				found++;
+			}
+			catch(const NoSuchKeyFoundException &e)
+			{
+			}
+		}
+		double lookupNs = elapsedNs(start);
+
+		// all the entries of one item: a prefix scan, or a range over the STRING keys of the item's first and last pair
+		int scanned = 0;
+		RecordId rids[64];
+		size_t numRids;
+		start = Clock::now();
+		for (int n = 0; n < numPrefixScans; n++)
+		{
+			const int item = random() % numItems;
+			try
+			{
+				if (composite)
+				{
+					const void *values[1] = { &item };
+					index->startPrefixScan(values, 1);
+				}
+				else
+				{
+					KeyBuffer highKey;
+					makePairKey(index, composite, item, 0, key);
+					makePairKey(index, composite, item, groupSize - 1, highKey);
+					index->startScan(key.s, GTE, highKey.s, LTE);
+				}
+			}
+			catch(const NoSuchKeyFoundException &e)
+			{
+				continue;
+			}
+			while ((numRids = index->scanNextBatch(rids, 64)) > 0)
+				scanned += numRids;
+			index->endScan();
+		}
+		double scanNs = elapsedNs(start);
+
+		std::cout << "  " << (composite ? "composite key" : "concatenated STRING key") << ": build "
+			<< buildNs / 1e6 << " ms, " << nodes << " nodes, " << lookupNs / numLookups << " ns/lookup (" << found
+			<< " found), " << scanNs / numPrefixScans << " ns/item scan (" << scanned << " entries)" << std::endl;
+
+		delete index;
+		removeFile(indexName);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// hashBench: point lookups in a hash index versus a B+ tree on the same INTEGER keys
+// -----------------------------------------------------------------------------
+
+void hashBench(int numKeys)
+{
+	const int numLookups = 100000;
+
+	std::cout << "hash: " << numKeys << " INTEGER keys, " << numLookups << " random lookups" << std::endl;
+	for (int hashed = 0; hashed < 2; hashed++)
+	{
+		srandom(1);
+
+		std::string indexName;
+		BTreeIndex *tree = NULL;
+		HashIndex *hash = NULL;
+		if (hashed)
+			hash = new HashIndex(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+		else
+			tree = new BTreeIndex(relationName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+
+		std::vector<int> keys = shuffledKeys(numKeys);
+		Clock::time_point start = Clock::now();
+		for (int n = 0; n < numKeys; n++)
+		{
+			RecordId rid = { (PageId)keys[n] + 1, 1, 0 };
+			if (hashed)
+				hash->insertEntry(&keys[n], rid);
+			else
+				tree->insertEntry(&keys[n], rid);
+		}
+		double buildNs = elapsedNs(start);
+
+		// pages on the path of a probe: every level of the tree, or a bucket and, on average, its share of overflow pages
+		double pagesPerProbe;
+		int pages;
+		if (hashed)
+		{
+			int depth, buckets, overflowPages;
+			hash->computeShape(depth, buckets, overflowPages);
+			pagesPerProbe = 1 + (double)overflowPages / buckets;
+			pages = buckets + overflowPages;
+		}
+		else
+		{
+			int height;
+			tree->computeShape(height, pages);
+			pagesPerProbe = height;
+		}
+
+		int found = 0;
+		bufMgr->clearBufStats();
+		start = Clock::now();
+		for (int n = 0; n < numLookups; n++)
+		{
+			const int k = random() % numKeys;
+			RecordId rid;
+			try
+			{
+				if (hashed)
+					hash->lookupEntry(&k, rid);
+				else
+					tree->lookupEntry(&k, rid);
+				found++;
+			}
+			catch(const NoSuchKeyFoundException &e)
+			{
+			}
+		}
+		double lookupNs = elapsedNs(start);
+		double readsPerProbe = (double)bufMgr->getBufStats().diskreads / numLookups;
+
+		std::cout << "  " << (hashed ? "extendible hash" : "B+ tree") << ": build " << buildNs / 1e6 << " ms, "
+			<< pages << " pages, " << lookupNs / numLookups << " ns/lookup (" << found << " found), "
+			<< pagesPerProbe << " pages/probe, " << readsPerProbe << " disk reads/probe" << std::endl;
+
+		delete tree;
+		delete hash;
+		removeFile(indexName);
+	}
+}
+
+// Writes the file's pages out and asks the kernel to drop them from its page cache, so that the next reads go to disk
+void dropFileCache(const std::string &name)
+{
+	int fd = open(name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+// Appends records with the keys first..first+numRows-1 to the relation, writing each page once it is full
+void appendRows(const std::string &name, int first, int numRows)
+{
+	PageFile file = PageFile::open(name);
+	RECORD record;
+	memset(&record, 0, sizeof(record));
+	PageId pageNo;
+	Page page = file.allocatePage(pageNo);
+	for (int i = first; i < first + numRows; i++)
+	{
+		record.i = i;
+		std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+		if (!page.hasSpaceForRecord(data))
+		{
+			file.writePage(pageNo, page);
+			page = file.allocatePage(pageNo);
+		}
+		file.insertRecord(page, data);
+	}
+	file.writePage(pageNo, page);
+}
+
+// Builds an index over a relation of numKeys records, and times opening it again unchanged, after a page was added
+// to the relation (the index is out of date and rebuilt from the relation), and after its meta page was damaged
+void reopenBench(int numKeys)
+{
+	const std::string rowsName = relationName + ".rows";
+	std::cout << "reopen: " << numKeys << " records in the relation" << std::endl;
+	removeFile(rowsName);
+	PageFile::create(rowsName);
+	appendRows(rowsName, 0, numKeys);
+
+	std::string indexName;
+	Clock::time_point start = Clock::now();
+	BTreeIndex *index = new BTreeIndex(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	double buildNs = elapsedNs(start);
+	delete index;
+
+	start = Clock::now();
+	index = new BTreeIndex(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	double reopenNs = elapsedNs(start);
+	std::int64_t entries = index->getStats().numEntries;
+	delete index;
+
+	{
+		PageFile file = PageFile::open(rowsName);
+		PageId pageNo;
+		file.allocatePage(pageNo);
+	}
+	start = Clock::now();
+	index = new BTreeIndex(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	double changedNs = elapsedNs(start);
+	delete index;
+
+	{
+		BlobFile file = BlobFile::open(indexName);
+		const PageId metaPageNo = file.getFirstPageNo();
+		Page metaPage = file.readPage(metaPageNo);
+		reinterpret_cast<IndexMetaInfo*>(&metaPage)->numEntries++;
+		file.writePage(metaPageNo, metaPage);
+	}
+	start = Clock::now();
+	index = new BTreeIndex(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	double damagedNs = elapsedNs(start);
+	delete index;
+
+	std::cout << "  build " << buildNs / 1e6 << " ms, reopen " << reopenNs / 1e6 << " ms (" << entries
+		<< " entries), reopen after the relation changed " << changedNs / 1e6 << " ms, reopen with a damaged meta page "
+		<< damagedNs / 1e6 << " ms" << std::endl;
+
+	removeFile(indexName);
+	removeFile(rowsName);
+}
+
+// Appends numKeys records to a relation with an open index, which picks them up as the pages are written, and to one
+// without, whose index is then rebuilt
+void maintainBench(int numKeys)
+{
+	const std::string rowsName = relationName + ".rows";
+	std::cout << "maintain: " << numKeys << " records appended to the relation" << std::endl;
+
+	removeFile(rowsName);
+	PageFile::create(rowsName);
+	std::string indexName;
+	BTreeIndex *index = new BTreeIndex(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	Clock::time_point start = Clock::now();
+	appendRows(rowsName, 0, numKeys);
+	double appendNs = elapsedNs(start);
+	start = Clock::now();
+	std::int64_t entries = index->getStats().numEntries;
+	double applyNs = elapsedNs(start);
+	delete index;
+	removeFile(indexName);
+	std::cout << "  incremental: append " << appendNs / 1e6 << " ms, then " << applyNs / 1e6 << " ms to apply "
+		<< entries << " entries" << std::endl;
+
+	removeFile(rowsName);
+	PageFile::create(rowsName);
+	start = Clock::now();
+	appendRows(rowsName, 0, numKeys);
+	appendNs = elapsedNs(start);
+	start = Clock::now();
+	index = new BTreeIndex(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	double buildNs = elapsedNs(start);
+	entries = index->getStats().numEntries;
+	delete index;
+	std::cout << "  rebuild: append " << appendNs / 1e6 << " ms without an index, then " << buildNs / 1e6
+		<< " ms to build " << entries << " entries" << std::endl;
+
+	removeFile(indexName);
+	removeFile(rowsName);
+}
+
+// Inserts numKeys keys in random order into an index whose buffer manager does not log, and into ones whose buffer
+// manager logs every insert and syncs the log once per 1, 8 and 64 of them, losing up to the last 7 and 63 on a crash for the latter two
+void walBench(int numKeys)
+{
+	const std::string logName = relationName + ".log";
+	const int syncIntervals[] = { 0, 1, 8, 64 };
+	std::vector<int> keys = shuffledKeys(numKeys);
+	std::cout << "wal: " << numKeys << " inserts" << std::endl;
+
+	for (int g = 0; g < 4; g++)
+	{
+		removeFile(logName);
+		WriteAheadLog *log = syncIntervals[g] > 0 ? new WriteAheadLog(logName, syncIntervals[g]) : NULL;
+		BufMgr *loggedBufMgr = new BufMgr(1000, log);
+		std::string indexName;
+		BTreeIndex *index = new BTreeIndex(relationName, indexName, loggedBufMgr, offsetof(tuple, i), INTEGER);
+
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < numKeys; i++)
+		{
+			RecordId rid = { (PageId)keys[i] + 1, 1, 0 };
+			index->insertEntry(&keys[i], rid);
+		}
+		double insertNs = elapsedNs(start);
+
+		if (log == NULL)
+			std::cout << "  no log: ";
+		else
+			std::cout << "  sync every " << syncIntervals[g] << " commits (up to " << syncIntervals[g] - 1
+				<< " lost on crash): ";
+		std::cout << numKeys / (insertNs / 1e9) << " inserts/s";
+		if (log != NULL)
+		{
+			const LogStats &stats = log->getStats();
+			std::cout << ", " << stats.syncs << " syncs, " << stats.bytes / numKeys << " log bytes per insert";
+		}
+		std::cout << std::endl;
+
+		delete index;
+		delete loggedBufMgr;
+		delete log;
+		removeFile(indexName);
+	}
+	removeFile(logName);
+}
+
+// Scans all the records of a relation, returning the time taken
+double relationScan(const std::string &name, BufMgr *scanBufMgr, int &found)
+{
+	found = 0;
+	Clock::time_point start = Clock::now();
+	FileScan scan(name, scanBufMgr);
+	try
+	{
+		RecordId rid;
+		while (1)
+		{
+			scan.scanNext(rid);
+			found++;
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	return elapsedNs(start);
+}
+
+// Times full scans of a relation of numKeys records and of an index over it, with the checksum policy off and with
+// every page read from its file verified. The buffer pools are much smaller than the files, so every page is read.
+void checksumBench(int numKeys)
+{
+	const std::string rowsName = relationName + ".rows";
+	const ChecksumPolicy policies[] = { CHECKSUM_OFF, CHECKSUM_VERIFY };
+	const char *labels[] = { "off", "verify" };
+	std::cout << "checksum: " << numKeys << " records in the relation" << std::endl;
+	removeFile(rowsName);
+	PageFile::create(rowsName);
+	appendRows(rowsName, 0, numKeys);
+	std::string indexName;
+	{
+		BTreeIndex index(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	}
+
+	for (int p = 0; p < 2; p++)
+	{
+		File::setChecksumPolicy(policies[p]);
+		BufMgr *scanBufMgr = new BufMgr(64);
+		BTreeIndex *index = new BTreeIndex(rowsName, indexName, scanBufMgr, offsetof(tuple, i), INTEGER);
+
+		// the best of a few runs, the files being in the kernel page cache after the first
+		double relationNs = 0, indexNs = 0;
+		int relationFound = 0, indexFound = 0;
+		for (int run = 0; run < 3; run++)
+		{
+			double ns = relationScan(rowsName, scanBufMgr, relationFound);
+			relationNs = run == 0 ? ns : std::min(relationNs, ns);
+			fullScan(index, indexFound, ns);
+			indexNs = run == 0 ? ns : std::min(indexNs, ns);
+		}
+		std::cout << "  " << labels[p] << ": relation scan " << relationNs / 1e6 << " ms (" << relationFound
+			<< " records), index scan " << indexNs / 1e6 << " ms (" << indexFound << " entries)" << std::endl;
+
+		delete index;
+		delete scanBufMgr;
+	}
+	File::setChecksumPolicy(CHECKSUM_VERIFY);
+
+	removeFile(indexName);
+	removeFile(rowsName);
+}
+
+// Times a full scan of a relation of numKeys records and random lookups in an index over it, through buffer frames
+// and with both files mapped read-only, cold (files dropped from the kernel page cache) and warm (the same again)
+void mmapBench(int numKeys)
+{
+	const std::string rowsName = relationName + ".rows";
+	const int numLookups = std::min(numKeys, 100000);
+	std::cout << "mmap: " << numKeys << " records in the relation, " << numLookups << " random lookups" << std::endl;
+	removeFile(rowsName);
+	PageFile::create(rowsName);
+	appendRows(rowsName, 0, numKeys);
+	std::string indexName;
+	{
+		BTreeIndex index(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	}
+	std::vector<int> keys = shuffledKeys(numKeys);
+
+	for (int mapped = 0; mapped < 2; mapped++)
+	{
+		if (mapped)
+		{
+			File::mapReadOnly(rowsName);
+			File::mapReadOnly(indexName);
+		}
+		dropFileCache(rowsName);
+		dropFileCache(indexName);
+		BufMgr *scanBufMgr = new BufMgr(1000);
+		BTreeIndex *index = new BTreeIndex(rowsName, indexName, scanBufMgr, offsetof(tuple, i), INTEGER);
+
+		for (int warm = 0; warm < 2; warm++)
+		{
+			int found = 0;
+			const double scanNs = relationScan(rowsName, scanBufMgr, found);
+			int matches = 0;
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < numLookups; i++)
+			{
+				matches += lookup(index, &keys[i]);
+			}
+			const double lookupNs = elapsedNs(start);
+			std::cout << "  " << (mapped ? "mapped" : "buffered") << ", " << (warm ? "warm" : "cold") << ": scan "
+				<< scanNs / 1e6 << " ms (" << found << " records), lookups " << lookupNs / numLookups << " ns each ("
+				<< matches << " found)" << std::endl;
+		}
+
+		delete index;
+		delete scanBufMgr;
+		File::unmap(rowsName);
+		File::unmap(indexName);
+	}
+
+	removeFile(indexName);
+	removeFile(rowsName);
+}
+
+// Reads every page of a file into one frame, by value (frame = readPage()) or in place (readPageInto()), returning
+// the time taken
+double readPages(PageFile &file, Page &frame, bool into, int &numPages)
+{
+	numPages = 0;
+	Clock::time_point start = Clock::now();
+	for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+	{
+		if (into)
+			file.readPageInto(iter.page_number(), frame);
+		else
+			frame = file.readPage(iter.page_number());
+		numPages++;
+	}
+	return elapsedNs(start);
+}
+
+// Times reading the pages of a relation of numKeys records into a frame, by value and in place, and the buffer
+// manager miss path of a full scan through a small pool, cold (file dropped from the kernel page cache) and warm.
+// The rate in MB/s is that of page bytes delivered into frames.
+void readIntoBench(int numKeys)
+{
+	const std::string rowsName = relationName + ".rows";
+	std::cout << "readinto: " << numKeys << " records in the relation" << std::endl;
+	removeFile(rowsName);
+	PageFile::create(rowsName);
+	appendRows(rowsName, 0, numKeys);
+
+	{
+		PageFile file = PageFile::open(rowsName);
+		Page frame;
+		const char *labels[] = { "readPage", "readPageInto" };
+		for (int into = 0; into < 2; into++)
+		{
+			// the best of a few runs, the file being in the kernel page cache
+			double ns = 0;
+			int numPages = 0;
+			for (int run = 0; run < 3; run++)
+			{
+				const double runNs = readPages(file, frame, into, numPages);
+				ns = run == 0 ? runNs : std::min(ns, runNs);
+			}
+			std::cout << "  " << labels[into] << ": " << ns / numPages << " ns per page, "
+				<< numPages * double(Page::SIZE) / (ns / 1e9) / 1e6 << " MB/s (" << numPages << " pages)" << std::endl;
+		}
+	}
+
+	dropFileCache(rowsName);
+	BufMgr *scanBufMgr = new BufMgr(64);
+	for (int warm = 0; warm < 2; warm++)
+	{
+		int found = 0;
+		const int diskreads = scanBufMgr->getBufStats().diskreads;
+		const double ns = relationScan(rowsName, scanBufMgr, found);
+		const int misses = scanBufMgr->getBufStats().diskreads - diskreads;
+		std::cout << "  buffer scan, " << (warm ? "warm" : "cold") << ": " << ns / misses << " ns per miss, "
+			<< misses * double(Page::SIZE) / (ns / 1e9) / 1e6 << " MB/s (" << misses << " misses, " << found
+			<< " records)" << std::endl;
+	}
+	delete scanBufMgr;
+
+	removeFile(rowsName);
+}
+
+// Fills a buffer pool of poolMb MB with the pages of a file, with regular pages and with huge pages, and times the
+// clock sweep and the hit path. Each round hits every frame once in random order, reading the page number from the
+// page, and then misses once, which sweeps the whole pool clearing the reference bits before it finds a frame.
+void poolBench(int poolMb)
+{
+	const std::string blobName = relationName + ".pool";
+	const std::uint32_t numFrames = std::uint32_t(poolMb) * (1024 * 1024 / Page::SIZE);
+	const int numRounds = 5;
+	std::cout << "pool: " << poolMb << " MB, " << numFrames << " frames" << std::endl;
+	removeFile(blobName);
+	{
+		BlobFile file = BlobFile::create(blobName);
+		PageId pageNo;
+		for (std::uint32_t i = 0; i < numFrames + numRounds; i++)
+			file.allocatePage(pageNo);
+	}
+	std::vector<int> order = shuffledKeys(numFrames);
+
+	const int flags[] = { 0, POOL_HUGE_PAGES };
+	for (int f = 0; f < 2; f++)
+	{
+		BlobFile file = BlobFile::open(blobName);
+		BufMgr *poolBufMgr = new BufMgr(numFrames, NULL, flags[f]);
+		std::vector<PageId> frameOwner(numFrames);
+		Page *page;
+
+		Clock::time_point start = Clock::now();
+		for (PageId pageNo = 1; pageNo <= numFrames; pageNo++)
+		{
+			poolBufMgr->readPage(&file, pageNo, page);
+			frameOwner[page - poolBufMgr->bufPool] = pageNo;
+			poolBufMgr->unPinPage(&file, pageNo, false);
+		}
+		const double fillNs = elapsedNs(start);
+
+		double hitNs = 0, sweepNs = 0;
+		std::uint64_t matched = 0;
+		for (int round = 0; round < numRounds; round++)
+		{
+			start = Clock::now();
+			for (std::uint32_t i = 0; i < numFrames; i++)
+			{
+				const PageId pageNo = frameOwner[order[i]];
+				poolBufMgr->readPage(&file, pageNo, page);
+				// the pages of a blob file are blank, so a hit finds the frame it expects with no page number in it
+				matched += page == poolBufMgr->bufPool + order[i] && page->page_number() == Page::INVALID_NUMBER;
+				poolBufMgr->unPinPage(&file, pageNo, false);
+			}
+			hitNs += elapsedNs(start);
+
+			const PageId pageNo = numFrames + 1 + round;
+			start = Clock::now();
+			poolBufMgr->readPage(&file, pageNo, page);
+			sweepNs += elapsedNs(start);
+			frameOwner[page - poolBufMgr->bufPool] = pageNo;
+			poolBufMgr->unPinPage(&file, pageNo, false);
+		}
+
+		std::cout << "  " << (flags[f] ? "huge pages" : "regular pages")
+			<< (poolBufMgr->getPoolFlags() == flags[f] ? "" : " (not granted)") << ": fill " << fillNs / 1e6
+			<< " ms, sweep " << sweepNs / numRounds / numFrames << " ns per frame, hit " << hitNs / numRounds / numFrames
+			<< " ns (" << matched << " hits in place)" << std::endl;
+		delete poolBufMgr;
+	}
+
+	removeFile(blobName);
+}
+
+// Scans all the records of a relation over and over until done
+void scanLoop(const std::string &name, BufMgr *scanBufMgr, std::atomic<bool> *done)
+{
+	while (!*done)
+	{
+		int found = 0;
+		relationScan(name, scanBufMgr, found);
+	}
+}
+
+// Times random lookups in an index over a relation of numKeys records while another thread scans the relation over
+// and over, once with the index and the relation sharing one buffer pool, and once with the same frames split into
+// an index pool that holds the whole index and a small FIFO pool for the relation. Reports the median and 99th
+// percentile lookup latency.
+void poolsBench(int numKeys)
+{
+	const std::string rowsName = relationName + ".rows";
+	const int numLookups = std::min(numKeys, 200000);
+	std::cout << "pools: " << numKeys << " records in the relation, " << numLookups << " random lookups" << std::endl;
+	removeFile(rowsName);
+	PageFile::create(rowsName);
+	appendRows(rowsName, 0, numKeys);
+	std::string indexName;
+	{
+		BTreeIndex index(rowsName, indexName, bufMgr, offsetof(tuple, i), INTEGER);
+	}
+	std::uint32_t indexFrames;
+	{
+		BlobFile file = BlobFile::open(indexName);
+		indexFrames = file.getNumPages() + 16;
+	}
+	const std::uint32_t heapFrames = 256;
+	std::vector<int> keys = shuffledKeys(numKeys);
+
+	for (int split = 0; split < 2; split++)
+	{
+		BufPools pools;
+		if (split)
+		{
+			pools.create("index", indexFrames);
+			pools.create(BufPools::DEFAULT, heapFrames, REPLACE_FIFO);
+			pools.assign(indexName, "index");
+		}
+		else
+		{
+			pools.create(BufPools::DEFAULT, indexFrames + heapFrames);
+		}
+		BTreeIndex *index = new BTreeIndex(rowsName, indexName, &pools, offsetof(tuple, i), INTEGER);
+		for (int i = 0; i < numLookups; i++)
+		{
+			lookup(index, &keys[i]);
+		}
+
+		std::atomic<bool> done(false);
+		std::thread scanner(scanLoop, rowsName, pools.poolFor(rowsName), &done);
+		std::vector<double> latencies(numLookups);
+		int matches = 0;
+		for (int i = 0; i < numLookups; i++)
+		{
+			Clock::time_point start = Clock::now();
+			matches += lookup(index, &keys[numLookups - 1 - i]);
+			latencies[i] = elapsedNs(start);
+		}
+		done = true;
+		scanner.join();
+
+		std::sort(latencies.begin(), latencies.end());
+		if (split)
+			std::cout << "  index pool of " << indexFrames << " frames, relation pool of " << heapFrames << " (FIFO): ";
+		else
+			std::cout << "  shared pool of " << indexFrames + heapFrames << " frames: ";
+		std::cout << "lookup p50 " << latencies[numLookups / 2] << " ns, p99 " << latencies[numLookups * 99 / 100]
+			<< " ns (" << matches << " found)" << std::endl;
+		delete index;
+	}
+
+	removeFile(indexName);
+	removeFile(rowsName);
+}
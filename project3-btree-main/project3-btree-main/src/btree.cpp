@@ -5,16 +5,24 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
+#include <sys/stat.h>
 #include "btree.h"
 #include "filescan.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/corrupt_page_exception.h"
+#include "exceptions/read_only_file_exception.h"
 
 
 //#define DEBUG
@@ -22,460 +30,3215 @@
 namespace badgerdb
 {
 
+/**
+ * Set while the calling thread applies the queued changes of an index, whose public methods it then calls.
+ */
+static thread_local bool applyingChanges = false;
+
+// -----------------------------------------------------------------------------
+// Meta page helpers
+// -----------------------------------------------------------------------------
+
+/**
+ * FNV-1a hash of the bytes of the meta page in front of its checksum.
+ */
+static std::uint64_t metaChecksum(const IndexMetaInfo& metaInfo)
+{
+	const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&metaInfo);
+	std::uint64_t h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < offsetof(IndexMetaInfo, checksum); i++)
+	{
+		h = (h ^ bytes[i]) * 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/**
+ * Sets bytes and modified to the size and the modification time, in nanoseconds, of the relation's file; both are -1
+ * if it cannot be found. Any write to the relation that reaches the file changes them.
+ */
+static void relationStamp(const std::string& relationName, std::int64_t& bytes, std::int64_t& modified)
+{
+	struct stat st;
+	if (stat(relationName.c_str(), &st) != 0)
+	{
+		bytes = -1;
+		modified = -1;
+		return;
+	}
+	bytes = st.st_size;
+	modified = (std::int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// -----------------------------------------------------------------------------
+// Node search helpers
+// -----------------------------------------------------------------------------
+
+/**
+ * Returns the number of keys in keyArray[0, numKeys) that are strictly less than key,
+ * i.e. the position of the first key >= key.
+ */
+template <class T>
+static int lowerBound(const T* keyArray, int numKeys, const T& key)
+{
+	int low = 0, high = numKeys;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		// the next probe is the middle of one of the two halves: fetch both while this comparison waits for its key
+		__builtin_prefetch(&keyArray[(low + mid) / 2]);
+		__builtin_prefetch(&keyArray[(mid + 1 + high) / 2]);
+		if (keyArray[mid] < key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/**
+ * Returns the number of keys in keyArray[0, numKeys) that are less than or equal to key,
+ * i.e. the position of the first key > key.
+ */
+template <class T>
+static int upperBound(const T* keyArray, int numKeys, const T& key)
+{
+	int low = 0, high = numKeys;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		// the next probe is the middle of one of the two halves: fetch both while this comparison waits for its key
+		__builtin_prefetch(&keyArray[(low + mid) / 2]);
+		__builtin_prefetch(&keyArray[(mid + 1 + high) / 2]);
+		if (keyArray[mid] <= key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/**
+ * Returns true if key satisfies the lower bound of a scan.
+ */
+template <class T>
+static bool aboveLow(const T& key, const T& lowVal, Operator lowOp)
+{
+	return lowOp == GT ? lowVal < key : lowVal <= key;
+}
+
+/**
+ * Returns true if key satisfies the upper bound of a scan.
+ */
+template <class T>
+static bool belowHigh(const T& key, const T& highVal, Operator highOp)
+{
+	return highOp == LT ? key < highVal : key <= highVal;
+}
+
+/**
+ * Returns the key proper of a key, as passed to insertEntry(): a covering index's key without its included attributes.
+ */
+template <class T>
+static inline const T& keyProper(const T& key)
+{
+	return key;
+}
+
+template <class T>
+static inline const T& keyProper(const CoveredKey<T>& key)
+{
+	return key.key;
+}
+
+/**
+ * Copies the included attributes of a covering index's key; keys of other indexes have none.
+ */
+template <class T>
+static inline void copyPayload(const T& key, char* dst, int length)
+{
+}
+
+template <class T>
+static inline void copyPayload(const CoveredKey<T>& key, char* dst, int length)
+{
+	memcpy(dst, key.payload, length);
+}
+
+/**
+ * Asks the CPU to bring the start and the middle of a node into the cache, where a binary search over its keys begins.
+ */
+static inline void prefetchNode(const Page *page)
+{
+	const char *bytes = reinterpret_cast<const char*>(page);
+	__builtin_prefetch(bytes);
+	__builtin_prefetch(bytes + Page::SIZE / 4);
+	__builtin_prefetch(bytes + Page::SIZE / 2);
+}
+
+/**
+ * The node an optimistic reader searches. Readers search nodes in the buffer pool in place and validate the latch
+ * afterwards, see the specializations for prefix-compressed nodes.
+ */
+template <class Node>
+struct OptimisticView
+{
+	const Node *node;
+
+	explicit OptimisticView(const Page *page)
+		: node(reinterpret_cast<const Node*>(page))
+	{
+	}
+};
+
+// -----------------------------------------------------------------------------
+// Generic nodes
+// -----------------------------------------------------------------------------
+
+template <class T>
+void NonLeafNode<T>::init(int nodeLevel, PageId firstChild)
+{
+	level = nodeLevel;
+	numKeys = 0;
+	pageNoArray[0] = firstChild;
+}
+
+template <class T>
+int NonLeafNode<T>::lowerBound(const T& key) const
+{
+	return badgerdb::lowerBound(keyArray, numKeys, key);
+}
+
+template <class T>
+int NonLeafNode<T>::upperBound(const T& key) const
+{
+	return badgerdb::upperBound(keyArray, numKeys, key);
+}
+
+template <class T>
+bool NonLeafNode<T>::insertAt(int pos, const T& key, PageId child)
+{
+	if (numKeys >= NodeCapacity<T>::NONLEAF)
+	{
+		return false;
+	}
+	for (int i = numKeys; i > pos; i--)
+	{
+		keyArray[i] = keyArray[i - 1];
+		pageNoArray[i + 1] = pageNoArray[i];
+	}
+	keyArray[pos] = key;
+	pageNoArray[pos + 1] = child;
+	numKeys++;
+	return true;
+}
+
+template <class T>
+void NonLeafNode<T>::split(NonLeafNode* sibling, int pos, const T& key, PageId child, T& middleKey)
+{
+	const int total = NodeCapacity<T>::NONLEAF + 1;
+
+	// merge the new separator into a combined sequence of keys and children
+	T keys[NodeCapacity<T>::NONLEAF + 1];
+	PageId children[NodeCapacity<T>::NONLEAF + 2];
+	children[0] = pageNoArray[0];
+	for (int i = 0, src = 0; i < total; i++)
+	{
+		if (i == pos)
+		{
+			keys[i] = key;
+			children[i + 1] = child;
+		}
+		else
+		{
+			keys[i] = keyArray[src];
+			children[i + 1] = pageNoArray[src + 1];
+			src++;
+		}
+	}
+
+	// the middle key moves up; keys left of it stay, keys right of it move to the sibling
+	const int middle = total / 2;
+	numKeys = middle;
+	for (int i = 0; i < middle; i++)
+	{
+		keyArray[i] = keys[i];
+		pageNoArray[i + 1] = children[i + 1];
+	}
+
+	sibling->level = level;
+	sibling->numKeys = total - middle - 1;
+	sibling->pageNoArray[0] = children[middle + 1];
+	for (int i = middle + 1; i < total; i++)
+	{
+		sibling->keyArray[i - middle - 1] = keys[i];
+		sibling->pageNoArray[i - middle] = children[i + 1];
+	}
+
+	middleKey = keys[middle];
+}
+
+template <class T>
+double NonLeafNode<T>::fillFactor() const
+{
+	return static_cast<double>(numKeys) / NodeCapacity<T>::NONLEAF;
+}
+
+template <class T>
+void NonLeafNode<T>::removeAt(int pos)
+{
+	for (int i = pos; i < numKeys - 1; i++)
+	{
+		keyArray[i] = keyArray[i + 1];
+		pageNoArray[i + 1] = pageNoArray[i + 2];
+	}
+	numKeys--;
+}
+
+template <class T>
+bool NonLeafNode<T>::replaceKeyAt(int pos, const T& key)
+{
+	keyArray[pos] = key;
+	return true;
+}
+
+template <class T>
+bool NonLeafNode<T>::mergeRight(const T& separator, NonLeafNode* right)
+{
+	if (numKeys + 1 + right->numKeys > NodeCapacity<T>::NONLEAF)
+	{
+		return false;
+	}
+	keyArray[numKeys] = separator;
+	pageNoArray[numKeys + 1] = right->pageNoArray[0];
+	for (int i = 0; i < right->numKeys; i++)
+	{
+		keyArray[numKeys + 1 + i] = right->keyArray[i];
+		pageNoArray[numKeys + 2 + i] = right->pageNoArray[i + 1];
+	}
+	numKeys += 1 + right->numKeys;
+	return true;
+}
+
+template <class T>
+void NonLeafNode<T>::balance(NonLeafNode* right, T& separator)
+{
+	// combined sequence of both nodes with the separator from the parent between them
+	const int total = numKeys + 1 + right->numKeys;
+	T keys[2 * NodeCapacity<T>::NONLEAF + 1];
+	PageId children[2 * NodeCapacity<T>::NONLEAF + 2];
+	for (int i = 0; i < numKeys; i++)
+	{
+		keys[i] = keyArray[i];
+		children[i] = pageNoArray[i];
+	}
+	keys[numKeys] = separator;
+	children[numKeys] = pageNoArray[numKeys];
+	for (int i = 0; i <= right->numKeys; i++)
+	{
+		if (i < right->numKeys)
+			keys[numKeys + 1 + i] = right->keyArray[i];
+		children[numKeys + 1 + i] = right->pageNoArray[i];
+	}
+
+	const int middle = total / 2;
+	numKeys = middle;
+	for (int i = 0; i < middle; i++)
+	{
+		keyArray[i] = keys[i];
+		pageNoArray[i + 1] = children[i + 1];
+	}
+	separator = keys[middle];
+	right->numKeys = total - middle - 1;
+	right->pageNoArray[0] = children[middle + 1];
+	for (int i = 0; i < right->numKeys; i++)
+	{
+		right->keyArray[i] = keys[middle + 1 + i];
+		right->pageNoArray[i + 1] = children[middle + 2 + i];
+	}
+}
+
+template <class T>
+void LeafNode<T>::init()
+{
+	numKeys = 0;
+	rightSibPageNo = Page::INVALID_NUMBER;
+}
+
+template <class T>
+int LeafNode<T>::lowerBound(const T& key) const
+{
+	return badgerdb::lowerBound(keyArray, numKeys, key);
+}
+
+template <class T>
+int LeafNode<T>::upperBound(const T& key) const
+{
+	return badgerdb::upperBound(keyArray, numKeys, key);
+}
+
+template <class T>
+bool LeafNode<T>::insertAt(int pos, const T& key, const RecordId& rid)
+{
+	if (numKeys >= NodeCapacity<T>::LEAF)
+	{
+		return false;
+	}
+	for (int i = numKeys; i > pos; i--)
+	{
+		keyArray[i] = keyArray[i - 1];
+		ridArray[i] = ridArray[i - 1];
+	}
+	keyArray[pos] = key;
+	ridArray[pos] = rid;
+	numKeys++;
+	return true;
+}
+
+template <class T>
+void LeafNode<T>::split(LeafNode* sibling, int pos, const T& key, const RecordId& rid, T& separator)
+{
+	const int total = NodeCapacity<T>::LEAF + 1;
+	const int leftCount = total / 2;
+
+	// entry i of the combined (node + new entry) sequence
+	for (int i = total - 1; i >= leftCount; i--)
+	{
+		int j = i - leftCount;
+		if (i == pos)
+		{
+			sibling->keyArray[j] = key;
+			sibling->ridArray[j] = rid;
+		}
+		else
+		{
+			int src = i > pos ? i - 1 : i;
+			sibling->keyArray[j] = keyArray[src];
+			sibling->ridArray[j] = ridArray[src];
+		}
+	}
+	if (pos < leftCount)
+	{
+		for (int i = leftCount - 1; i > pos; i--)
+		{
+			keyArray[i] = keyArray[i - 1];
+			ridArray[i] = ridArray[i - 1];
+		}
+		keyArray[pos] = key;
+		ridArray[pos] = rid;
+	}
+
+	sibling->numKeys = total - leftCount;
+	numKeys = leftCount;
+	separator = sibling->keyArray[0];
+}
+
+template <class T>
+double LeafNode<T>::fillFactor() const
+{
+	return static_cast<double>(numKeys) / NodeCapacity<T>::LEAF;
+}
+
+template <class T>
+void LeafNode<T>::removeAt(int pos)
+{
+	for (int i = pos; i < numKeys - 1; i++)
+	{
+		keyArray[i] = keyArray[i + 1];
+		ridArray[i] = ridArray[i + 1];
+	}
+	numKeys--;
+}
+
+template <class T>
+bool LeafNode<T>::mergeRight(LeafNode* right)
+{
+	if (numKeys + right->numKeys > NodeCapacity<T>::LEAF)
+	{
+		return false;
+	}
+	for (int i = 0; i < right->numKeys; i++)
+	{
+		keyArray[numKeys + i] = right->keyArray[i];
+		ridArray[numKeys + i] = right->ridArray[i];
+	}
+	numKeys += right->numKeys;
+	return true;
+}
+
+template <class T>
+void LeafNode<T>::balance(LeafNode* right, T& separator)
+{
+	const int leftCount = (numKeys + right->numKeys) / 2;
+	if (numKeys > leftCount)
+	{
+		// move the tail of this leaf to the front of right
+		const int moved = numKeys - leftCount;
+		for (int i = right->numKeys - 1; i >= 0; i--)
+		{
+			right->keyArray[i + moved] = right->keyArray[i];
+			right->ridArray[i + moved] = right->ridArray[i];
+		}
+		for (int i = 0; i < moved; i++)
+		{
+			right->keyArray[i] = keyArray[leftCount + i];
+			right->ridArray[i] = ridArray[leftCount + i];
+		}
+		right->numKeys += moved;
+	}
+	else
+	{
+		// move the head of right to the end of this leaf
+		const int moved = leftCount - numKeys;
+		for (int i = 0; i < moved; i++)
+		{
+			keyArray[numKeys + i] = right->keyArray[i];
+			ridArray[numKeys + i] = right->ridArray[i];
+		}
+		for (int i = moved; i < right->numKeys; i++)
+		{
+			right->keyArray[i - moved] = right->keyArray[i];
+			right->ridArray[i - moved] = right->ridArray[i];
+		}
+		right->numKeys -= moved;
+	}
+	numKeys = leftCount;
+	separator = right->keyArray[0];
+}
+
+// the buckets of a HashIndex are leaves too
+template struct LeafNode<int>;
+template struct LeafNode<double>;
+template struct LeafNode<StringKey>;
+
+// -----------------------------------------------------------------------------
+// Prefix-compressed STRING nodes
+// -----------------------------------------------------------------------------
+
+/**
+ * Returns the number of bytes of a string key before its '\0' padding.
+ */
+static int keyLength(const StringKey& key)
+{
+	int length = 0;
+	while (length < STRINGSIZE && key.data[length] != '\0')
+		length++;
+	return length;
+}
+
+/**
+ * Returns the length of the longest common prefix of two string keys.
+ */
+static int commonPrefix(const StringKey& key1, const StringKey& key2)
+{
+	int length = 0;
+	while (length < STRINGSIZE && key1.data[length] != '\0' && key1.data[length] == key2.data[length])
+		length++;
+	return length;
+}
+
+/**
+ * Packs the first four of length bytes big-endian, padding with '\0', so that heads compare like the bytes.
+ */
+static std::uint32_t keyHead(const char* bytes, int length)
+{
+	std::uint32_t head = 0;
+	for (int i = 0; i < 4; i++)
+		head = (head << 8) | (i < length ? static_cast<unsigned char>(bytes[i]) : 0);
+	return head;
+}
+
+/**
+ * Returns the shortest prefix of right that is still greater than left, where left < right or left == right.
+ */
+static StringKey shortestSeparator(const StringKey& left, const StringKey& right)
+{
+	StringKey separator = right;
+	for (int i = commonPrefix(left, right) + 1; i < STRINGSIZE; i++)
+		separator.data[i] = '\0';
+	return separator;
+}
+
+/**
+ * Picks the split point of a full prefix-compressed node holding count sorted entries: entries [0, split) stay,
+ * entries [split + gap, count) move to the sibling and, for non-leaf nodes (gap = 1), entry split moves up.
+ * Prefers the middle, but moves away from it until both halves fit, which always happens at the latest when
+ * the new entry ends up on its own.
+ */
+template <class Area, class Entry>
+static int chooseSplit(const Entry* entries, int count, int gap)
+{
+	const int middle = count / 2;
+	for (int distance = 0; distance < count; distance++)
+	{
+		for (int sign = -1; sign <= 1; sign += 2)
+		{
+			int split = middle + sign * distance;
+			if (split >= 1 && split + gap < count
+				&& Area::fits(entries, split) && Area::fits(entries + split + gap, count - split - gap))
+			{
+				return split;
+			}
+		}
+	}
+	return middle;
+}
+
+template <class V, int headerSize>
+void PrefixKeyArea<V, headerSize>::clear()
+{
+	prefixLength = 0;
+	heapOffset = DATASIZE;
+}
+
+template <class V, int headerSize>
+void PrefixKeyArea<V, headerSize>::encode(const StringKey& key, PrefixSearchKey& searchKey) const
+{
+	const int length = keyLength(key);
+	int order = memcmp(key.data, prefix, std::min<int>(length, prefixLength));
+	if (order == 0 && length < prefixLength)
+		order = -1;
+	searchKey.order = order;
+
+	const char *suffix = key.data + prefixLength;
+	const int suffixLength = length - prefixLength;
+	searchKey.head = order == 0 ? keyHead(suffix, suffixLength) : 0;
+	searchKey.rest = suffix + 4;
+	searchKey.restLength = order == 0 && suffixLength > 4 ? suffixLength - 4 : 0;
+}
+
+template <class V, int headerSize>
+int PrefixKeyArea<V, headerSize>::compare(int i, const PrefixSearchKey& searchKey) const
+{
+	const Slot& slot = slots()[i];
+	if (slot.head != searchKey.head)
+		return slot.head < searchKey.head ? -1 : 1;
+
+	// equal heads: keys never contain '\0', so both suffixes are at most four bytes long or both are longer
+	const int restLength = slot.length > 4 ? slot.length - 4 : 0;
+	int order = memcmp(data + slot.offset, searchKey.rest, std::min(restLength, searchKey.restLength));
+	return order != 0 ? order : restLength - searchKey.restLength;
+}
+
+template <class V, int headerSize>
+int PrefixKeyArea<V, headerSize>::lowerBound(int numKeys, const StringKey& key) const
+{
+	PrefixSearchKey searchKey;
+	encode(key, searchKey);
+	if (searchKey.order != 0)
+		return searchKey.order < 0 ? 0 : numKeys;
+
+	int low = 0, high = numKeys;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (compare(mid, searchKey) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+template <class V, int headerSize>
+int PrefixKeyArea<V, headerSize>::upperBound(int numKeys, const StringKey& key) const
+{
+	PrefixSearchKey searchKey;
+	encode(key, searchKey);
+	if (searchKey.order != 0)
+		return searchKey.order < 0 ? 0 : numKeys;
+
+	int low = 0, high = numKeys;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (compare(mid, searchKey) <= 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+template <class V, int headerSize>
+StringKey PrefixKeyArea<V, headerSize>::keyAt(int i) const
+{
+	const Slot& slot = slots()[i];
+	StringKey key;
+	memset(key.data, 0, STRINGSIZE);
+	memcpy(key.data, prefix, prefixLength);
+	char *suffix = key.data + prefixLength;
+	for (int b = 0; b < 4 && b < slot.length; b++)
+		suffix[b] = static_cast<char>(slot.head >> (24 - 8 * b));
+	if (slot.length > 4)
+		memcpy(suffix + 4, data + slot.offset, slot.length - 4);
+	return key;
+}
+
+template <class V, int headerSize>
+bool PrefixKeyArea<V, headerSize>::insertAt(int& numKeys, int pos, const StringKey& key, const V& value)
+{
+	PrefixSearchKey searchKey;
+	encode(key, searchKey);
+
+	if (searchKey.order == 0)
+	{
+		const int used = numKeys * sizeof(Slot);
+		if (heapOffset - used < static_cast<int>(sizeof(Slot)) + searchKey.restLength)
+		{
+			return false;
+		}
+		heapOffset -= searchKey.restLength;
+		memcpy(data + heapOffset, searchKey.rest, searchKey.restLength);
+
+		Slot *slot = slots();
+		memmove(slot + pos + 1, slot + pos, (numKeys - pos) * sizeof(Slot));
+		slot[pos].head = searchKey.head;
+		slot[pos].offset = heapOffset;
+		slot[pos].length = keyLength(key) - prefixLength;
+		slot[pos].value = value;
+		numKeys++;
+		return true;
+	}
+
+	// the key does not share the node prefix: rebuild the node around a shorter one if everything still fits
+	std::vector< std::pair<StringKey, V> > entries;
+	collect(numKeys, entries);
+	entries.insert(entries.begin() + pos, std::make_pair(key, value));
+	if (!fits(&entries[0], entries.size()))
+	{
+		return false;
+	}
+	build(numKeys, &entries[0], entries.size());
+	return true;
+}
+
+template <class V, int headerSize>
+void PrefixKeyArea<V, headerSize>::removeAt(int& numKeys, int pos)
+{
+	Slot *slot = slots();
+	if (slot[pos].length > 4)
+	{
+		// close the gap in the heap by moving the suffixes stored below it up
+		const int offset = slot[pos].offset;
+		const int restLength = slot[pos].length - 4;
+		memmove(data + heapOffset + restLength, data + heapOffset, offset - heapOffset);
+		heapOffset += restLength;
+		for (int i = 0; i < numKeys; i++)
+		{
+			if (slot[i].length > 4 && slot[i].offset < offset)
+				slot[i].offset += restLength;
+		}
+	}
+	memmove(slot + pos, slot + pos + 1, (numKeys - pos - 1) * sizeof(Slot));
+	numKeys--;
+	if (numKeys == 0)
+	{
+		clear();
+	}
+}
+
+template <class V, int headerSize>
+void PrefixKeyArea<V, headerSize>::collect(int numKeys, std::vector< std::pair<StringKey, V> >& entries) const
+{
+	entries.reserve(entries.size() + numKeys + 1);
+	for (int i = 0; i < numKeys; i++)
+	{
+		entries.push_back(std::make_pair(keyAt(i), valueAt(i)));
+	}
+}
+
+template <class V, int headerSize>
+bool PrefixKeyArea<V, headerSize>::fits(const std::pair<StringKey, V>* entries, int count)
+{
+	if (count == 0)
+	{
+		return true;
+	}
+	const int prefixLength = commonPrefix(entries[0].first, entries[count - 1].first);
+	int size = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const int suffixLength = keyLength(entries[i].first) - prefixLength;
+		size += sizeof(Slot) + (suffixLength > 4 ? suffixLength - 4 : 0);
+	}
+	return size <= DATASIZE;
+}
+
+template <class V, int headerSize>
+void PrefixKeyArea<V, headerSize>::build(int& numKeys, const std::pair<StringKey, V>* entries, int count)
+{
+	clear();
+	if (count > 0)
+	{
+		prefixLength = commonPrefix(entries[0].first, entries[count - 1].first);
+		memcpy(prefix, entries[0].first.data, prefixLength);
+	}
+
+	Slot *slot = slots();
+	for (int i = 0; i < count; i++)
+	{
+		const char *suffix = entries[i].first.data + prefixLength;
+		const int suffixLength = keyLength(entries[i].first) - prefixLength;
+		const int restLength = suffixLength > 4 ? suffixLength - 4 : 0;
+		heapOffset -= restLength;
+		memcpy(data + heapOffset, suffix + 4, restLength);
+		slot[i].head = keyHead(suffix, suffixLength);
+		slot[i].offset = heapOffset;
+		slot[i].length = suffixLength;
+		slot[i].value = entries[i].second;
+	}
+	numKeys = count;
+}
+
+void NonLeafNode<PrefixStringKey>::init(int nodeLevel, PageId child)
+{
+	level = nodeLevel;
+	numKeys = 0;
+	firstChild = child;
+	keys.clear();
+}
+
+void NonLeafNode<PrefixStringKey>::split(NonLeafNode* sibling, int pos, const StringKey& key, PageId child, StringKey& middleKey)
+{
+	std::vector< std::pair<StringKey, PageId> > entries;
+	keys.collect(numKeys, entries);
+	entries.insert(entries.begin() + pos, std::make_pair(key, child));
+	const int count = entries.size();
+	const int middle = chooseSplit<KeyArea>(&entries[0], count, 1);
+
+	middleKey = entries[middle].first;
+	sibling->init(level, entries[middle].second);
+	sibling->keys.build(sibling->numKeys, &entries[middle + 1], count - middle - 1);
+	keys.build(numKeys, &entries[0], middle);
+}
+
+bool NonLeafNode<PrefixStringKey>::replaceKeyAt(int pos, const StringKey& key)
+{
+	std::vector< std::pair<StringKey, PageId> > entries;
+	keys.collect(numKeys, entries);
+	entries[pos].first = key;
+	if (!KeyArea::fits(&entries[0], numKeys))
+	{
+		return false;
+	}
+	keys.build(numKeys, &entries[0], entries.size());
+	return true;
+}
+
+bool NonLeafNode<PrefixStringKey>::mergeRight(const StringKey& separator, NonLeafNode* right)
+{
+	std::vector< std::pair<StringKey, PageId> > entries;
+	keys.collect(numKeys, entries);
+	entries.push_back(std::make_pair(separator, right->firstChild));
+	right->keys.collect(right->numKeys, entries);
+	if (!KeyArea::fits(&entries[0], entries.size()))
+	{
+		return false;
+	}
+	keys.build(numKeys, &entries[0], entries.size());
+	return true;
+}
+
+void NonLeafNode<PrefixStringKey>::balance(NonLeafNode* right, StringKey& separator)
+{
+	std::vector< std::pair<StringKey, PageId> > entries;
+	keys.collect(numKeys, entries);
+	entries.push_back(std::make_pair(separator, right->firstChild));
+	right->keys.collect(right->numKeys, entries);
+	const int count = entries.size();
+	const int middle = chooseSplit<KeyArea>(&entries[0], count, 1);
+
+	separator = entries[middle].first;
+	right->firstChild = entries[middle].second;
+	right->keys.build(right->numKeys, &entries[middle + 1], count - middle - 1);
+	keys.build(numKeys, &entries[0], middle);
+}
+
+void LeafNode<PrefixStringKey>::init()
+{
+	numKeys = 0;
+	rightSibPageNo = Page::INVALID_NUMBER;
+	keys.clear();
+}
+
+void LeafNode<PrefixStringKey>::split(LeafNode* sibling, int pos, const StringKey& key, const RecordId& rid, StringKey& separator)
+{
+	std::vector< std::pair<StringKey, RecordId> > entries;
+	keys.collect(numKeys, entries);
+	entries.insert(entries.begin() + pos, std::make_pair(key, rid));
+	const int count = entries.size();
+	const int middle = chooseSplit<KeyArea>(&entries[0], count, 0);
+
+	separator = shortestSeparator(entries[middle - 1].first, entries[middle].first);
+	sibling->init();
+	sibling->keys.build(sibling->numKeys, &entries[middle], count - middle);
+	keys.build(numKeys, &entries[0], middle);
+}
+
+bool LeafNode<PrefixStringKey>::mergeRight(LeafNode* right)
+{
+	std::vector< std::pair<StringKey, RecordId> > entries;
+	keys.collect(numKeys, entries);
+	right->keys.collect(right->numKeys, entries);
+	if (!KeyArea::fits(&entries[0], entries.size()))
+	{
+		return false;
+	}
+	keys.build(numKeys, &entries[0], entries.size());
+	return true;
+}
+
+void LeafNode<PrefixStringKey>::balance(LeafNode* right, StringKey& separator)
+{
+	std::vector< std::pair<StringKey, RecordId> > entries;
+	keys.collect(numKeys, entries);
+	right->keys.collect(right->numKeys, entries);
+	const int count = entries.size();
+	const int middle = chooseSplit<KeyArea>(&entries[0], count, 0);
+
+	separator = shortestSeparator(entries[middle - 1].first, entries[middle].first);
+	right->keys.build(right->numKeys, &entries[middle], count - middle);
+	keys.build(numKeys, &entries[0], middle);
+}
+
+/**
+ * Prefix-compressed nodes are variable-length. A search through one that a concurrent writer is rewriting may follow
+ * a torn slot past the end of the node, so optimistic readers search a copy; the latch still validates what they read.
+ */
+template <>
+struct OptimisticView< NonLeafNode<PrefixStringKey> >
+{
+	NonLeafNode<PrefixStringKey> copy;
+	const NonLeafNode<PrefixStringKey> *node;
+
+	explicit OptimisticView(const Page *page)
+		: copy(*reinterpret_cast<const NonLeafNode<PrefixStringKey>*>(page)), node(&copy)
+	{
+	}
+};
+
+template <>
+struct OptimisticView< LeafNode<PrefixStringKey> >
+{
+	LeafNode<PrefixStringKey> copy;
+	const LeafNode<PrefixStringKey> *node;
+
+	explicit OptimisticView(const Page *page)
+		: copy(*reinterpret_cast<const LeafNode<PrefixStringKey>*>(page)), node(&copy)
+	{
+	}
+};
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::BTreeIndex -- Constructor
+// -----------------------------------------------------------------------------
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const int attrByteOffset,
+		const Datatype attrType,
+		const bool prefixCompressed,
+		const int includeByteOffset,
+		const int includeLength)
+{
+	bufMgr = relationBufMgr = bufMgrIn;
+	pools = NULL;
+	openIndex(relationName, outIndexName, attrByteOffset, attrType, prefixCompressed, includeByteOffset, includeLength);
+}
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufPools *poolsIn,
+		const int attrByteOffset,
+		const Datatype attrType,
+		const bool prefixCompressed,
+		const int includeByteOffset,
+		const int includeLength)
+{
+	bufMgr = relationBufMgr = NULL;
+	pools = poolsIn;
+	openIndex(relationName, outIndexName, attrByteOffset, attrType, prefixCompressed, includeByteOffset, includeLength);
+}
+
+BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const std::vector<KeyPart>& keyParts,
+		const int includeByteOffset,
+		const int includeLength)
+{
+	bufMgr = relationBufMgr = bufMgrIn;
+	pools = NULL;
+	BTreeIndex::keyParts = keyParts;
+	openIndex(relationName, outIndexName, keyParts.empty() ? 0 : keyParts[0].byteOffset, COMPOSITE, false,
+	          includeByteOffset, includeLength);
+}
+
+void BTreeIndex::openIndex(const std::string & relationName,
+		std::string & outIndexName,
+		const int attrByteOffset,
+		const Datatype attrType,
+		const bool prefixCompressed,
+		const int includeByteOffset,
+		const int includeLength)
+{
+	attributeType = attrType;
+	BTreeIndex::relationName = relationName;
+	BTreeIndex::attrByteOffset = attrByteOffset;
+	BTreeIndex::prefixCompressed = attrType == STRING && prefixCompressed;
+	BTreeIndex::includeByteOffset = includeLength > 0 ? includeByteOffset : 0;
+	BTreeIndex::includeLength = includeLength;
+	mergeThreshold = 0.5;
+	hasPendingChanges = false;
+	unreportedChangesAtOpen = 0;
+
+	switch (attrType)
+	{
+		case INTEGER:
+			leafOccupancy = includeLength > 0 ? NodeCapacity< CoveredKey<int> >::LEAF : INTARRAYLEAFSIZE;
+			nodeOccupancy = INTARRAYNONLEAFSIZE;
+			break;
+		case DOUBLE:
+			leafOccupancy = includeLength > 0 ? NodeCapacity< CoveredKey<double> >::LEAF : DOUBLEARRAYLEAFSIZE;
+			nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
+			break;
+		case STRING:
+			leafOccupancy = BTreeIndex::prefixCompressed ? PREFIXLEAFSIZE
+				: includeLength > 0 ? NodeCapacity< CoveredKey<StringKey> >::LEAF : STRINGARRAYLEAFSIZE;
+			nodeOccupancy = BTreeIndex::prefixCompressed ? PREFIXNONLEAFSIZE : STRINGARRAYNONLEAFSIZE;
+			break;
+		case COMPOSITE:
+			leafOccupancy = includeLength > 0 ? NodeCapacity< CoveredKey<CompositeKey> >::LEAF : NodeCapacity<CompositeKey>::LEAF;
+			nodeOccupancy = NodeCapacity<CompositeKey>::NONLEAF;
+			break;
+	}
+
+	// a plain index is named after its relation and attribute offset; other kinds of index on the same attributes add
+	// what sets them apart, so that each has a file of its own
+	std::ostringstream idxStr;
+	idxStr << relationName;
+	if (attrType != COMPOSITE)
+	{
+		idxStr << '.' << attrByteOffset;
+	}
+	else
+	{
+		// the type of each part, and the length of STRING parts: i, d or s<length>
+		for (size_t i = 0; i < keyParts.size(); i++)
+		{
+			idxStr << '.' << keyParts[i].byteOffset;
+			if (keyParts[i].type == INTEGER)
+				idxStr << 'i';
+			else if (keyParts[i].type == DOUBLE)
+				idxStr << 'd';
+			else
+				idxStr << 's' << keyParts[i].length;
+		}
+	}
+	if (BTreeIndex::prefixCompressed)
+	{
+		idxStr << ".pfx";
+	}
+	if (includeLength > 0)
+	{
+		idxStr << ".inc" << includeByteOffset << '_' << includeLength;
+	}
+	std::string indexName = idxStr.str(); // indexName is the name of the index file
+	outIndexName = indexName;
+
+	// with pools, the index and the relation are each buffered in the pool their file is assigned to
+	if (pools != NULL)
+	{
+		bufMgr = pools->poolFor(indexName);
+		relationBufMgr = pools->poolFor(relationName);
+	}
+
+	// covering leaves have room for INCLUDESIZE bytes, and prefix-compressed leaves for none
+	if (includeLength < 0 || includeLength > INCLUDESIZE || (includeLength > 0 && BTreeIndex::prefixCompressed))
+	{
+		throw BadIndexInfoException(indexName);
+	}
+
+	// the parts of a composite key are laid out one after the other, and must fit into a CompositeKey
+	keyLength = 0;
+	bool partsValid = attrType != COMPOSITE || (!keyParts.empty() && keyParts.size() <= (size_t)MAXKEYPARTS);
+	for (size_t i = 0; i < keyParts.size(); i++)
+	{
+		if (keyParts[i].type == INTEGER)
+			keyParts[i].length = sizeof(int);
+		else if (keyParts[i].type == DOUBLE)
+			keyParts[i].length = sizeof(double);
+		else if (keyParts[i].type != STRING || keyParts[i].length <= 0)
+			partsValid = false;
+		keyLength += keyParts[i].length;
+	}
+	if (!partsValid || keyLength > COMPOSITESIZE)
+	{
+		throw BadIndexInfoException(indexName);
+	}
+
+	// if indexName exists, then the file is opened. Else, a new index file is created.
+	try
+	{
+		file = new BlobFile(indexName, false);
+
+		// index file already exists: read meta info and check it against the parameters and the relation
+		headerPageNum = file->getFirstPageNo();
+		bool current;
+		try
+		{
+			current = readMetaInfo(indexName);
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			delete file;
+			throw;
+		}
+		catch(const CorruptPageException &e)
+		{
+			// a damaged meta page is treated like one that fails its own checksum
+			current = false;
+		}
+		if (current && file->isMapped())
+		{
+			// a mapped index is only read, and it is not told of changes to the relation; an index it no longer
+			// matches is found out of date when it is opened next
+			return;
+		}
+		if (current)
+		{
+			// until it is closed again, the index is not known to match the relation
+			unreportedChangesAtOpen = PageFile::unreportedChanges(relationName);
+			writeMetaInfo(false, true);
+			bufMgr->flushFile(file);
+			PageFile::addRecordListener(relationName, this);
+			return;
+		}
+		if (file->isMapped())
+		{
+			delete file;
+			throw ReadOnlyFileException(indexName);
+		}
+
+		// the index cannot be trusted: build it anew
+		bufMgr->flushFile(file);
+		bufMgr->checkpoint();
+		delete file;
+		File::remove(indexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+
+	// index file doesn't exist, or is out of date: create it with a meta page and an empty leaf as root
+	file = new BlobFile(indexName, true);
+
+	Page *metaPage;
+	bufMgr->allocPage(file, headerPageNum, metaPage);
+	PageId rootPageNo;
+	Page *rootPage;
+	bufMgr->allocPage(file, rootPageNo, rootPage);
+	rootPageNum = rootPageNo;
+	height = 1;
+	numEntries = 0;
+	numLeaves = 1;
+	numNonLeaves = 0;
+	hasKeyRange = false;
+	memset(minKey, 0, MAXKEYSIZE);
+	memset(maxKey, 0, MAXKEYSIZE);
+
+	IndexMetaInfo *metaInfo = reinterpret_cast<IndexMetaInfo*>(metaPage);
+	metaInfo->formatVersion = INDEXFORMATVERSION;
+	memset(metaInfo->relationName, 0, sizeof(metaInfo->relationName));
+	relationName.copy(metaInfo->relationName, sizeof(metaInfo->relationName));
+	metaInfo->attrByteOffset = attrByteOffset;
+	metaInfo->attrType = attrType;
+	metaInfo->rootPageNo = rootPageNum;
+	metaInfo->prefixCompressed = BTreeIndex::prefixCompressed;
+	metaInfo->includeByteOffset = BTreeIndex::includeByteOffset;
+	metaInfo->includeLength = includeLength;
+	metaInfo->numKeyParts = keyParts.size();
+	metaInfo->relationBytes = -1;
+	metaInfo->relationModified = -1;
+	memset(metaInfo->keyParts, 0, sizeof(metaInfo->keyParts));
+	for (size_t i = 0; i < keyParts.size(); i++)
+	{
+		metaInfo->keyParts[i] = keyParts[i];
+	}
+
+	switch (attrType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				reinterpret_cast<LeafNode< CoveredKey<int> >*>(rootPage)->init();
+			else
+				reinterpret_cast<LeafNodeInt*>(rootPage)->init();
+			break;
+		case DOUBLE:
+			if (includeLength > 0)
+				reinterpret_cast<LeafNode< CoveredKey<double> >*>(rootPage)->init();
+			else
+				reinterpret_cast<LeafNodeDouble*>(rootPage)->init();
+			break;
+		case STRING:
+			if (BTreeIndex::prefixCompressed)
+				reinterpret_cast<LeafNode<PrefixStringKey>*>(rootPage)->init();
+			else if (includeLength > 0)
+				reinterpret_cast<LeafNode< CoveredKey<StringKey> >*>(rootPage)->init();
+			else
+				reinterpret_cast<LeafNodeString*>(rootPage)->init();
+			break;
+		case COMPOSITE:
+			if (includeLength > 0)
+				reinterpret_cast<LeafNode< CoveredKey<CompositeKey> >*>(rootPage)->init();
+			else
+				reinterpret_cast<LeafNode<CompositeKey>*>(rootPage)->init();
+			break;
+	}
+
+	bufMgr->unPinPage(file, headerPageNum, true);
+	bufMgr->unPinPage(file, rootPageNum, true);
+
+	// insert entries for all of the tuples in the relation into the index
+	FileScan scan(relationName, relationBufMgr);
+	try
+	{
+		RecordId scanRid;
+		while(1)
+		{
+			scan.scanNext(scanRid);
+			unsigned char key[MAXKEYSIZE];
+			char payload[INCLUDESIZE];
+			recordKey(scan.getRecord(), key, payload);
+			insertEntry(key, scanRid, includeLength > 0 ? payload : NULL);
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+
+	unreportedChangesAtOpen = PageFile::unreportedChanges(relationName);
+	writeMetaInfo(false, true);
+	bufMgr->flushFile(file);
+	PageFile::addRecordListener(relationName, this);
+}
+
+void BTreeIndex::recordKey(const std::string & record, unsigned char* key, char* payload) const
+{
+	const char *data = record.c_str();
+	memset(key, 0, MAXKEYSIZE);
+	switch (attributeType)
+	{
+		case INTEGER:
+			memcpy(key, data + attrByteOffset, sizeof(int));
+			break;
+		case DOUBLE:
+			memcpy(key, data + attrByteOffset, sizeof(double));
+			break;
+		case STRING:
+			memcpy(key, KeyTraits<StringKey>::read(data + attrByteOffset).data, STRINGSIZE);
+			break;
+		case COMPOSITE:
+		{
+			const void *values[MAXKEYPARTS];
+			for (size_t i = 0; i < keyParts.size(); i++)
+			{
+				values[i] = data + keyParts[i].byteOffset;
+			}
+			CompositeKey compositeKey;
+			encodeKeyParts(values, keyParts.size(), 0, compositeKey);
+			memcpy(key, compositeKey.data, COMPOSITESIZE);
+			break;
+		}
+	}
+
+	memset(payload, 0, INCLUDESIZE);
+	if (includeLength > 0)
+	{
+		memcpy(payload, data + includeByteOffset, includeLength);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::recordsChanged
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::recordsChanged(const std::string& filename, const std::vector<RecordChange>& changes)
+{
+	// only the keys are kept; changes to other attributes need no entry change
+	std::vector<EntryChange> entryChanges;
+	entryChanges.reserve(changes.size());
+	for (size_t i = 0; i < changes.size(); i++)
+	{
+		EntryChange change;
+		change.rid = changes[i].rid;
+		change.existed = changes[i].existed;
+		change.exists = changes[i].exists;
+		recordKey(changes[i].old_data, change.oldKey, change.oldPayload);
+		recordKey(changes[i].new_data, change.newKey, change.newPayload);
+		if (!change.existed || !change.exists || memcmp(change.oldKey, change.newKey, MAXKEYSIZE) != 0
+			|| memcmp(change.oldPayload, change.newPayload, INCLUDESIZE) != 0)
+		{
+			entryChanges.push_back(change);
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(changesMutex);
+	pendingChanges.insert(pendingChanges.end(), entryChanges.begin(), entryChanges.end());
+	hasPendingChanges = !pendingChanges.empty();
+}
+
+void BTreeIndex::applyPendingChanges()
+{
+	if (!hasPendingChanges || applyingChanges)
+	{
+		return;
+	}
+
+	// applying changes inserts and deletes entries, which must not apply them again
+	applyingChanges = true;
+	try
+	{
+		while (true)
+		{
+			std::vector<EntryChange> changes;
+			{
+				std::lock_guard<std::mutex> guard(changesMutex);
+				changes.swap(pendingChanges);
+				hasPendingChanges = false;
+			}
+			if (changes.empty())
+			{
+				break;
+			}
+
+			switch (attributeType)
+			{
+				case INTEGER:
+					applyChanges<int>(changes);
+					break;
+				case DOUBLE:
+					applyChanges<double>(changes);
+					break;
+				case STRING:
+					applyChanges<StringKey>(changes);
+					break;
+				case COMPOSITE:
+					applyChanges<CompositeKey>(changes);
+					break;
+			}
+		}
+	}
+	catch(...)
+	{
+		applyingChanges = false;
+		throw;
+	}
+	applyingChanges = false;
+}
+
+/**
+ * Orders entry changes by record id.
+ */
+static bool ridLess(const EntryChange& c1, const EntryChange& c2)
+{
+	return c1.rid.page_number < c2.rid.page_number
+		|| (c1.rid.page_number == c2.rid.page_number && c1.rid.slot_number < c2.rid.slot_number);
+}
+
+/**
+ * Orders entry changes by their old, or their new, key.
+ */
+template <class K, bool old>
+static bool keyLess(const EntryChange* c1, const EntryChange* c2)
+{
+	return KeyTraits<K>::read(old ? c1->oldKey : c1->newKey) < KeyTraits<K>::read(old ? c2->oldKey : c2->newKey);
+}
+
+template <class K>
+void BTreeIndex::applyChanges(std::vector<EntryChange>& changes)
+{
+	// a record changed several times needs only the entry it had before the first change removed, and the one it
+	// has after the last one added
+	std::stable_sort(changes.begin(), changes.end(), ridLess);
+	std::vector<const EntryChange*> removals, additions;
+	for (size_t first = 0, last; first < changes.size(); first = last + 1)
+	{
+		last = first;
+		while (last + 1 < changes.size() && changes[last + 1].rid == changes[first].rid)
+		{
+			last++;
+		}
+		const EntryChange& before = changes[first];
+		const EntryChange& after = changes[last];
+		if (before.existed && after.exists && memcmp(before.oldKey, after.newKey, MAXKEYSIZE) == 0
+			&& memcmp(before.oldPayload, after.newPayload, INCLUDESIZE) == 0)
+		{
+			continue;
+		}
+		if (before.existed)
+			removals.push_back(&before);
+		if (after.exists)
+			additions.push_back(&after);
+	}
+
+	// in key order, consecutive changes mostly fall into the same leaf
+	std::sort(removals.begin(), removals.end(), keyLess<K, true>);
+	std::sort(additions.begin(), additions.end(), keyLess<K, false>);
+	for (size_t i = 0; i < removals.size(); i++)
+	{
+		try
+		{
+			deleteEntry(removals[i]->oldKey, removals[i]->rid);
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+		}
+	}
+	for (size_t i = 0; i < additions.size(); i++)
+	{
+		insertEntry(additions[i]->newKey, additions[i]->rid, includeLength > 0 ? additions[i]->newPayload : NULL);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::~BTreeIndex -- destructor
+// -----------------------------------------------------------------------------
+
+BTreeIndex::~BTreeIndex()
+{
+	try
+	{
+		PageFile::removeRecordListener(relationName, this);
+		applyPendingChanges();
+		if (scanCursor.scanExecuting)
+		{
+			endScan();
+		}
+
+		// the meta page is marked clean only once every other page is on disk
+		if (!file->isMapped())
+		{
+			bufMgr->flushFile(file);
+			writeMetaInfo(true);
+			bufMgr->flushFile(file);
+		}
+	}
+	catch(const BadgerDbException &e)
+	{
+		std::cerr << "BTreeIndex: " << e.message() << std::endl;
+	}
+	delete file;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::encodeKey
+// -----------------------------------------------------------------------------
+
+/**
+ * Stores the low numBytes bytes of bits at out, most significant byte first, so that memcmp orders them as integers.
+ */
+static void storeBigEndian(unsigned char *out, std::uint64_t bits, int numBytes)
+{
+	for (int i = numBytes - 1; i >= 0; i--)
+	{
+		out[i] = bits & 0xff;
+		bits >>= 8;
+	}
+}
+
+void BTreeIndex::encodeKeyParts(const void* const* values, int numValues, unsigned char fill, CompositeKey& key) const
+{
+	memset(key.data, 0, COMPOSITESIZE);
+	unsigned char *out = key.data;
+	for (int i = 0; i < (int)keyParts.size(); i++)
+	{
+		const KeyPart &part = keyParts[i];
+		if (i >= numValues)
+		{
+			memset(out, fill, part.length);
+		}
+		else if (part.type == INTEGER)
+		{
+			// with the sign bit flipped, negative values come before positive ones as unsigned numbers
+			std::uint32_t bits = static_cast<std::uint32_t>(KeyTraits<int>::read(values[i])) ^ 0x80000000u;
+			storeBigEndian(out, bits, part.length);
+		}
+		else if (part.type == DOUBLE)
+		{
+			// -0.0 equals 0.0, so both get the same bytes
+			double value = KeyTraits<double>::read(values[i]);
+			if (value == 0)
+			{
+				value = 0;
+			}
+			std::uint64_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			// the bits of positive values order them once the sign bit is set; those of negative values order them
+			// backwards, so they are all flipped
+			bits = (bits >> 63) ? ~bits : bits | (1ull << 63);
+			storeBigEndian(out, bits, part.length);
+		}
+		else
+		{
+			const char *str = static_cast<const char*>(values[i]);
+			for (int j = 0; j < part.length && str[j] != '\0'; j++)
+			{
+				out[j] = str[j];
+			}
+		}
+		out += part.length;
+	}
+}
+
+void BTreeIndex::encodeKey(const void* const* values, int numValues, void* out) const
+{
+	if (attributeType != COMPOSITE || numValues < 1 || numValues > (int)keyParts.size())
+	{
+		throw BadScanParamException();
+	}
+
+	CompositeKey key;
+	encodeKeyParts(values, numValues, 0, key);
+	memcpy(out, key.data, COMPOSITESIZE);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertEntry(const void *key, const RecordId rid)
+{
+	insertEntry(key, rid, NULL);
+}
+
+/**
+ * Makes the key of a covering index out of an insert parameter and the record's included attributes.
+ */
+template <class T>
+static CoveredKey<T> readCoveredKey(const void* key, const void* payload, int includeLength)
+{
+	CoveredKey<T> coveredKey = KeyTraits< CoveredKey<T> >::read(key);
+	if (payload != NULL)
+	{
+		memcpy(coveredKey.payload, payload, includeLength);
+	}
+	return coveredKey;
+}
+
+void BTreeIndex::insertEntry(const void *key, const RecordId rid, const void *payload)
+{
+	// the pages of a mapped index are not writable memory
+	if (file->isMapped())
+	{
+		throw ReadOnlyFileException(file->filename());
+	}
+	BufOperation operation(bufMgr);
+	applyPendingChanges();
+	if (includeLength > 0)
+	{
+		switch (attributeType)
+		{
+			case INTEGER:
+				insertEntryTyped< CoveredKey<int> >(readCoveredKey<int>(key, payload, includeLength), rid);
+				break;
+			case DOUBLE:
+				insertEntryTyped< CoveredKey<double> >(readCoveredKey<double>(key, payload, includeLength), rid);
+				break;
+			case STRING:
+				insertEntryTyped< CoveredKey<StringKey> >(readCoveredKey<StringKey>(key, payload, includeLength), rid);
+				break;
+			case COMPOSITE:
+				insertEntryTyped< CoveredKey<CompositeKey> >(readCoveredKey<CompositeKey>(key, payload, includeLength), rid);
+				break;
+		}
+	}
+	else
+	{
+		switch (attributeType)
+		{
+			case INTEGER:
+				insertEntryTyped<int>(KeyTraits<int>::read(key), rid);
+				break;
+			case DOUBLE:
+				insertEntryTyped<double>(KeyTraits<double>::read(key), rid);
+				break;
+			case STRING:
+				if (prefixCompressed)
+					insertEntryTyped<PrefixStringKey>(KeyTraits<StringKey>::read(key), rid);
+				else
+					insertEntryTyped<StringKey>(KeyTraits<StringKey>::read(key), rid);
+				break;
+			case COMPOSITE:
+				insertEntryTyped<CompositeKey>(KeyTraits<CompositeKey>::read(key), rid);
+				break;
+		}
+	}
+	if (bufMgr->hasLog())
+	{
+		writeMetaInfo();
+	}
+}
+
+template <class T>
+void BTreeIndex::insertEntryTyped(const typename LeafNode<T>::KeyType& key, const RecordId rid)
+{
+	RIDKeyPair<typename LeafNode<T>::KeyType> entry;
+	entry.set(rid, key);
+
+	// the entry is counted and the key bounds widened first, so that a lookup finding the key outside them is never
+	// wrong and a concurrent delete of the last entry does not drop them; the count is taken back if the insert fails
+	countInsert<T>(key);
+	try
+	{
+		if (insertOptimistic<T>(entry))
+		{
+			return;
+		}
+
+		// the leaf is full: split it, and its ancestors as needed
+		std::lock_guard<std::mutex> guard(structureMutex);
+		PageKeyPair<typename LeafNode<T>::KeyType> newChild;
+		insertInto<T>(rootPageNum, height == 1, entry, newChild);
+	}
+	catch(...)
+	{
+		countDelete();
+		throw;
+	}
+}
+
+template <class T>
+bool BTreeIndex::descendOptimistic(const typename LeafNode<T>::KeyType& key, bool upper, PageId& pageNo, Page*& page,
+                                   std::uint64_t& version)
+{
+	// the root may have been replaced between reading its page number and latching it
+	pageNo = rootPageNum;
+	bool isLeaf = height == 1;
+	bufMgr->readPage(file, pageNo, page);
+	if (!bufMgr->pageLatch(page).readLock(version) || pageNo != rootPageNum)
+	{
+		bufMgr->unPinPage(file, pageNo, false);
+		return false;
+	}
+
+	while (!isLeaf)
+	{
+		OptimisticView< NonLeafNode<T> > view(page);
+		const NonLeafNode<T> *node = view.node;
+		const PageId childPageNo = node->childAt(upper ? node->upperBound(key) : node->lowerBound(key));
+		const bool childIsLeaf = node->level == 1;
+
+		// the child page number is only safe to use if the parent did not change while it was read
+		PageLatch &latch = bufMgr->pageLatch(page);
+		if (!latch.validate(version))
+		{
+			bufMgr->unPinPage(file, pageNo, false);
+			return false;
+		}
+
+		Page *childPage;
+		std::uint64_t childVersion;
+		bufMgr->readPage(file, childPageNo, childPage);
+		prefetchNode(childPage);
+		const bool coupled = bufMgr->pageLatch(childPage).readLock(childVersion) && latch.validate(version);
+		bufMgr->unPinPage(file, pageNo, false);
+		if (!coupled)
+		{
+			bufMgr->unPinPage(file, childPageNo, false);
+			return false;
+		}
+
+		pageNo = childPageNo;
+		page = childPage;
+		version = childVersion;
+		isLeaf = childIsLeaf;
+	}
+	return true;
+}
+
+template <class T>
+void BTreeIndex::lockLeaf(const typename LeafNode<T>::KeyType& key, bool upper, PageId& pageNo, Page*& page)
+{
+	std::uint64_t version;
+	while (true)
+	{
+		if (descendOptimistic<T>(key, upper, pageNo, page, version))
+		{
+			if (bufMgr->pageLatch(page).upgrade(version))
+			{
+				return;
+			}
+			bufMgr->unPinPage(file, pageNo, false);
+		}
+		std::this_thread::yield();
+	}
+}
+
+template <class T>
+bool BTreeIndex::insertOptimistic(const RIDKeyPair<typename LeafNode<T>::KeyType>& entry)
+{
+	PageId pageNo;
+	Page *page;
+	lockLeaf<T>(entry.key, true, pageNo, page);
+
+	// insert after any equal keys
+	LeafNode<T> *leaf = reinterpret_cast<LeafNode<T>*>(page);
+	const bool inserted = leaf->insertAt(leaf->upperBound(entry.key), entry.key, entry.rid);
+	bufMgr->pageLatch(page).unlock();
+	bufMgr->unPinPage(file, pageNo, inserted);
+	return inserted;
+}
+
+template <class T>
+bool BTreeIndex::insertInto(PageId pageNo, bool isLeaf, const RIDKeyPair<typename LeafNode<T>::KeyType>& entry,
+                            PageKeyPair<typename LeafNode<T>::KeyType>& newChild)
+{
+	Page *page = lockNode(pageNo);
+
+	if (isLeaf)
+	{
+		// insert after any equal keys
+		LeafNode<T> *leaf = reinterpret_cast<LeafNode<T>*>(page);
+		int pos = leaf->upperBound(entry.key);
+		if (!leaf->insertAt(pos, entry.key, entry.rid))
+		{
+			splitLeaf(leaf, pos, entry, newChild);
+			return finishSplit<T>(pageNo, page, newChild);
+		}
+		unlockNode(pageNo, page, true);
+		return false;
+	}
+
+	NonLeafNode<T> *node = reinterpret_cast<NonLeafNode<T>*>(page);
+	int childIndex = node->upperBound(entry.key);
+
+	PageKeyPair<typename LeafNode<T>::KeyType> childSplit;
+	if (!insertInto<T>(node->childAt(childIndex), node->level == 1, entry, childSplit))
+	{
+		unlockNode(pageNo, page, false);
+		return false;
+	}
+
+	// the new child goes right after the one that was split
+	if (!node->insertAt(childIndex, childSplit.key, childSplit.pageNo))
+	{
+		splitNonLeaf(node, childIndex, childSplit, newChild);
+		return finishSplit<T>(pageNo, page, newChild);
+	}
+	unlockNode(pageNo, page, true);
+	return false;
+}
+
+template <class T>
+bool BTreeIndex::finishSplit(PageId pageNo, Page *page, const PageKeyPair<typename LeafNode<T>::KeyType>& newChild)
+{
+	// a reader reaching the old root after it is unlocked would not find the keys that moved to its new sibling
+	const bool isRoot = pageNo == rootPageNum;
+	if (isRoot)
+	{
+		growRoot<T>(newChild);
+	}
+	unlockNode(pageNo, page, true);
+	return !isRoot;
+}
+
+template <class T>
+void BTreeIndex::splitLeaf(LeafNode<T>* node, int pos, const RIDKeyPair<typename LeafNode<T>::KeyType>& entry,
+                           PageKeyPair<typename LeafNode<T>::KeyType>& newChild)
+{
+	PageId newPageNo;
+	Page *newPage;
+	bufMgr->allocPage(file, newPageNo, newPage);
+	LeafNode<T> *sibling = reinterpret_cast<LeafNode<T>*>(newPage);
+
+	typename LeafNode<T>::KeyType separator;
+	node->split(sibling, pos, entry.key, entry.rid, separator);
+	sibling->rightSibPageNo = node->rightSibPageNo;
+	node->rightSibPageNo = newPageNo;
+
+	newChild.set(newPageNo, separator);
+	bufMgr->unPinPage(file, newPageNo, true);
+	countNodes(true, 1);
+}
+
+template <class T>
+void BTreeIndex::splitNonLeaf(NonLeafNode<T>* node, int pos, const PageKeyPair<typename LeafNode<T>::KeyType>& entry,
+                              PageKeyPair<typename LeafNode<T>::KeyType>& newChild)
+{
+	PageId newPageNo;
+	Page *newPage;
+	bufMgr->allocPage(file, newPageNo, newPage);
+	NonLeafNode<T> *sibling = reinterpret_cast<NonLeafNode<T>*>(newPage);
+
+	typename LeafNode<T>::KeyType middleKey;
+	node->split(sibling, pos, entry.key, entry.pageNo, middleKey);
+
+	newChild.set(newPageNo, middleKey);
+	bufMgr->unPinPage(file, newPageNo, true);
+	countNodes(false, 1);
+}
+
+template <class T>
+void BTreeIndex::growRoot(const PageKeyPair<typename LeafNode<T>::KeyType>& newChild)
+{
+	PageId newRootPageNo;
+	Page *newRootPage;
+	bufMgr->allocPage(file, newRootPageNo, newRootPage);
+	NonLeafNode<T> *root = reinterpret_cast<NonLeafNode<T>*>(newRootPage);
+
+	root->init(height == 1 ? 1 : 0, rootPageNum);
+	root->insertAt(0, newChild.key, newChild.pageNo);
+	bufMgr->unPinPage(file, newRootPageNo, true);
+	countNodes(false, 1);
+
+	height++;
+	rootPageNum = newRootPageNo;
+	writeMetaInfo();
+}
+
 // -----------------------------------------------------------------------------
-// BTreeIndex::BTreeIndex -- Constructor
+// BTreeIndex::deleteEntry
 // -----------------------------------------------------------------------------
 
+void BTreeIndex::deleteEntry(const void *key, const RecordId rid)
+{
+	if (file->isMapped())
+	{
+		throw ReadOnlyFileException(file->filename());
+	}
+	BufOperation operation(bufMgr);
+	applyPendingChanges();
+	bool found = false;
+	switch (attributeType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				found = deleteEntryTyped< CoveredKey<int> >(KeyTraits< CoveredKey<int> >::read(key), rid);
+			else
+				found = deleteEntryTyped<int>(KeyTraits<int>::read(key), rid);
+			break;
+		case DOUBLE:
+			if (includeLength > 0)
+				found = deleteEntryTyped< CoveredKey<double> >(KeyTraits< CoveredKey<double> >::read(key), rid);
+			else
+				found = deleteEntryTyped<double>(KeyTraits<double>::read(key), rid);
+			break;
+		case STRING:
+			if (prefixCompressed)
+				found = deleteEntryTyped<PrefixStringKey>(KeyTraits<StringKey>::read(key), rid);
+			else if (includeLength > 0)
+				found = deleteEntryTyped< CoveredKey<StringKey> >(KeyTraits< CoveredKey<StringKey> >::read(key), rid);
+			else
+				found = deleteEntryTyped<StringKey>(KeyTraits<StringKey>::read(key), rid);
+			break;
+		case COMPOSITE:
+			if (includeLength > 0)
+				found = deleteEntryTyped< CoveredKey<CompositeKey> >(KeyTraits< CoveredKey<CompositeKey> >::read(key), rid);
+			else
+				found = deleteEntryTyped<CompositeKey>(KeyTraits<CompositeKey>::read(key), rid);
+			break;
+	}
+	if (!found)
+	{
+		throw NoSuchKeyFoundException();
+	}
+	countDelete();
+	if (bufMgr->hasLog())
+	{
+		writeMetaInfo();
+	}
+}
+
+void BTreeIndex::setMergeThreshold(double fillFactor)
+{
+	mergeThreshold = fillFactor;
+}
 
+template <class T>
+bool BTreeIndex::deleteEntryTyped(const typename LeafNode<T>::KeyType& key, const RecordId rid)
+{
+	RIDKeyPair<typename LeafNode<T>::KeyType> entry;
+	entry.set(rid, key);
 
-BTreeIndex::BTreeIndex(const std::string & relationName,
-		std::string & outIndexName,
-		BufMgr *bufMgrIn,
-		const int attrByteOffset,
-		const Datatype attrType)
+	if (deleteOptimistic<T>(entry))
+	{
+		return true;
+	}
+
+	std::lock_guard<std::mutex> guard(structureMutex);
+	bool underflow = false;
+	const bool isLeaf = height == 1;
+	if (!removeFrom<T>(rootPageNum, isLeaf, entry, underflow))
+	{
+		return false;
+	}
+	if (isLeaf)
+	{
+		return true;
+	}
+
+	// a root left with a single child is replaced by that child
+	const PageId rootPageNo = rootPageNum;
+	Page *page = lockNode(rootPageNo);
+	NonLeafNode<T> *root = reinterpret_cast<NonLeafNode<T>*>(page);
+	if (root->numKeys == 0)
+	{
+		height--;
+		rootPageNum = root->childAt(0);
+		freeNode(rootPageNo, page);
+		countNodes(false, -1);
+		writeMetaInfo();
+	}
+	else
+	{
+		unlockNode(rootPageNo, page, false);
+	}
+	return true;
+}
+
+template <class T>
+bool BTreeIndex::deleteOptimistic(const RIDKeyPair<typename LeafNode<T>::KeyType>& entry)
 {
-	bufMgr = bufMgrIn;
-	attributeType = attrType; // should just be INTEGER
-	BTreeIndex::attrByteOffset = attrByteOffset;
+	PageId pageNo;
+	Page *page;
+	lockLeaf<T>(entry.key, false, pageNo, page);
+
+	LeafNode<T> *leaf = reinterpret_cast<LeafNode<T>*>(page);
+	bool removed = false;
+	for (int pos = leaf->lowerBound(entry.key); pos < leaf->numKeys && leaf->keyAt(pos) == entry.key; pos++)
+	{
+		if (leaf->ridAt(pos) == entry.rid)
+		{
+			// an underflowing leaf has to be rebalanced with its siblings; put the entry back, with any payload, for
+			// removeFrom()
+			const typename LeafNode<T>::KeyType removedKey = leaf->keyAt(pos);
+			leaf->removeAt(pos);
+			removed = leaf->numKeys > 0 && leaf->fillFactor() >= mergeThreshold;
+			if (!removed)
+			{
+				leaf->insertAt(pos, removedKey, entry.rid);
+			}
+			break;
+		}
+	}
+	bufMgr->pageLatch(page).unlock();
+	bufMgr->unPinPage(file, pageNo, removed);
+	return removed;
+}
+
+template <class T>
+bool BTreeIndex::removeFrom(PageId pageNo, bool isLeaf, const RIDKeyPair<typename LeafNode<T>::KeyType>& entry, bool& underflow)
+{
+	Page *page = lockNode(pageNo);
+
+	if (isLeaf)
+	{
+		LeafNode<T> *leaf = reinterpret_cast<LeafNode<T>*>(page);
+		for (int pos = leaf->lowerBound(entry.key); pos < leaf->numKeys && leaf->keyAt(pos) == entry.key; pos++)
+		{
+			if (leaf->ridAt(pos) == entry.rid)
+			{
+				leaf->removeAt(pos);
+				underflow = leaf->numKeys == 0 || leaf->fillFactor() < mergeThreshold;
+				unlockNode(pageNo, page, true);
+				return true;
+			}
+		}
+		unlockNode(pageNo, page, false);
+		return false;
+	}
+
+	NonLeafNode<T> *node = reinterpret_cast<NonLeafNode<T>*>(page);
+	const int last = node->upperBound(entry.key);
+	for (int i = node->lowerBound(entry.key); i <= last; i++)
+	{
+		bool childUnderflow = false;
+		if (removeFrom<T>(node->childAt(i), node->level == 1, entry, childUnderflow))
+		{
+			bool changed = childUnderflow && rebalanceChild(node, i);
+			underflow = node->numKeys == 0 || node->fillFactor() < mergeThreshold;
+			unlockNode(pageNo, page, changed);
+			return true;
+		}
+	}
+	unlockNode(pageNo, page, false);
+	return false;
+}
+
+template <class T>
+bool BTreeIndex::rebalanceChild(NonLeafNode<T>* node, int pos)
+{
+	if (node->numKeys == 0)
+	{
+		return false;
+	}
+
+	// work on the child and its right sibling, or its left sibling if it is the last child.
+	// The right one of the two is the one that gets freed.
+	const int left = pos < node->numKeys ? pos : pos - 1;
+	const PageId leftPageNo = node->childAt(left);
+	const PageId rightPageNo = node->childAt(left + 1);
+	Page *leftPage = lockNode(leftPageNo);
+	Page *rightPage = lockNode(rightPageNo);
+
+	typename LeafNode<T>::KeyType separator = node->keyAt(left);
+	bool merged;
+	if (node->level == 1)
+	{
+		LeafNode<T> *leftLeaf = reinterpret_cast<LeafNode<T>*>(leftPage);
+		LeafNode<T> *rightLeaf = reinterpret_cast<LeafNode<T>*>(rightPage);
+		merged = leftLeaf->mergeRight(rightLeaf);
+		if (merged)
+			leftLeaf->rightSibPageNo = rightLeaf->rightSibPageNo;
+	}
+	else
+	{
+		merged = reinterpret_cast<NonLeafNode<T>*>(leftPage)->mergeRight(separator, reinterpret_cast<NonLeafNode<T>*>(rightPage));
+	}
+
+	if (merged)
+	{
+		node->removeAt(left);
+		unlockNode(leftPageNo, leftPage, true);
+		freeNode(rightPageNo, rightPage);
+		countNodes(node->level == 1, -1);
+		return true;
+	}
+
+	// the two do not fit into one page: even them out instead. The new separator may not fit into a
+	// prefix-compressed parent, in which case both children are left as they were.
+	const Page savedLeft = *leftPage;
+	const Page savedRight = *rightPage;
+	if (node->level == 1)
+		reinterpret_cast<LeafNode<T>*>(leftPage)->balance(reinterpret_cast<LeafNode<T>*>(rightPage), separator);
+	else
+		reinterpret_cast<NonLeafNode<T>*>(leftPage)->balance(reinterpret_cast<NonLeafNode<T>*>(rightPage), separator);
+
+	const bool changed = node->replaceKeyAt(left, separator);
+	if (!changed)
+	{
+		*leftPage = savedLeft;
+		*rightPage = savedRight;
+	}
+	unlockNode(leftPageNo, leftPage, changed);
+	unlockNode(rightPageNo, rightPage, changed);
+	return changed;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupEntry
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::lookupEntry(const void *key, RecordId& outRid)
+{
+	applyPendingChanges();
+	bool found = false;
+	switch (attributeType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				found = lookupEntryTyped< CoveredKey<int> >(KeyTraits< CoveredKey<int> >::read(key), outRid);
+			else
+				found = lookupEntryTyped<int>(KeyTraits<int>::read(key), outRid);
+			break;
+		case DOUBLE:
+			if (includeLength > 0)
+				found = lookupEntryTyped< CoveredKey<double> >(KeyTraits< CoveredKey<double> >::read(key), outRid);
+			else
+				found = lookupEntryTyped<double>(KeyTraits<double>::read(key), outRid);
+			break;
+		case STRING:
+			if (prefixCompressed)
+				found = lookupEntryTyped<PrefixStringKey>(KeyTraits<StringKey>::read(key), outRid);
+			else if (includeLength > 0)
+				found = lookupEntryTyped< CoveredKey<StringKey> >(KeyTraits< CoveredKey<StringKey> >::read(key), outRid);
+			else
+				found = lookupEntryTyped<StringKey>(KeyTraits<StringKey>::read(key), outRid);
+			break;
+		case COMPOSITE:
+			if (includeLength > 0)
+				found = lookupEntryTyped< CoveredKey<CompositeKey> >(KeyTraits< CoveredKey<CompositeKey> >::read(key), outRid);
+			else
+				found = lookupEntryTyped<CompositeKey>(KeyTraits<CompositeKey>::read(key), outRid);
+			break;
+	}
+	if (!found)
+	{
+		throw NoSuchKeyFoundException();
+	}
+}
+
+template <class T>
+bool BTreeIndex::lookupEntryTyped(const typename LeafNode<T>::KeyType& key, RecordId& outRid)
+{
+	if (!mayHaveKeys<T>(key, GTE, key, LTE))
+	{
+		return false;
+	}
+
+	while (true)
+	{
+		PageId pageNo;
+		Page *page;
+		std::uint64_t version;
+		if (!descendOptimistic<T>(key, false, pageNo, page, version))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// the first key >= key may be at the start of a right sibling
+		while (true)
+		{
+			OptimisticView< LeafNode<T> > view(page);
+			const LeafNode<T> *leaf = view.node;
+			const int pos = leaf->lowerBound(key);
+			PageId nextPageNo = Page::INVALID_NUMBER;
+			if (pos == leaf->numKeys)
+			{
+				nextPageNo = leaf->rightSibPageNo;
+			}
+			const bool found = pos < leaf->numKeys && leaf->keyAt(pos) == key;
+			RecordId rid;
+			if (found)
+			{
+				rid = leaf->ridAt(pos);
+			}
+
+			PageLatch &latch = bufMgr->pageLatch(page);
+			if (!latch.validate(version))
+			{
+				bufMgr->unPinPage(file, pageNo, false);
+				break;
+			}
+			if (nextPageNo == Page::INVALID_NUMBER)
+			{
+				bufMgr->unPinPage(file, pageNo, false);
+				outRid = rid;
+				return found;
+			}
+
+			Page *nextPage;
+			std::uint64_t nextVersion;
+			bufMgr->readPage(file, nextPageNo, nextPage);
+			const bool coupled = bufMgr->pageLatch(nextPage).readLock(nextVersion) && latch.validate(version);
+			bufMgr->unPinPage(file, pageNo, false);
+			if (!coupled)
+			{
+				bufMgr->unPinPage(file, nextPageNo, false);
+				break;
+			}
+			pageNo = nextPageNo;
+			page = nextPage;
+			version = nextVersion;
+		}
+		std::this_thread::yield();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupBatch
+// -----------------------------------------------------------------------------
+
+size_t BTreeIndex::lookupBatch(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found)
+{
+	applyPendingChanges();
+	switch (attributeType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				return lookupBatchTyped< CoveredKey<int> >(keys, numKeys, outRids, found);
+			else
+				return lookupBatchTyped<int>(keys, numKeys, outRids, found);
+		case DOUBLE:
+			if (includeLength > 0)
+				return lookupBatchTyped< CoveredKey<double> >(keys, numKeys, outRids, found);
+			else
+				return lookupBatchTyped<double>(keys, numKeys, outRids, found);
+		case STRING:
+			if (prefixCompressed)
+				return lookupBatchTyped<PrefixStringKey>(keys, numKeys, outRids, found);
+			else if (includeLength > 0)
+				return lookupBatchTyped< CoveredKey<StringKey> >(keys, numKeys, outRids, found);
+			else
+				return lookupBatchTyped<StringKey>(keys, numKeys, outRids, found);
+		case COMPOSITE:
+			if (includeLength > 0)
+				return lookupBatchTyped< CoveredKey<CompositeKey> >(keys, numKeys, outRids, found);
+			else
+				return lookupBatchTyped<CompositeKey>(keys, numKeys, outRids, found);
+	}
+	return 0;
+}
+
+template <class T>
+size_t BTreeIndex::lookupBatchTyped(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found)
+{
+	typedef typename LeafNode<T>::KeyType KeyType;
+
+	if (numKeys == 1)
+	{
+		found[0] = lookupEntryTyped<T>(KeyTraits<KeyType>::read(keys[0]), outRids[0]);
+		return found[0] ? 1 : 0;
+	}
+
+	// probe in key order, so that the keys reaching a node are next to each other
+	std::vector< std::pair<KeyType, size_t> > probes(numKeys);
+	for (size_t i = 0; i < numKeys; i++)
+	{
+		probes[i] = std::make_pair(KeyTraits<KeyType>::read(keys[i]), i);
+	}
+	std::sort(probes.begin(), probes.end());
+
+	// a descent cut short by a concurrent writer starts over from the root with the probes not yet answered
+	size_t next = 0;
+	while (next < numKeys)
+	{
+		PageId pageNo = rootPageNum;
+		bool isLeaf = height == 1;
+		Page *page;
+		std::uint64_t version;
+		bufMgr->readPage(file, pageNo, page);
+		if (!bufMgr->pageLatch(page).readLock(version) || pageNo != rootPageNum)
+		{
+			bufMgr->unPinPage(file, pageNo, false);
+		}
+		else if (probeSubtree<T>(pageNo, page, version, isLeaf, probes, next, numKeys, outRids, found))
+		{
+			continue;
+		}
+		std::this_thread::yield();
+	}
+
+	size_t numFound = 0;
+	for (size_t i = 0; i < numKeys; i++)
+	{
+		if (found[i])
+		{
+			numFound++;
+		}
+	}
+	return numFound;
+}
+
+template <class T>
+bool BTreeIndex::probeSubtree(PageId pageNo, Page *page, std::uint64_t version, bool isLeaf,
+                              const std::vector< std::pair<typename LeafNode<T>::KeyType, size_t> >& probes,
+                              size_t& next, size_t end, RecordId* outRids, bool* found)
+{
+	PageLatch &latch = bufMgr->pageLatch(page);
+
+	if (isLeaf)
+	{
+		// answers are only final once the latch validates; probes past the last key may be answered by a right
+		// sibling, and are looked up on their own
+		OptimisticView< LeafNode<T> > view(page);
+		const LeafNode<T> *leaf = view.node;
+		std::vector<size_t> pastLeaf;
+		for (size_t i = next; i < end; i++)
+		{
+			const int pos = leaf->lowerBound(probes[i].first);
+			found[probes[i].second] = pos < leaf->numKeys && leaf->keyAt(pos) == probes[i].first;
+			if (found[probes[i].second])
+			{
+				outRids[probes[i].second] = leaf->ridAt(pos);
+			}
+			else if (pos == leaf->numKeys && leaf->rightSibPageNo != Page::INVALID_NUMBER)
+			{
+				pastLeaf.push_back(i);
+			}
+		}
+
+		const bool valid = latch.validate(version);
+		bufMgr->unPinPage(file, pageNo, false);
+		if (!valid)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < pastLeaf.size(); i++)
+		{
+			const std::pair<typename LeafNode<T>::KeyType, size_t> &probe = probes[pastLeaf[i]];
+			found[probe.second] = lookupEntryTyped<T>(probe.first, outRids[probe.second]);
+		}
+		next = end;
+		return true;
+	}
+
+	// group the probes by the child they descend to; each child is visited once for its group
+	OptimisticView< NonLeafNode<T> > view(page);
+	const NonLeafNode<T> *node = view.node;
+	const bool childIsLeaf = node->level == 1;
+	std::vector< std::pair<PageId, size_t> > groups;
+	for (size_t i = next; i < end; i++)
+	{
+		const PageId childPageNo = node->childAt(node->lowerBound(probes[i].first));
+		if (groups.empty() || groups.back().first != childPageNo)
+		{
+			groups.push_back(std::make_pair(childPageNo, i + 1));
+		}
+		else
+		{
+			groups.back().second = i + 1;
+		}
+	}
+	if (!latch.validate(version))
+	{
+		bufMgr->unPinPage(file, pageNo, false);
+		return false;
+	}
+
+	// read the children a window at a time, so that the buffer misses and cache misses of a window overlap
+	// before any of them is searched
+	const size_t window = 8;
+	Page *childPages[window];
+	std::uint64_t childVersions[window];
+	for (size_t first = 0; first < groups.size(); first += window)
+	{
+		const size_t count = std::min(window, groups.size() - first);
+		size_t numPinned = 0;
+		bool coupled = true;
+		for (; numPinned < count && coupled; numPinned++)
+		{
+			bufMgr->readPage(file, groups[first + numPinned].first, childPages[numPinned]);
+			coupled = bufMgr->pageLatch(childPages[numPinned]).readLock(childVersions[numPinned]);
+		}
+		coupled = coupled && latch.validate(version);
+
+		size_t numVisited = 0;
+		if (coupled)
+		{
+			for (size_t c = 0; c < count; c++)
+			{
+				prefetchNode(childPages[c]);
+			}
+			for (; numVisited < count && coupled; numVisited++)
+			{
+				// the child unpins itself
+				coupled = probeSubtree<T>(groups[first + numVisited].first, childPages[numVisited], childVersions[numVisited],
+				                          childIsLeaf, probes, next, groups[first + numVisited].second, outRids, found);
+			}
+		}
+		if (!coupled)
+		{
+			for (size_t c = numVisited; c < numPinned; c++)
+			{
+				bufMgr->unPinPage(file, groups[first + c].first, false);
+			}
+			bufMgr->unPinPage(file, pageNo, false);
+			return false;
+		}
+	}
+
+	bufMgr->unPinPage(file, pageNo, false);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// Page management
+// -----------------------------------------------------------------------------
+
+Page *BTreeIndex::lockNode(PageId pageNo)
+{
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	bufMgr->pageLatch(page).lock();
+	return page;
+}
+
+void BTreeIndex::unlockNode(PageId pageNo, Page *page, bool dirty)
+{
+	bufMgr->pageLatch(page).unlock();
+	bufMgr->unPinPage(file, pageNo, dirty);
+}
+
+void BTreeIndex::freeNode(PageId pageNo, Page *page)
+{
+	// readers still holding the page restart when they validate, and the buffer manager disposes of it once they unpin it
+	bufMgr->pageLatch(page).unlockObsolete();
+	bufMgr->unPinPage(file, pageNo, false);
+	bufMgr->disposePage(file, pageNo);
+}
+
+bool BTreeIndex::readMetaInfo(const std::string & indexName)
+{
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	IndexMetaInfo *metaInfo = reinterpret_cast<IndexMetaInfo*>(metaPage);
+	if (metaInfo->formatVersion != INDEXFORMATVERSION || metaInfo->checksum != metaChecksum(*metaInfo))
+	{
+		bufMgr->unPinPage(file, headerPageNum, false);
+		return false;
+	}
 
-	std::ostringstream idxStr;
-	idxStr << relationName << '.' << attrByteOffset;
-	std::string indexName = idxStr.str(); // indexName is the name of the index file
-	outIndexName = indexName;
+	bool matches = strncmp(metaInfo->relationName, relationName.c_str(), sizeof(metaInfo->relationName)) == 0
+		&& metaInfo->attrByteOffset == attrByteOffset
+		&& metaInfo->attrType == attributeType
+		&& metaInfo->prefixCompressed == prefixCompressed
+		&& metaInfo->includeByteOffset == includeByteOffset
+		&& metaInfo->includeLength == includeLength
+		&& metaInfo->numKeyParts == (int)keyParts.size();
+	for (size_t i = 0; matches && i < keyParts.size(); i++)
+	{
+		matches = metaInfo->keyParts[i].byteOffset == keyParts[i].byteOffset
+			&& metaInfo->keyParts[i].type == keyParts[i].type
+			&& metaInfo->keyParts[i].length == keyParts[i].length;
+	}
+	if (!matches)
+	{
+		bufMgr->unPinPage(file, headerPageNum, false);
+		throw BadIndexInfoException(indexName);
+	}
 
-	// if indexName exists, then the file is opened. Else, a new index file is created.
-	try {
-		BlobFile bf = BlobFile::open(indexName);
-		file = &bf;
-		// index file already exists:
-		
-		// read meta info (btree.h:108)
-		Page *metaPage;
-		bufMgr->readPage(file, 0, metaPage);
-		IndexMetaInfo metaInfo = *reinterpret_cast<IndexMetaInfo*>(metaPage);
-		rootPageNum = metaInfo.rootPageNo;
+	std::int64_t bytes, modified;
+	relationStamp(relationName, bytes, modified);
+	const bool current = (metaInfo->closedCleanly || (metaInfo->logged && bufMgr->hasLog()))
+		&& metaInfo->relationBytes == bytes && metaInfo->relationModified == modified;
+	if (current)
+	{
+		rootPageNum = metaInfo->rootPageNo;
+		height = metaInfo->height;
+		numEntries = metaInfo->numEntries;
+		numLeaves = metaInfo->numLeaves;
+		numNonLeaves = metaInfo->numNonLeaves;
+		hasKeyRange = metaInfo->hasKeyRange;
+		memcpy(minKey, metaInfo->minKey, MAXKEYSIZE);
+		memcpy(maxKey, metaInfo->maxKey, MAXKEYSIZE);
+	}
+	bufMgr->unPinPage(file, headerPageNum, false);
+	return current;
+}
 
-		// TODO : this shouldn't be necessary after calling open:
-		// file = &BlobFile::create(indexName); 
+void BTreeIndex::writeMetaInfo(bool closing, bool stampRelation)
+{
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	IndexMetaInfo *metaInfo = reinterpret_cast<IndexMetaInfo*>(metaPage);
+	metaInfo->rootPageNo = rootPageNum;
+	metaInfo->height = height;
+	{
+		std::lock_guard<std::mutex> guard(statsMutex);
+		metaInfo->numEntries = numEntries;
+		metaInfo->numLeaves = numLeaves;
+		metaInfo->numNonLeaves = numNonLeaves;
+		metaInfo->hasKeyRange = hasKeyRange;
+		memcpy(metaInfo->minKey, minKey, MAXKEYSIZE);
+		memcpy(metaInfo->maxKey, maxKey, MAXKEYSIZE);
+	}
+	metaInfo->closedCleanly = closing;
+	metaInfo->logged = bufMgr->hasLog();
+	if (PageFile::unreportedChanges(relationName) != unreportedChangesAtOpen)
+	{
+		// records changed through Page directly and written are not in the index
+		metaInfo->relationBytes = -1;
+		metaInfo->relationModified = -1;
+	}
+	else if (closing || stampRelation)
+	{
+		relationStamp(relationName, metaInfo->relationBytes, metaInfo->relationModified);
 	}
-	catch(FileNotFoundException const&) {
-		// index file doesn't already exist:
+	metaInfo->checksum = metaChecksum(*metaInfo);
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
 
-		file = &BlobFile::create(indexName);
-		
-		// initialize meta info page
-		IndexMetaInfo newInfo;
-		strcpy(newInfo.relationName, relationName.c_str());
-		newInfo.attrByteOffset = attrByteOffset;
-		newInfo.attrType = attrType;
-		newInfo.rootPageNo = 1;
-		rootPageNum = 1;
+// -----------------------------------------------------------------------------
+// BTreeIndex::getStats
+// -----------------------------------------------------------------------------
 
-		// read meta info page to file
-		Page* metaPage = reinterpret_cast<Page*>(&newInfo);
-		file->writePage(0, *metaPage);
+IndexStats BTreeIndex::getStats()
+{
+	applyPendingChanges();
+	IndexStats stats;
+	stats.formatVersion = INDEXFORMATVERSION;
+	stats.height = height;
+	std::lock_guard<std::mutex> guard(statsMutex);
+	stats.numEntries = numEntries;
+	stats.numLeaves = numLeaves;
+	stats.numNonLeaves = numNonLeaves;
+	stats.leafFill = numLeaves > 0 ? (double)numEntries / ((double)numLeaves * leafOccupancy) : 0;
+	stats.hasKeyRange = hasKeyRange;
+	memcpy(stats.minKey, minKey, MAXKEYSIZE);
+	memcpy(stats.maxKey, maxKey, MAXKEYSIZE);
+	return stats;
+}
 
-		// initialize root node
-		NonLeafNodeInt* rootNode;
-		rootNode->level = 1;
-		
-		Page* rootPage;
-		bufMgr->allocPage(file, rootPageNum, rootPage);
-		*rootPage = *reinterpret_cast<Page*>(rootNode);
+template <class T>
+void BTreeIndex::countInsert(const typename LeafNode<T>::KeyType& key)
+{
+	typedef typename LeafNode<T>::KeyType KeyType;
+	const size_t keySize = sizeof(keyProper(key));
+	std::lock_guard<std::mutex> guard(statsMutex);
+	numEntries++;
+	if (!hasKeyRange)
+	{
+		memcpy(minKey, &keyProper(key), keySize);
+		memcpy(maxKey, &keyProper(key), keySize);
+		hasKeyRange = true;
+	}
+	else if (key < KeyTraits<KeyType>::read(minKey))
+	{
+		memcpy(minKey, &keyProper(key), keySize);
+	}
+	else if (KeyTraits<KeyType>::read(maxKey) < key)
+	{
+		memcpy(maxKey, &keyProper(key), keySize);
+	}
+}
 
-		// = (Page*) &rootNode;
-		// file->writePage(1, *rootPage);
+void BTreeIndex::countDelete()
+{
+	std::lock_guard<std::mutex> guard(statsMutex);
+	if (--numEntries <= 0)
+	{
+		hasKeyRange = false;
 	}
+}
+
+void BTreeIndex::countNodes(bool leaves, int delta)
+{
+	std::lock_guard<std::mutex> guard(statsMutex);
+	if (leaves)
+		numLeaves += delta;
+	else
+		numNonLeaves += delta;
+}
 
+template <class T>
+bool BTreeIndex::mayHaveKeys(const typename LeafNode<T>::KeyType& lowVal, Operator lowOp,
+                             const typename LeafNode<T>::KeyType& highVal, Operator highOp)
+{
+	typedef typename LeafNode<T>::KeyType KeyType;
+	std::lock_guard<std::mutex> guard(statsMutex);
+	return hasKeyRange && belowHigh(KeyTraits<KeyType>::read(minKey), highVal, highOp)
+		&& aboveLow(KeyTraits<KeyType>::read(maxKey), lowVal, lowOp);
+}
 
+// -----------------------------------------------------------------------------
+// IndexCursor
+// -----------------------------------------------------------------------------
 
-	// the constructor should scan relationName and insert entries
-	// for all of the tuples in the relation into the index
-	FileScan scan(relationName, bufMgr);
-	try {
-		RecordId nextRec;
+IndexCursor::IndexCursor()
+	: index(NULL), scanExecuting(false), nextEntry(-1), currentPageNum(Page::INVALID_NUMBER), currentPageData(NULL),
+	  currentVersion(0), equalReturned(0), equalToSkip(0)
+{
+}
 
-		while(true) {
-			scan.scanNext(nextRec);
-			
-			// --- The following is taken from main.cpp:121 ---
-			// Assuming RECORD.keyIndex is our key, lets extract the key, which we know is 
-			// INTEGER and whose byte offset is also know inside the record. 
-			std::string recordStr = scan.getRecord();
-			const char *record = recordStr.c_str();
-			int key = attrByteOffset + *reinterpret_cast<const int*>(record); // offsetof (attributeType, keyIndex)));
-			
-			insertEntry(&key, nextRec);
+IndexCursor::~IndexCursor()
+{
+	if (scanExecuting)
+	{
+		try
+		{
+			index->endScan(*this);
+		}
+		catch(const BadgerDbException &e)
+		{
+			std::cerr << "IndexCursor: " << e.message() << std::endl;
 		}
-	}
-	catch(EndOfFileException const&) {
-		std::cout << "Initial file scan of " << indexName << " finished.";
 	}
 }
 
+void IndexCursor::setScanRange(const int& lowVal, const int& highVal)
+{
+	lowValInt = lowVal;
+	highValInt = highVal;
+}
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::~BTreeIndex -- destructor
-// -----------------------------------------------------------------------------
+void IndexCursor::setScanRange(const double& lowVal, const double& highVal)
+{
+	lowValDouble = lowVal;
+	highValDouble = highVal;
+}
 
+void IndexCursor::setScanRange(const StringKey& lowVal, const StringKey& highVal)
+{
+	lowValString.assign(lowVal.data, STRINGSIZE);
+	highValString.assign(highVal.data, STRINGSIZE);
+}
 
-BTreeIndex::~BTreeIndex()
+void IndexCursor::setScanRange(const CompositeKey& lowVal, const CompositeKey& highVal)
 {
-	/*
-	The destructor. Perform any cleanup that may be necessary, including clearing up
-	any state variables, unpinning any B+ Tree pages that are pinned, and flushing the
-	index file (by calling bufMgr->flushFile()). Note that this method does not
-	delete the index file! But, deletion of the file object is required, which will call the
-	destructor of File class causing the index file to be closed.
-	*/
-	
-	// ends scan if it is in progress
-	if(scanExecuting) {
-		endScan();
-	}
+	lowValComposite = lowVal;
+	highValComposite = highVal;
+}
 
-	// unpin the root page. It should be the only page still pinned.
-	bufMgr->unPinPage(file, rootPageNum, false);
+void IndexCursor::getScanRange(int& lowVal, int& highVal) const
+{
+	lowVal = lowValInt;
+	highVal = highValInt;
+}
 
-	// flushing the index
-	bufMgr->flushFile(file);
+void IndexCursor::getScanRange(double& lowVal, double& highVal) const
+{
+	lowVal = lowValDouble;
+	highVal = highValDouble;
+}
 
-	// clearing up any state variables
-	delete bufMgr;
-	delete currentPageData;
-	delete file;
+void IndexCursor::getScanRange(StringKey& lowVal, StringKey& highVal) const
+{
+	lowVal = KeyTraits<StringKey>::read(lowValString.data());
+	highVal = KeyTraits<StringKey>::read(highValString.data());
+}
+
+void IndexCursor::getScanRange(CompositeKey& lowVal, CompositeKey& highVal) const
+{
+	lowVal = lowValComposite;
+	highVal = highValComposite;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
+// BTreeIndex::startScan
 // -----------------------------------------------------------------------------
 
-NonLeafNodeInt BTreeIndex::getNonLeafNodeFromPage(PageId pageId) {
-	Page* p;
-	bufMgr->readPage(file, pageId, p);
-	NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*>(p);
-	return *node;
+void BTreeIndex::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	startScan(scanCursor, lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+void BTreeIndex::startScan(IndexCursor& cursor,
+				   const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	if(lowOpParm != GT && lowOpParm != GTE) throw BadOpcodesException();
+	if(highOpParm != LT && highOpParm != LTE) throw BadOpcodesException();
+	applyPendingChanges();
+
+	// If another scan is already executing, that needs to be ended here.
+	if(cursor.scanExecuting)
+	{
+		endScan(cursor);
+	}
+
+	cursor.lowOp = lowOpParm;
+	cursor.highOp = highOpParm;
+
+	switch (attributeType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				startScanTyped< CoveredKey<int> >(cursor, KeyTraits< CoveredKey<int> >::read(lowValParm), KeyTraits< CoveredKey<int> >::read(highValParm));
+			else
+				startScanTyped<int>(cursor, KeyTraits<int>::read(lowValParm), KeyTraits<int>::read(highValParm));
+			break;
+		case DOUBLE:
+			if (includeLength > 0)
+				startScanTyped< CoveredKey<double> >(cursor, KeyTraits< CoveredKey<double> >::read(lowValParm), KeyTraits< CoveredKey<double> >::read(highValParm));
+			else
+				startScanTyped<double>(cursor, KeyTraits<double>::read(lowValParm), KeyTraits<double>::read(highValParm));
+			break;
+		case STRING:
+			if (prefixCompressed)
+				startScanTyped<PrefixStringKey>(cursor, KeyTraits<StringKey>::read(lowValParm), KeyTraits<StringKey>::read(highValParm));
+			else if (includeLength > 0)
+				startScanTyped< CoveredKey<StringKey> >(cursor, KeyTraits< CoveredKey<StringKey> >::read(lowValParm), KeyTraits< CoveredKey<StringKey> >::read(highValParm));
+			else
+				startScanTyped<StringKey>(cursor, KeyTraits<StringKey>::read(lowValParm), KeyTraits<StringKey>::read(highValParm));
+			break;
+		case COMPOSITE:
+			if (includeLength > 0)
+				startScanTyped< CoveredKey<CompositeKey> >(cursor, KeyTraits< CoveredKey<CompositeKey> >::read(lowValParm), KeyTraits< CoveredKey<CompositeKey> >::read(highValParm));
+			else
+				startScanTyped<CompositeKey>(cursor, KeyTraits<CompositeKey>::read(lowValParm), KeyTraits<CompositeKey>::read(highValParm));
+			break;
+	}
 }
 
-NonLeafNodeInt BTreeIndex::getRootNode() {
-	return getNonLeafNodeFromPage(rootPageNum);
+void BTreeIndex::startPrefixScan(const void* const* values, int numValues)
+{
+	startPrefixScan(scanCursor, values, numValues);
 }
 
-void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+void BTreeIndex::startPrefixScan(IndexCursor& cursor, const void* const* values, int numValues)
 {
-	/*
-	Start from root and recursively search for which leaf key belongs to
-	If leaf is full then split leaf, update parent non-leaf, and if root needs splitting then update metadata
-	Might have to keep track of height here
-	*/
-	// You have to add the node page to the buffer manager if there is space. Maybe use allocPage???
-	// NonLeafNodeInt root = getRootNode();
+	if (attributeType != COMPOSITE || numValues < 1 || numValues > (int)keyParts.size())
+	{
+		throw BadScanParamException();
+	}
 
-	RIDKeyPair<int> current_data_to_enter;
-	current_data_to_enter.set(rid, *((int *)key));
+	// the keys starting with the values lie between the prefix followed by the smallest and by the largest bytes
+	CompositeKey lowVal, highVal;
+	encodeKeyParts(values, numValues, 0, lowVal);
+	encodeKeyParts(values, numValues, 0xff, highVal);
+	startScan(cursor, &lowVal, GTE, &highVal, LTE);
+}
+
+template <class T>
+void BTreeIndex::startScanTyped(IndexCursor& cursor, const typename LeafNode<T>::KeyType& lowVal,
+                                const typename LeafNode<T>::KeyType& highVal)
+{
+	if(highVal < lowVal) throw BadScanrangeException();
+	if(!mayHaveKeys<T>(lowVal, cursor.lowOp, highVal, cursor.highOp)) throw NoSuchKeyFoundException();
 
-	Page* rootPage;
+	cursor.index = this;
+	cursor.setScanRange(lowVal, highVal);
+	cursor.equalReturned = 0;
+	seekCursor<T>(cursor);
 
-	bufMgr->readPage(file, rootPageNum, rootPage);
-  	PageKeyPair<int> *child_data = nullptr;
-	
-	search(rootPage, rootPageNum, initialRootPageNum == rootPageNum ? true : false, current_data_to_enter, child_data);
+	const LeafNode<T> *leaf = reinterpret_cast<const LeafNode<T>*>(&cursor.leafCopy);
+	if (!seekNextEntry<T>(cursor, lowVal) || !belowHigh(leaf->keyAt(cursor.nextEntry), highVal, cursor.highOp))
+	{
+		bufMgr->unPinPage(file, cursor.currentPageNum, false);
+		throw NoSuchKeyFoundException();
+	}
+	cursor.scanExecuting = true;
 }
-//Under Construction
-void BTreeIndex::search(Page *Page_currently, PageId Page_number_currently, bool is_leaf, const RIDKeyPair<int> current_data_to_enter
-, PageKeyPair<int> *&child_data){
-	if(!is_leaf) {
-		NonLeafNodeInt *Node_currently = reinterpret_cast<NonLeafNodeInt *>(Page_currently);
-		Page *page_next;
-		PageId node_next_number;
-		NextNonLeafNode(Node_currently, node_next_number, current_data_to_enter.key);
-		bufMgr->readPage(file, node_next_number, page_next);
-		is_leaf = Node_currently->level == 1;
 
-		// Recursive step
-		search(page_next, node_next_number, is_leaf, current_data_to_enter, child_data);
+template <class T>
+void BTreeIndex::seekCursor(IndexCursor& cursor)
+{
+	typename LeafNode<T>::KeyType lowVal, highVal;
+	cursor.getScanRange(lowVal, highVal);
 
-		if (child_data == nullptr){
-			bufMgr->unPinPage(file,Page_number_currently,false);
-		}
-		else{
-			if(Node_currently->pageNoArray[nodeOccupancy]==0){
-				insert_into_nonleaf(Node_currently, child_data);
-				child_data == nullptr;
-				bufMgr -> unPinPage(file,Page_number_currently,true);
-			}
-			else {
-				// making this now
-				splitter();
+	// descend towards the leftmost leaf that may contain a key >= lowVal, and take a consistent copy of it
+	while (true)
+	{
+		PageId pageNo;
+		Page *page;
+		std::uint64_t version;
+		if (descendOptimistic<T>(lowVal, false, pageNo, page, version))
+		{
+			cursor.leafCopy = *page;
+			if (bufMgr->pageLatch(page).validate(version))
+			{
+				cursor.currentPageNum = pageNo;
+				cursor.currentPageData = page;
+				cursor.currentVersion = version;
+				break;
 			}
+			bufMgr->unPinPage(file, pageNo, false);
 		}
-
+		std::this_thread::yield();
 	}
+
+	const LeafNode<T> *leaf = reinterpret_cast<const LeafNode<T>*>(&cursor.leafCopy);
+	cursor.nextEntry = leaf->lowerBound(lowVal);
+	cursor.equalToSkip = cursor.equalReturned;
 }
 
-void BTreeIndex::NextNonLeafNode(NonLeafNodeInt *Node_currently, PageId &node_next_number, int key){
-	int keyIndex = nodeOccupancy;
-	while((keyIndex>=0)&& (Node_currently->pageNoArray[keyIndex] == 0)) {
-		keyIndex--;
-	}
-	while((keyIndex>0) && (Node_currently->keyArray[keyIndex] >= key)) {
-		keyIndex--;
+template <class T>
+bool BTreeIndex::seekNextEntry(IndexCursor& cursor, const typename LeafNode<T>::KeyType& lowVal)
+{
+	while (true)
+	{
+		const LeafNode<T> *leaf = reinterpret_cast<const LeafNode<T>*>(&cursor.leafCopy);
+		if (cursor.nextEntry >= leaf->numKeys)
+		{
+			if (leaf->rightSibPageNo == Page::INVALID_NUMBER)
+			{
+				return false;
+			}
+			advanceCursor<T>(cursor);
+			continue;
+		}
+
+		const typename LeafNode<T>::KeyType key = leaf->keyAt(cursor.nextEntry);
+		if (!aboveLow(key, lowVal, cursor.lowOp))
+		{
+			cursor.nextEntry++;
+		}
+		else if (cursor.equalToSkip > 0 && key == lowVal)
+		{
+			cursor.equalToSkip--;
+			cursor.nextEntry++;
+		}
+		else
+		{
+			return true;
+		}
 	}
-	node_next_number = Node_currently->pageNoArray[keyIndex];
 }
 
-void BTreeIndex::insert_into_nonleaf(NonLeafNodeInt *Node_nonleaf, PageKeyPair<int> *key_and_page){
-	int keyIndex = nodeOccupancy;
-	while((keyIndex>=0)&&(Node_nonleaf->pageNoArray[keyIndex]==0)){
-		keyIndex--;
-	}
-	while((keyIndex>0)&&(Node_leaf->keyArray[keyIndex-1]>key_and_page->key)){
-		Node_nonleaf -> keyArray[keyIndex] = Node_nonleaf -> keyArray[keyIndex-1];
-		Node_nonleaf -> pageNoArray[keyIndex+1] = Node_nonleaf -> pageNoArray[keyIndex];
-		keyIndex--;
+template <class T>
+void BTreeIndex::advanceCursor(IndexCursor& cursor)
+{
+	const LeafNode<T> *leaf = reinterpret_cast<const LeafNode<T>*>(&cursor.leafCopy);
+	const PageId nextPageNo = leaf->rightSibPageNo;
+
+	// the sibling page number is only safe to use if the leaf did not change since it was copied
+	PageLatch &latch = bufMgr->pageLatch(cursor.currentPageData);
+	if (latch.validate(cursor.currentVersion))
+	{
+		Page *nextPage;
+		std::uint64_t nextVersion;
+		bufMgr->readPage(file, nextPageNo, nextPage);
+		if (bufMgr->pageLatch(nextPage).readLock(nextVersion) && latch.validate(cursor.currentVersion))
+		{
+			cursor.leafCopy = *nextPage;
+			if (bufMgr->pageLatch(nextPage).validate(nextVersion))
+			{
+				bufMgr->unPinPage(file, cursor.currentPageNum, false);
+				cursor.currentPageNum = nextPageNo;
+				cursor.currentPageData = nextPage;
+				cursor.currentVersion = nextVersion;
+				cursor.nextEntry = 0;
+				return;
+			}
+		}
+		bufMgr->unPinPage(file, nextPageNo, false);
 	}
-	Node_nonleaf -> keyArray[keyIndex] = key_and_page->key;
-	Node_nonleaf -> pageNoArray[keyIndex+1] = key_and_page->pageNo;
+
+	bufMgr->unPinPage(file, cursor.currentPageNum, false);
+	seekCursor<T>(cursor);
 }
 
-// under construction
-void BTreeIndex::splitter(NonLeafNodeInt node_old, PageId page_num_old, PageKeyPair<int> *&child_data){
-	PageId newNum;
-	Page newP;
-	BufMgr->allocPage(file,newNum,newP);
-	NonLeafNodeInt *node_new = (NonLeafNodeInt *)newP;
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
 
-	int middle_key = nodeOccupancy/2;
-	PageKeyPair<int> other_node_entry;
+void BTreeIndex::scanNext(RecordId& outRid)
+{
+	scanNext(scanCursor, outRid);
+}
 
-	other_node_entry.set(newNum, node_old->keyArray[middle_key])
-	middle_key = node_1_key + 1;
+void BTreeIndex::scanNext(IndexCursor& cursor, RecordId& outRid)
+{
+	if(!cursor.scanExecuting) throw ScanNotInitializedException();
 
-	for(int i = middle_key, i < nodeOccupancy, i++){
-		node_new->keyArray[i-middle_key] = node_old->keyArray[i];
-		node_old->keyArray[i+1]=0;
-		node_new->pageNoArray[i-middle_key] = node_old->pageNoArray[i+1];
-		node_old->pageNoArray[i+1]=(PageId) 0;
+	switch (attributeType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				scanNextTyped< CoveredKey<int> >(cursor, outRid);
+			else
+				scanNextTyped<int>(cursor, outRid);
+			break;
+		case DOUBLE:
+			if (includeLength > 0)
+				scanNextTyped< CoveredKey<double> >(cursor, outRid);
+			else
+				scanNextTyped<double>(cursor, outRid);
+			break;
+		case STRING:
+			if (prefixCompressed)
+				scanNextTyped<PrefixStringKey>(cursor, outRid);
+			else if (includeLength > 0)
+				scanNextTyped< CoveredKey<StringKey> >(cursor, outRid);
+			else
+				scanNextTyped<StringKey>(cursor, outRid);
+			break;
+		case COMPOSITE:
+			if (includeLength > 0)
+				scanNextTyped< CoveredKey<CompositeKey> >(cursor, outRid);
+			else
+				scanNextTyped<CompositeKey>(cursor, outRid);
+			break;
 	}
-	node_new->level = node_old->level;
-	//have to set old nodes's 
-	if(key<node_new->keyArray[0]){
-		insert_into_nonleaf(node_old, child_data);
+}
+
+template <class T>
+void BTreeIndex::scanNextTyped(IndexCursor& cursor, RecordId& outRid)
+{
+	typename LeafNode<T>::KeyType lowVal, highVal;
+	cursor.getScanRange(lowVal, highVal);
+
+	// the leaf copy is stale once a writer has changed the leaf, so the cursor finds its place again
+	if (!bufMgr->pageLatch(cursor.currentPageData).validate(cursor.currentVersion))
+	{
+		bufMgr->unPinPage(file, cursor.currentPageNum, false);
+		seekCursor<T>(cursor);
 	}
-	else if(key>=node_new->keyArray[0]){
-		insert_into_nonleaf(node_new, child_data);
+
+	if (!seekNextEntry<T>(cursor, lowVal))
+	{
+		throw IndexScanCompletedException();
 	}
-	child_data = &other_node_entry;
-	BufMgr->unPinPage(file,page_num_old,true);
-	BufMgr->unPinPage(file,newP, true);
-	
-	if(page_num_old == rootPageNum){
-		//gotta make this
-		root_changer(page_num_old, child_data);
+
+	// keys are sorted, so the first key past the high bound ends the scan
+	const LeafNode<T> *leaf = reinterpret_cast<const LeafNode<T>*>(&cursor.leafCopy);
+	const typename LeafNode<T>::KeyType key = leaf->keyAt(cursor.nextEntry);
+	if (!belowHigh(key, highVal, cursor.highOp))
+	{
+		throw IndexScanCompletedException();
 	}
-	
-}
 
-PageId BTreeIndex::findLeastPageId(NonLeafNodeInt node, int lowValParam, Operator greaterThan) {
-	int keyArrLength = sizeof(node.keyArray) / sizeof(node.keyArray[0]);
-	int key;
-	
-	for (int keyIndex = 0; keyIndex < keyArrLength; keyIndex++)
-	{		
-		key = node.keyArray[keyIndex];
-		if(lowValParam < key) return node.pageNoArray[keyIndex];
+	outRid = leaf->ridAt(cursor.nextEntry);
+	cursor.nextEntry++;
+
+	// if the cursor has to find its place again, it resumes after this entry
+	if (cursor.lowOp == GTE && key == lowVal)
+	{
+		cursor.equalReturned++;
+	}
+	else
+	{
+		cursor.setScanRange(key, highVal);
+		cursor.lowOp = GTE;
+		cursor.equalReturned = 1;
 	}
-	return node.pageNoArray[keyArrLength];
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::startScan
+// BTreeIndex::scanNextBatch
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::startScan(const void* lowValParm,
-				   const Operator lowOpParm,
-				   const void* highValParm,
-				   const Operator highOpParm)
+size_t BTreeIndex::scanNextBatch(RecordId* out, size_t max)
+{
+	return scanNextBatch(scanCursor, out, max);
+}
+
+size_t BTreeIndex::scanNextBatch(IndexCursor& cursor, RecordId* out, size_t max)
+{
+	return scanNextBatchPayloads(cursor, out, NULL, max);
+}
+
+size_t BTreeIndex::scanNextBatch(RecordId* out, void* outPayloads, size_t max)
+{
+	return scanNextBatch(scanCursor, out, outPayloads, max);
+}
+
+size_t BTreeIndex::scanNextBatch(IndexCursor& cursor, RecordId* out, void* outPayloads, size_t max)
+{
+	// only a covering index has anything to return
+	if(includeLength == 0) throw BadScanParamException();
+
+	return scanNextBatchPayloads(cursor, out, static_cast<char*>(outPayloads), max);
+}
+
+size_t BTreeIndex::scanNextBatchPayloads(IndexCursor& cursor, RecordId* out, char* outPayloads, size_t max)
 {
-	/*
-	This method is used to begin a “filtered scan” of the index. For example, if the
-	method is called using arguments (1,GT,100,LTE), then the scan should seek all
-	entries greater than 1 and less than or equal to 100.
-	*/
-
-	if(lowValParm > highValParm) throw BadScanrangeException();
-	if(lowOpParm != Operator::GT && lowOpParm != Operator::GTE) throw BadOpcodesException();
-	if(highOpParm != Operator::LT && highOpParm != Operator::LTE) throw BadOpcodesException();
-
-	scanExecuting = true;
-
-	// Sets data in the provided parameters for scanNext()
-	lowValInt	= *reinterpret_cast<const int*>(lowValParm);
-	highValInt	= *reinterpret_cast<const int*>(highValParm);
-	lowOp 		= lowOpParm;
-	highOp		= highOpParm;
-
-	// Get the root to start the scan
-	NonLeafNodeInt nextNode = getRootNode();
-	LeafNodeInt leaf;
-	PageId traversalPageId = rootPageNum;
-
-	// scan continues until a proper leaf node is found
-	while (1)
-	{
-		// if the next node is the last level, then the next level has leaf nodes.
-		PageId pageId = findLeastPageId(nextNode, lowValInt, lowOpParm);
-		
-		if(nextNode.level) {
-			Page* p;
-			bufMgr->readPage(file, pageId, p);
-			leaf = *reinterpret_cast<LeafNodeInt*>(p);
-
-			// if it's not the root, unpin the last nonleafnode
-			if(traversalPageId != rootPageNum) {
-				bufMgr->unPinPage(file, traversalPageId, false);
+	if(!cursor.scanExecuting) throw ScanNotInitializedException();
+
+	switch (attributeType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				return scanNextBatchTyped< CoveredKey<int> >(cursor, out, outPayloads, max);
+			else
+				return scanNextBatchTyped<int>(cursor, out, outPayloads, max);
+		case DOUBLE:
+			if (includeLength > 0)
+				return scanNextBatchTyped< CoveredKey<double> >(cursor, out, outPayloads, max);
+			else
+				return scanNextBatchTyped<double>(cursor, out, outPayloads, max);
+		case STRING:
+			if (prefixCompressed)
+				return scanNextBatchTyped<PrefixStringKey>(cursor, out, outPayloads, max);
+			else if (includeLength > 0)
+				return scanNextBatchTyped< CoveredKey<StringKey> >(cursor, out, outPayloads, max);
+			else
+				return scanNextBatchTyped<StringKey>(cursor, out, outPayloads, max);
+		case COMPOSITE:
+			if (includeLength > 0)
+				return scanNextBatchTyped< CoveredKey<CompositeKey> >(cursor, out, outPayloads, max);
+			else
+				return scanNextBatchTyped<CompositeKey>(cursor, out, outPayloads, max);
+	}
+	return 0;
+}
+
+template <class T>
+size_t BTreeIndex::scanNextBatchTyped(IndexCursor& cursor, RecordId* out, char* outPayloads, size_t max)
+{
+	typename LeafNode<T>::KeyType lowVal, highVal;
+	cursor.getScanRange(lowVal, highVal);
+
+	// the leaf copy is stale once a writer has changed the leaf, so the cursor finds its place again
+	if (!bufMgr->pageLatch(cursor.currentPageData).validate(cursor.currentVersion))
+	{
+		bufMgr->unPinPage(file, cursor.currentPageNum, false);
+		seekCursor<T>(cursor);
+	}
+
+	size_t numOut = 0;
+	bool pastHigh = false;
+	while (numOut < max && !pastHigh && seekNextEntry<T>(cursor, lowVal))
+	{
+		// copy out the run of matching entries on this leaf. Keys are sorted, so only when the last key of the run
+		// is past the high bound does the run have to be cut short.
+		const LeafNode<T> *leaf = reinterpret_cast<const LeafNode<T>*>(&cursor.leafCopy);
+		const int first = cursor.nextEntry;
+		const int stop = first + (int)std::min(max - numOut, (size_t)(leaf->numKeys - first));
+		int end = stop;
+		if (!belowHigh(leaf->keyAt(stop - 1), highVal, cursor.highOp))
+		{
+			end = first;
+			while (belowHigh(leaf->keyAt(end), highVal, cursor.highOp))
+			{
+				end++;
+			}
+			pastHigh = true;
+			if (end == first)
+			{
+				break;
 			}
+		}
 
-			// this is the pageNum we're looking for
-			currentPageNum = pageId;
-			currentPageData = p;
+		if (outPayloads != NULL)
+		{
+			for (int i = first; i < end; i++)
+			{
+				copyPayload(leaf->keyAt(i), outPayloads + numOut * includeLength, includeLength);
+				out[numOut++] = leaf->ridAt(i);
+			}
 		}
-		else {
-			// if it's not the root, unpin the last nonleafnode
-			if(traversalPageId != rootPageNum) {
-				bufMgr->unPinPage(file, traversalPageId, false);
+		else
+		{
+			for (int i = first; i < end; i++)
+			{
+				out[numOut++] = leaf->ridAt(i);
 			}
-			traversalPageId = pageId;
-			nextNode = getNonLeafNodeFromPage(pageId);
+		}
+		cursor.nextEntry = end;
+
+		// if the cursor has to find its place again, it resumes after the last entry returned
+		const typename LeafNode<T>::KeyType lastKey = leaf->keyAt(end - 1);
+		int runStart = end - 1;
+		while (runStart > first && leaf->keyAt(runStart - 1) == lastKey)
+		{
+			runStart--;
+		}
+		if (cursor.lowOp == GTE && lastKey == lowVal)
+		{
+			cursor.equalReturned += end - runStart;
+		}
+		else
+		{
+			lowVal = lastKey;
+			cursor.setScanRange(lowVal, highVal);
+			cursor.lowOp = GTE;
+			cursor.equalReturned = end - runStart;
 		}
 	}
+	return numOut;
+}
 
-	// scan continues until a proper leaf node is found for scanNext
-	int leafRidLength = sizeof(leaf.ridArray) / sizeof(leaf.ridArray[0]);
-	for (int keyIndex = 0; keyIndex < leafRidLength; keyIndex++)
-	{
-		// Determine correct operator comparison
-		int key = leaf.keyArray[keyIndex];
-		bool comparison;
-		if(lowOp == Operator::GT) 
-			comparison = key > lowValInt;
-		else if(lowOp == Operator::GTE)
-			comparison = key >= lowValInt;
+// -----------------------------------------------------------------------------
+// BTreeIndex::endScan
+// -----------------------------------------------------------------------------
+//
+void BTreeIndex::endScan()
+{
+	endScan(scanCursor);
+}
 
-		// sets the next entry + sets page data
-		if(comparison) {
-			nextEntry = keyIndex;
-			break;
-		}
+void BTreeIndex::endScan(IndexCursor& cursor)
+{
+	if(!cursor.scanExecuting)
+	{
+		throw ScanNotInitializedException();
 	}
 
-	// nothing satisifies the scan
-	nextEntry = -1;
+	// the leaf the cursor is positioned on is the only page pinned by the scan
+	bufMgr->unPinPage(file, cursor.currentPageNum, false);
+
+	cursor.scanExecuting = false;
+	cursor.currentPageData = NULL;
+	cursor.nextEntry = -1;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// BTreeIndex::computeShape
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::scanNext(RecordId& outRid) 
-{
-	/*
-	This method fetches the record id of the next tuple that matches the scan crite-
-	ria. If the scan has reached the end, then it should throw the following excep-
-	tion: IndexScanCompletedException. For instance, if there are two data en-
-	tries that need to be returned in a scan, then the third call to scanNext must throw
-	IndexScanCompletedException. A leaf page that has been read into the buffer
-	pool for the purpose of scanning, should not be unpinned from buffer pool unless
-	all records from it are read or the scan has reached its end. Use the right sibling
-	page number value from the current leaf to move on to the next leaf which holds
-	successive key values for the scan.
-	*/
-
-	// NOTE: I'm not sure how to "unpin" a page. I assume if there were a funciton that
-	// did that, then you would do it in the second if statement (nextEntry >= leafRidLength).
-	
-	if(nextEntry < 0) throw IndexScanCompletedException();
-	if(!scanExecuting) throw ScanNotInitializedException();
-
-	LeafNodeInt leaf = *reinterpret_cast<LeafNodeInt*>(currentPageData);
-	int leafRidLength = sizeof(leaf.ridArray) / sizeof(leaf.ridArray[0]);
-
-	// if it's out of bounds of the array, move on to the next page, or throw an error
-	if(nextEntry >= leafRidLength) {
-		// I assume that if rightSibPageNo = 0, then it's "null", indicating that there
-		// is no next page. If that is the case, the scan must be done.
-		if(leaf.rightSibPageNo == 0) {
-			throw IndexScanCompletedException();
-		}
-
-		// unpins a page when all records from it are read
-		bufMgr->unPinPage(file, currentPageNum, false);
-
-		PageId nextPage = leaf.rightSibPageNo;
-		currentPageNum = nextPage;
-		bufMgr->readPage(file, nextPage, currentPageData);
-		nextEntry = 0;
-
-		// I'm getting recursive here. Not sure if I did the & right
-		// The idea is we redo the process now that the next page is set.
-		scanNext(outRid); 
-		return;
+void BTreeIndex::computeShape(int& height, int& nodes)
+{
+	applyPendingChanges();
+	height = 0;
+	nodes = 0;
+	bool isLeaf = BTreeIndex::height == 1;
+	switch (attributeType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				computeShapeTyped< CoveredKey<int> >(rootPageNum, isLeaf, 1, height, nodes);
+			else
+				computeShapeTyped<int>(rootPageNum, isLeaf, 1, height, nodes);
+			break;
+		case DOUBLE:
+			if (includeLength > 0)
+				computeShapeTyped< CoveredKey<double> >(rootPageNum, isLeaf, 1, height, nodes);
+			else
+				computeShapeTyped<double>(rootPageNum, isLeaf, 1, height, nodes);
+			break;
+		case STRING:
+			if (prefixCompressed)
+				computeShapeTyped<PrefixStringKey>(rootPageNum, isLeaf, 1, height, nodes);
+			else if (includeLength > 0)
+				computeShapeTyped< CoveredKey<StringKey> >(rootPageNum, isLeaf, 1, height, nodes);
+			else
+				computeShapeTyped<StringKey>(rootPageNum, isLeaf, 1, height, nodes);
+			break;
+		case COMPOSITE:
+			if (includeLength > 0)
+				computeShapeTyped< CoveredKey<CompositeKey> >(rootPageNum, isLeaf, 1, height, nodes);
+			else
+				computeShapeTyped<CompositeKey>(rootPageNum, isLeaf, 1, height, nodes);
+			break;
 	}
+}
 
-	// No need to check for greater than, because that has already happened in the
-	// startScan function. We only need to check lesser than.
-	int key = leaf.keyArray[nextEntry];
-	bool comparison;
-	if(highOp == Operator::LT) 
-		comparison = key < highValInt;
-	else if(highOp == Operator::LTE)
-		comparison = key <= highValInt;
-
-	// if the comparison holds true, return it and go to the next entry.
-	// otherwise, our scan is completed.
-	if(comparison) {
-		outRid = leaf.ridArray[nextEntry];
-		nextEntry++;
+template <class T>
+void BTreeIndex::computeShapeTyped(PageId pageNo, bool isLeaf, int depth, int& height, int& nodes)
+{
+	nodes++;
+	if (isLeaf)
+	{
+		height = std::max(height, depth);
+		return;
 	}
-	else {
-		// unpins a page when scan has reached its end
-		throw IndexScanCompletedException();
+
+	Page *page;
+	bufMgr->readPage(file, pageNo, page);
+	NonLeafNode<T> *node = reinterpret_cast<NonLeafNode<T>*>(page);
+	for (int i = 0; i <= node->numKeys; i++)
+	{
+		computeShapeTyped<T>(node->childAt(i), node->level == 1, depth + 1, height, nodes);
 	}
+	bufMgr->unPinPage(file, pageNo, false);
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::endScan
+// BTreeIndex::compact
 // -----------------------------------------------------------------------------
-//
-void BTreeIndex::endScan() 
+
+void BTreeIndex::compact()
 {
-	/*
-	This method terminates the current scan and unpins all the pages that have been
-	pinned for the purpose of the scan. It throws ScanNotInitializedException
-	when called before a successful startScan call.  
-	*/
+	if (file->isMapped())
+	{
+		throw ReadOnlyFileException(file->filename());
+	}
+	applyPendingChanges();
+	if (scanCursor.scanExecuting)
+	{
+		endScan();
+	}
 
-	if(!scanExecuting) {
-		throw ScanNotInitializedException();
+	switch (attributeType)
+	{
+		case INTEGER:
+			if (includeLength > 0)
+				compactTyped< CoveredKey<int> >();
+			else
+				compactTyped<int>();
+			break;
+		case DOUBLE:
+			if (includeLength > 0)
+				compactTyped< CoveredKey<double> >();
+			else
+				compactTyped<double>();
+			break;
+		case STRING:
+			if (prefixCompressed)
+				compactTyped<PrefixStringKey>();
+			else if (includeLength > 0)
+				compactTyped< CoveredKey<StringKey> >();
+			else
+				compactTyped<StringKey>();
+			break;
+		case COMPOSITE:
+			if (includeLength > 0)
+				compactTyped< CoveredKey<CompositeKey> >();
+			else
+				compactTyped<CompositeKey>();
+			break;
+	}
+}
+
+template <class T>
+void BTreeIndex::compactTyped()
+{
+	// list the nodes level by level, each level from left to right, so that the last level holds the leaves in key order
+	writeMetaInfo();
+	std::vector< std::vector<PageId> > levels(1, std::vector<PageId>(1, rootPageNum));
+	bool isLeaf = height == 1;
+	while (!isLeaf)
+	{
+		std::vector<PageId> children;
+		for (size_t i = 0; i < levels.back().size(); i++)
+		{
+			Page *page;
+			bufMgr->readPage(file, levels.back()[i], page);
+			NonLeafNode<T> *node = reinterpret_cast<NonLeafNode<T>*>(page);
+			for (int c = 0; c <= node->numKeys; c++)
+			{
+				children.push_back(node->childAt(c));
+			}
+			isLeaf = node->level == 1;
+			bufMgr->unPinPage(file, levels.back()[i], false);
+		}
+		levels.push_back(children);
+	}
+
+	// new page order: meta page, leaves, then non-leaf nodes from the root down
+	std::vector<PageId> order(1, headerPageNum);
+	order.insert(order.end(), levels.back().begin(), levels.back().end());
+	for (size_t l = 0; l + 1 < levels.size(); l++)
+	{
+		order.insert(order.end(), levels[l].begin(), levels[l].end());
+	}
+	const size_t numLeaves = levels.back().size();
+
+	std::vector<PageId> newPageNo;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		if (order[i] >= newPageNo.size())
+			newPageNo.resize(order[i] + 1, (PageId)Page::INVALID_NUMBER);
+		newPageNo[order[i]] = headerPageNum + i;
+	}
+
+	const std::string indexName = file->filename();
+	const std::string compactName = indexName + ".compact";
+	try
+	{
+		File::remove(compactName);
+	}
+	catch(const FileNotFoundException &e)
+	{
 	}
 
-	/* The only file that is pinned is the currrentPageNum, which we won't need anymore.
-	 * The only places that currentPageNum is unpinned is in endScan and nextScan.
-	 * In nextScan, the page is NOT UNPINNED when IndexScanCompletedException is thrown.
-	 * It is only unpinned in nextScan when there is for sure a next page to get.
-	 *
-	 * This is a design choice because it is:
-	 *	1) lazy
-	 * 	2) makes the complexity of page pinning easier among the two functions
-	 * 	3) keeps the "end" in the endScan function
-	*/
-	bufMgr->unPinPage(file, currentPageNum, false);
+	{
+		BlobFile compactFile(compactName, true);
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			Page *page;
+			bufMgr->readPage(file, order[i], page);
+			Page copy = *page;
+			bufMgr->unPinPage(file, order[i], false);
+
+			if (i == 0)
+			{
+				IndexMetaInfo *metaInfo = reinterpret_cast<IndexMetaInfo*>(&copy);
+				metaInfo->rootPageNo = newPageNo[rootPageNum];
+				metaInfo->checksum = metaChecksum(*metaInfo);
+			}
+			else if (i <= numLeaves)
+			{
+				LeafNode<T> *leaf = reinterpret_cast<LeafNode<T>*>(&copy);
+				if (leaf->rightSibPageNo != Page::INVALID_NUMBER)
+					leaf->rightSibPageNo = newPageNo[leaf->rightSibPageNo];
+			}
+			else
+			{
+				NonLeafNode<T> *node = reinterpret_cast<NonLeafNode<T>*>(&copy);
+				for (int c = 0; c <= node->numKeys; c++)
+				{
+					node->setChildAt(c, newPageNo[node->childAt(c)]);
+				}
+			}
+
+			PageId compactPageNo;
+			compactFile.allocatePage(compactPageNo);
+			compactFile.writePage(compactPageNo, copy);
+		}
+	}
 
-	// in our current implementation, root is kept pinned until destructor is called
-	// no other pages are kept pinned throughout entirety of scan
-	// bufMgr->unPinPage(file, rootPageNum, false);
+	// swap the files; the old pages must leave the buffer pool and the log first
+	bufMgr->flushFile(file);
+	bufMgr->checkpoint();
+	delete file;
+	File::remove(indexName);
+	std::rename(compactName.c_str(), indexName.c_str());
+	file = new BlobFile(indexName, false);
 
-	scanExecuting = false;
+	rootPageNum = newPageNo[rootPageNum];
 }
 
 }
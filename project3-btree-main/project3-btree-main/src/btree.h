@@ -11,11 +11,17 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "buf_pools.h"
 
 namespace badgerdb
 {
@@ -27,31 +33,314 @@ enum Datatype
 {
 	INTEGER = 0,
 	DOUBLE = 1,
-	STRING = 2
+	STRING = 2,
+	COMPOSITE = 3
 };
 
 /**
  * @brief Scan operations enumeration. Passed to BTreeIndex::startScan() method.
  */
 enum Operator
-{ 
+{
 	LT, 	/* Less Than */
 	LTE,	/* Less Than or Equal to */
 	GTE,	/* Greater Than or Equal to */
 	GT		/* Greater Than */
 };
 
+/**
+ * @brief Number of leading bytes of a STRING attribute that are stored in the index as its key.
+ * Strings that share this prefix compare equal inside the tree. Can be changed at compile time
+ * with -DBTREE_STRINGSIZE=n, as long as n does not exceed the length of the indexed attribute.
+ */
+#ifndef BTREE_STRINGSIZE
+#define BTREE_STRINGSIZE 10
+#endif
+const  int STRINGSIZE = BTREE_STRINGSIZE;
+
+/**
+ * @brief Fixed-length, possibly not null-terminated, string key. Used for STRING attributes, where
+ * only the first N bytes of the attribute are kept in the tree.
+ */
+template <int N>
+struct FixedString {
+  /**
+   * Key bytes, padded with '\0' when the source string is shorter than N.
+   */
+	char data[N];
+};
+
+template <int N>
+bool operator<( const FixedString<N>& s1, const FixedString<N>& s2 )
+{
+	return strncmp( s1.data, s2.data, N ) < 0;
+}
+
+template <int N>
+bool operator<=( const FixedString<N>& s1, const FixedString<N>& s2 )
+{
+	return strncmp( s1.data, s2.data, N ) <= 0;
+}
+
+template <int N>
+bool operator==( const FixedString<N>& s1, const FixedString<N>& s2 )
+{
+	return strncmp( s1.data, s2.data, N ) == 0;
+}
+
+template <int N>
+bool operator!=( const FixedString<N>& s1, const FixedString<N>& s2 )
+{
+	return strncmp( s1.data, s2.data, N ) != 0;
+}
+
+/**
+ * @brief Key type used for STRING attributes.
+ */
+typedef FixedString<STRINGSIZE> StringKey;
+
+/**
+ * @brief Reads a key of type T out of a record or out of a scan/insert parameter.
+ * Uses memcpy since the attribute inside a record is not necessarily aligned.
+ */
+template <class T>
+struct KeyTraits
+{
+	static T read( const void* src )
+	{
+		T key;
+		memcpy( &key, src, sizeof( T ) );
+		return key;
+	}
+};
+
+/**
+ * @brief String keys keep at most N bytes of the source string; shorter strings are padded with '\0'.
+ */
+template <int N>
+struct KeyTraits< FixedString<N> >
+{
+	static FixedString<N> read( const void* src )
+	{
+		const char* str = static_cast<const char*>( src );
+		FixedString<N> key;
+		int i = 0;
+		for( ; i < N && str[i] != '\0'; i++ )
+			key.data[i] = str[i];
+		for( ; i < N; i++ )
+			key.data[i] = '\0';
+		return key;
+	}
+};
+
+/**
+ * @brief Largest number of bytes of a composite key. Can be changed at compile time with -DBTREE_COMPOSITESIZE=n.
+ */
+#ifndef BTREE_COMPOSITESIZE
+#define BTREE_COMPOSITESIZE 16
+#endif
+const  int COMPOSITESIZE = BTREE_COMPOSITESIZE;
+
+/**
+ * @brief Largest number of attributes in a composite key.
+ */
+const  int MAXKEYPARTS = 4;
+
+/**
+ * @brief One attribute of a composite key.
+ */
+struct KeyPart {
+  /**
+   * Offset of the attribute inside the record.
+   */
+	int byteOffset;
+
+  /**
+   * Type of the attribute: INTEGER, DOUBLE or STRING.
+   */
+	Datatype type;
+
+  /**
+   * Number of bytes the attribute takes up in the key: 4 for INTEGER, 8 for DOUBLE, and the number of leading bytes
+   * of the string that are kept for STRING.
+   */
+	int length;
+};
+
+/**
+ * @brief Key of a COMPOSITE index: the encoded values of its parts one after the other, padded with '\0'.
+ * Each part is encoded so that comparing the bytes of two keys orders them as comparing their parts one by one
+ * would. INTEGER and DOUBLE values are stored big-endian with the sign bit flipped, and every bit flipped for
+ * negative DOUBLEs; STRING values keep their first length bytes, padded with '\0'. Searching a node therefore
+ * takes a single byte-wise comparison per key, whatever the types of the parts.
+ */
+struct CompositeKey {
+  /**
+   * Encoded key bytes.
+   */
+	unsigned char data[COMPOSITESIZE];
+};
+
+static_assert(COMPOSITESIZE % 8 == 0, "COMPOSITESIZE must be a multiple of 8.");
+
+/**
+ * @brief Size of the largest key of any attribute type, not counting included attributes. The meta page keeps this
+ * much room for the smallest and the largest key of the index.
+ */
+const  int MAXKEYSIZE = STRINGSIZE > COMPOSITESIZE ? ( STRINGSIZE > 8 ? STRINGSIZE : 8 ) : ( COMPOSITESIZE > 8 ? COMPOSITESIZE : 8 );
+
+/**
+ * @brief Compares two composite keys as memcmp does, eight bytes at a time: each word is loaded and, on a
+ * little-endian host, byte-swapped, so that comparing the words as integers compares their bytes in order.
+ * @return Negative, zero or positive as k1 is less than, equal to or greater than k2.
+ */
+inline int compareKeyBytes( const CompositeKey& k1, const CompositeKey& k2 )
+{
+	for( int i = 0; i < COMPOSITESIZE; i += 8 )
+	{
+		std::uint64_t w1, w2;
+		memcpy( &w1, k1.data + i, 8 );
+		memcpy( &w2, k2.data + i, 8 );
+		if( w1 != w2 )
+		{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			w1 = __builtin_bswap64( w1 );
+			w2 = __builtin_bswap64( w2 );
+#endif
+			return w1 < w2 ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+inline bool operator<( const CompositeKey& k1, const CompositeKey& k2 )
+{
+	return compareKeyBytes( k1, k2 ) < 0;
+}
+
+inline bool operator<=( const CompositeKey& k1, const CompositeKey& k2 )
+{
+	return compareKeyBytes( k1, k2 ) <= 0;
+}
+
+inline bool operator==( const CompositeKey& k1, const CompositeKey& k2 )
+{
+	return memcmp( k1.data, k2.data, COMPOSITESIZE ) == 0;
+}
+
+inline bool operator!=( const CompositeKey& k1, const CompositeKey& k2 )
+{
+	return memcmp( k1.data, k2.data, COMPOSITESIZE ) != 0;
+}
+
+/**
+ * @brief Largest number of bytes of included attributes that a covering index stores with each entry. Can be
+ * changed at compile time with -DBTREE_INCLUDESIZE=n.
+ */
+#ifndef BTREE_INCLUDESIZE
+#define BTREE_INCLUDESIZE 8
+#endif
+const  int INCLUDESIZE = BTREE_INCLUDESIZE;
+
+/**
+ * @brief Key of a covering index: the key proper, followed by the included attributes stored with it in the leaves.
+ * Keys compare on the key proper only.
+ */
+template <class T>
+struct CoveredKey {
+  /**
+   * Value of the indexed attribute.
+   */
+	T key;
+
+  /**
+   * Included attribute bytes, padded with '\0' up to INCLUDESIZE.
+   */
+	char payload[INCLUDESIZE];
+};
+
+template <class T>
+bool operator<( const CoveredKey<T>& k1, const CoveredKey<T>& k2 )
+{
+	return k1.key < k2.key;
+}
+
+template <class T>
+bool operator<=( const CoveredKey<T>& k1, const CoveredKey<T>& k2 )
+{
+	return k1.key <= k2.key;
+}
+
+template <class T>
+bool operator==( const CoveredKey<T>& k1, const CoveredKey<T>& k2 )
+{
+	return k1.key == k2.key;
+}
+
+template <class T>
+bool operator!=( const CoveredKey<T>& k1, const CoveredKey<T>& k2 )
+{
+	return k1.key != k2.key;
+}
+
+/**
+ * @brief A scan or lookup parameter only holds the key proper; the payload is left empty.
+ */
+template <class T>
+struct KeyTraits< CoveredKey<T> >
+{
+	static CoveredKey<T> read( const void* src )
+	{
+		CoveredKey<T> key;
+		key.key = KeyTraits<T>::read( src );
+		memset( key.payload, 0, INCLUDESIZE );
+		return key;
+	}
+};
+
+/**
+ * @brief Number of key slots in B+Tree leaf and non-leaf nodes for keys of type T.
+ * A few bytes are reserved for alignment padding between the key array and the rid/pageNo array.
+ */
+template <class T>
+struct NodeCapacity
+{
+	//                                       numKeys       sibling ptr         padding                    key           rid
+	static const int LEAF = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) - alignof( RecordId ) ) / ( sizeof( T ) + sizeof( RecordId ) );
+
+	//                                          level, numKeys    extra pageNo       padding                    key         pageNo
+	static const int NONLEAF = ( Page::SIZE - 2 * sizeof( int ) - sizeof( PageId ) - alignof( double ) ) / ( sizeof( T ) + sizeof( PageId ) );
+};
+
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+const  int INTARRAYLEAFSIZE = NodeCapacity<int>::LEAF;
 
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+const  int INTARRAYNONLEAFSIZE = NodeCapacity<int>::NONLEAF;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+const  int DOUBLEARRAYLEAFSIZE = NodeCapacity<double>::LEAF;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+const  int DOUBLEARRAYNONLEAFSIZE = NodeCapacity<double>::NONLEAF;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for STRING key.
+ */
+const  int STRINGARRAYLEAFSIZE = NodeCapacity<StringKey>::LEAF;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for STRING key.
+ */
+const  int STRINGARRAYNONLEAFSIZE = NodeCapacity<StringKey>::NONLEAF;
 
 /**
  * @brief Order of the btree
@@ -59,7 +348,7 @@ const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId )
 const  int d = (INTARRAYNONLEAFSIZE / 2);
 
 /**
- * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
+ * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that
  * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
  */
 template <class T>
@@ -75,7 +364,7 @@ public:
 };
 
 /**
- * @brief Structure to store a key page pair which is used to pass the key and page to functions that make 
+ * @brief Structure to store a key page pair which is used to pass the key and page to functions that make
  * any modifications to the non leaf pages of the tree.
 */
 template <class T>
@@ -104,6 +393,12 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 		return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief Version of the layout of the meta page and the nodes. An index file written with another version is not
+ * opened.
+ */
+const  int INDEXFORMATVERSION = 3;
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -111,6 +406,7 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
  * of the key value on which the index is made, the type of the key and the page no
  * of the root page. Root page starts as page 2 but since a split can occur
  * at the root the root page may get moved up and get a new page no.
+ * It also holds the statistics returned by BTreeIndex::getStats() as of the last time they were written.
 */
 struct IndexMetaInfo{
   /**
@@ -132,217 +428,1084 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
-};
 
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
-These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
-at this level are just above the leaf nodes. Otherwise set to 0.
-*/
+  /**
+   * True if the nodes of a STRING index are prefix-compressed.
+   */
+	bool prefixCompressed;
 
-/*
-// Getting the page
-Page* p = &(blobFile.readPage());
-NonLeafNodeInt node = (NonLeafNodeInt)(p);
-node.level = 1;
-node.keyArray .... 
-
-// Setting the page
-node.level = 1 ...
-node.keyArray .... 
-
-// Writing the page
-page = (page) node
-blobFile.writePage(page)
-*/
+  /**
+   * Offset of the included attributes inside the record, for a covering index.
+   */
+	int includeByteOffset;
 
-/**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
-*/
-struct NonLeafNodeInt {
   /**
-   * Level of the node in the tree.
+   * Number of included bytes stored with each entry, 0 if the index is not covering.
    */
-	int level;
+	int includeLength;
 
   /**
-   * Stores keys.
+   * Number of attributes of a COMPOSITE index, 0 for an index on a single attribute.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	int numKeyParts;
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * Attributes of a COMPOSITE index, in the order their values are compared.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
-};
+	KeyPart keyParts[MAXKEYPARTS];
 
+  /**
+   * INDEXFORMATVERSION of the code that created the file.
+   */
+	int formatVersion;
 
-/**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
-*/
-struct LeafNodeInt{
   /**
-   * Stores keys.
+   * Number of levels of the tree, 1 while the root is a leaf.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	int height;
 
   /**
-   * Stores RecordIds.
+   * Number of entries in the index.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	std::int64_t numEntries;
 
   /**
-   * Page number of the leaf on the right side.
-	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   * Number of leaf and non-leaf nodes.
    */
-	PageId rightSibPageNo;
-};
+	int numLeaves;
+	int numNonLeaves;
 
+  /**
+   * True if minKey and maxKey bound the keys in the index.
+   */
+	bool hasKeyRange;
 
-/**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
-*/
-class BTreeIndex {
+  /**
+   * Bounds on the keys in the index, see IndexStats.
+   */
+	unsigned char minKey[MAXKEYSIZE];
+	unsigned char maxKey[MAXKEYSIZE];
 
- private:
+  /**
+   * True if the index was closed after all of its pages were written, false while it is open.
+   */
+	bool closedCleanly;
 
   /**
-   * File object for the index file.
+   * True if the changes to the index are logged by its buffer manager. After a crash the log brings the index back
+   * to its last committed operation, so it can be trusted although it was not closed cleanly.
    */
-	File		*file;
+	bool logged;
 
   /**
-   * Buffer Manager Instance.
+   * Size and modification time, in nanoseconds, of the relation's file when the index was last known to match it:
+   * when it was opened or closed.
    */
-	BufMgr	*bufMgr;
+	std::int64_t relationBytes;
+	std::int64_t relationModified;
 
   /**
-   * Page number of meta page.
+   * FNV-1a hash of the bytes of the meta page before this field.
    */
-	PageId	headerPageNum;
+	std::uint64_t checksum;
+};
 
+static_assert(sizeof(IndexMetaInfo) <= Page::SIZE, "The index meta page must fit in a page.");
+
+/**
+ * @brief Statistics of a BTreeIndex, returned by BTreeIndex::getStats() without reading the tree.
+ */
+struct IndexStats {
   /**
-   * page number of root page of B+ tree inside index file.
+   * INDEXFORMATVERSION of the index file.
    */
-	PageId	rootPageNum;
+	int formatVersion;
 
   /**
-   * Datatype of attribute over which index is built.
+   * Number of levels of the tree, 1 while the root is a leaf.
    */
-	Datatype	attributeType;
+	int height;
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Number of entries in the index.
    */
-	int 		attrByteOffset;
+	std::int64_t numEntries;
 
+  /**
+   * Number of leaf and non-leaf nodes.
+   */
+	int numLeaves;
+	int numNonLeaves;
 
-  // let's just ignore these two for now
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Fraction of the key slots of the leaves in use. For prefix-compressed leaves the number of slots is the most keys a
+   * leaf can hold, reached only when all of them equal its prefix.
    */
-	int			leafOccupancy;
+	double leafFill;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * True if minKey and maxKey hold keys, false if the index is empty.
    */
-	int			nodeOccupancy;
+	bool hasKeyRange;
 
+  /**
+   * No key in the index is smaller than minKey or greater than maxKey. The bounds are exact as long as no entry is
+   * deleted; deletes leave them as they are, until the index is empty. Both are stored as a key passed to
+   * insertEntry() would be: an int, a double, STRINGSIZE characters, or COMPOSITESIZE bytes made by encodeKey().
+   */
+	unsigned char minKey[MAXKEYSIZE];
+	unsigned char maxKey[MAXKEYSIZE];
 
-	// MEMBERS SPECIFIC TO SCANNING
+  /**
+   * Returns minKey as a key of type T, e.g. int for an INTEGER index. The key arrays are not aligned for T, so the
+   * bytes are copied out rather than the array cast.
+   */
+	template <class T>
+	T minKeyAs() const
+	{
+		T key;
+		memcpy( &key, minKey, sizeof( T ) );
+		return key;
+	}
 
   /**
-   * True if an index scan has been started.
+   * Returns maxKey as a key of type T, see minKeyAs().
    */
-	bool		scanExecuting;
+	template <class T>
+	T maxKeyAs() const
+	{
+		T key;
+		memcpy( &key, maxKey, sizeof( T ) );
+		return key;
+	}
+};
+
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
+These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of
+node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes
+at this level are just above the leaf nodes. Otherwise set to 0.
+The tree algorithms in BTreeIndex only go through the member functions of the nodes, so that a key type
+can come with its own page format (see the PrefixStringKey specializations below).
+*/
 
+/**
+ * @brief Structure for all non-leaf nodes, templated on the key type.
+*/
+template <class T>
+struct NonLeafNode {
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Type of the keys stored in and passed to the node.
    */
-	int			nextEntry;
+	typedef T KeyType;
 
   /**
-   * Page number of current page being scanned.
+   * Level of the node in the tree.
    */
-	PageId	currentPageNum;
+	int level;
 
   /**
-   * Current Page being scanned.
+   * Number of keys currently stored in keyArray. The node has numKeys + 1 children.
    */
-	Page		*currentPageData;
+	int numKeys;
 
   /**
-   * Low INTEGER value for scan.
+   * Stores keys.
    */
-	int			lowValInt;
+	T keyArray[ NodeCapacity<T>::NONLEAF ];
 
   /**
-   * Low DOUBLE value for scan.
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
    */
-	double	lowValDouble;
+	PageId pageNoArray[ NodeCapacity<T>::NONLEAF + 1 ];
 
   /**
-   * Low STRING value for scan.
+   * Makes this an empty node at the given level whose only child is firstChild.
    */
-	std::string	lowValString;
+	void init( int nodeLevel, PageId firstChild );
 
   /**
-   * High INTEGER value for scan.
+   * Returns the number of keys that are strictly less than key.
    */
-	int			highValInt;
+	int lowerBound( const T& key ) const;
 
   /**
-   * High DOUBLE value for scan.
+   * Returns the number of keys that are less than or equal to key.
    */
-	double	highValDouble;
+	int upperBound( const T& key ) const;
+
+	const T& keyAt( int i ) const { return keyArray[i]; }
+	PageId childAt( int i ) const { return pageNoArray[i]; }
+	void setChildAt( int i, PageId child ) { pageNoArray[i] = child; }
 
   /**
-   * High STRING value for scan.
+   * Inserts key at position pos, with child to its right.
+   * @return False, leaving the node unchanged, if the node is full.
    */
-	std::string highValString;
-	
+	bool insertAt( int pos, const T& key, PageId child );
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Inserts key and child at position pos of a full node and moves the upper half of the keys to sibling.
+   * @param sibling			Empty node that becomes the right sibling of this node
+   * @param middleKey		Set to the key that separates the two nodes; it is no longer stored in either of them
    */
-	Operator	lowOp;
+	void split( NonLeafNode* sibling, int pos, const T& key, PageId child, T& middleKey );
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Returns the fraction of the key space of the node that is in use.
    */
-	Operator	highOp;
+	double fillFactor() const;
 
-	
- public:
+  /**
+   * Removes key pos and the child to its right.
+   */
+	void removeAt( int pos );
 
   /**
-   * BTreeIndex Constructor. 
+   * Replaces key pos.
+   * @return False, leaving the node unchanged, if the new key does not fit.
+   */
+	bool replaceKeyAt( int pos, const T& key );
+
+  /**
+   * Moves separator and all keys and children of right, its right sibling under the same parent, into this node.
+   * @return False, leaving both nodes unchanged, if they do not fit into one node.
+   */
+	bool mergeRight( const T& separator, NonLeafNode* right );
+
+  /**
+   * Moves keys between this node and right, its right sibling, so that both are about equally full.
+   * Keys rotate through the parent.
+   * @param separator		Key separating the two nodes in the parent; set to the new one
+   */
+	void balance( NonLeafNode* right, T& separator );
+};
+
+
+/**
+ * @brief Structure for all leaf nodes, templated on the key type.
+*/
+template <class T>
+struct LeafNode {
+  /**
+   * Type of the keys stored in and passed to the node.
+   */
+	typedef T KeyType;
+
+  /**
+   * Number of key/rid pairs currently stored in the node.
+   */
+	int numKeys;
+
+  /**
+   * Page number of the leaf on the right side.
+	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Stores keys.
+   */
+	T keyArray[ NodeCapacity<T>::LEAF ];
+
+  /**
+   * Stores RecordIds.
+   */
+	RecordId ridArray[ NodeCapacity<T>::LEAF ];
+
+  /**
+   * Makes this an empty leaf without a right sibling.
+   */
+	void init();
+
+  /**
+   * Returns the number of keys that are strictly less than key.
+   */
+	int lowerBound( const T& key ) const;
+
+  /**
+   * Returns the number of keys that are less than or equal to key.
+   */
+	int upperBound( const T& key ) const;
+
+	const T& keyAt( int i ) const { return keyArray[i]; }
+	const RecordId& ridAt( int i ) const { return ridArray[i]; }
+
+  /**
+   * Inserts the pair <key, rid> at position pos.
+   * @return False, leaving the leaf unchanged, if the leaf is full.
+   */
+	bool insertAt( int pos, const T& key, const RecordId& rid );
+
+  /**
+   * Inserts the pair <key, rid> at position pos of a full leaf and moves the upper half of the entries to sibling.
+   * Sibling links are left to the caller.
+   * @param sibling			Empty leaf that becomes the right sibling of this leaf
+   * @param separator		Set to a key greater than every key left in this leaf and not greater than any key in sibling
+   */
+	void split( LeafNode* sibling, int pos, const T& key, const RecordId& rid, T& separator );
+
+  /**
+   * Returns the fraction of the key space of the leaf that is in use.
+   */
+	double fillFactor() const;
+
+  /**
+   * Removes entry pos.
+   */
+	void removeAt( int pos );
+
+  /**
+   * Moves all entries of right, its right sibling, into this leaf. Sibling links are left to the caller.
+   * @return False, leaving both leaves unchanged, if they do not fit into one leaf.
+   */
+	bool mergeRight( LeafNode* right );
+
+  /**
+   * Moves entries between this leaf and right, its right sibling, so that both are about equally full.
+   * @param separator		Set to the new key separating the two leaves
+   */
+	void balance( LeafNode* right, T& separator );
+};
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+*/
+typedef NonLeafNode<int> NonLeafNodeInt;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of INTEGER type.
+*/
+typedef LeafNode<int> LeafNodeInt;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of DOUBLE type.
+*/
+typedef NonLeafNode<double> NonLeafNodeDouble;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of DOUBLE type.
+*/
+typedef LeafNode<double> LeafNodeDouble;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of STRING type.
+*/
+typedef NonLeafNode<StringKey> NonLeafNodeString;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of STRING type.
+*/
+typedef LeafNode<StringKey> LeafNodeString;
+
+static_assert(sizeof(NonLeafNodeInt) <= Page::SIZE && sizeof(LeafNodeInt) <= Page::SIZE,
+              "INTEGER nodes must fit in a page.");
+static_assert(sizeof(NonLeafNodeDouble) <= Page::SIZE && sizeof(LeafNodeDouble) <= Page::SIZE,
+              "DOUBLE nodes must fit in a page.");
+static_assert(sizeof(NonLeafNodeString) <= Page::SIZE && sizeof(LeafNodeString) <= Page::SIZE,
+              "STRING nodes must fit in a page.");
+static_assert(sizeof(NonLeafNode<CompositeKey>) <= Page::SIZE && sizeof(LeafNode<CompositeKey>) <= Page::SIZE,
+              "COMPOSITE nodes must fit in a page.");
+
+
+/**
+ * @brief Non-leaf node of a covering index. Separators only need the key proper, so the node has the layout and
+ * fan-out of NonLeafNode<T>; keys passed in lose their payload and keys returned come with an empty one.
+ * The leaves are the generic LeafNode< CoveredKey<T> >, which store the payload of every entry.
+ */
+template <class T>
+struct NonLeafNode< CoveredKey<T> > : public NonLeafNode<T> {
+	typedef CoveredKey<T> KeyType;
+
+	int lowerBound( const KeyType& key ) const { return NonLeafNode<T>::lowerBound( key.key ); }
+	int upperBound( const KeyType& key ) const { return NonLeafNode<T>::upperBound( key.key ); }
+
+	KeyType keyAt( int i ) const
+	{
+		KeyType key;
+		key.key = NonLeafNode<T>::keyAt( i );
+		memset( key.payload, 0, INCLUDESIZE );
+		return key;
+	}
+
+	bool insertAt( int pos, const KeyType& key, PageId child ) { return NonLeafNode<T>::insertAt( pos, key.key, child ); }
+
+	void split( NonLeafNode* sibling, int pos, const KeyType& key, PageId child, KeyType& middleKey )
+	{
+		memset( middleKey.payload, 0, INCLUDESIZE );
+		NonLeafNode<T>::split( sibling, pos, key.key, child, middleKey.key );
+	}
+
+	bool replaceKeyAt( int pos, const KeyType& key ) { return NonLeafNode<T>::replaceKeyAt( pos, key.key ); }
+	bool mergeRight( const KeyType& separator, NonLeafNode* right ) { return NonLeafNode<T>::mergeRight( separator.key, right ); }
+	void balance( NonLeafNode* right, KeyType& separator ) { NonLeafNode<T>::balance( right, separator.key ); }
+};
+
+static_assert(sizeof(LeafNode< CoveredKey<double> >) <= Page::SIZE && sizeof(LeafNode< CoveredKey<StringKey> >) <= Page::SIZE
+              && sizeof(LeafNode< CoveredKey<CompositeKey> >) <= Page::SIZE,
+              "Covering leaves must fit in a page.");
+
+
+/**
+ * @brief Tag type selecting prefix-compressed nodes for a STRING index. Keys are still passed to and
+ * returned from these nodes as StringKey, but only their variable-length suffix after the common prefix
+ * of the node is stored, and separators in non-leaf nodes are truncated to the shortest string that
+ * separates the two children. Fan-out therefore depends on the keys instead of on STRINGSIZE.
+ */
+struct PrefixStringKey {};
+
+/**
+ * @brief Number of bytes reserved for the common prefix of a prefix-compressed node, rounded up so that
+ * the slot array that follows it stays aligned.
+ */
+const  int PREFIXCAPACITY = ( STRINGSIZE + 3 ) / 4 * 4;
+
+/**
+ * @brief Slot of a prefix-compressed node. The first four bytes of the key suffix are kept in head,
+ * big-endian and padded with '\0', so that most comparisons during a search are a single integer compare.
+ * The remaining bytes of the suffix are stored in the heap at the end of the node.
+ */
+template <class V>
+struct PrefixSlot {
+  /**
+   * First four bytes of the suffix.
+   */
+	std::uint32_t head;
+
+  /**
+   * Offset of the remaining suffix bytes inside PrefixKeyArea::data.
+   */
+	std::uint16_t offset;
+
+  /**
+   * Length of the whole suffix, head included.
+   */
+	std::uint16_t length;
+
+  /**
+   * RecordId in leaves, page number of the child to the right of the key in non-leaf nodes.
+   */
+	V value;
+};
+
+/**
+ * @brief A key with the common prefix of a prefix-compressed node removed, ready to be compared with its slots.
+ */
+struct PrefixSearchKey {
+  /**
+   * Negative if the key sorts before every key that can share the node prefix, positive if after,
+   * zero if the key starts with the node prefix.
+   */
+	int order;
+
+	std::uint32_t head;
+	const char* rest;
+	int restLength;
+};
+
+/**
+ * @brief Key storage shared by prefix-compressed leaf and non-leaf nodes, filling the node after its
+ * header of headerSize bytes. Slots grow from the front of data and suffixes from the back.
+ */
+template <class V, int headerSize>
+struct PrefixKeyArea {
+	typedef PrefixSlot<V> Slot;
+
+	static const int DATASIZE = Page::SIZE - headerSize - 2 * sizeof( std::uint16_t ) - PREFIXCAPACITY;
+
+  /**
+   * Length of the prefix shared by every key of the node.
+   */
+	std::uint16_t prefixLength;
+
+  /**
+   * Offset of the first used heap byte inside data.
+   */
+	std::uint16_t heapOffset;
+
+	char prefix[ PREFIXCAPACITY ];
+
+	char data[ DATASIZE ];
+
+	void clear();
+	void encode( const StringKey& key, PrefixSearchKey& searchKey ) const;
+	int compare( int i, const PrefixSearchKey& searchKey ) const;
+	int lowerBound( int numKeys, const StringKey& key ) const;
+	int upperBound( int numKeys, const StringKey& key ) const;
+	StringKey keyAt( int i ) const;
+	V valueAt( int i ) const { return slots()[i].value; }
+
+  /**
+   * Returns the number of bytes of data in use.
+   */
+	int usedSpace( int numKeys ) const { return numKeys * sizeof( Slot ) + DATASIZE - heapOffset; }
+
+  /**
+   * Inserts <key, value> at position pos. A key that does not share the node prefix makes the node
+   * be rebuilt around a shorter prefix.
+   * @return False, leaving the node unchanged, if the entry does not fit.
+   */
+	bool insertAt( int& numKeys, int pos, const StringKey& key, const V& value );
+
+  /**
+   * Removes entry pos and compacts the heap, so that the node never holds garbage.
+   */
+	void removeAt( int& numKeys, int pos );
+
+  /**
+   * Appends every entry of the node to entries.
+   */
+	void collect( int numKeys, std::vector< std::pair<StringKey, V> >& entries ) const;
+
+  /**
+   * Returns true if the count sorted entries fit into one node.
+   */
+	static bool fits( const std::pair<StringKey, V>* entries, int count );
+
+  /**
+   * Replaces the contents of the node with count sorted entries, using their longest common prefix.
+   */
+	void build( int& numKeys, const std::pair<StringKey, V>* entries, int count );
+
+	Slot* slots() { return reinterpret_cast<Slot*>( data ); }
+	const Slot* slots() const { return reinterpret_cast<const Slot*>( data ); }
+};
+
+/**
+ * @brief Prefix-compressed non-leaf node. Has the same member functions as the generic non-leaf node.
+ */
+template <>
+struct NonLeafNode<PrefixStringKey> {
+	typedef StringKey KeyType;
+	typedef PrefixKeyArea< PageId, 2 * sizeof( int ) + sizeof( PageId ) > KeyArea;
+
+	int level;
+	int numKeys;
+
+  /**
+   * Leftmost child; child i + 1 is stored in slot i next to its separator.
+   */
+	PageId firstChild;
+
+	KeyArea keys;
+
+	void init( int nodeLevel, PageId child );
+	int lowerBound( const StringKey& key ) const { return keys.lowerBound( numKeys, key ); }
+	int upperBound( const StringKey& key ) const { return keys.upperBound( numKeys, key ); }
+	StringKey keyAt( int i ) const { return keys.keyAt( i ); }
+	PageId childAt( int i ) const { return i == 0 ? firstChild : keys.valueAt( i - 1 ); }
+	void setChildAt( int i, PageId child ) { if( i == 0 ) firstChild = child; else keys.slots()[i - 1].value = child; }
+	bool insertAt( int pos, const StringKey& key, PageId child ) { return keys.insertAt( numKeys, pos, key, child ); }
+	void split( NonLeafNode* sibling, int pos, const StringKey& key, PageId child, StringKey& middleKey );
+	double fillFactor() const { return static_cast<double>( keys.usedSpace( numKeys ) ) / KeyArea::DATASIZE; }
+	void removeAt( int pos ) { keys.removeAt( numKeys, pos ); }
+	bool replaceKeyAt( int pos, const StringKey& key );
+	bool mergeRight( const StringKey& separator, NonLeafNode* right );
+	void balance( NonLeafNode* right, StringKey& separator );
+};
+
+/**
+ * @brief Prefix-compressed leaf node. Has the same member functions as the generic leaf node.
+ */
+template <>
+struct LeafNode<PrefixStringKey> {
+	typedef StringKey KeyType;
+	typedef PrefixKeyArea< RecordId, sizeof( int ) + sizeof( PageId ) > KeyArea;
+
+	int numKeys;
+	PageId rightSibPageNo;
+	KeyArea keys;
+
+	void init();
+	int lowerBound( const StringKey& key ) const { return keys.lowerBound( numKeys, key ); }
+	int upperBound( const StringKey& key ) const { return keys.upperBound( numKeys, key ); }
+	StringKey keyAt( int i ) const { return keys.keyAt( i ); }
+	RecordId ridAt( int i ) const { return keys.valueAt( i ); }
+	bool insertAt( int pos, const StringKey& key, const RecordId& rid ) { return keys.insertAt( numKeys, pos, key, rid ); }
+	void split( LeafNode* sibling, int pos, const StringKey& key, const RecordId& rid, StringKey& separator );
+	double fillFactor() const { return static_cast<double>( keys.usedSpace( numKeys ) ) / KeyArea::DATASIZE; }
+	void removeAt( int pos ) { keys.removeAt( numKeys, pos ); }
+	bool mergeRight( LeafNode* right );
+	void balance( LeafNode* right, StringKey& separator );
+};
+
+static_assert(sizeof(NonLeafNode<PrefixStringKey>) <= Page::SIZE && sizeof(LeafNode<PrefixStringKey>) <= Page::SIZE,
+              "Prefix-compressed STRING nodes must fit in a page.");
+
+/**
+ * @brief Upper bound on the number of keys in a prefix-compressed leaf, reached when every key equals the node prefix.
+ */
+const  int PREFIXLEAFSIZE = LeafNode<PrefixStringKey>::KeyArea::DATASIZE / sizeof( LeafNode<PrefixStringKey>::KeyArea::Slot );
+
+/**
+ * @brief Upper bound on the number of keys in a prefix-compressed non-leaf.
+ */
+const  int PREFIXNONLEAFSIZE = NonLeafNode<PrefixStringKey>::KeyArea::DATASIZE / sizeof( NonLeafNode<PrefixStringKey>::KeyArea::Slot );
+
+/**
+ * @brief Index entry of a record of the relation before and after the record changed, queued by
+ * BTreeIndex::recordsChanged() until the index applies it.
+ */
+struct EntryChange {
+  /**
+   * ID of the record.
+   */
+	RecordId	rid;
+
+  /**
+   * True if the record existed before the change, and has an entry made of oldKey and oldPayload.
+   */
+	bool		existed;
+
+  /**
+   * True if the record exists after the change, and needs an entry made of newKey and newPayload.
+   */
+	bool		exists;
+
+  /**
+   * Keys, as passed to insertEntry(), and included attributes of the record before and after the change.
+   */
+	unsigned char	oldKey[MAXKEYSIZE];
+	char			oldPayload[INCLUDESIZE];
+	unsigned char	newKey[MAXKEYSIZE];
+	char			newPayload[INCLUDESIZE];
+};
+
+
+class BTreeIndex;
+
+/**
+ * @brief State of one range scan over a BTreeIndex: its bounds and the leaf it is positioned on.
+ *
+ * An index can have any number of cursors open at once, so scans can be interleaved or nested, or run in separate
+ * threads, without opening the index again. A cursor keeps its leaf pinned and reads a copy of it. Before returning
+ * an entry or moving to the right sibling it checks the leaf's latch; if a writer changed the leaf in the meantime,
+ * the cursor finds its place again from the root, just past the last entry it returned. Scans therefore stay correct
+ * while other threads insert and delete entries, and see every entry that is in the index for the whole scan.
+ * A cursor must not outlive the index it scans while its scan is running.
+ */
+class IndexCursor {
+	friend class BTreeIndex;
+
+ public:
+	IndexCursor();
+
+  /**
+	 * Ends the scan if it is still running.
+	 */
+	~IndexCursor();
+
+ private:
+	IndexCursor(const IndexCursor&);
+	IndexCursor& operator=(const IndexCursor&);
+
+  /**
+   * Index being scanned, set by BTreeIndex::startScan().
+   */
+	BTreeIndex	*index;
+
+  /**
+   * True if an index scan has been started.
+   */
+	bool		scanExecuting;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+	int			nextEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned. It stays pinned while the cursor is positioned on it.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Version of the latch of the current page when it was copied into leafCopy.
+   */
+	std::uint64_t	currentVersion;
+
+  /**
+   * Copy of the current page, which the scan reads its entries from.
+   */
+	Page		leafCopy;
+
+  /**
+   * Number of entries equal to the low bound that the scan has returned. Once the scan has returned an entry, the
+   * low bound is the last key returned, with GTE, so that the cursor can find its place again from the root.
+   */
+	int			equalReturned;
+
+  /**
+   * Number of entries equal to the low bound still to be passed over after the cursor found its place again.
+   */
+	int			equalToSkip;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	std::string	lowValString;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	std::string highValString;
+
+  /**
+   * Low COMPOSITE value for scan.
+   */
+	CompositeKey	lowValComposite;
+
+  /**
+   * High COMPOSITE value for scan.
+   */
+	CompositeKey	highValComposite;
+
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * Stores the scan range in the scan members matching the key type.
+   */
+	void setScanRange(const int& lowVal, const int& highVal);
+	void setScanRange(const double& lowVal, const double& highVal);
+	void setScanRange(const StringKey& lowVal, const StringKey& highVal);
+	void setScanRange(const CompositeKey& lowVal, const CompositeKey& highVal);
+
+  /**
+   * Reads back the scan range stored by setScanRange().
+   */
+	void getScanRange(int& lowVal, int& highVal) const;
+	void getScanRange(double& lowVal, double& highVal) const;
+	void getScanRange(StringKey& lowVal, StringKey& highVal) const;
+	void getScanRange(CompositeKey& lowVal, CompositeKey& highVal) const;
+
+  /**
+   * The scan range of a covering index is that of its keys proper.
+   */
+	template <class T>
+	void setScanRange(const CoveredKey<T>& lowVal, const CoveredKey<T>& highVal)
+	{
+		setScanRange(lowVal.key, highVal.key);
+	}
+
+	template <class T>
+	void getScanRange(CoveredKey<T>& lowVal, CoveredKey<T>& highVal) const
+	{
+		getScanRange(lowVal.key, highVal.key);
+		memset(lowVal.payload, 0, INCLUDESIZE);
+		memset(highVal.payload, 0, INCLUDESIZE);
+	}
+};
+
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation, or on several of them (COMPOSITE). The scan methods without a cursor argument run one scan at a time on a default
+ * cursor; pass an IndexCursor of your own to run several.
+ * The node layouts and algorithms are templates on the key type; the public methods
+ * take untyped keys and dispatch on the attribute type given at construction.
+ *
+ * insertEntry(), deleteEntry() and lookupEntry() may be called by many threads at once. They use optimistic lock
+ * coupling on the latches of the buffer frames: readers never block, and an insert or delete that stays within one
+ * leaf only locks that leaf. Splits, merges and root changes run one at a time. Scans on separate cursors may run
+ * alongside them. computeShape() and compact() must not run concurrently with other calls.
+ *
+ * While it is open, the index listens for the record changes of its relation's PageFile. Records inserted, updated or
+ * deleted with PageFile::insertRecord(), updateRecord() and deleteRecord() reach the index as they change, whether or
+ * not their page has been written back; the index queues their entries and applies them, in key order, at the start
+ * of its next public method call. Records changed through Page directly are not seen until the index is rebuilt; once
+ * such a change is written, the index is no longer stamped as matching its relation, and is rebuilt when opened next.
+ *
+ * With a buffer manager that logs page changes, every insertEntry() and deleteEntry() is one operation of the buffer
+ * manager, split and meta page included, so a crash never leaves half of one in the index file. Inserts and deletes
+ * then run one at a time.
+ *
+ * An index file mapped with File::mapReadOnly() before the index is opened is read in place, without buffer frames.
+ * Such an index is only searched and scanned: it does not follow its relation, and changing it throws a
+ * ReadOnlyFileException.
+*/
+class BTreeIndex : public RecordListener {
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Buffer manager through which the relation is scanned when the index is built; bufMgr unless the index was
+   * opened with BufPools.
+   */
+	BufMgr	*relationBufMgr;
+
+  /**
+   * Pools the index and the relation are buffered in, or NULL if the index was opened with one buffer manager
+   */
+	BufPools	*pools;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * Name of the relation the index is built over.
+   */
+	std::string	relationName;
+
+  /**
+   * page number of root page of B+ tree inside index file. Readers check it again after latching the root.
+   */
+	std::atomic<PageId>	rootPageNum;
+
+  /**
+   * Number of levels of the tree, 1 while the root is a leaf. Writers change it before rootPageNum, both while holding
+   * the latch of the old root, so that a reader loading rootPageNum and then height has a matching pair once it finds
+   * rootPageNum unchanged after latching the root.
+   */
+	std::atomic<int>	height;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * True if the nodes of this STRING index are prefix-compressed (LeafNode<PrefixStringKey>).
+   */
+	bool		prefixCompressed;
+
+  /**
+   * Fill factor below which deleteEntry() merges a node with a sibling or redistributes their entries.
+   */
+	double	mergeThreshold;
+
+  /**
+   * Held while the structure of the tree changes. Splits, merges and root changes are the only writes to non-leaf
+   * nodes, so a thread holding it can read those without latching them.
+   */
+	std::mutex	structureMutex;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Offset of the included attributes inside records, for a covering index.
+   */
+	int			includeByteOffset;
+
+  /**
+   * Number of included bytes stored with each entry (LeafNode< CoveredKey<T> >), 0 if the index is not covering.
+   */
+	int			includeLength;
+
+  /**
+   * Attributes of a COMPOSITE index, in the order their values are compared; empty for an index on a single attribute.
+   */
+	std::vector<KeyPart>	keyParts;
+
+  /**
+   * Number of bytes of a COMPOSITE key taken up by its parts.
+   */
+	int			keyLength;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+	int			leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Cursor used by startScan(), scanNext() and endScan() without a cursor argument.
+   */
+	IndexCursor	scanCursor;
+
+
+	// STATISTICS, see IndexStats. Kept up to date in memory and written to the meta page with the root page number,
+	// and when the index is closed.
+
+  /**
+   * Guards the statistics below.
+   */
+	std::mutex	statsMutex;
+
+  /**
+   * Number of entries in the index.
+   */
+	std::int64_t	numEntries;
+
+  /**
+   * Number of leaf and non-leaf nodes.
+   */
+	int			numLeaves;
+	int			numNonLeaves;
+
+  /**
+   * True if minKey and maxKey bound the keys in the index.
+   */
+	bool		hasKeyRange;
+
+  /**
+   * Bounds on the keys in the index.
+   */
+	unsigned char	minKey[MAXKEYSIZE];
+	unsigned char	maxKey[MAXKEYSIZE];
+
+
+	// CHANGES OF THE RELATION
+
+  /**
+   * Guards pendingChanges.
+   */
+	std::mutex	changesMutex;
+
+  /**
+   * Entry changes reported by recordsChanged() and not applied yet, in the order they were reported.
+   */
+	std::vector<EntryChange>	pendingChanges;
+
+  /**
+   * True if pendingChanges may not be empty; lets public methods skip changesMutex when nothing is queued.
+   */
+	std::atomic<bool>	hasPendingChanges;
+
+  /**
+   * PageFile::unreportedChanges() of the relation when the index started listening to it; a higher count means the
+   * relation changed in ways the index did not see.
+   */
+	std::uint64_t	unreportedChangesAtOpen;
+
+
+ public:
+
+  /**
+   * BTreeIndex Constructor.
 	 * Check to see if the corresponding index file exists. If so, open the file.
 	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * An existing file is opened without reading the relation if its meta page is intact, it was closed cleanly and
+	 * the relation's file has not changed since. Otherwise it is built anew, like a missing one.
+	 * The file is named relation.offset, followed by .pfx for a prefix-compressed index and .inc<offset>_<length> for
+	 * a covering one; the parts of a COMPOSITE index are named offset and type each, e.g. relation.20s3.0i.
+	 * Indexes of different kinds on the same attributes thus have files of their own.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @param prefixCompressed		For a STRING attribute, store keys in prefix-compressed nodes instead of fixed-width slots
+   * @param includeByteOffset	Offset, in the record, of the attributes to include in a covering index
+   * @param includeLength		Number of bytes from includeByteOffset on to store with each entry, at most INCLUDESIZE; 0 for
+   *													an index that is not covering. Scans of a covering index return these bytes with each record id,
+   *													so that they can be answered without reading the base relation.
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters,
+   *                                    or if includeLength is out of range or combined with prefixCompressed.
+   * @throws  ReadOnlyFileException     If the index file is mapped read-only and would have to be built anew.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+							const bool prefixCompressed = false, const int includeByteOffset = 0, const int includeLength = 0);
+
+
+  /**
+   * BTreeIndex Constructor for an index whose pages are buffered in the pool its file is assigned to in a set of
+   * pools, e.g. one kept for indexes, while the relation is scanned in the pool of the relation's file. Otherwise
+   * the same as the constructor above.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param poolsIn						Pools the index file and the relation file are assigned to
+   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+   * @param attrType						Datatype of attribute over which index is built
+   * @param prefixCompressed		For a STRING attribute, store keys in prefix-compressed nodes instead of fixed-width slots
+   * @param includeByteOffset	Offset, in the record, of the attributes to include in a covering index
+   * @param includeLength		Number of bytes from includeByteOffset on to store with each entry, as for the constructor above
+   * @throws  PoolNotFoundException     If the index file or the relation file goes to a pool that does not exist
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufPools *poolsIn,	const int attrByteOffset,	const Datatype attrType,
+							const bool prefixCompressed = false, const int includeByteOffset = 0, const int includeLength = 0);
+
+
+  /**
+   * BTreeIndex Constructor for an index on several attributes of a relation, of type COMPOSITE. Its keys are ordered by
+   * the first attribute, then by the second, and so on. Keys passed to its methods are COMPOSITESIZE bytes long and
+   * made by encodeKey(). The index file is named after the relation and the offsets of all the attributes.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param keyParts					Attributes the index is built over, at most MAXKEYPARTS of them. The length of INTEGER and
+   *													DOUBLE parts is set from their type; the lengths of all parts add up to at most COMPOSITESIZE.
+   * @param includeByteOffset	Offset, in the record, of the attributes to include in a covering index
+   * @param includeLength		Number of bytes from includeByteOffset on to store with each entry, as for the constructor above
+   * @throws  BadIndexInfoException     If the index file already exists but was built over other attributes, or if the
+   *                                    attributes or includeLength are out of range.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
-	
+						BufMgr *bufMgrIn, const std::vector<KeyPart>& keyParts,
+							const int includeByteOffset = 0, const int includeLength = 0);
+
 
   /**
-   * BTreeIndex Destructor. 
+   * BTreeIndex Destructor.
 	 * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
-	 * and delete file instance thereby closing the index file.
-	 * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
+	 * and delete file instance thereby closing the index file. The meta page then records the state of the relation,
+	 * which the next constructor checks the index against.
+	 * Destructor should not throw any exceptions. All exceptions should be caught in here itself.
 	 * */
 	~BTreeIndex();
 
 
   /**
-	 * Insert a new entry using the pair <value,rid>. 
+	 * Insert a new entry using the pair <value,rid>.
 	 * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
 	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
 	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
@@ -354,8 +1517,79 @@ class BTreeIndex {
 
 
   /**
-	 * Begin a filtered scan of the index.  For instance, if the method is called 
-	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
+	 * Insert a new entry into a covering index, with the included attributes of its record.
+   * @param key			Key to insert, pointer to integer/double/char string
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @param payload	The record's includeLength bytes of included attributes; NULL stores zeros, as insertEntry(key, rid) does
+	**/
+	void insertEntry(const void* key, const RecordId rid, const void* payload);
+
+
+  /**
+	 * Delete the entry <key,rid>.
+	 * Start from root to find the leaf holding the entry and remove it. A node whose fill factor drops below the
+	 * merge threshold is merged with a sibling, or takes entries from it if both do not fit into one node.
+	 * Pages emptied by merges are disposed of, and the index file hands them out again to later splits.
+	 * Running scans carry on; a cursor whose leaf was changed finds its place again before moving on.
+   * @param key			Key to delete, pointer to integer/double/char string
+   * @param rid			Record ID stored with the key
+	 * @throws  NoSuchKeyFoundException If the index has no entry <key,rid>.
+	**/
+	void deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Look up the first entry with the given key. Unlike a scan, a lookup keeps no state in the index, so any number
+	 * of threads may look up keys while others insert and delete entries.
+   * @param key			Key to look up, pointer to integer/double/char string
+   * @param outRid	Record ID stored with the key returned in this
+	 * @throws  NoSuchKeyFoundException If the index has no entry with this key.
+	**/
+	void lookupEntry(const void* key, RecordId& outRid);
+
+
+  /**
+	 * Look up the first entry of each of a batch of keys, as lookupEntry() does for one key. The keys are probed in
+	 * sorted order in a single descent: each node is read once for all the keys that pass through it, and the children
+	 * of a node are read a few at a time before any of them is searched. Meant for index nested-loop joins and other
+	 * callers with many keys to probe.
+   * @param keys		Keys to look up, each a pointer to integer/double/char string
+   * @param numKeys	Number of keys
+   * @param outRids	Record IDs stored with the keys returned in this, in the order of keys
+   * @param found		Set to whether the index has an entry with each key, in the order of keys
+   * @return Number of keys that were found.
+	**/
+	size_t lookupBatch(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found);
+
+
+  /**
+	 * Set the fill factor below which deleteEntry() rebalances a node, 0.5 by default. Lower values delete lazily:
+	 * sparse nodes are left alone until they drop below the threshold, and 0 only reclaims nodes that become empty.
+   * @param fillFactor	Threshold between 0 and 1
+	**/
+	void setMergeThreshold(double fillFactor);
+
+
+  /**
+	 * Return the statistics of the index: its height, its number of entries and nodes, how full its leaves are, and
+	 * bounds on its keys. Takes constant time and reads no page. lookupEntry() and startScan() use the key bounds to
+	 * answer lookups and scans outside them without descending the tree.
+	**/
+	IndexStats getStats();
+
+
+  /**
+	 * Queues the entry changes for records of the relation that changed. Called by the relation's PageFile; see
+	 * RecordListener.
+   * @param filename	Name of the relation
+   * @param changes		Records of one page that changed
+	**/
+	void recordsChanged(const std::string& filename, const std::vector<RecordChange>& changes) override;
+
+
+  /**
+	 * Begin a filtered scan of the index.  For instance, if the method is called
+	 * using ("a",GT,"d",LTE) then we should seek all entries with a value
 	 * greater than "a" and less than or equal to "d".
 	 * If another scan is already executing, that needs to be ended here.
 	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
@@ -364,13 +1598,28 @@ class BTreeIndex {
    * @param lowOp		Low operator (GT/GTE)
    * @param highVal	High value of range, pointer to integer / double / char string
    * @param highOp	High operator (LT/LTE)
-   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
    * @throws  BadScanrangeException If lowVal > highval
 	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
 	**/
 	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
 
 
+  /**
+	 * Begin a filtered scan on the given cursor, as startScan() does on the default cursor.
+	 * A scan already running on the cursor is ended first.
+   * @param cursor	Cursor to position
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	void startScan(IndexCursor& cursor, const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
   /**
 	 * Fetch the record id of the next index entry that matches the scan.
 	 * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
@@ -381,56 +1630,459 @@ class BTreeIndex {
 	void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the record id of the next index entry that matches the scan running on the given cursor.
+   * @param cursor	Cursor of the scan
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan has been initialized on the cursor.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	void scanNext(IndexCursor& cursor, RecordId& outRid);
+
+
+  /**
+	 * Fetch the record ids of the next index entries that match the scan, up to max of them.
+	 * The entries are copied out of each leaf in one pass, moving on to the right sibling as
+	 * often as needed; the end of the scan is reported by the return value rather than by an exception.
+   * @param out	Array the record ids are stored in
+   * @param max	Number of record ids out has room for
+   * @return Number of record ids stored in out, less than max only once the scan has reached its end, and 0 after that.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	size_t scanNextBatch(RecordId* out, size_t max);
+
+
+  /**
+	 * Fetch the record ids of the next index entries that match the scan running on the given cursor, as
+	 * scanNextBatch() does on the default cursor.
+   * @param cursor	Cursor of the scan
+   * @param out	Array the record ids are stored in
+   * @param max	Number of record ids out has room for
+   * @return Number of record ids stored in out, less than max only once the scan has reached its end, and 0 after that.
+	 * @throws ScanNotInitializedException If no scan has been initialized on the cursor.
+	**/
+	size_t scanNextBatch(IndexCursor& cursor, RecordId* out, size_t max);
+
+
+  /**
+	 * Fetch the record ids of the next index entries that match the scan running on the given cursor, together with
+	 * the included attributes stored with them by a covering index. An index-only scan reads these instead of the
+	 * records.
+   * @param cursor	Cursor of the scan
+   * @param out	Array the record ids are stored in
+   * @param outPayloads	Array of max * includeLength bytes the included attributes of each entry are stored in, one after
+   *										the other
+   * @param max	Number of record ids out has room for
+   * @return Number of record ids stored in out, less than max only once the scan has reached its end, and 0 after that.
+	 * @throws ScanNotInitializedException If no scan has been initialized on the cursor.
+	 * @throws BadScanParamException If the index is not covering.
+	**/
+	size_t scanNextBatch(IndexCursor& cursor, RecordId* out, void* outPayloads, size_t max);
+
+
+  /**
+	 * Fetch the record ids and included attributes of the next index entries that match the scan, as the overload
+	 * above does on the default cursor.
+	**/
+	size_t scanNextBatch(RecordId* out, void* outPayloads, size_t max);
+
+
+  /**
+	 * Number of included bytes stored with each entry, 0 if the index is not covering.
+	**/
+	int getIncludeLength() const { return includeLength; }
+
+
+  /**
+		 * Make the key of a COMPOSITE index out of the values of its first numValues attributes. The remaining attributes
+		 * take their smallest value, so the key is the first one of the index that starts with these values.
+   * @param values		Values of the attributes, each a pointer to integer/double/char string
+   * @param numValues	Number of values, from 1 to the number of attributes of the index
+   * @param out			Buffer of COMPOSITESIZE bytes the key is stored in
+		 * @throws BadScanParamException If the index is not COMPOSITE or numValues is out of range.
+		**/
+	void encodeKey(const void* const* values, int numValues, void* out) const;
+
+
+  /**
+		 * Begin a scan of all the entries of a COMPOSITE index whose first numValues attributes have the given values, such
+		 * as all the entries for one value of the first attribute. Runs like a scan started with startScan().
+   * @param cursor		Cursor to position
+   * @param values		Values of the leading attributes, each a pointer to integer/double/char string
+   * @param numValues	Number of values, from 1 to the number of attributes of the index
+		 * @throws BadScanParamException If the index is not COMPOSITE or numValues is out of range.
+		 * @throws NoSuchKeyFoundException If the index has no entry starting with these values.
+		**/
+	void startPrefixScan(IndexCursor& cursor, const void* const* values, int numValues);
+
+
+  /**
+		 * Begin a prefix scan on the default cursor, as the overload above does.
+		**/
+	void startPrefixScan(const void* const* values, int numValues);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
 	**/
 	void endScan();
 
+
+  /**
+	 * Terminate the scan running on the given cursor and unpin its leaf.
+   * @param cursor	Cursor of the scan
+	 * @throws ScanNotInitializedException If no scan has been initialized on the cursor.
+	**/
+	void endScan(IndexCursor& cursor);
+
+
   /**
-  * Finds the closest pageId to the query.
-  * 
-  * @param node the node whose children to search in
-  * @param lowValParam the low value to compare to
-  * @param greaterThan the greater value to compare to
-  * @return PageId the pageId of the page that might have the values desired
-  */
-  PageId findLeastPageId(NonLeafNodeInt node, int lowValParam, Operator greaterThan);
+	 * Walks the whole tree and reports its shape. Takes time linear in the size of the index;
+	 * meant for tests and benchmarks.
+   * @param height	Set to the number of levels of the tree, 1 if the root is a leaf
+   * @param nodes		Set to the number of leaf and non-leaf nodes
+	**/
+	void computeShape(int& height, int& nodes);
+
+
+  /**
+	 * Rewrite the index file densely: the meta page, then the leaves in key order, then the non-leaf nodes level by
+	 * level, without free pages in between. Range scans then read the leaf chain sequentially. The nodes are copied
+	 * into a new file that replaces the old one, so the index stays open and usable. A scan running on the default
+	 * cursor is ended first; scans on other cursors must have been ended.
+	**/
+	void compact();
+
+ private:
+
+  /**
+   * Body of the constructors: opens the index file and checks its meta page, or creates it and inserts an entry for
+   * every record of the relation. keyParts must have been set.
+   */
+	void openIndex(const std::string & relationName, std::string & outIndexName, const int attrByteOffset,
+	               const Datatype attrType, const bool prefixCompressed, const int includeByteOffset,
+	               const int includeLength);
+
+  /**
+   * Encodes the values of the first numValues parts of a COMPOSITE key, and fills the bytes of the remaining parts
+   * with fill: 0 for the smallest key starting with these values, 0xff for the largest.
+   */
+	void encodeKeyParts(const void* const* values, int numValues, unsigned char fill, CompositeKey& key) const;
+
+  /**
+   * Typed body of insertEntry(). Tries insertOptimistic() first, and splits under structureMutex if the leaf is full.
+   * T selects the node format; keys are of type LeafNode<T>::KeyType.
+   *
+   * @param key			Key to insert
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   */
+	template <class T>
+	void insertEntryTyped(const typename LeafNode<T>::KeyType& key, const RecordId rid);
+
+  /**
+   * Descends optimistically from the root to the leaf responsible for key, coupling the latches of each parent and
+   * child: the child's version is noted before the parent is validated and unpinned.
+   *
+   * @param key			Key to search for
+   * @param upper		True to follow the child after any separators equal to key, as inserts do, false to follow the
+   *								first child that may hold key, as lookups and deletes do
+   * @param pageNo	Set to the page number of the leaf
+   * @param page		Set to the leaf, which stays pinned
+   * @param version	Set to the version of the leaf's latch
+   * @return False if a concurrent writer got in the way. No page is left pinned then, and the caller starts over.
+   */
+	template <class T>
+	bool descendOptimistic(const typename LeafNode<T>::KeyType& key, bool upper, PageId& pageNo, Page*& page,
+	                       std::uint64_t& version);
+
+  /**
+   * Descends optimistically to the leaf responsible for key and locks it, starting over until no concurrent writer
+   * gets in the way.
+   *
+   * @param key			Key to search for
+   * @param upper		As for descendOptimistic()
+   * @param pageNo	Set to the page number of the leaf
+   * @param page		Set to the leaf, which stays pinned and locked
+   */
+	template <class T>
+	void lockLeaf(const typename LeafNode<T>::KeyType& key, bool upper, PageId& pageNo, Page*& page);
+
+  /**
+   * Inserts the entry if its leaf has room for it, locking only that leaf.
+   * @return False if the leaf is full, so that the tree has to be split under structureMutex.
+   */
+	template <class T>
+	bool insertOptimistic(const RIDKeyPair<typename LeafNode<T>::KeyType>& entry);
+
+  /**
+   * Removes the entry if it is in the leaf the key leads to and that leaf stays above the merge threshold, locking
+   * only that leaf.
+   * @return False if the entry has to be removed under structureMutex, because the leaf would underflow or the entry
+   *         is not there. In that case the leaf is left unchanged.
+   */
+	template <class T>
+	bool deleteOptimistic(const RIDKeyPair<typename LeafNode<T>::KeyType>& entry);
+
+  /**
+   * Typed body of lookupEntry().
+   * @return False if the index has no entry with this key.
+   */
+	template <class T>
+	bool lookupEntryTyped(const typename LeafNode<T>::KeyType& key, RecordId& outRid);
+
+  /**
+   * Typed body of lookupBatch().
+   */
+	template <class T>
+	size_t lookupBatchTyped(const void* const* keys, size_t numKeys, RecordId* outRids, bool* found);
+
+  /**
+   * Answers the sorted probes [next, end) of lookupBatch() from the subtree rooted at the given page, which the
+   * caller has pinned and read-locked, and unpins it. Probes answered are not visited again.
+   *
+   * @param pageNo		Page number of the subtree's root
+   * @param page			The subtree's root
+   * @param version		Version of the latch of page
+   * @param isLeaf		True if the page is a leaf
+   * @param probes		Keys of the batch in sorted order, each with its position in the batch
+   * @param next			First probe still to be answered; advanced past the probes answered
+   * @param end			End of the probes that descend to this subtree
+   * @param outRids		As for lookupBatch()
+   * @param found			As for lookupBatch()
+   * @return False if a concurrent writer got in the way. No page is left pinned then, and the caller starts over
+   *         from the root with the probes from next on.
+   */
+	template <class T>
+	bool probeSubtree(PageId pageNo, Page *page, std::uint64_t version, bool isLeaf,
+	                  const std::vector< std::pair<typename LeafNode<T>::KeyType, size_t> >& probes,
+	                  size_t& next, size_t end, RecordId* outRids, bool* found);
+
+  /**
+   * Inserts the entry into the subtree rooted at the given page. Called with structureMutex held; the nodes on the
+   * path are locked from the top down.
+   *
+   * @param pageNo		Page number of the subtree root
+   * @param isLeaf		True if that page is a leaf
+   * @param entry			Key and rid to insert
+   * @param newChild	If the page had to be split, set to the separator key and page number of the new right sibling
+   * @return True if the page was split and newChild must be inserted into the parent. The root is never left split.
+   */
+	template <class T>
+	bool insertInto(PageId pageNo, bool isLeaf, const RIDKeyPair<typename LeafNode<T>::KeyType>& entry,
+	                PageKeyPair<typename LeafNode<T>::KeyType>& newChild);
+
+  /**
+   * Unlocks a node after it was split. A split root is replaced by a new root first.
+   *
+   * @param pageNo		Page number of the node that was split
+   * @param page			The node, locked by lockNode()
+   * @param newChild	Separator key and page number of the new right sibling
+   * @return True if newChild must still be inserted into the parent.
+   */
+	template <class T>
+	bool finishSplit(PageId pageNo, Page *page, const PageKeyPair<typename LeafNode<T>::KeyType>& newChild);
+
+  /**
+   * Inserts into a full leaf by splitting it into itself and a newly allocated right sibling.
+   *
+   * @param node			Leaf that is full
+   * @param pos				Position of the new entry in the leaf
+   * @param entry			Key and rid to insert
+   * @param newChild	Set to the separator key and page number of the new right sibling
+   */
+	template <class T>
+	void splitLeaf(LeafNode<T>* node, int pos, const RIDKeyPair<typename LeafNode<T>::KeyType>& entry,
+	               PageKeyPair<typename LeafNode<T>::KeyType>& newChild);
+
+  /**
+   * Inserts into a full non-leaf by splitting it. The middle key moves up into newChild.
+   *
+   * @param node			Non-leaf that is full
+   * @param pos				Position of the new separator in the node
+   * @param entry			Separator key and page number to insert
+   * @param newChild	Set to the middle key and page number of the new right sibling
+   */
+	template <class T>
+	void splitNonLeaf(NonLeafNode<T>* node, int pos, const PageKeyPair<typename LeafNode<T>::KeyType>& entry,
+	                  PageKeyPair<typename LeafNode<T>::KeyType>& newChild);
+
+  /**
+   * Typed body of deleteEntry(). Tries deleteOptimistic() first. Otherwise removes the entry under structureMutex,
+   * rebalancing nodes and shrinking the tree if the root is left with a single non-leaf child.
+   * @return False if the index has no such entry.
+   */
+	template <class T>
+	bool deleteEntryTyped(const typename LeafNode<T>::KeyType& key, const RecordId rid);
+
+  /**
+   * Removes the entry from the subtree rooted at the given page, with structureMutex held. Because of duplicates, the entry may be in any child
+   * whose key range includes the key, so those are tried in order.
+   *
+   * @param pageNo		Page number of the subtree root
+   * @param isLeaf		True if that page is a leaf
+   * @param entry			Key and rid to remove
+   * @param underflow	Set to true if the page fell below the merge threshold
+   * @return True if the entry was found and removed.
+   */
+	template <class T>
+	bool removeFrom(PageId pageNo, bool isLeaf, const RIDKeyPair<typename LeafNode<T>::KeyType>& entry, bool& underflow);
+
+  /**
+   * Merges child pos of node with a sibling, or redistributes their entries if they do not fit into one page.
+   *
+   * @param node			Parent of the child, pinned by the caller
+   * @param pos				Index of the child that fell below the merge threshold
+   * @return True if node was changed.
+   */
+	template <class T>
+	bool rebalanceChild(NonLeafNode<T>* node, int pos);
+
+  /**
+   * Pins a node for a change of the tree structure and locks its latch.
+   */
+	Page *lockNode(PageId pageNo);
+
+  /**
+   * Unlocks a node locked by lockNode() and unpins it.
+   */
+	void unlockNode(PageId pageNo, Page *page, bool dirty);
+
+  /**
+   * Marks a node locked by lockNode() as freed, unpins it and gives it back to the index file.
+   */
+	void freeNode(PageId pageNo, Page *page);
+
+  /**
+   * Stores the root page number and the statistics in the meta page.
+   * @param closing	True when the index is being closed and all of its other pages are on disk
+   * @param stampRelation	True when the index is known to match the relation, which is the case when closing unless
+   * 				the relation was changed without the index being told
+   */
+	void writeMetaInfo(bool closing = false, bool stampRelation = false);
+
+  /**
+   * Applies the entry changes queued by recordsChanged(): for each record, the entry it had when the changes were
+   * last applied is removed and the one it has now is added, removals before additions and each in key order.
+   * Does nothing when called again by the methods it calls.
+   */
+	void applyPendingChanges();
+
+  /**
+   * Typed body of applyPendingChanges(). K is the type of the key proper.
+   */
+	template <class K>
+	void applyChanges(std::vector<EntryChange>& changes);
+
+  /**
+   * Copies the key of a record, as passed to insertEntry(), and its included attributes.
+   * @param record	The record
+   * @param key		Set to the key, MAXKEYSIZE bytes
+   * @param payload	Set to the included attributes, INCLUDESIZE bytes
+   */
+	void recordKey(const std::string & record, unsigned char* key, char* payload) const;
+
+  /**
+   * Reads an existing index file's meta page. Returns false if the index must be built anew: the page is damaged or
+   * of another format version, the index was neither closed cleanly nor logged by a buffer manager with a log, or the
+   * relation changed since the index was last known to match it.
+   * @throws  BadIndexInfoException     If the index was built with other parameters.
+   */
+	bool readMetaInfo(const std::string & indexName);
+
+  /**
+   * Counts an inserted entry and widens the key bounds to its key.
+   */
+	template <class T>
+	void countInsert(const typename LeafNode<T>::KeyType& key);
 
   /**
-  * Gets the root node
-  * 
-  * @return NonLeafNodeInt 
-  */
-  NonLeafNodeInt getRootNode();
+   * Counts a deleted entry; the key bounds are dropped once the index is empty.
+   */
+	void countDelete();
+
+  /**
+   * Adds delta to the number of leaf or non-leaf nodes.
+   */
+	void countNodes(bool leaves, int delta);
+
+  /**
+   * Returns false if the key bounds show that no key in the index lies in the range, which may be open at either end.
+   */
+	template <class T>
+	bool mayHaveKeys(const typename LeafNode<T>::KeyType& lowVal, Operator lowOp,
+	                 const typename LeafNode<T>::KeyType& highVal, Operator highOp);
+
+  /**
+   * Typed body of compact().
+   */
+	template <class T>
+	void compactTyped();
+
+  /**
+   * Allocates a new root above the old one after the old root was split, and records it in the meta page.
+   *
+   * @param newChild	Separator key and page number of the new right sibling of the old root
+   */
+	template <class T>
+	void growRoot(const PageKeyPair<typename LeafNode<T>::KeyType>& newChild);
+
+  /**
+   * Typed body of startScan().
+   */
+	template <class T>
+	void startScanTyped(IndexCursor& cursor, const typename LeafNode<T>::KeyType& lowVal,
+	                    const typename LeafNode<T>::KeyType& highVal);
+
+  /**
+   * Typed body of scanNext().
+   */
+	template <class T>
+	void scanNextTyped(IndexCursor& cursor, RecordId& outRid);
 
-	/**
-  * Reads a page into a non leaf node struct.
-  * 
-  * @param pageId the pageId of the non leaf node
-  * @return NonLeafNodeInt the struct representing the non leaf
-  */
-  NonLeafNodeInt getNonLeafNodeFromPage(PageId pageId);
+  /**
+   * Typed body of scanNextBatch().
+   */
+	template <class T>
+	size_t scanNextBatchTyped(IndexCursor& cursor, RecordId* out, char* outPayloads, size_t max);
+
+  /**
+   * Body of the scanNextBatch() overloads; outPayloads is NULL when the caller only wants record ids.
+   */
+	size_t scanNextBatchPayloads(IndexCursor& cursor, RecordId* out, char* outPayloads, size_t max);
 
-  void search(Page *Page_currently, PageId Page_number_currently, bool is_leaf, const RIDKeyPair<int> current_data_to_enter, PageKeyPair<int> *&child_data);
+  /**
+   * Positions the cursor on the leaf that may hold the first entry for the low bound of its scan, at the first key
+   * not below the low bound. The cursor may end up past the last entry of the leaf. Any leaf the cursor was on
+   * before must have been unpinned.
+   */
+	template <class T>
+	void seekCursor(IndexCursor& cursor);
 
   /**
-   * @brief The NextNonLeafNode grabs the current node and traverses through it's key array.
-   * It then compares them to the current key to find the appropriate page id to find the right nonleaf node
-   * 
-   * @param Node_currently 
-   * @param node_next_number 
-   * @param key 
+   * Moves the cursor forward to the next entry that satisfies the low bound and is not to be skipped, moving on to
+   * right siblings as needed. The high bound is left to the caller.
+   *
+   * @param cursor	Cursor of the scan
+   * @param lowVal	Low bound of the scan
+   * @return False if the scan has no entries left.
    */
-  void NextNonLeafNode(NonLeafNodeInt *Node_currently, PageId &node_next_number, int key);
+	template <class T>
+	bool seekNextEntry(IndexCursor& cursor, const typename LeafNode<T>::KeyType& lowVal);
 
+  /**
+   * Moves the cursor from its leaf, which it has read entirely, to the right sibling.
+   * If the leaf changed since it was copied, the sibling it names may be stale, and the cursor finds its place
+   * again from the root instead.
+   */
+	template <class T>
+	void advanceCursor(IndexCursor& cursor);
 
   /**
-   * @brief The insert_into_nonLeaf function searches through the given nonleaf to find the correct spot to enter in key and pageid.
-   * The keys and pageids after the key are shifted too.
-   * 
-   * @param Node_nonleaf 
-   * @param key_and_page 
+   * Typed body of computeShape(). Adds the nodes of the subtree rooted at pageNo, found at the given depth.
    */
-  void insert_into_nonleaf(NonLeafNodeInt *Node_nonleaf, PageKeyPair<int> *key_and_page);
+	template <class T>
+	void computeShapeTyped(PageId pageNo, bool isLeaf, int depth, int& height, int& nodes);
+};
+
 }
@@ -5,6 +5,7 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cstdint>
 #include <memory>
 #include <iostream>
 #include "buffer.h"
@@ -15,16 +16,61 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+int BufHashTbl::hash(const File* file, const PageId pageNo, const int size)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // the pointer to the file object is taken as an unsigned integer, so that the value is never negative
+  std::uintptr_t tmp = reinterpret_cast<std::uintptr_t>(file);
+  return (tmp + pageNo) % size;
+}
+
+hashBucket*& BufHashTbl::chain(const File* file, const PageId pageNo)
+{
+  int index = hash(file, pageNo, HTSIZE);
+  if (newHt != NULL && index < rehashIndex)
+    return newHt[hash(file, pageNo, newHTSIZE)];
+  return ht[index];
+}
+
+void BufHashTbl::rehash(int numBuckets)
+{
+  for (; numBuckets > 0 && rehashIndex < HTSIZE; numBuckets--, rehashIndex++) {
+    hashBucket* tmpBuc = ht[rehashIndex];
+    while (tmpBuc) {
+      hashBucket* next = tmpBuc->next;
+      int index = hash(tmpBuc->file, tmpBuc->pageNo, newHTSIZE);
+      tmpBuc->next = newHt[index];
+      newHt[index] = tmpBuc;
+      tmpBuc = next;
+    }
+    ht[rehashIndex] = NULL;
+  }
+
+  if (rehashIndex == HTSIZE) {
+    delete [] ht;
+    ht = newHt;
+    HTSIZE = newHTSIZE;
+    newHt = NULL;
+    newHTSIZE = 0;
+    rehashIndex = 0;
+  }
+}
+
+void BufHashTbl::resize(const int htSize)
+{
+  if (newHt != NULL)
+    rehash(HTSIZE);
+  if (htSize == HTSIZE)
+    return;
+
+  newHt = new hashBucket* [htSize];
+  for(int i=0; i < htSize; i++)
+    newHt[i] = NULL;
+  newHTSIZE = htSize;
+  rehashIndex = 0;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+	: HTSIZE(htSize), newHTSIZE(0), newHt(NULL), rehashIndex(0)
 {
   // allocate an array of pointers to hashBuckets
   ht = new hashBucket* [htSize];
@@ -34,6 +80,8 @@ BufHashTbl::BufHashTbl(int htSize)
 
 BufHashTbl::~BufHashTbl()
 {
+  if (newHt != NULL)
+    rehash(HTSIZE);
   for(int i = 0; i < HTSIZE; i++) {
     hashBucket* tmpBuf = ht[i];
     while (ht[i]) {
@@ -47,9 +95,11 @@ BufHashTbl::~BufHashTbl()
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
+  if (newHt != NULL)
+    rehash(REHASH_STEP);
+  hashBucket*& head = chain(file, pageNo);
 
-  hashBucket* tmpBuc = ht[index];
+  hashBucket* tmpBuc = head;
   while (tmpBuc) {
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
   		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
@@ -63,14 +113,15 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
   tmpBuc->file = (File*) file;
   tmpBuc->pageNo = pageNo;
   tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  tmpBuc->next = head;
+  head = tmpBuc;
 }
 
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
+  if (newHt != NULL)
+    rehash(REHASH_STEP);
+  hashBucket* tmpBuc = chain(file, pageNo);
   while (tmpBuc) {
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
     {
@@ -85,8 +136,10 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
+  if (newHt != NULL)
+    rehash(REHASH_STEP);
+  hashBucket*& head = chain(file, pageNo);
+  hashBucket* tmpBuc = head;
   hashBucket* prevBuc = NULL;
 
   while (tmpBuc)
@@ -96,7 +149,7 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
       if(prevBuc) 
 				prevBuc->next = tmpBuc->next;
       else
-				ht[index] = tmpBuc->next;
+				head = tmpBuc->next;
 
       delete tmpBuc;
       return;
@@ -40,6 +40,10 @@ struct hashBucket {
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
+* The table is resized incrementally: resize() allocates the new bucket array, and every later call moves a few
+* buckets of the old array over, so that no one call pays for rehashing the whole table. Until the move is done, a
+* bucket of the old array that has not moved yet is searched there, and every other entry in the new array.
+*
 * @warning This class is not threadsafe.
 */
 class BufHashTbl
@@ -55,13 +59,49 @@ class BufHashTbl
   hashBucket**  ht;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * Size of the hash table being moved to by a resize, or 0 if none is in progress
+	 */
+  int newHTSIZE;
+
+	/**
+	 * Hash table being moved to by a resize
+	 */
+  hashBucket**  newHt;
+
+	/**
+	 * Number of buckets of ht moved to newHt so far
+	 */
+  int rehashIndex;
+
+	/**
+	 * Number of buckets of ht moved to newHt by each call made during a resize
+	 */
+  static const int REHASH_STEP = 4;
+
+	/**
+	 * returns hash value between 0 and size-1 computed using file and pageNo
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
+	 * @param size  	Size of the hash table
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  static int hash(const File* file, const PageId pageNo, const int size);
+
+	/**
+	 * Returns the bucket chain that holds (file, pageNo), or would hold it once inserted.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  hashBucket*& chain(const File* file, const PageId pageNo);
+
+	/**
+	 * Moves up to a number of buckets of ht to newHt, and ends the resize once all of them have moved.
+	 *
+	 * @param numBuckets	Number of buckets to move
+	 */
+  void rehash(int numBuckets);
 
  public:
 	/**
@@ -104,6 +144,14 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Starts resizing the hash table. The entries move over to the new size a few buckets at a time, in the calls
+   * that follow; a resize still in progress is finished first.
+	 *
+	 * @param htSize  New size of the hash table
+	 */
+  void resize(const int htSize);
 };
 
 }
@@ -0,0 +1,216 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "buf_metrics.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+std::uint64_t Histogram::percentile(double fraction) const
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+	std::uint64_t rank = (std::uint64_t)std::ceil(fraction * count);
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+	std::uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+		{
+			const std::uint64_t bound = i == 0 ? 0 : (i == 64 ? UINT64_MAX : (1ULL << i) - 1);
+			return bound < max ? bound : max;
+		}
+	}
+	return max;
+}
+
+void Histogram::clear()
+{
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		buckets[i] = 0;
+	}
+	count = sum = max = 0;
+}
+
+void BufMetrics::clear()
+{
+	hits = misses = cleanEvictions = dirtyEvictions = 0;
+	sweepLength.clear();
+	pinWaitNanos.clear();
+	files.clear();
+	hotPages.clear();
+}
+
+// Writes a histogram as count, mean, median, 99th percentile and maximum
+static void writeHistogramText(std::ostream& out, const Histogram& histogram)
+{
+	out << "count=" << histogram.count << " mean=" << histogram.mean() << " p50=" << histogram.percentile(0.5)
+		<< " p99=" << histogram.percentile(0.99) << " max=" << histogram.max << "\n";
+}
+
+static void writeHistogramJson(std::ostream& out, const Histogram& histogram)
+{
+	out << "{\"count\": " << histogram.count << ", \"mean\": " << histogram.mean() << ", \"p50\": "
+		<< histogram.percentile(0.5) << ", \"p99\": " << histogram.percentile(0.99) << ", \"max\": " << histogram.max
+		<< "}";
+}
+
+// Writes a string as a JSON string, quoted and escaped
+static void writeJsonString(std::ostream& out, const std::string& value)
+{
+	out << '"';
+	for (size_t i = 0; i < value.size(); i++)
+	{
+		const unsigned char c = value[i];
+		if (c == '"' || c == '\\')
+		{
+			out << '\\' << c;
+		}
+		else if (c < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		}
+		else
+		{
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+void BufMetrics::writeText(std::ostream& out) const
+{
+	out << "hits " << hits << "\n";
+	out << "misses " << misses << "\n";
+	out << "hit_ratio " << hitRatio() << "\n";
+	out << "evictions_clean " << cleanEvictions << "\n";
+	out << "evictions_dirty " << dirtyEvictions << "\n";
+	out << "sweep_length ";
+	writeHistogramText(out, sweepLength);
+	out << "pin_wait_ns ";
+	writeHistogramText(out, pinWaitNanos);
+	for (std::map<std::string, FileIoMetrics>::const_iterator it = files.begin(); it != files.end(); ++it)
+	{
+		out << "file " << it->first << " read_ns ";
+		writeHistogramText(out, it->second.readNanos);
+		out << "file " << it->first << " write_ns ";
+		writeHistogramText(out, it->second.writeNanos);
+	}
+	for (size_t i = 0; i < hotPages.size(); i++)
+	{
+		out << "hot_page " << hotPages[i].filename << " " << hotPages[i].pageNo << " " << hotPages[i].accesses << "\n";
+	}
+}
+
+void BufMetrics::writeJson(std::ostream& out) const
+{
+	out << "{\"hits\": " << hits << ", \"misses\": " << misses << ", \"hit_ratio\": " << hitRatio()
+		<< ", \"evictions_clean\": " << cleanEvictions << ", \"evictions_dirty\": " << dirtyEvictions;
+	out << ", \"sweep_length\": ";
+	writeHistogramJson(out, sweepLength);
+	out << ", \"pin_wait_ns\": ";
+	writeHistogramJson(out, pinWaitNanos);
+	out << ", \"files\": {";
+	for (std::map<std::string, FileIoMetrics>::const_iterator it = files.begin(); it != files.end(); ++it)
+	{
+		if (it != files.begin())
+		{
+			out << ", ";
+		}
+		writeJsonString(out, it->first);
+		out << ": {\"read_ns\": ";
+		writeHistogramJson(out, it->second.readNanos);
+		out << ", \"write_ns\": ";
+		writeHistogramJson(out, it->second.writeNanos);
+		out << "}";
+	}
+	out << "}, \"hot_pages\": [";
+	for (size_t i = 0; i < hotPages.size(); i++)
+	{
+		if (i > 0)
+		{
+			out << ", ";
+		}
+		out << "{\"file\": ";
+		writeJsonString(out, hotPages[i].filename);
+		out << ", \"page\": " << hotPages[i].pageNo << ", \"accesses\": " << hotPages[i].accesses << "}";
+	}
+	out << "]}\n";
+}
+
+MetricsReporter::MetricsReporter(BufMgr* bufMgr, const std::string& path, std::chrono::milliseconds interval,
+	MetricsFormat format, std::size_t topK)
+	: bufMgr(bufMgr), path(path), interval(interval), format(format), topK(topK), stopping(false)
+{
+	thread = std::thread(&MetricsReporter::run, this);
+}
+
+MetricsReporter::~MetricsReporter()
+{
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		stopping = true;
+	}
+	wakeUp.notify_one();
+	thread.join();
+	write();
+}
+
+void MetricsReporter::run()
+{
+	std::unique_lock<std::mutex> guard(mutex);
+	while (!wakeUp.wait_for(guard, interval, [this] { return stopping; }))
+	{
+		guard.unlock();
+		write();
+		guard.lock();
+	}
+}
+
+void MetricsReporter::write()
+{
+	const BufMetrics metrics = bufMgr->getMetrics(topK);
+
+	// written beside the file and renamed over it, which replaces it at once
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath.c_str(), std::ios::out | std::ios::trunc);
+		if (format == METRICS_JSON)
+		{
+			metrics.writeJson(out);
+		}
+		else
+		{
+			metrics.writeText(out);
+		}
+		out.close();
+		if (!out)
+		{
+			std::cerr << "MetricsReporter: cannot write " << tempPath << std::endl;
+			return;
+		}
+	}
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+	{
+		std::cerr << "MetricsReporter: cannot rename " << tempPath << " to " << path << std::endl;
+	}
+}
+
+}
@@ -0,0 +1,291 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* forward declaration of BufMgr class
+*/
+class BufMgr;
+
+/**
+* @brief Distribution of a quantity, e.g. a latency, in buckets of powers of two.
+*
+* Bucket 0 counts the zeros and bucket i the values from 2^(i-1) to 2^i - 1, so adding a value is a few
+* instructions and the histogram has a fixed size, whatever the values.
+*/
+struct Histogram
+{
+	/**
+	 * Number of buckets, enough for any 64-bit value
+	 */
+	static const int BUCKETS = 65;
+
+	/**
+	 * Number of values in each bucket
+	 */
+	std::uint64_t buckets[BUCKETS];
+
+	/**
+	 * Number of values
+	 */
+	std::uint64_t count;
+
+	/**
+	 * Sum of the values
+	 */
+	std::uint64_t sum;
+
+	/**
+	 * Largest value
+	 */
+	std::uint64_t max;
+
+	/**
+	 * Adds a value.
+	 */
+	void add(std::uint64_t value)
+	{
+		buckets[value == 0 ? 0 : 64 - __builtin_clzll(value)]++;
+		count++;
+		sum += value;
+		if (value > max)
+		{
+			max = value;
+		}
+	}
+
+	/**
+	 * Returns the mean of the values, or 0 if there are none.
+	 */
+	double mean() const
+	{
+		return count == 0 ? 0 : (double)sum / count;
+	}
+
+	/**
+	 * Returns an upper bound of a percentile: the largest value of the bucket it falls in, or the largest value
+	 * added if that is smaller.
+	 *
+	 * @param fraction	Percentile as a fraction, e.g. 0.99
+	 */
+	std::uint64_t percentile(double fraction) const;
+
+	/**
+	 * Clear all values
+	 */
+	void clear();
+
+	/**
+	 * Constructor of Histogram class, empty
+	 */
+	Histogram()
+	{
+		clear();
+	}
+};
+
+/**
+* @brief Latencies of the page reads and writes of one file
+*/
+struct FileIoMetrics
+{
+	/**
+	 * Nanoseconds per page read from the file into a frame
+	 */
+	Histogram readNanos;
+
+	/**
+	 * Nanoseconds per page written from a frame to the file
+	 */
+	Histogram writeNanos;
+};
+
+/**
+* @brief A page in the buffer pool and how often it was accessed
+*/
+struct HotPage
+{
+	/**
+	 * Name of the file of the page
+	 */
+	std::string filename;
+
+	/**
+	 * Page number in the file
+	 */
+	PageId pageNo;
+
+	/**
+	 * Number of times the page was read or allocated since it came into the pool
+	 */
+	std::uint64_t accesses;
+};
+
+/**
+* @brief Counters and distributions of what a buffer manager does, to size pools and to catch regressions.
+*
+* The buffer manager updates them under the mutex that each of its calls holds anyway, so keeping them costs a few
+* increments per call and a clock read per page read or written. BufMgr::getMetrics() returns a copy.
+*/
+struct BufMetrics
+{
+	/**
+	 * Number of page reads that found the page in the pool
+	 */
+	std::uint64_t hits;
+
+	/**
+	 * Number of page reads that read the page from its file
+	 */
+	std::uint64_t misses;
+
+	/**
+	 * Number of pages evicted that were not dirty
+	 */
+	std::uint64_t cleanEvictions;
+
+	/**
+	 * Number of pages evicted that were written first
+	 */
+	std::uint64_t dirtyEvictions;
+
+	/**
+	 * Number of frames the clock looked at per frame allocated, 0 for a frame that held no page
+	 */
+	Histogram sweepLength;
+
+	/**
+	 * Nanoseconds that a read or allocation of a page waited for another thread's call to finish
+	 */
+	Histogram pinWaitNanos;
+
+	/**
+	 * Read and write latencies by file name
+	 */
+	std::map<std::string, FileIoMetrics> files;
+
+	/**
+	 * Most accessed pages in the pool, most accessed first. Only filled in a copy returned by BufMgr::getMetrics().
+	 */
+	std::vector<HotPage> hotPages;
+
+	/**
+	 * Returns the fraction of page reads that were hits, or 0 if there were none.
+	 */
+	double hitRatio() const
+	{
+		return hits + misses == 0 ? 0 : (double)hits / (hits + misses);
+	}
+
+	/**
+	 * Writes the metrics as text, one per line.
+	 *
+	 * @param out		Stream to write to
+	 */
+	void writeText(std::ostream& out) const;
+
+	/**
+	 * Writes the metrics as a JSON object.
+	 *
+	 * @param out		Stream to write to
+	 */
+	void writeJson(std::ostream& out) const;
+
+	/**
+	 * Clear all values
+	 */
+	void clear();
+
+	/**
+	 * Constructor of BufMetrics class, empty
+	 */
+	BufMetrics()
+	{
+		clear();
+	}
+};
+
+/**
+* Format in which a MetricsReporter writes the metrics
+*/
+enum MetricsFormat
+{
+	METRICS_TEXT,
+	METRICS_JSON
+};
+
+/**
+* @brief Thread that writes the metrics of a buffer manager to a file at an interval.
+*
+* Each time the file is replaced whole, so that whatever reads it never sees half of it. The last metrics are
+* written once more when the reporter is destroyed, which must happen before the buffer manager is.
+*/
+class MetricsReporter
+{
+ public:
+	/**
+	 * Starts the thread.
+	 *
+	 * @param bufMgr		Buffer manager whose metrics are written
+	 * @param path			File to write them to
+	 * @param interval	Time between two writes
+	 * @param format		Format of the file
+	 * @param topK			Number of the most accessed pages to write
+	 */
+	MetricsReporter(BufMgr* bufMgr, const std::string& path, std::chrono::milliseconds interval,
+		MetricsFormat format = METRICS_TEXT, std::size_t topK = 10);
+
+	/**
+	 * Stops the thread, and writes the metrics one last time.
+	 */
+	~MetricsReporter();
+
+ private:
+	MetricsReporter(const MetricsReporter&);
+	MetricsReporter& operator=(const MetricsReporter&);
+
+	/**
+	 * Body of the thread
+	 */
+	void run();
+
+	/**
+	 * Writes the metrics to the file.
+	 */
+	void write();
+
+	BufMgr* bufMgr;
+	std::string path;
+	std::chrono::milliseconds interval;
+	MetricsFormat format;
+	std::size_t topK;
+
+	/**
+	 * Guards stopping, with which the thread is woken up to stop
+	 */
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping;
+
+	std::thread thread;
+};
+
+}
@@ -0,0 +1,76 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "buf_pools.h"
+#include "exceptions/pool_exists_exception.h"
+#include "exceptions/pool_not_found_exception.h"
+
+namespace badgerdb {
+
+const std::string BufPools::DEFAULT = "default";
+
+BufPools::BufPools()
+{
+}
+
+BufPools::~BufPools()
+{
+	for (std::map<std::string, BufMgr*>::iterator it = pools.begin(); it != pools.end(); ++it)
+	{
+		delete it->second;
+	}
+}
+
+BufMgr* BufPools::create(const std::string& name, std::uint32_t bufs, ReplacementPolicy policy, WriteAheadLog* log)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	if (pools.find(name) != pools.end())
+	{
+		throw PoolExistsException(name);
+	}
+	BufMgr* pool = new BufMgr(bufs, log);
+	pool->setReplacementPolicy(policy);
+	pools[name] = pool;
+	return pool;
+}
+
+BufMgr* BufPools::get(const std::string& name) const
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	std::map<std::string, BufMgr*>::const_iterator it = pools.find(name);
+	if (it == pools.end())
+	{
+		throw PoolNotFoundException(name);
+	}
+	return it->second;
+}
+
+void BufPools::assign(const std::string& filename, const std::string& name)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	if (pools.find(name) == pools.end())
+	{
+		throw PoolNotFoundException(name);
+	}
+	assignments[filename] = name;
+}
+
+BufMgr* BufPools::poolFor(const std::string& filename) const
+{
+	std::string name = DEFAULT;
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		std::map<std::string, std::string>::const_iterator it = assignments.find(filename);
+		if (it != assignments.end())
+		{
+			name = it->second;
+		}
+	}
+	return get(name);
+}
+
+}
@@ -0,0 +1,101 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+* @brief Named buffer pools, and the pool that each file's pages go to.
+*
+* Each pool is a BufMgr of its own, with its own size and replacement policy, so that e.g. a large scan of a heap
+* file does not evict the pages of an index that are read over and over. A file is assigned to a pool by name;
+* the files not assigned to any go to the pool named DEFAULT. A page must always be read through the same pool, so
+* a file is assigned before it is first read and not moved while it has pages buffered.
+*/
+class BufPools
+{
+ public:
+	/**
+	 * Name of the pool that files not assigned to a pool go to
+	 */
+	static const std::string DEFAULT;
+
+	/**
+	 * Constructor of BufPools class, with no pools
+	 */
+	BufPools();
+
+	/**
+	 * Destroys every pool, writing out their dirty pages. The files and indexes using them must be closed first.
+	 */
+	~BufPools();
+
+	/**
+	 * Creates a pool.
+	 *
+	 * @param name		Name of the pool
+	 * @param bufs		Number of frames in the pool
+	 * @param policy	Policy by which the pool picks the frames to evict
+	 * @param log			Log of the page changes of the pool, or NULL not to log them
+	 * @return The buffer manager of the pool.
+	 * @throws  PoolExistsException If there is a pool by that name already
+	 */
+	BufMgr* create(const std::string& name, std::uint32_t bufs, ReplacementPolicy policy = REPLACE_CLOCK,
+		WriteAheadLog* log = NULL);
+
+	/**
+	 * Returns a pool by name.
+	 *
+	 * @param name		Name of the pool
+	 * @throws  PoolNotFoundException If there is no pool by that name
+	 */
+	BufMgr* get(const std::string& name) const;
+
+	/**
+	 * Assigns a file to a pool, in which its pages are buffered from then on.
+	 *
+	 * @param filename	Name of the file
+	 * @param name			Name of the pool
+	 * @throws  PoolNotFoundException If there is no pool by that name
+	 */
+	void assign(const std::string& filename, const std::string& name);
+
+	/**
+	 * Returns the pool a file is assigned to, or the DEFAULT pool for a file that is not assigned.
+	 *
+	 * @param filename	Name of the file
+	 * @throws  PoolNotFoundException If the file is not assigned and there is no DEFAULT pool
+	 */
+	BufMgr* poolFor(const std::string& filename) const;
+
+ private:
+	BufPools(const BufPools&);
+	BufPools& operator=(const BufPools&);
+
+	/**
+	 * Pools by name
+	 */
+	std::map<std::string, BufMgr*> pools;
+
+	/**
+	 * Pool name of each assigned file
+	 */
+	std::map<std::string, std::string> assignments;
+
+	/**
+	 * Serializes changes to the pools and assignments with the threads looking them up
+	 */
+	mutable std::mutex mutex;
+};
+
+}
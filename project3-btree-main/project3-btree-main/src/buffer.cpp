@@ -5,121 +5,236 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <iostream>
 #include "buffer.h"
+#include "exceptions/badgerdb_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/corrupt_page_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/log_io_exception.h"
+#include "exceptions/read_only_file_exception.h"
 
 namespace badgerdb { 
 
+const FrameId CandidateRing::NO_FRAME;
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+// Returns the size of the hash table for a pool of bufs frames
+static int hashTableSize(std::uint32_t bufs)
+{
+  return ((((int) (bufs * 1.2))*2)/2)+1;
+}
+
+// Returns the nanoseconds since a time
+static std::uint64_t nanosSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
 
-  for (FrameId i = 0; i < bufs; i++) 
+BufMgr::BufMgr(std::uint32_t bufs, WriteAheadLog* log, int poolFlags)
+	: policy(REPLACE_CLOCK), numBufs(bufs), usedBufs(bufs), maxBufs(bufs > RESERVED_FRAMES ? bufs : RESERVED_FRAMES),
+	  log(log), loggedPool(NULL), operationDepth(0), tracer(NULL) {
+  // the frames come first, at a huge page boundary, then the logged images, the frame states and the descriptors,
+  // each with room for maxBufs frames so that the pool can grow in place. If the kernel will not map that much, the
+  // pool cannot grow beyond its first size.
+  for (;;)
   {
-  	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
+    try
+    {
+      poolMemory = new PoolMemory(std::size_t(maxBufs) * ((log != NULL ? 2 : 1) * sizeof(Page) + sizeof(FrameState)
+        + sizeof(BufDesc)), poolFlags);
+      break;
+    }
+    catch(const std::bad_alloc &e)
+    {
+      if (maxBufs == bufs)
+      {
+        throw;
+      }
+      maxBufs = bufs;
+    }
   }
+  char* memory = static_cast<char*>(poolMemory->address());
+  bufPool = reinterpret_cast<Page*>(memory);
+  memory += std::size_t(maxBufs) * sizeof(Page);
+  if (log != NULL)
+  {
+  	loggedPool = reinterpret_cast<Page*>(memory);
+  	memory += std::size_t(maxBufs) * sizeof(Page);
+  }
+  frameStates = reinterpret_cast<FrameState*>(memory);
+  memory += std::size_t(maxBufs) * sizeof(FrameState);
+  bufDescTable = reinterpret_cast<BufDesc*>(memory);
 
-  bufPool = new Page[bufs];
+  addFrames(0, bufs);
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  hashTable = new BufHashTbl (hashTableSize(bufs));  // allocate the buffer hash table
+}
 
-  clockHand = bufs - 1;
+void BufMgr::addFrames(FrameId first, FrameId last)
+{
+  // every frame is overwritten whole when a page is read into it, so the frames are left as the kernel zero-filled
+  // them. The new frames go on the free stack highest first, so that the lowest is taken first.
+  candidates.reserve(last);
+  for (FrameId i = last; i-- > first; )
+  {
+  	freeFrames.push_back(i);
+  }
+  for (FrameId i = first; i < last; i++) 
+  {
+  	new (&bufPool[i]) Page(Page::Uninitialized());
+  	if (log != NULL)
+  	{
+  		new (&loggedPool[i]) Page(Page::Uninitialized());
+  	}
+  	new (&bufDescTable[i]) BufDesc();
+  	bufDescTable[i].frameNo = i;
+  	frameStates[i].Clear();
+  }
 }
 
 
 BufMgr::~BufMgr() {
+  delete tracer;
+
   //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+  bool logged = true;
+  if (log != NULL)
+  {
+  	// a destructor cannot throw; a page whose changes may not be in the log is not written, as after a crash
+  	try
+  	{
+  		checkpointLocked();
+  	}
+  	catch(const LogIoException &e)
+  	{
+  		std::cerr << e.message() << std::endl;
+  		logged = false;
+  	}
+  }
+  for (std::uint32_t i = 0; logged && i < usedBufs; i++) 
   {
   	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
+  	if (frameStates[i].valid == true && frameStates[i].dirty == true)
 		{
 			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
   	}
   }
 
 	delete hashTable;
-  delete [] bufDescTable;
-  delete [] bufPool;
+  delete poolMemory;
 }
 
 void BufMgr::allocBuf(FrameId & frame) 
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  // Called with the mutex held by readPage() and allocPage()
+  if (!freeFrames.empty())
+  {
+    metrics.sweepLength.add(0);
+    frame = freeFrames.back();
+    freeFrames.pop_back();
+    return;
+  }
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  // every frame holds a page that is pinned or changed by the operation in progress
+  if (candidates.empty())
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    metrics.sweepLength.add(0);
+    throw BufferExceededException();
+  }
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
-    {
-      break;
-    }
+  // a frame referenced since the clock last passed it gets a second chance, which FIFO does not give. Every frame
+  // of the ring can be evicted, so the clock stops at the latest one lap on, once it cleared all the refbits.
+  std::uint32_t numScanned = 1;
+  while (policy == REPLACE_CLOCK && frameStates[candidates.current()].refbit)
+  {
+    frameStates[candidates.current()].refbit = false;
+    candidates.advance();
+    numScanned++;
+  }
+  metrics.sweepLength.add(numScanned);
+  frame = candidates.current();
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
-    {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
-      {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
-      }
-    }
-    else
-    {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
-    }
+  // flush any existing changes to disk if necessary, before the page leaves the frame so that it stays if this throws
+  if (frameStates[frame].dirty)
+  {
+    metrics.dirtyEvictions++;
+    bufStats.diskwrites++;
+    writeFrame(frame);
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  else
   {
-    throw BufferExceededException();
+    metrics.cleanEvictions++;
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  // remove previous entry from hash table, and reset the frame before returning it
+  hashTable->remove(bufDescTable[frame].file, bufDescTable[frame].pageNo);
+  candidates.remove(frame);
+  clearFrame(frame);
+} // end allocBuf
+
+
+void BufMgr::freeFrame(FrameId frame)
+{
+  candidates.remove(frame);
+  clearFrame(frame);
+  if (frame < numBufs)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    freeFrames.push_back(frame);
   }
+}
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+void BufMgr::writeFrame(FrameId frame)
+{
+  // the log goes first, so that whatever reaches the file can be redone
+  if (log != NULL)
+  {
+    log->flush(bufDescTable[frame].lsn);
+  }
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bufDescTable[frame].file->writePage(bufDescTable[frame].pageNo, bufPool[frame]);
+  metrics.files[bufDescTable[frame].file->filename()].writeNanos.add(nanosSince(start));
+}
+
+
+void BufMgr::lockPool(std::unique_lock<std::mutex>& guard)
+{
+  // the clock is only read when another thread holds the mutex
+  if (guard.try_lock())
+  {
+    metrics.pinWaitNanos.add(0);
+    return;
+  }
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  guard.lock();
+  metrics.pinWaitNanos.add(nanosSince(start));
+}
 
 
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
+  // pages of a file mapped read-only are used where they are, without a frame
+  if (file->isMapped())
+  {
+    page = const_cast<Page*>(file->mappedPage(pageNo));
+    return;
+  }
+
+  std::unique_lock<std::mutex> guard(mutex, std::defer_lock);
+  lockPool(guard);
+  bufStats.accesses++;
+
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
@@ -128,9 +243,16 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
   	hashTable->lookup(file, pageNo, frameNo);
 
     // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
+    frameStates[frameNo].refbit = true;
+    frameStates[frameNo].pinCnt++;
+    candidates.remove(frameNo);
+    bufDescTable[frameNo].accesses++;
+    metrics.hits++;
     page = &bufPool[frameNo];
+    if (tracer != NULL)
+    {
+      tracer->record(TRACE_READ, file->filename(), pageNo);
+    }
   }
   catch(const HashNotFoundException &e) //not in the buffer pool, must allocate a new page
   {
@@ -139,107 +261,590 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 
     // read the page into the new frame
     bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+    metrics.misses++;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try
+    {
+      try
+      {
+        file->readPageInto(pageNo, bufPool[frameNo]);
+      }
+      catch(const CorruptPageException &e)
+      {
+        // a page the log holds a whole image of is rebuilt from it and written back
+        if (log == NULL || File::getChecksumPolicy() != CHECKSUM_REPAIR || !log->repairPage(file, pageNo, bufPool[frameNo]))
+        {
+          throw;
+        }
+        file->writePage(pageNo, bufPool[frameNo]);
+      }
+    }
+    catch(...)
+    {
+      // the frame goes back on the free stack
+      freeFrames.push_back(frameNo);
+      throw;
+    }
+    metrics.files[file->filename()].readNanos.add(nanosSince(start));
+    if (log != NULL)
+    {
+      loggedPool[frameNo] = bufPool[frameNo];
+    }
 
     // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
+    setFrame(frameNo, file, pageNo);
     page = &bufPool[frameNo];
 
     // insert in the hash table
     hashTable->insert(file, pageNo, frameNo);
+    if (tracer != NULL)
+    {
+      tracer->record(TRACE_READ, file->filename(), pageNo);
+    }
   }
 }
 
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
+  if (file->isMapped())
+  {
+    if (dirty)
+    {
+      throw ReadOnlyFileException(file->filename());
+    }
+    return;
+  }
+
+  // a change made outside of an operation waits for the one in progress, and is then logged on its own
+  std::unique_lock<std::recursive_mutex> operation(operationMutex, std::defer_lock);
+  if (log != NULL && dirty)
+  {
+    operation.lock();
+  }
+  std::lock_guard<std::mutex> guard(mutex);
+
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  if (dirty == true) frameStates[frameNo].dirty = dirty;
+  if (log != NULL && dirty && !frameStates[frameNo].changed)
+  {
+    frameStates[frameNo].changed = true;
+    changedFrames.push_back(frameNo);
+  }
 
   // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  if (frameStates[frameNo].pinCnt == 0)
   {
   	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
   }
-  else bufDescTable[frameNo].pinCnt--;
+  else frameStates[frameNo].pinCnt--;
+  if (tracer != NULL)
+  {
+    tracer->record(TRACE_UNPIN, file->filename(), pageNo, dirty ? TRACE_DIRTY : 0);
+  }
+
+  // a page disposed of while pinned goes once nobody uses it any more
+  if (bufDescTable[frameNo].disposed && frameStates[frameNo].pinCnt == 0)
+  {
+    freeFrame(frameNo);
+    hashTable->remove(file, pageNo);
+    // with a log, the operation that disposed of the page deletes it once it is logged
+    if (log == NULL)
+    {
+      file->deletePage(pageNo);
+    }
+  }
+  else
+  {
+    updateCandidate(frameNo);
+  }
+
+  if (log != NULL && dirty && operationDepth == 0)
+  {
+    commitOperation();
+  }
+  if (usedBufs > numBufs)
+  {
+    releaseRetired();
+  }
 }
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  std::unique_lock<std::mutex> guard(mutex, std::defer_lock);
+  lockPool(guard);
+  bufStats.accesses++;
+
   FrameId frameNo;
 
   // alloc a new frame
   allocBuf(frameNo);
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  // allocate a new page in the file, straight into the frame
+  try
+  {
+    file->allocatePageInto(pageNo, bufPool[frameNo]);
+  }
+  catch(...)
+  {
+    freeFrames.push_back(frameNo);
+    throw;
+  }
+
+  // a reader that raced with the disposal of a page may have read it back in, and may still have it pinned.
+  // The new page takes over that frame, and the frame just allocated goes back on the free stack.
+  FrameId bufferedFrameNo;
+  try
+  {
+    hashTable->lookup(file, pageNo, bufferedFrameNo);
+    bufPool[bufferedFrameNo] = bufPool[frameNo];
+    freeFrames.push_back(frameNo);
+    frameNo = bufferedFrameNo;
+    bufDescTable[frameNo].disposed = false;
+    frameStates[frameNo].pinCnt++;
+    frameStates[frameNo].refbit = true;
+    candidates.remove(frameNo);
+    bufDescTable[frameNo].accesses++;
+  }
+  catch(const HashNotFoundException &e)
+  {
+    // set up the entry properly
+    setFrame(frameNo, file, pageNo);
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+    // insert in the hash table
+    hashTable->insert(file, pageNo, frameNo);
+  }
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+  if (log != NULL)
+  {
+    loggedPool[frameNo] = bufPool[frameNo];
+  }
+  page = &bufPool[frameNo];
+  if (tracer != NULL)
+  {
+    tracer->record(TRACE_ALLOC, file->filename(), pageNo);
+  }
 }
 
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
+  std::lock_guard<std::mutex> guard(mutex);
+
+  for (std::uint32_t i = 0; i < usedBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
+  	FrameState* state = &(frameStates[i]);
+  	if(tmpbuf->file && state->valid == true && tmpbuf->file == file)
 		{
-	    if (tmpbuf->pinCnt > 0)
+	    // a page changed by the operation in progress counts as pinned until the operation ends
+	    if (state->pinCnt > 0 || state->changed)
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
 
-	    if (tmpbuf->dirty == true)
+	    if (state->dirty == true)
 			{
 				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
+				writeFrame(i);
+				state->dirty = false;
     	}
 
     	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
+    	freeFrame(i);
   	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+		else if (state->valid == false && tmpbuf->file == file)
+  		throw BadBufferException(tmpbuf->frameNo, state->dirty, state->valid, state->refbit);
   }
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo)
 {
+  if (file->isMapped())
+  {
+    throw ReadOnlyFileException(file->filename());
+  }
+
+  std::unique_lock<std::recursive_mutex> operation(operationMutex, std::defer_lock);
+  if (log != NULL)
+  {
+    operation.lock();
+  }
+  std::lock_guard<std::mutex> guard(mutex);
+
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  bool pinned = false;
+	try
+	{
+		hashTable->lookup(file, pageNo, frameNo);
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+		// other threads may still be reading the page; the last unPinPage() disposes of it
+		if (frameStates[frameNo].pinCnt > 0)
+		{
+			bufDescTable[frameNo].disposed = true;
+			pinned = true;
+		}
+		else
+		{
+			// clear the page
+			freeFrame(frameNo);
+
+			hashTable->remove(file, pageNo);
+		}
+	}
+	catch(const HashNotFoundException &e)
+	{
+		// not buffered, only the file needs to know
+	}
+  if (tracer != NULL)
+  {
+    tracer->record(TRACE_DISPOSE, file->filename(), pageNo);
+  }
 
-	hashTable->remove(file, pageNo);
+  // with a log, the page stays in the file until the operation disposing of it is logged; a crash before that
+  // leaves the page in use, as the operation is not redone
+  if (log != NULL)
+  {
+    disposedPages.push_back(std::make_pair(file, pageNo));
+    if (operationDepth == 0)
+    {
+      commitOperation();
+    }
+    return;
+  }
 
   // deallocate it in the file	
-  file->deletePage(pageNo);
+  if (!pinned)
+  {
+    file->deletePage(pageNo);
+  }
+}
+
+void BufMgr::resize(std::uint32_t bufs)
+{
+  if (bufs == 0 || bufs > maxBufs)
+  {
+    throw BufferExceededException();
+  }
+
+  // with a log, no page is changed by an operation in progress while the operation mutex is held
+  std::unique_lock<std::recursive_mutex> operation(operationMutex, std::defer_lock);
+  if (log != NULL)
+  {
+    operation.lock();
+  }
+  std::lock_guard<std::mutex> guard(mutex);
+
+  if (bufs >= numBufs)
+  {
+    // frames beyond usedBufs are new; those before it that a shrink left rejoin the pool as they are, on the free
+    // stack if empty and in the ring if their page could be evicted
+    const std::uint32_t oldNumBufs = numBufs;
+    const std::uint32_t retiredEnd = std::min(usedBufs, bufs);
+    addFrames(std::max(usedBufs, numBufs), std::max(usedBufs, bufs));
+    numBufs = bufs;
+    usedBufs = std::max(usedBufs, bufs);
+    for (FrameId i = retiredEnd; i-- > oldNumBufs; )
+    {
+      if (!frameStates[i].valid)
+      {
+        freeFrames.push_back(i);
+      }
+    }
+    for (FrameId i = oldNumBufs; i < retiredEnd; i++)
+    {
+      if (frameStates[i].valid)
+      {
+        updateCandidate(i);
+      }
+    }
+  }
+  else
+  {
+    const std::uint32_t oldUsedBufs = usedBufs;
+    numBufs = bufs;
+
+    // the frames beyond the new size leave the free stack and the ring, and the clock hand with them
+    const std::uint32_t newNumBufs = numBufs;
+    freeFrames.erase(std::remove_if(freeFrames.begin(), freeFrames.end(),
+      [newNumBufs](FrameId frame) { return frame >= newNumBufs; }), freeFrames.end());
+    for (FrameId i = numBufs; i < oldUsedBufs; i++)
+    {
+      candidates.remove(i);
+    }
+
+    // evict what can be, and give back the memory of the empty frames a run at a time
+    FrameId runStart = numBufs;
+    for (FrameId i = numBufs; i <= oldUsedBufs; i++)
+    {
+      if (i < oldUsedBufs && evictRetired(i))
+      {
+        continue;
+      }
+      if (i > runStart)
+      {
+        poolMemory->release(&bufPool[runStart], (i - runStart) * sizeof(Page));
+        if (log != NULL)
+        {
+          poolMemory->release(&loggedPool[runStart], (i - runStart) * sizeof(Page));
+        }
+      }
+      runStart = i + 1;
+    }
+    while (usedBufs > numBufs && !frameStates[usedBufs - 1].valid)
+    {
+      usedBufs--;
+    }
+  }
+
+  hashTable->resize(hashTableSize(numBufs));
+}
+
+bool BufMgr::evictRetired(FrameId frame)
+{
+  FrameState& state = frameStates[frame];
+  if (!state.valid)
+  {
+    return true;
+  }
+  if (state.pinCnt > 0 || state.changed)
+  {
+    return false;
+  }
+  if (state.dirty)
+  {
+    metrics.dirtyEvictions++;
+    bufStats.diskwrites++;
+    writeFrame(frame);
+  }
+  else
+  {
+    metrics.cleanEvictions++;
+  }
+  hashTable->remove(bufDescTable[frame].file, bufDescTable[frame].pageNo);
+  clearFrame(frame);
+  return true;
+}
+
+void BufMgr::releaseRetired()
+{
+  for (FrameId i = numBufs; i < usedBufs; i++)
+  {
+    if (frameStates[i].valid && evictRetired(i))
+    {
+      poolMemory->release(&bufPool[i], sizeof(Page));
+      if (log != NULL)
+      {
+        poolMemory->release(&loggedPool[i], sizeof(Page));
+      }
+    }
+  }
+  while (usedBufs > numBufs && !frameStates[usedBufs - 1].valid)
+  {
+    usedBufs--;
+  }
+}
+
+void BufMgr::beginOperation()
+{
+  if (log == NULL)
+  {
+    return;
+  }
+  operationMutex.lock();
+  std::lock_guard<std::mutex> guard(mutex);
+  operationDepth++;
+}
+
+void BufMgr::endOperation()
+{
+  if (log == NULL)
+  {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> operation(operationMutex, std::adopt_lock);
+  std::lock_guard<std::mutex> guard(mutex);
+  if (--operationDepth == 0)
+  {
+    commitOperation();
+    if (usedBufs > numBufs)
+    {
+      releaseRetired();
+    }
+  }
+}
+
+void BufMgr::commitOperation()
+{
+  bool logged = !disposedPages.empty();
+  for (size_t i = 0; i < changedFrames.size(); i++)
+  {
+    BufDesc& desc = bufDescTable[changedFrames[i]];
+    if (!frameStates[changedFrames[i]].changed)
+    {
+      // disposed of since
+      continue;
+    }
+    frameStates[changedFrames[i]].changed = false;
+    updateCandidate(changedFrames[i]);
+    const std::uint64_t lsn = log->logPage(desc.file, desc.pageNo, loggedPool[desc.frameNo], bufPool[desc.frameNo]);
+    if (lsn != 0)
+    {
+      desc.lsn = lsn;
+      logged = true;
+    }
+  }
+  changedFrames.clear();
+  for (size_t i = 0; i < disposedPages.size(); i++)
+  {
+    log->logDispose(disposedPages[i].first, disposedPages[i].second);
+  }
+  if (!logged)
+  {
+    return;
+  }
+  const std::uint64_t lsn = log->commit();
+
+  // a page is deleted only once its deletion is sure to be redone
+  if (!disposedPages.empty())
+  {
+    log->flush(lsn);
+    for (size_t i = 0; i < disposedPages.size(); i++)
+    {
+      disposedPages[i].first->deletePage(disposedPages[i].second);
+    }
+    disposedPages.clear();
+  }
+
+  if (log->needsCheckpoint())
+  {
+    checkpointLocked();
+  }
+}
+
+void BufMgr::checkpoint()
+{
+  if (log == NULL)
+  {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> operation(operationMutex);
+  std::lock_guard<std::mutex> guard(mutex);
+  checkpointLocked();
+}
+
+void BufMgr::checkpointLocked()
+{
+  // pages still pinned are written too: whatever they hold was logged, and the log is about to be emptied
+  log->flush(UINT64_MAX);
+  for (std::uint32_t i = 0; i < usedBufs; i++)
+  {
+    BufDesc* tmpbuf = &(bufDescTable[i]);
+    if (frameStates[i].valid == true && frameStates[i].dirty == true)
+    {
+      bufStats.diskwrites++;
+      writeFrame(i);
+      frameStates[i].dirty = false;
+    }
+    tmpbuf->lsn = 0;
+  }
+  log->checkpoint();
+}
+
+void BufMgr::startTrace(const std::string& path, std::size_t capacity)
+{
+  // the trace in progress is ended before the new one replaces its file, which may be the same
+  stopTrace();
+  PageTracer* started = new PageTracer(path, capacity);
+  PageTracer* stopped;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stopped = tracer;
+    tracer = started;
+  }
+  // only if another thread started a trace meanwhile
+  delete stopped;
+}
+
+void BufMgr::stopTrace()
+{
+  PageTracer* stopped;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stopped = tracer;
+    tracer = NULL;
+  }
+  // the tracer writes out what is left without the mutex held
+  delete stopped;
+}
+
+BufMetrics BufMgr::getMetrics(std::size_t topK)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  BufMetrics snapshot = metrics;
+  std::vector< std::pair<std::uint64_t, FrameId> > accessed;
+  for (FrameId i = 0; i < usedBufs; i++)
+  {
+    if (frameStates[i].valid && bufDescTable[i].accesses > 0)
+    {
+      accessed.push_back(std::make_pair(bufDescTable[i].accesses, i));
+    }
+  }
+  const std::size_t numHot = std::min(topK, accessed.size());
+  std::partial_sort(accessed.begin(), accessed.begin() + numHot, accessed.end(),
+    std::greater< std::pair<std::uint64_t, FrameId> >());
+  for (std::size_t i = 0; i < numHot; i++)
+  {
+    const BufDesc& desc = bufDescTable[accessed[i].second];
+    HotPage hot;
+    hot.filename = desc.file->filename();
+    hot.pageNo = desc.pageNo;
+    hot.accesses = desc.accesses;
+    snapshot.hotPages.push_back(hot);
+  }
+  return snapshot;
+}
+
+void BufMgr::clearMetrics()
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  metrics.clear();
+  for (FrameId i = 0; i < usedBufs; i++)
+  {
+    bufDescTable[i].accesses = 0;
+  }
+}
+
+BufOperation::~BufOperation()
+{
+  try
+  {
+    bufMgr->endOperation();
+  }
+  catch(const BadgerDbException &e)
+  {
+    std::cerr << "BufOperation: " << e.message() << std::endl;
+  }
 }
 
 void BufMgr::printSelf(void) 
 {
+  std::lock_guard<std::mutex> guard(mutex);
+
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
-  for (std::uint32_t i = 0; i < numBufs; i++)
+  for (std::uint32_t i = 0; i < usedBufs; i++)
 	{
   	tmpbuf = &(bufDescTable[i]);
 		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+		tmpbuf->Print(frameStates[i]);
 
-  	if (tmpbuf->valid == true)
+  	if (frameStates[i].valid == true)
     	validFrames++;
   }
 
@@ -9,7 +9,14 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "buf_metrics.h"
+#include "page_latch.h"
+#include "page_trace.h"
+#include "pool_memory.h"
+#include "wal.h"
 #include <iostream>
+#include <mutex>
+#include <vector>
 
 namespace badgerdb {
 
@@ -18,6 +25,200 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+* @brief State of a buffer pool frame that the clock sweep looks at.
+*
+* The states of all frames are kept in an array of their own, apart from the rest of their BufDesc, so that the sweep
+* reads eight frames per cache line.
+*/
+struct FrameState {
+	/**
+   * Number of times this page has been pinned
+	 */
+  std::int32_t pinCnt;
+
+	/**
+   * True if page is valid
+	 */
+  bool valid;
+
+	/**
+   * Has this buffer frame been reference recently
+	 */
+  bool refbit;
+
+	/**
+   * True if page is dirty;  false otherwise
+	 */
+  bool dirty;
+
+	/**
+   * True if the page was changed by the operation in progress, which is not logged yet. Such a page is not evicted.
+	 */
+  bool changed;
+
+	/**
+   * Initialize the state for a new user
+	 */
+  void Clear()
+	{
+    pinCnt = 0;
+		valid = false;
+    refbit = false;
+    dirty = false;
+		changed = false;
+  }
+
+	/**
+   * Set the state of a frame newly assigned to a page, which is pinned once
+	 */
+  void Set()
+	{
+    pinCnt = 1;
+    valid = true;
+    refbit = true;
+    dirty = false;
+    changed = false;
+  }
+};
+
+/**
+* @brief Ring of the frames a clock may evict, with the clock hand on it.
+*
+* A frame joins just behind the hand, so that the clock looks at it last, and leaves when it is pinned or stops
+* holding a page. The clock then never looks at a frame it could not evict, and finds out at once when there is
+* none. BufMgr and ReplaySimulator share it, so that they pick the same frames.
+*/
+class CandidateRing
+{
+ public:
+	/**
+	 * Frame number of no frame: the links of a frame not in the ring, and the hand of an empty ring
+	 */
+	static const FrameId NO_FRAME = UINT32_MAX;
+
+	/**
+	 * Constructor of CandidateRing class, empty and with room for no frames
+	 */
+	CandidateRing()
+		: hand(NO_FRAME), count(0)
+	{
+	}
+
+	/**
+	 * Makes room for the frames below a number, none of which joins the ring.
+	 *
+	 * @param frames	Number of frames
+	 */
+	void reserve(FrameId frames)
+	{
+		if (frames > next.size())
+		{
+			next.resize(frames, NO_FRAME);
+			prev.resize(frames, NO_FRAME);
+		}
+	}
+
+	/**
+	 * Tells whether a frame is in the ring.
+	 */
+	bool contains(FrameId frame) const
+	{
+		return next[frame] != NO_FRAME;
+	}
+
+	/**
+	 * Tells whether the ring has no frames.
+	 */
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	/**
+	 * Returns the frame under the hand. The ring must not be empty.
+	 */
+	FrameId current() const
+	{
+		return hand;
+	}
+
+	/**
+	 * Moves the hand to the next frame of the ring.
+	 */
+	void advance()
+	{
+		hand = next[hand];
+	}
+
+	/**
+	 * Adds a frame just behind the hand. A frame already in the ring stays where it is.
+	 */
+	void add(FrameId frame)
+	{
+		if (contains(frame))
+		{
+			return;
+		}
+		if (hand == NO_FRAME)
+		{
+			next[frame] = prev[frame] = hand = frame;
+		}
+		else
+		{
+			next[frame] = hand;
+			prev[frame] = prev[hand];
+			next[prev[hand]] = frame;
+			prev[hand] = frame;
+		}
+		count++;
+	}
+
+	/**
+	 * Takes a frame out of the ring; the hand moves on to the next frame if it was on it. A frame not in the ring is
+	 * ignored.
+	 */
+	void remove(FrameId frame)
+	{
+		if (!contains(frame))
+		{
+			return;
+		}
+		if (--count == 0)
+		{
+			hand = NO_FRAME;
+		}
+		else
+		{
+			if (hand == frame)
+			{
+				hand = next[frame];
+			}
+			next[prev[frame]] = next[frame];
+			prev[next[frame]] = prev[frame];
+		}
+		next[frame] = prev[frame] = NO_FRAME;
+	}
+
+ private:
+	/**
+	 * Next and previous frame of each frame in the ring, NO_FRAME for the others. They are in arrays of their own,
+	 * as the clock only follows the next ones.
+	 */
+	std::vector<FrameId> next;
+	std::vector<FrameId> prev;
+
+	/**
+	 * Frame under the hand, the one the clock looks at first
+	 */
+	FrameId hand;
+
+	/**
+	 * Number of frames in the ring
+	 */
+	std::uint32_t count;
+};
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
@@ -42,41 +243,41 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * True if the page was disposed of while pinned. It leaves the buffer pool and the file once the last pin is released.
 	 */
-  int pinCnt;
+  bool disposed;
 
 	/**
-   * True if page is dirty;  false otherwise
+   * Log sequence number of the last log record of the page. The log is forced up to it before the page is written.
 	 */
-  bool dirty;
+  std::uint64_t lsn;
 
 	/**
-   * True if page is valid
+   * Number of times the page was read or allocated since it came into the frame
 	 */
-  bool valid;
+  std::uint64_t accesses;
 
 	/**
-   * Has this buffer frame been reference recently
+   * Optimistic latch of the page held by this frame
 	 */
-  bool refbit;
+  PageLatch latch;
 
 	/**
-   * Initialize buffer frame for a new user
+   * Initialize buffer frame for a new user. The frame's FrameState is cleared apart.
 	 */
   void Clear()
 	{
-    pinCnt = 0;
 		file = NULL;
 		pageNo = Page::INVALID_NUMBER;
-    dirty = false;
-    refbit = false;
-		valid = false;
+		disposed = false;
+		lsn = 0;
+		accesses = 0;
   };
 
 	/**
 	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame 
-	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
+	 * in buffer pool is allocated to any page in the file through readPage() or allocPage(). The frame's FrameState is
+	 * set apart.
 	 *
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
@@ -85,13 +286,13 @@ class BufDesc {
 	{ 
 		file = filePtr;
     pageNo = pageNum;
-    pinCnt = 1;
-    dirty = false;
-    valid = true;
-    refbit = true;
+    disposed = false;
+    lsn = 0;
+    accesses = 1;
+    latch.reset();
   }
 
-  void Print()
+  void Print(const FrameState& state)
 	{
 		if(file != NULL)
 		{
@@ -101,10 +302,10 @@ class BufDesc {
 		else
 			std::cout << "file:NULL ";
 
-		std::cout << "valid:" << valid << " ";
-		std::cout << "pinCnt:" << pinCnt << " ";
-		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "valid:" << state.valid << " ";
+		std::cout << "pinCnt:" << state.pinCnt << " ";
+		std::cout << "dirty:" << state.dirty << " ";
+		std::cout << "refbit:" << state.refbit << "\n";
   }
 
 	/**
@@ -123,7 +324,7 @@ class BufDesc {
 struct BufStats
 {
 	/**
-   * Total number of accesses to buffer pool
+   * Total number of accesses to buffer pool: pages read or allocated
 	 */
   int accesses;
 
@@ -155,6 +356,23 @@ struct BufStats
 };
 
 
+/**
+* Policy by which a buffer manager picks the frame to evict
+*/
+enum ReplacementPolicy
+{
+	/**
+	 * Clock: a frame referenced since the clock last passed it gets a second chance
+	 */
+	REPLACE_CLOCK,
+
+	/**
+	 * First in, first out: the clock takes the next unpinned frame, referenced or not. Suits a pool that mostly
+	 * serves one-pass scans, whose pages are not read again.
+	 */
+	REPLACE_FIFO
+};
+
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
 */
@@ -162,14 +380,37 @@ class BufMgr
 {
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Frames of the pool that hold no page, used as a stack. allocBuf() takes a frame from here before it runs the
+   * clock.
+	 */
+  std::vector<FrameId> freeFrames;
+
+	/**
+   * Ring of the frames the clock may evict: those of the pool holding a page that is neither pinned nor changed by
+   * the operation in progress. The clock hand runs over this ring only.
 	 */
-  FrameId clockHand;
+  CandidateRing candidates;
 
 	/**
-   * Number of frames in the buffer pool
+   * Policy by which allocBuf() picks the frame to evict
+	 */
+  ReplacementPolicy policy;
+
+	/**
+   * Number of frames in the buffer pool, which the clock sweeps
 	 */
   std::uint32_t numBufs;
+
+	/**
+   * Number of frames that may hold a page: numBufs, and beyond it the frames left by resize() that still hold a
+   * pinned page
+	 */
+  std::uint32_t usedBufs;
+
+	/**
+   * Number of frames that the memory of the pool has room for, which resize() can grow the pool to
+	 */
+  std::uint32_t maxBufs;
 	
 	/**
    * Hash table mapping (File, page) to frame
@@ -181,27 +422,180 @@ class BufMgr
 	 */
   BufDesc *bufDescTable;
 
+	/**
+   * State of every frame that the clock sweep looks at, in an array of its own
+	 */
+  FrameState *frameStates;
+
+	/**
+   * Memory of bufPool, loggedPool, frameStates and bufDescTable, each with room for maxBufs frames
+	 */
+  PoolMemory *poolMemory;
+
 	/**
    * Maintains Buffer pool usage statistics 
 	 */
   BufStats bufStats;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * Hits, misses, evictions and latencies, see getMetrics()
+	 */
+  BufMetrics metrics;
+
+	/**
+   * Serializes all calls into the buffer manager, so that it can be shared by threads
+	 */
+  std::mutex mutex;
+
+	/**
+   * Log of the page changes, or NULL if changes are not logged
+	 */
+  WriteAheadLog* log;
+
+	/**
+   * Last logged image of the page in each frame, which the page is compared with when its changes are logged
+	 */
+  Page* loggedPool;
+
+	/**
+   * Held by the thread whose operation is in progress; taken before the mutex
+	 */
+  std::recursive_mutex operationMutex;
+
+	/**
+   * Nesting depth of beginOperation() calls of the operation in progress
+	 */
+  int operationDepth;
+
+	/**
+   * Frames changed by the operation in progress
+	 */
+  std::vector<FrameId> changedFrames;
+
+	/**
+   * Pages disposed of by the operation in progress. They are deleted from their files once it is logged.
+	 */
+  std::vector< std::pair<File*, PageId> > disposedPages;
+
+	/**
+   * Latch of the pages of files mapped read-only, which are never written, so it is never locked
+	 */
+  PageLatch mappedLatch;
+
+	/**
+   * Tracer the page accesses are recorded with, or NULL if they are not traced
+	 */
+  PageTracer* tracer;
+
+	/**
+	 * Puts a frame in the ring of candidates if the clock may evict its page, and takes it out otherwise. Called
+	 * whenever the pin count or the changed flag of a frame holding a page moves.
+	 *
+	 * @param frame   	Frame to look at
+	 */
+  void updateCandidate(FrameId frame)
+  {
+		const FrameState& state = frameStates[frame];
+		if (frame < numBufs && state.valid && state.pinCnt == 0 && !state.changed)
+		{
+			candidates.add(frame);
+		}
+		else
+		{
+			candidates.remove(frame);
+		}
+  }
+
+	/**
+	 * Clears a frame whose page left the pool, and puts it on the stack of free frames unless resize() retired it.
+	 *
+	 * @param frame   	Frame to free
+	 */
+  void freeFrame(FrameId frame);
+
+	/**
+	 * Takes the mutex for a call that pins a page, recording how long it waited for another thread's call.
+	 *
+	 * @param guard   	Lock of the mutex, not yet locked
+	 */
+  void lockPool(std::unique_lock<std::mutex>& guard);
+
+	/**
+	 * Clears a frame, both its BufDesc and its FrameState.
+	 *
+	 * @param frame   	Frame to clear
+	 */
+  void clearFrame(FrameId frame)
+  {
+		bufDescTable[frame].Clear();
+		frameStates[frame].Clear();
+  }
+
+	/**
+	 * Assigns a frame to a page, pinned once.
+	 *
+	 * @param frame   	Frame to assign
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
 	 */
-  void advanceClock()
+  void setFrame(FrameId frame, File* file, PageId pageNo)
   {
-		clockHand = (clockHand + 1) % numBufs;
+		bufDescTable[frame].Set(file, pageNo);
+		frameStates[frame].Set();
   }
 
 	/**
-	 * Allocate a free frame.  
+	 * Constructs the frames of a range of the pool, empty.
+	 *
+	 * @param first   	First frame of the range
+	 * @param last   	Frame just past the range
+	 */
+  void addFrames(FrameId first, FrameId last);
+
+	/**
+	 * Evicts the page of a frame beyond numBufs, left by resize(), unless it is pinned or changed by the operation in
+	 * progress. Called with the mutex held.
+	 *
+	 * @param frame   	Frame to evict
+	 * @return True if the frame is empty now.
+	 */
+  bool evictRetired(FrameId frame);
+
+	/**
+	 * Evicts the pages left beyond numBufs by resize() that are no longer pinned, and gives the memory of their frames
+	 * back. Called with the mutex held.
+	 */
+  void releaseRetired();
+
+	/**
+	 * Allocate a free frame. A frame from the stack of free frames is used if there is one; otherwise the clock picks
+	 * a frame of the ring of candidates to evict, writing its page first if it is dirty. The frame is taken off the
+	 * stack, and its page evicted, only once nothing can throw any more. A caller that fails to put a page in the
+	 * frame pushes it back on the stack.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @throws BufferExceededException If every frame holds a page that is pinned or changed by the operation in
+	 *									progress, found out without looking at any of them
 	 */
   void allocBuf(FrameId & frame);
 
+	/**
+	 * Writes the page in a frame to its file, forcing the log up to the page's LSN first. Called with the mutex held.
+	 *
+	 * @param frame   	Frame of the page
+	 */
+  void writeFrame(FrameId frame);
+
+	/**
+	 * Logs the changes of the operation in progress and commits it. Called with both mutexes held.
+	 */
+  void commitOperation();
+
+	/**
+	 * Writes every dirty page to its file and empties the log. Called with both mutexes held.
+	 */
+  void checkpointLocked();
+
  public:
 	/**
    * Actual buffer pool from which frames are allocated
@@ -209,9 +603,22 @@ class BufMgr
   Page* bufPool;
 
 	/**
-   * Constructor of BufMgr class
+   * Constructor of BufMgr class. The frames of the pool are not touched until pages are read into them, so that the
+   * kernel backs a large pool as it is used.
+   *
+   * @param bufs		Number of frames in the buffer pool
+   * @param log			Log of the page changes, or NULL not to log them. Opening the log has redone the operations
+   *							committed in it before.
+   * @param poolFlags	Combination of PoolFlags for the memory of the pool. Flags the kernel does not support are
+   *							ignored.
+	 */
+  BufMgr(std::uint32_t bufs, WriteAheadLog* log = NULL, int poolFlags = POOL_HUGE_PAGES);
+
+	/**
+   * Number of frames that the memory of a pool is mapped for, unless it starts out larger. resize() can grow a pool
+   * up to it; the memory is only backed as frames are used.
 	 */
-  BufMgr(std::uint32_t bufs);
+  static const std::uint32_t RESERVED_FRAMES = 1 << 21;
 	
 	/**
    * Destructor of BufMgr class
@@ -222,10 +629,14 @@ class BufMgr
 	 * Reads the given page from the file into a frame and returns the pointer to page.
 	 * If the requested page is already present in the buffer pool pointer to that frame is returned
 	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 * Under the CHECKSUM_REPAIR policy, a page found corrupt is rebuilt from the write-ahead log if it can be.
+	 * A page of a file mapped read-only is not copied into a frame: the pointer returned is into the mapping, and
+	 * the page must not be written.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number in the file to be read
 	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+   * @throws  CorruptPageException If the page does not match its checksum and cannot be repaired
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
@@ -236,6 +647,7 @@ class BufMgr
 	 * @param PageNo  Page number
 	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
    * @throws  PageNotPinnedException If the page is not already pinned
+   * @throws  ReadOnlyFileException If the page is of a file mapped read-only and dirty is true
 	 */
   void unPinPage(File* file, const PageId PageNo, const bool dirty);
 
@@ -263,6 +675,7 @@ class BufMgr
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * If other threads still have the page pinned, it is deleted when the last of them unpins it.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
@@ -270,6 +683,103 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Starts an operation whose page changes are logged and redone after a crash all together or not at all. Until
+	 * endOperation() the calling thread is the only one changing pages, and the pages it changes stay in the buffer
+	 * pool. Calls may nest; the outermost operation counts. Pages unpinned dirty outside of an operation are logged
+	 * one by one. Does nothing if changes are not logged.
+	 */
+  void beginOperation();
+
+	/**
+	 * Ends the operation started by beginOperation(), logging and committing its changes.
+	 */
+  void endOperation();
+
+	/**
+	 * Writes every dirty page to its file and empties the log, waiting for the operation in progress to end. Files
+	 * must be checkpointed before they are removed or replaced, so that their log records are not redone into
+	 * another file of the same name. Does nothing if changes are not logged.
+	 *
+	 * @throws  LogIoException If the log or a file cannot be synced; the log is then left whole
+	 */
+  void checkpoint();
+
+	/**
+	 * Grows or shrinks the buffer pool while it is in use. New frames are empty. Shrinking evicts the pages of the
+	 * frames beyond the new size, writing them first if they are dirty, and gives their memory back; a page still
+	 * pinned stays in its frame until it is unpinned. Pages handed out never move. The hash table is resized a few
+	 * buckets at a time by the calls that follow. Waits for the operation in progress, if changes are logged.
+	 *
+	 * @param bufs		New number of frames
+	 * @throws  BufferExceededException If bufs is 0 or more than the memory of the pool has room for
+	 */
+  void resize(std::uint32_t bufs);
+
+	/**
+	 * Starts recording every readPage(), unPinPage(), allocPage() and disposePage() to a trace file, which
+	 * badgerdb_replay replays against pools of other sizes and policies. Pages of files mapped read-only are not
+	 * buffered and are not traced. A trace in progress is ended first.
+	 *
+	 * @param path		Trace file, replaced if it exists
+	 * @param capacity	Number of events buffered for the thread writing the file; events beyond it are dropped
+	 * @throws  BadTraceException If the file cannot be created
+	 */
+  void startTrace(const std::string& path, std::size_t capacity = 1 << 16);
+
+	/**
+	 * Ends the trace in progress, if any, writing out the events recorded.
+	 */
+  void stopTrace();
+
+	/**
+	 * Sets the policy by which frames are picked for eviction. The default is REPLACE_CLOCK.
+	 */
+  void setReplacementPolicy(ReplacementPolicy replacementPolicy)
+  {
+		std::lock_guard<std::mutex> guard(mutex);
+		policy = replacementPolicy;
+  }
+
+	/**
+	 * Returns the number of frames in the buffer pool.
+	 */
+  std::uint32_t size() const
+  {
+		return numBufs;
+  }
+
+	/**
+	 * Tells whether page changes are logged.
+	 */
+  bool hasLog() const
+  {
+		return log != NULL;
+  }
+
+	/**
+	 * Returns the optimistic latch of the frame holding a page, for callers that coordinate threads
+	 * reading and writing the same pages. The page must be pinned.
+	 *
+	 * @param page  	Page returned by readPage() or allocPage()
+	 */
+  PageLatch& pageLatch(const Page* page)
+  {
+		if (page < bufPool || page >= bufPool + maxBufs)
+		{
+			return mappedLatch;
+		}
+		return bufDescTable[page - bufPool].latch;
+  }
+
+	/**
+   * Returns the PoolFlags that took effect for the memory of the pool.
+	 */
+  int getPoolFlags() const
+  {
+		return poolMemory->flags();
+  }
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
@@ -289,6 +799,37 @@ class BufMgr
   {
 		bufStats.clear();
   }
+
+	/**
+	 * Returns a copy of the metrics of the buffer pool, with the pages accessed most since they came into the pool.
+	 *
+	 * @param topK		Number of the most accessed pages to return
+	 */
+  BufMetrics getMetrics(std::size_t topK = 10);
+
+	/**
+	 * Clears the metrics of the buffer pool, and the access counts of the pages in it.
+	 */
+  void clearMetrics();
+};
+
+
+/**
+* @brief Scoped operation of a buffer manager: begins it when constructed and ends it when destroyed
+*/
+class BufOperation
+{
+ public:
+  explicit BufOperation(BufMgr* bufMgr)
+	: bufMgr(bufMgr)
+  {
+		bufMgr->beginOperation();
+  }
+
+  ~BufOperation();
+
+ private:
+  BufMgr* bufMgr;
 };
 
 }
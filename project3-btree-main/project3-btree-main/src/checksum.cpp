@@ -0,0 +1,116 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstring>
+#include "checksum.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define BADGERDB_CRC32C_SSE42
+#endif
+
+namespace badgerdb {
+
+/**
+ * CRC32C polynomial, bit-reversed
+ */
+static const std::uint32_t POLYNOMIAL = 0x82f63b78;
+
+/**
+ * Lookup tables for slicing by 8: table[k][b] is the checksum of byte b followed by k zero bytes.
+ */
+struct Crc32cTables
+{
+	std::uint32_t table[8][256];
+
+	Crc32cTables()
+	{
+		for (std::uint32_t b = 0; b < 256; b++)
+		{
+			std::uint32_t crc = b;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc >> 1) ^ (crc & 1 ? POLYNOMIAL : 0);
+			}
+			table[0][b] = crc;
+		}
+		for (std::uint32_t b = 0; b < 256; b++)
+		{
+			for (int k = 1; k < 8; k++)
+			{
+				table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+			}
+		}
+	}
+};
+
+static std::uint32_t crc32cTables(const unsigned char* bytes, std::size_t length, std::uint32_t crc)
+{
+	static const Crc32cTables tables;
+	const std::uint32_t (*table)[256] = tables.table;
+	while (length >= 8)
+	{
+		std::uint32_t low;
+		std::uint32_t high;
+		memcpy(&low, bytes, 4);
+		memcpy(&high, bytes + 4, 4);
+		low ^= crc;
+		crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^ table[5][(low >> 16) & 0xff] ^ table[4][low >> 24]
+			^ table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^ table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+		bytes += 8;
+		length -= 8;
+	}
+	while (length-- > 0)
+	{
+		crc = (crc >> 8) ^ table[0][(crc ^ *bytes++) & 0xff];
+	}
+	return crc;
+}
+
+#ifdef BADGERDB_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static std::uint32_t crc32cSse42(const unsigned char* bytes, std::size_t length, std::uint32_t crc)
+{
+	std::uint64_t crc64 = crc;
+	while (length >= 8)
+	{
+		std::uint64_t word;
+		memcpy(&word, bytes, 8);
+		crc64 = _mm_crc32_u64(crc64, word);
+		bytes += 8;
+		length -= 8;
+	}
+	crc = (std::uint32_t)crc64;
+	while (length-- > 0)
+	{
+		crc = _mm_crc32_u8(crc, *bytes++);
+	}
+	return crc;
+}
+
+static bool hasSse42()
+{
+	static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2"));
+	return supported;
+}
+#endif
+
+std::uint32_t crc32c(const void* data, std::size_t length, std::uint32_t crc)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	// the register starts out as all ones and is inverted at the end, so chaining undoes the inversion first
+	crc = ~crc;
+#ifdef BADGERDB_CRC32C_SSE42
+	if (hasSse42())
+	{
+		return ~crc32cSse42(bytes, length, crc);
+	}
+#endif
+	return ~crc32cTables(bytes, length, crc);
+}
+
+}
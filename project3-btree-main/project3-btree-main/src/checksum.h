@@ -0,0 +1,27 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * Computes the CRC32C (Castagnoli) checksum of a byte range, with the SSE4.2 crc32 instruction where the processor
+ * has it and with lookup tables otherwise. A checksum of several ranges is computed by passing the checksum of the
+ * ranges before as crc.
+ *
+ * @param data		First byte of the range
+ * @param length	Number of bytes
+ * @param crc			Checksum of the bytes before the range, 0 for none
+ * @return Checksum of the bytes so far.
+ */
+std::uint32_t crc32c(const void* data, std::size_t length, std::uint32_t crc = 0);
+
+}
@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_trace_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadTraceException::BadTraceException(const std::string& name)
+    : BadgerDbException(""), filename_(name) {
+  std::stringstream ss;
+  ss << "Not a readable or writable page access trace: " << filename_;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,47 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a page access trace cannot be
+ *        written, or a file read as one is not a trace.
+ */
+class BadTraceException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad trace exception for the given file.
+   *
+   * @param name  Name of the trace file.
+   */
+  explicit BadTraceException(const std::string& name);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~BadTraceException() throw() {}
+
+  /**
+   * Returns the name of the trace file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of the trace file that caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
@@ -0,0 +1,25 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "log_io_exception.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+LogIoException::LogIoException(const std::string& name, const std::string& what,
+                               int error)
+    : BadgerDbException(""), filename_(name) {
+  std::stringstream ss;
+  ss << "Write-ahead log cannot " << what << " " << filename_ << ": "
+     << strerror(error);
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,49 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the write-ahead log, or a file it
+ *        syncs, cannot be opened, written or synced.
+ */
+class LogIoException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a log I/O exception for the given file.
+   *
+   * @param name  Name of the file that failed.
+   * @param what  The operation that failed, such as "sync".
+   * @param error The errno value of the failure.
+   */
+  LogIoException(const std::string& name, const std::string& what, int error);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~LogIoException() throw() {}
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of the file that caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
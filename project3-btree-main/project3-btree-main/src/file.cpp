@@ -7,17 +7,26 @@
 
 #include "file.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "checksum.h"
+#include "exceptions/corrupt_page_exception.h"
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/read_only_file_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
@@ -25,6 +34,73 @@ namespace badgerdb {
 
 File::StreamMap File::open_streams_;
 File::CountMap File::open_counts_;
+ChecksumPolicy File::checksum_policy_ = CHECKSUM_VERIFY;
+File::MappingMap File::open_mappings_;
+PageFile::ListenerMap PageFile::record_listeners_;
+std::mutex PageFile::record_listeners_mutex_;
+PageFile::ImageMap PageFile::reported_images_;
+std::map<std::string, std::uint64_t> PageFile::unreported_changes_;
+
+/**
+ * Written after the free list link of a deleted blob page.
+ */
+static const std::uint32_t FREE_PAGE_MARKER = 0x45455246;  // "FREE"
+
+FileMapping::FileMapping(const std::string& filename)
+    : data_(NULL), length_(0), last_page_(0), run_(0), advice_(MADV_NORMAL) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw FileNotFoundException(filename);
+  }
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* data = ::mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED) {
+      data_ = static_cast<char*>(data);
+      length_ = st.st_size;
+    }
+  }
+  ::close(fd);
+  const std::size_t num_pages = length_ / File::PAGE_STRIDE + 2;
+  verified_.reset(new std::atomic<std::uint8_t>[num_pages]);
+  for (std::size_t i = 0; i < num_pages; ++i) {
+    verified_[i] = 0;
+  }
+}
+
+FileMapping::~FileMapping() {
+  if (data_ != NULL) {
+    ::munmap(data_, length_);
+  }
+}
+
+void FileMapping::noteRead(const PageId page_number) {
+  // the run and the advice are only hints, so racing readers may miscount
+  const PageId last_page = last_page_.exchange(page_number, std::memory_order_relaxed);
+  int run = run_.load(std::memory_order_relaxed);
+  if (page_number == last_page) {
+    return;
+  }
+  if (page_number == last_page + 1) {
+    run = run > 0 ? run + 1 : 1;
+  } else {
+    run = run < 0 ? run - 1 : -1;
+  }
+  run_.store(run, std::memory_order_relaxed);
+  const int advice = run >= ADVICE_RUN ? MADV_SEQUENTIAL
+      : run <= -ADVICE_RUN ? MADV_RANDOM : advice_.load(std::memory_order_relaxed);
+  if (advice != advice_.exchange(advice, std::memory_order_relaxed) && data_ != NULL) {
+    ::madvise(data_, length_, advice);
+  }
+}
+
+void File::mapReadOnly(const std::string& filename) {
+  open_mappings_[filename] = std::make_shared<FileMapping>(filename);
+}
+
+void File::unmap(const std::string& filename) {
+  open_mappings_.erase(filename);
+}
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -33,6 +109,7 @@ void File::remove(const std::string& filename) {
   if (isOpen(filename)) {
     throw FileOpenException(filename);
   }
+  unmap(filename);
   std::remove(filename.c_str());
 }
 
@@ -64,6 +141,37 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
+PageId File::getNumPages() const {
+  return readHeader().num_pages;
+}
+
+bool File::checkPage(const PageId page_number) const {
+  Page page{Page::Uninitialized()};
+  return readChecked(page_number, page);
+}
+
+bool File::readChecked(const PageId page_number, Page& page) const {
+  std::uint32_t checksum = 0;
+  if (mapping_) {
+    readBytes(pagePosition(page_number), reinterpret_cast<char*>(&page), Page::SIZE);
+    readBytes(pagePosition(page_number) + std::streamoff(Page::SIZE),
+              reinterpret_cast<char*>(&checksum), CHECKSUM_SIZE);
+    return checksum == crc32c(&page, Page::SIZE);
+  }
+  stream_->seekg(pagePosition(page_number), std::ios::beg);
+  stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+  stream_->read(reinterpret_cast<char*>(&checksum), CHECKSUM_SIZE);
+  return checksum == crc32c(&page, Page::SIZE);
+}
+
+void File::writeChecked(const PageId page_number, const Page& page) {
+  const std::uint32_t checksum = crc32c(&page, Page::SIZE);
+  stream_->seekp(pagePosition(page_number), std::ios::beg);
+  stream_->write(reinterpret_cast<const char*>(&page), Page::SIZE);
+  stream_->write(reinterpret_cast<const char*>(&checksum), CHECKSUM_SIZE);
+  stream_->flush();
+}
+
 File::File(const std::string& name, const bool create_new) : filename_(name) {
   openIfNeeded(create_new);
 
@@ -100,6 +208,10 @@ void File::openIfNeeded(const bool create_new) {
     open_streams_[filename_] = stream_;
     open_counts_[filename_] = 1;
   }
+  MappingMap::const_iterator mapping = open_mappings_.find(filename_);
+  if (mapping != open_mappings_.end() && !create_new) {
+    mapping_ = mapping->second;
+  }
 }
 
 void File::close() {
@@ -107,6 +219,7 @@ void File::close() {
   	--open_counts_[filename_];
 
   stream_.reset();
+  mapping_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
@@ -117,11 +230,50 @@ void File::close() {
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+  readBytes(0 /* pos */, reinterpret_cast<char*>(&header), sizeof(FileHeader));
   return header;
 }
 
+void File::readBytes(const std::streampos position, char* bytes,
+                     const std::size_t length) const {
+  if (mapping_) {
+    const char* mapped = mapping_->at(position, length);
+    if (mapped == NULL) {
+      memset(bytes, 0, length);
+      return;
+    }
+    memcpy(bytes, mapped, length);
+    return;
+  }
+  stream_->seekg(position, std::ios::beg);
+  stream_->read(bytes, length);
+}
+
+void File::checkWritable() const {
+  if (mapping_) {
+    throw ReadOnlyFileException(filename_);
+  }
+}
+
+const Page* File::mappedPage(const PageId page_number) const {
+  const char* mapped = page_number == Page::INVALID_NUMBER ? NULL
+      : mapping_->at(pagePosition(page_number), Page::SIZE + CHECKSUM_SIZE);
+  if (mapped == NULL) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  // a mapped page cannot be repaired, but it needs checking only once
+  if (checksum_policy_ != CHECKSUM_OFF && !mapping_->isVerified(page_number)) {
+    std::uint32_t checksum;
+    memcpy(&checksum, mapped + Page::SIZE, CHECKSUM_SIZE);
+    if (checksum != crc32c(mapped, Page::SIZE)) {
+      throw CorruptPageException(page_number, filename_);
+    }
+    mapping_->setVerified(page_number);
+  }
+  mapping_->noteRead(page_number);
+  return reinterpret_cast<const Page*>(mapped);
+}
+
 void File::writeHeader(const FileHeader& header) {
   stream_->seekp(0 /* pos */, std::ios::beg);
   stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
@@ -163,11 +315,20 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
+  Page new_page{Page::Uninitialized()};
+  allocatePageInto(new_page_number, new_page);
+  return new_page;
+}
+
+void PageFile::allocatePageInto(PageId &new_page_number, Page& new_page) {
+  checkWritable();
   FileHeader header = readHeader();
-  Page new_page;
-  Page existing_page;
+  // the used list is walked by page headers; only the page whose link changes
+  // is read whole
+  Page existing_page{Page::Uninitialized()};
+  bool update_existing = false;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
+    readPageInto(header.first_free_page, new_page, true /* allow_free */);
     new_page.set_page_number(header.first_free_page);
 		new_page_number = new_page.page_number();
     header.first_free_page = new_page.next_page_number();
@@ -177,6 +338,7 @@ Page PageFile::allocatePage(PageId &new_page_number) {
         header.first_used_page > new_page.page_number()) {
       // Either have no pages used or the head of the used list is a page later
       // than the one we just allocated, so add the new page to the head.
+      new_page.set_next_page_number(Page::INVALID_NUMBER);
       if (header.first_used_page > new_page.page_number()) {
         new_page.set_next_page_number(header.first_used_page);
       }
@@ -186,10 +348,11 @@ Page PageFile::allocatePage(PageId &new_page_number) {
       // find where in the used list to insert it.
       PageId next_page_number = Page::INVALID_NUMBER;
       for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
+        next_page_number = readPageHeader(iter.page_number()).next_page_number;
         if (next_page_number > new_page.page_number() ||
             next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
+          iter.readInto(existing_page);
+          update_existing = true;
           break;
         }
       }
@@ -202,6 +365,7 @@ Page PageFile::allocatePage(PageId &new_page_number) {
   }
 	else
 	{
+    new_page.initialize();
     new_page.set_page_number(header.num_pages);
 		new_page_number = new_page.page_number();
 
@@ -214,50 +378,58 @@ Page PageFile::allocatePage(PageId &new_page_number) {
       // If we have pages allocated, we need to add the new page to the tail
       // of the linked list.
       for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
+        if (readPageHeader(iter.page_number()).next_page_number == Page::INVALID_NUMBER) {
+          iter.readInto(existing_page);
+          update_existing = true;
           break;
         }
       }
-      assert(existing_page.isUsed());
+      assert(update_existing && existing_page.isUsed());
       existing_page.set_next_page_number(new_page.page_number());
     }
     ++header.num_pages;
   }
   writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
+  if (update_existing) {
     // If we updated an existing page by inserting the new page into the
     // used list, we need to write it out.
     writePage(existing_page.page_number(), existing_page.header_, existing_page);
   }
   writeHeader(header);
-
-  return new_page;
+  trackImage(new_page, false);
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page{Page::Uninitialized()};
+  readPageInto(page_number, page);
+  return page;
+}
+
+void PageFile::readPageInto(const PageId page_number, Page& page) const {
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+	readPageInto(page_number, page, false /* allow_free */);
 }
 
-Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
-  Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(&page.data_[0], Page::DATA_SIZE);
+void PageFile::readPageInto(const PageId page_number, Page& page,
+                            const bool allow_free) const {
+  if (!readChecked(page_number, page) && checksum_policy_ != CHECKSUM_OFF) {
+    throw CorruptPageException(page_number, filename_);
+  }
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
+  if (page.isUsed()) {
+    trackImage(page, false);
+  }
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+	checkWritable();
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
@@ -270,14 +442,18 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	const PageId next_page_number = header.next_page_number;
 	header = new_page.header_;
 	header.next_page_number = next_page_number;
+	trackImage(new_page, true);
 	writePage(new_page_number, header, new_page);
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  checkWritable();
   FileHeader header = readHeader();
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
+  Page existing_page{Page::Uninitialized()};
+  readPageInto(page_number, existing_page);
+  Page previous_page{Page::Uninitialized()};
+  bool update_previous = false;
   // If this page is the head of the used list, update the header to point to
   // the next page in line.
   if (page_number == header.first_used_page) {
@@ -285,19 +461,40 @@ void PageFile::deletePage(const PageId page_number) {
   } else {
     // Walk the used list so we can update the page that points to this one.
     for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
+      if (readPageHeader(iter.page_number()).next_page_number == existing_page.page_number()) {
+        iter.readInto(previous_page);
         previous_page.set_next_page_number(existing_page.next_page_number());
+        update_previous = true;
         break;
       }
     }
   }
+  if (hasRecordListeners()) {
+    // every record of the page goes with it
+    const Page& old_page = existing_page;
+    std::vector<RecordChange> changes;
+    for (SlotId i = 1; i <= old_page.header_.num_slots; ++i) {
+      if (old_page.getSlot(i).used) {
+        const PageSlot& slot = old_page.getSlot(i);
+        RecordChange change;
+        change.rid = {page_number, i, 0};
+        change.existed = true;
+        change.exists = false;
+        change.old_data.assign(&old_page.data_[slot.item_offset], slot.item_length);
+        changes.push_back(change);
+      }
+    }
+    notifyRecordListeners(changes);
+    std::lock_guard<std::mutex> guard(record_listeners_mutex_);
+    reported_images_[filename_].erase(page_number);
+  }
+
   // Clear the page and add it to the head of the free list.
   existing_page.initialize();
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
+  if (update_previous) {
     writePage(previous_page.page_number(), previous_page.header_, previous_page);
   }
   writePage(page_number, existing_page.header_, existing_page);
@@ -313,21 +510,154 @@ FileIterator PageFile::end() {
   return FileIterator(this, Page::INVALID_NUMBER);
 }
 
+void PageFile::addRecordListener(const std::string& filename,
+                                 RecordListener* listener) {
+  std::lock_guard<std::mutex> guard(record_listeners_mutex_);
+  record_listeners_[filename].push_back(listener);
+}
+
+void PageFile::removeRecordListener(const std::string& filename,
+                                    RecordListener* listener) {
+  std::lock_guard<std::mutex> guard(record_listeners_mutex_);
+  ListenerMap::iterator it = record_listeners_.find(filename);
+  if (it == record_listeners_.end()) {
+    return;
+  }
+  std::vector<RecordListener*>& listeners = it->second;
+  listeners.erase(std::remove(listeners.begin(), listeners.end(), listener),
+                  listeners.end());
+  if (listeners.empty()) {
+    record_listeners_.erase(it);
+    reported_images_.erase(filename);
+  }
+}
+
+bool PageFile::hasRecordListeners() const {
+  std::lock_guard<std::mutex> guard(record_listeners_mutex_);
+  return record_listeners_.find(filename_) != record_listeners_.end();
+}
+
+std::uint64_t PageFile::unreportedChanges(const std::string& filename) {
+  std::lock_guard<std::mutex> guard(record_listeners_mutex_);
+  std::map<std::string, std::uint64_t>::const_iterator it =
+      unreported_changes_.find(filename);
+  return it == unreported_changes_.end() ? 0 : it->second;
+}
+
+void PageFile::trackImage(const Page& page, const bool check) const {
+  std::lock_guard<std::mutex> guard(record_listeners_mutex_);
+  if (record_listeners_.find(filename_) == record_listeners_.end()) {
+    return;
+  }
+  // the next page pointer is left out: allocating a page changes it on disk,
+  // and no record with it
+  PageHeader header = page.header_;
+  header.next_page_number = Page::INVALID_NUMBER;
+  std::uint32_t checksum = crc32c(&header, sizeof(PageHeader));
+  checksum = crc32c(page.data_, Page::DATA_SIZE, checksum);
+  std::pair<std::map<PageId, std::uint32_t>::iterator, bool> known =
+      reported_images_[filename_].insert(
+          std::make_pair(page.page_number(), checksum));
+  if (check && (known.second || known.first->second != checksum)) {
+    ++unreported_changes_[filename_];
+  }
+  known.first->second = checksum;
+}
+
+RecordId PageFile::insertRecord(Page& page, const std::string& record_data) {
+  if (!hasRecordListeners()) {
+    return page.insertRecord(record_data);
+  }
+  trackImage(page, true);
+  const RecordId record_id = page.insertRecord(record_data);
+  trackImage(page, false);
+  RecordChange change;
+  change.rid = record_id;
+  change.existed = false;
+  change.exists = true;
+  change.new_data = record_data;
+  notifyRecordListeners(std::vector<RecordChange>(1, change));
+  return record_id;
+}
+
+void PageFile::updateRecord(Page& page, const RecordId& record_id,
+                            const std::string& record_data) {
+  // the old record is only copied while someone listens for it
+  if (!hasRecordListeners()) {
+    page.updateRecord(record_id, record_data);
+    return;
+  }
+  RecordChange change;
+  change.rid = record_id;
+  change.existed = true;
+  change.exists = true;
+  change.old_data = page.getRecord(record_id);
+  trackImage(page, true);
+  page.updateRecord(record_id, record_data);
+  trackImage(page, false);
+  change.new_data = record_data;
+  notifyRecordListeners(std::vector<RecordChange>(1, change));
+}
+
+void PageFile::deleteRecord(Page& page, const RecordId& record_id) {
+  if (!hasRecordListeners()) {
+    page.deleteRecord(record_id);
+    return;
+  }
+  RecordChange change;
+  change.rid = record_id;
+  change.existed = true;
+  change.exists = false;
+  change.old_data = page.getRecord(record_id);
+  trackImage(page, true);
+  page.deleteRecord(record_id);
+  trackImage(page, false);
+  notifyRecordListeners(std::vector<RecordChange>(1, change));
+}
+
+void PageFile::notifyRecordListeners(
+    const std::vector<RecordChange>& changes) const {
+  if (changes.empty()) {
+    return;
+  }
+
+  // listeners are called while the mutex is held, so that none is called
+  // after removeRecordListener() returned
+  std::lock_guard<std::mutex> guard(record_listeners_mutex_);
+  ListenerMap::const_iterator it = record_listeners_.find(filename_);
+  if (it != record_listeners_.end()) {
+    for (std::size_t i = 0; i < it->second.size(); ++i) {
+      it->second[i]->recordsChanged(filename_, changes);
+    }
+  }
+}
+
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
+  // the checksum covers the page as stored, with the header given
+  std::uint32_t checksum = crc32c(&header, sizeof(PageHeader));
+  checksum = crc32c(new_page.data_, Page::DATA_SIZE, checksum);
   stream_->seekp(pagePosition(page_number), std::ios::beg);
   stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
   stream_->write(&new_page.data_[0], Page::DATA_SIZE);
+  stream_->write(reinterpret_cast<const char*>(&checksum), CHECKSUM_SIZE);
   stream_->flush();
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readBytes(pagePosition(page_number), reinterpret_cast<char*>(&header), sizeof(PageHeader));
   return header;
 }
 
+const Page* PageFile::mappedPage(const PageId page_number) const {
+  const Page* page = File::mappedPage(page_number);
+  if (!page->isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  return page;
+}
+
 
 
 
@@ -361,39 +691,98 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
-	Page new_page;
+	Page new_page{Page::Uninitialized()};
+	allocatePageInto(new_page_number, new_page);
+	return new_page;
+}
 
-	new_page_number = header.num_pages;
+void BlobFile::allocatePageInto(PageId &new_page_number, Page& new_page) {
+  checkWritable();
+  FileHeader header = readHeader();
+	new_page.initialize();
+
+	if (header.num_free_pages > 0) {
+		// Reuse the first page on the free list; it holds the number of the next one.
+		new_page_number = header.first_free_page;
+		header.first_free_page = readFreeLink(new_page_number);
+		--header.num_free_pages;
+	} else {
+		new_page_number = header.num_pages;
+		++header.num_pages;
+	}
 
 	if (header.first_used_page == Page::INVALID_NUMBER) {
-		header.first_used_page = header.num_pages;
+		header.first_used_page = new_page_number;
 	}
 
-	++header.num_pages;
-
 	writePage(new_page_number, new_page);
 	writeHeader(header);
-
-	return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
-	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	Page page{Page::Uninitialized()};
+	readPageInto(page_number, page);
 	return page;
 }
 
+void BlobFile::readPageInto(const PageId page_number, Page& page) const {
+	if (!readChecked(page_number, page) && checksum_policy_ != CHECKSUM_OFF) {
+		throw CorruptPageException(page_number, filename_);
+	}
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	checkWritable();
+	writeChecked(new_page_number, new_page);
 }
 
-//delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
-	throw InvalidPageException(page_number, filename_);
+	checkWritable();
+	FileHeader header = readHeader();
+	if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages) {
+		throw InvalidPageException(page_number, filename_);
+	}
+
+	// Blob pages have no header of their own, so the free list is chained
+	// through the first bytes of the freed pages, followed by a marker, and
+	// the pages are written whole to keep their checksum. A used page may hold
+	// the marker by chance, so it is only taken as freed if it is on the list.
+	Page page{Page::Uninitialized()};
+	readChecked(page_number, page);
+	std::uint32_t marker;
+	memcpy(&marker, reinterpret_cast<const char*>(&page) + sizeof(PageId), sizeof(marker));
+	if (marker == FREE_PAGE_MARKER && isFreePage(page_number)) {
+		throw InvalidPageException(page_number, filename_);
+	}
+	memcpy(reinterpret_cast<char*>(&page), &header.first_free_page, sizeof(PageId));
+	memcpy(reinterpret_cast<char*>(&page) + sizeof(PageId), &FREE_PAGE_MARKER, sizeof(FREE_PAGE_MARKER));
+	writeChecked(page_number, page);
+
+	header.first_free_page = page_number;
+	++header.num_free_pages;
+	writeHeader(header);
+}
+
+PageId BlobFile::getNumFreePages() const {
+	return readHeader().num_free_pages;
+}
+
+bool BlobFile::isFreePage(const PageId page_number) const {
+	const FileHeader header = readHeader();
+	PageId free_page = header.first_free_page;
+	for (PageId i = 0; i < header.num_free_pages; ++i) {
+		if (free_page == page_number) {
+			return true;
+		}
+		free_page = readFreeLink(free_page);
+	}
+	return false;
+}
+
+PageId BlobFile::readFreeLink(const PageId page_number) const {
+	PageId next;
+	readBytes(pagePosition(page_number), reinterpret_cast<char*>(&next), sizeof(PageId));
+	return next;
 }
 
 }
@@ -7,10 +7,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "page.h"
 
@@ -18,6 +22,113 @@ namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief What File::readPage() does with the checksum stored with each page.
+ *
+ * CHECKSUM_OFF does not look at it. CHECKSUM_VERIFY throws a CorruptPageException for a page that does not match
+ * it. CHECKSUM_REPAIR throws as well, but a buffer manager with a write-ahead log catches the exception and rebuilds
+ * the page from the log if it can.
+ */
+enum ChecksumPolicy { CHECKSUM_OFF, CHECKSUM_VERIFY, CHECKSUM_REPAIR };
+
+/**
+ * @brief A file mapped into memory read-only with File::mapReadOnly(), shared
+ *        by the File objects opened on it.
+ *
+ * Pages are used where they are in the mapping. The kernel is told how they
+ * are read: sequentially once a run of consecutive pages was read, and at
+ * random once a run of pages was read out of order.
+ */
+class FileMapping {
+ public:
+  /**
+   * Maps the file as it is now.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   */
+  explicit FileMapping(const std::string& filename);
+
+  /**
+   * Unmaps the file.
+   */
+  ~FileMapping();
+
+  /**
+   * Returns the bytes of the file at the given position, or NULL if the
+   * file is not that long.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param length    Number of bytes needed.
+   */
+  const char* at(const std::size_t position, const std::size_t length) const {
+    return position + length <= length_ ? data_ + position : NULL;
+  }
+
+  /**
+   * Notes that a page was read, and changes the advice given to the kernel
+   * when the access pattern changes.
+   *
+   * @param page_number   Number of the page read.
+   */
+  void noteRead(const PageId page_number);
+
+  /**
+   * Returns true if the page was found to match its checksum before.
+   *
+   * @param page_number   Number of the page.
+   */
+  bool isVerified(const PageId page_number) const {
+    return verified_[page_number].load(std::memory_order_relaxed) != 0;
+  }
+
+  /**
+   * Notes that the page matches its checksum.
+   *
+   * @param page_number   Number of the page.
+   */
+  void setVerified(const PageId page_number) {
+    verified_[page_number].store(1, std::memory_order_relaxed);
+  }
+
+ private:
+  FileMapping(const FileMapping&);
+  FileMapping& operator=(const FileMapping&);
+
+  /**
+   * Number of consecutive pages, or of pages read out of order, after which
+   * the advice changes.
+   */
+  static const int ADVICE_RUN = 8;
+
+  /**
+   * First byte of the mapping.
+   */
+  char* data_;
+
+  /**
+   * Length of the mapping.
+   */
+  std::size_t length_;
+
+  /**
+   * Whether each page was checked against its checksum.
+   */
+  std::unique_ptr<std::atomic<std::uint8_t>[]> verified_;
+
+  /**
+   * Last page read, and the length of the run of sequential (positive) or
+   * out-of-order (negative) reads that led to it.
+   */
+  std::atomic<PageId> last_page_;
+  std::atomic<int> run_;
+
+  /**
+   * Advice last given to the kernel with madvise().
+   */
+  std::atomic<int> advice_;
+};
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
@@ -68,6 +179,9 @@ struct FileHeader {
  * detects this (by looking in the open_streams_ map) and just returns a file object with
  * the already created stream for the file without actually opening the UNIX file again. 
  *
+ * Each page is followed on disk by its CRC32C checksum, computed whenever the page is written. Whether reads verify
+ * it is up to the checksum policy set with setChecksumPolicy(); checkPage() verifies a page whatever the policy.
+ *
  * @warning This class is not threadsafe.
  */
 
@@ -124,6 +238,15 @@ class File {
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
+  /**
+   * Allocates a new page in the file, and stores it in a page the caller
+   * provides, e.g. a buffer frame, rather than returning a copy.
+   *
+   * @param new_page_number   Set to the number of the new page.
+   * @param new_page          Overwritten with the new page.
+   */
+  virtual void allocatePageInto(PageId &new_page_number, Page& new_page) = 0;
+
   /**
    * Reads an existing page from the file.
    *
@@ -131,9 +254,24 @@ class File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file into a page the caller provides,
+   * e.g. a buffer frame, rather than returning a copy.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Overwritten with the page.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
+   */
+  virtual void readPageInto(const PageId page_number, Page& page) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -164,7 +302,48 @@ class File {
    */
 	PageId getFirstPageNo();
 
- protected:
+  /**
+   * Returns the number of pages allocated in the file, counting the header as
+   * page 0.
+   */
+  PageId getNumPages() const;
+
+  /**
+   * Checks a page against the checksum stored with it, whatever the checksum
+   * policy. No bounds checking is performed.
+   *
+   * @param page_number   Number of page to check.
+   * @return  True if the page matches its checksum.
+   */
+  bool checkPage(const PageId page_number) const;
+
+  /**
+   * Sets what reads do with the checksums of pages, for all files. The
+   * default is CHECKSUM_VERIFY.
+   *
+   * @param policy  Checksum policy.
+   */
+  static void setChecksumPolicy(const ChecksumPolicy policy) {
+    checksum_policy_ = policy;
+  }
+
+  /**
+   * Returns the checksum policy set with setChecksumPolicy().
+   */
+  static ChecksumPolicy getChecksumPolicy() { return checksum_policy_; }
+
+  /**
+   * Size of the checksum stored on disk after each page.
+   */
+  static const std::size_t CHECKSUM_SIZE = sizeof(std::uint32_t);
+
+  /**
+   * Distance between pages on disk: a page, its checksum, and padding that
+   * keeps pages 8-byte aligned, so that those of a mapped file can be used
+   * in place.
+   */
+  static const std::size_t PAGE_STRIDE = Page::SIZE + sizeof(std::uint64_t);
+
   /**
    * Returns the position of the page with the given number in the file (as an
    * offset from the beginning of the file).
@@ -173,9 +352,86 @@ class File {
    * @return  Position of page in file.
    */
   static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+    return sizeof(FileHeader) + ((std::streamoff)(page_number - 1) * PAGE_STRIDE);
   }
 
+  /**
+   * Maps a file into memory read-only, for relations and indexes that are
+   * read and not written. File objects opened on the file from then on read
+   * from the mapping, and the buffer manager hands out their pages where they
+   * are in the mapping instead of copying them into frames; allocating,
+   * writing or deleting their pages throws a ReadOnlyFileException. File
+   * objects opened before keep reading through their stream. The mapping
+   * covers the file as it is now.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   */
+  static void mapReadOnly(const std::string& filename);
+
+  /**
+   * Ends the read-only mode of a file. File objects opened on it before keep
+   * the mapping until they are closed.
+   *
+   * @param filename  Name of the file.
+   */
+  static void unmap(const std::string& filename);
+
+  /**
+   * Returns true if the file was opened while it was mapped read-only.
+   */
+  bool isMapped() const { return mapping_ != NULL; }
+
+  /**
+   * Returns a page of a file mapped read-only, where it is in the mapping.
+   * The page is checked against its checksum the first time, as the checksum
+   * policy says.
+   *
+   * @param page_number   Number of page.
+   * @return  The page, which must not be written.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
+   */
+  virtual const Page* mappedPage(const PageId page_number) const;
+
+ protected:
+  /**
+   * Reads the page with the given number as it is stored on disk, and its
+   * checksum. No bounds checking is performed.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page read.
+   * @return  True if the page matches its checksum.
+   */
+  bool readChecked(const PageId page_number, Page& page) const;
+
+  /**
+   * Writes a page as it is to be stored on disk, followed by its checksum.
+   * No bounds checking is performed.
+   *
+   * @param page_number   Number of page whose contents to replace.
+   * @param page          Page to write.
+   */
+  void writeChecked(const PageId page_number, const Page& page);
+
+  /**
+   * Reads bytes of the file from the mapping if it is mapped, from the
+   * stream otherwise.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param bytes     Where to store the bytes.
+   * @param length    Number of bytes.
+   */
+  void readBytes(const std::streampos position, char* bytes,
+                 const std::size_t length) const;
+
+  /**
+   * Throws a ReadOnlyFileException if the file is mapped read-only.
+   */
+  void checkWritable() const;
+
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
@@ -218,6 +474,18 @@ class File {
    */
   static StreamMap open_streams_;
 
+  /**
+   * What reads do with the checksums of pages.
+   */
+  static ChecksumPolicy checksum_policy_;
+
+  typedef std::map<std::string, std::shared_ptr<FileMapping> > MappingMap;
+
+  /**
+   * Mappings of the files mapped read-only.
+   */
+  static MappingMap open_mappings_;
+
   /**
    * Counts for opened files.
    */
@@ -233,9 +501,60 @@ class File {
    */
   std::shared_ptr<std::fstream> stream_;
 
+  /**
+   * Mapping of the file, if it was mapped read-only when this object opened it.
+   */
+  std::shared_ptr<FileMapping> mapping_;
+
   friend class FileIterator;
 };
 
+/**
+ * @brief A record of a PageFile that was inserted, updated or deleted.
+ */
+struct RecordChange {
+  /**
+   * ID of the record.
+   */
+  RecordId rid;
+
+  /**
+   * True if the record existed before the change, false if it was inserted.
+   */
+  bool existed;
+
+  /**
+   * True if the record exists after the change, false if it was deleted.
+   */
+  bool exists;
+
+  /**
+   * Record before and after the change; empty if it did not exist then.
+   */
+  std::string old_data;
+  std::string new_data;
+};
+
+/**
+ * @brief Receives the record changes of the PageFiles it is registered for with PageFile::addRecordListener().
+ */
+class RecordListener {
+ public:
+  virtual ~RecordListener() {}
+
+  /**
+   * Called as soon as a record of the file is changed with PageFile::insertRecord(), updateRecord() or
+   * deleteRecord(), with that one record, and when a page of the file is deleted, with all of its records in slot
+   * order. Changes made by calling the methods of a Page directly are not reported, so a listener does not see
+   * them. The caller may hold pages of the file pinned in the buffer manager.
+   *
+   * @param filename  Name of the file.
+   * @param changes   Records of the page that changed.
+   */
+  virtual void recordsChanged(const std::string& filename,
+                              const std::vector<RecordChange>& changes) = 0;
+};
+
 // The PageFile class will store all the relations as we did in the buffer assignment.
 class PageFile : public File {
  public:
@@ -301,6 +620,14 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number) override;
 
+  /**
+   * Allocates a new page in the file into a page the caller provides.
+   *
+   * @param new_page_number   Set to the number of the new page.
+   * @param new_page          Overwritten with the new page.
+   */
+  void allocatePageInto(PageId &new_page_number, Page& new_page) override;
+
   /**
    * Reads an existing page from the file.
    *
@@ -308,9 +635,36 @@ class PageFile : public File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads an existing page from the file into a page the caller provides.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Overwritten with the page.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
+   */
+  void readPageInto(const PageId page_number, Page& page) const override;
+
+  /**
+   * Returns a used page of a file mapped read-only, where it is in the
+   * mapping.
+   *
+   * @param page_number   Number of page.
+   * @return  The page, which must not be written.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
+   */
+  const Page* mappedPage(const PageId page_number) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -342,22 +696,145 @@ class PageFile : public File {
    */
   FileIterator end();
 
+  /**
+   * Inserts a record into a page of this file and reports it to the file's
+   * record listeners. The page is changed where it is, e.g. in a buffer
+   * frame, and writing it back is left to the caller.
+   *
+   * @param page          Page of this file.
+   * @param record_data   Bytes of the record.
+   * @return  ID of the new record.
+   * @throws  InsufficientSpaceException  If the page has no room for it.
+   */
+  RecordId insertRecord(Page& page, const std::string& record_data);
+
+  /**
+   * Replaces a record on a page of this file and reports the old and the new
+   * record to the file's record listeners.
+   *
+   * @param page          Page of this file holding the record.
+   * @param record_id     ID of the record.
+   * @param record_data   New bytes of the record.
+   * @throws  InvalidRecordException  If the record is not on the page.
+   * @throws  InsufficientSpaceException  If the page has no room for it.
+   */
+  void updateRecord(Page& page, const RecordId& record_id,
+                    const std::string& record_data);
+
+  /**
+   * Deletes a record from a page of this file and reports it to the file's
+   * record listeners.
+   *
+   * @param page          Page of this file holding the record.
+   * @param record_id     ID of the record.
+   * @throws  InvalidRecordException  If the record is not on the page.
+   */
+  void deleteRecord(Page& page, const RecordId& record_id);
+
+  /**
+   * Registers a listener for the record changes of a file. From then on, the
+   * records changed with insertRecord(), updateRecord() and deleteRecord(),
+   * and those of the pages deleted, are passed to the listener. Records
+   * changed through Page directly and written with writePage() are not, but
+   * are counted by unreportedChanges().
+   *
+   * @param filename  Name of the file.
+   * @param listener  Listener to register.
+   */
+  static void addRecordListener(const std::string& filename,
+                                RecordListener* listener);
+
+  /**
+   * Unregisters a listener added with addRecordListener(). Once this returns,
+   * the listener is not called anymore.
+   *
+   * @param filename  Name of the file.
+   * @param listener  Listener to unregister.
+   */
+  static void removeRecordListener(const std::string& filename,
+                                   RecordListener* listener);
+
+  /**
+   * Returns the number of times a page of a file was found changed in ways
+   * its record listeners were not told about, when it was written or changed
+   * through insertRecord(), updateRecord() or deleteRecord(). Only pages
+   * changed while the file has listeners are counted, and the count never
+   * goes down, so a listener that sees it unchanged since it was registered
+   * has been told of every change written.
+   *
+   * @param filename  Name of the file.
+   */
+  static std::uint64_t unreportedChanges(const std::string& filename);
+
  private:
 
   /**
-   * Reads a page from the file.  If <allow_free> is not set, an exception
-   * will be thrown if the page read from disk is not currently in use.
+   * Returns true if the file has record listeners.
+   */
+  bool hasRecordListeners() const;
+
+  /**
+   * Passes changed records to the file's record listeners.
+   *
+   * @param changes   Records that changed.
+   */
+  void notifyRecordListeners(const std::vector<RecordChange>& changes) const;
+
+  typedef std::map<std::string, std::vector<RecordListener*> > ListenerMap;
+
+  /**
+   * Record listeners of each file.
+   */
+  static ListenerMap record_listeners_;
+
+  /**
+   * Guards record_listeners_, which records may be changed from any thread.
+   * Also guards reported_images_ and unreported_changes_.
+   */
+  static std::mutex record_listeners_mutex_;
+
+  /**
+   * Checks a page against the image its listeners know of, and remembers it
+   * as the new one. A page is known as it was read, written or left by
+   * insertRecord(), updateRecord() and deleteRecord(); one that differs from
+   * it, or is not known, counts as an unreported change. Does nothing if the
+   * file has no listeners.
+   *
+   * @param page    Page of this file.
+   * @param check   False to only remember the page.
+   */
+  void trackImage(const Page& page, const bool check) const;
+
+  typedef std::map<std::string, std::map<PageId, std::uint32_t> > ImageMap;
+
+  /**
+   * Checksum of the image of each page known to the listeners of each file.
+   */
+  static ImageMap reported_images_;
+
+  /**
+   * Number of unreported changes found in each file.
+   */
+  static std::map<std::string, std::uint64_t> unreported_changes_;
+
+  /**
+   * Reads a page from the file into a page the caller provides.  If
+   * <allow_free> is not set, an exception will be thrown if the page read
+   * from disk is not currently in use.
    *
    * No bounds checking is performed; the underlying file stream will throw
    * an exception if the page is past the end of the file.
    *
    * @param page_number   Number of page to read.
+   * @param page          Overwritten with the page.
    * @param allow_free    Whether to allow reading a free (unused) page.
-   * @return  The page.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
    */
-  Page readPage(const PageId page_number, const bool allow_free) const;
+  void readPageInto(const PageId page_number, Page& page,
+                    const bool allow_free) const;
 
   /**
    * Writes a page into the file at the given page number with the given header.
@@ -449,12 +926,20 @@ class BlobFile : public File {
   ~BlobFile();
 
   /**
-   * Allocates a new page in the file.
+   * Allocates a new page in the file, reusing a deleted page if there is one.
    *
    * @return The new page.
    */
   Page allocatePage(PageId &new_page_number) override;
 
+  /**
+   * Allocates a new page in the file into a page the caller provides.
+   *
+   * @param new_page_number   Set to the number of the new page.
+   * @param new_page          Overwritten with the new page.
+   */
+  void allocatePageInto(PageId &new_page_number, Page& new_page) override;
+
   /**
    * Reads an existing page from the file.
    *
@@ -462,9 +947,23 @@ class BlobFile : public File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
    */
   Page readPage(const PageId page_number) const override;
 
+  /**
+   * Reads an existing page from the file into a page the caller provides.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Overwritten with the page.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  CorruptPageException  If the page does not match its checksum and
+   *                                the checksum policy verifies it.
+   */
+  void readPageInto(const PageId page_number, Page& page) const override;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -475,11 +974,38 @@ class BlobFile : public File {
   void writePage(const PageId page_number, const Page& new_page) override;
 
   /**
-   * Deletes a page from the file.
+   * Deletes a page from the file by putting it on the free list kept in the
+   * file header. The page is handed out again by a later allocatePage().
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or
+   *                                is already free.
    */
   void deletePage(const PageId page_number) override;
+
+  /**
+   * Returns the number of deleted pages waiting to be reused.
+   */
+  PageId getNumFreePages() const;
+
+  /**
+   * Returns whether a page is on the free list, walking the list from its
+   * head.
+   *
+   * @param page_number   Number of page to look for.
+   * @return  True if the page has been deleted and not allocated again.
+   */
+  bool isFreePage(const PageId page_number) const;
+
+ private:
+  /**
+   * Reads the number of the free page that follows the given one on the
+   * free list.
+   *
+   * @param page_number   Number of a page on the free list.
+   * @return  Number of the next free page.
+   */
+  PageId readFreeLink(const PageId page_number) const;
 };
 
 }
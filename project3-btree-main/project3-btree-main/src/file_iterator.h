@@ -103,6 +103,22 @@ class FileIterator {
 	inline Page operator*() const
   { return file_->readPage(current_page_number_); }
 
+  /**
+   * Reads the current page into a page the caller provides, e.g. a buffer
+   * frame, rather than returning a copy.
+   *
+   * @param page  Overwritten with the current page.
+   */
+  inline void readInto(Page& page) const
+  { file_->readPageInto(current_page_number_, page); }
+
+  /**
+   * Returns the number of the current page, without reading the page.
+   *
+   * @return  Page number.
+   */
+  inline PageId page_number() const { return current_page_number_; }
+
  private:
   /**
    * File we're iterating over.
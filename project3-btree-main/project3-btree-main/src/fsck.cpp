@@ -0,0 +1,62 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <iostream>
+#include <string>
+#include "file.h"
+#include "exceptions/badgerdb_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Checks the pages of relation (PageFile) and index (BlobFile) files against
+// the checksums stored with them, and reports the corrupt ones.
+//
+// usage: badgerdb_fsck file...
+// Exits with 1 if any page is corrupt, 2 if a file cannot be opened.
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " file..." << std::endl;
+		return 2;
+	}
+
+	int status = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string name = argv[i];
+		try
+		{
+			// both kinds of file store their pages the same way; only the page contents differ
+			BlobFile file = BlobFile::open(name);
+			const PageId numPages = file.getNumPages();
+			PageId corrupt = 0;
+			for (PageId pageNo = 1; pageNo < numPages; pageNo++)
+			{
+				if (!file.checkPage(pageNo))
+				{
+					std::cout << name << ": page " << pageNo << " is corrupt" << std::endl;
+					corrupt++;
+				}
+			}
+			std::cout << name << ": " << numPages - 1 << " pages, " << corrupt << " corrupt" << std::endl;
+			if (corrupt > 0 && status == 0)
+			{
+				status = 1;
+			}
+		}
+		catch(const BadgerDbException &e)
+		{
+			std::cerr << name << ": " << e.message() << std::endl;
+			status = 2;
+		}
+	}
+	return status;
+}
@@ -0,0 +1,597 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <sstream>
+#include "hash_index.h"
+#include "filescan.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/end_of_file_exception.h"
+
+namespace badgerdb
+{
+
+// -----------------------------------------------------------------------------
+// Hash functions
+// -----------------------------------------------------------------------------
+
+/**
+ * Finalizer of MurmurHash3: spreads every bit of h over the low bits that index the directory.
+ */
+static std::uint64_t mixBits(std::uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static std::uint64_t hashKey(int key)
+{
+	return mixBits(static_cast<std::uint32_t>(key));
+}
+
+static std::uint64_t hashKey(double key)
+{
+	// -0.0 equals 0.0, so both must hash alike
+	if (key == 0)
+	{
+		key = 0;
+	}
+	std::uint64_t bits;
+	memcpy(&bits, &key, sizeof(bits));
+	return mixBits(bits);
+}
+
+/**
+ * FNV-1a over the bytes that take part in comparisons, i.e. up to the first '\0'.
+ */
+static std::uint64_t hashKey(const StringKey& key)
+{
+	std::uint64_t h = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < STRINGSIZE && key.data[i] != '\0'; i++)
+	{
+		h = (h ^ static_cast<unsigned char>(key.data[i])) * 0x100000001b3ULL;
+	}
+	return mixBits(h);
+}
+
+/**
+ * Allocates an empty bucket page and returns its page number.
+ */
+template <class T>
+static PageId allocBucket(BufMgr *bufMgr, File *file)
+{
+	PageId pageNo;
+	Page *page;
+	bufMgr->allocPage(file, pageNo, page);
+	reinterpret_cast<LeafNode<T>*>(page)->init();
+	bufMgr->unPinPage(file, pageNo, true);
+	return pageNo;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::HashIndex -- Constructor
+// -----------------------------------------------------------------------------
+
+HashIndex::HashIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const int attrByteOffset,
+		const Datatype attrType)
+{
+	bufMgr = bufMgrIn;
+	attributeType = attrType;
+	HashIndex::attrByteOffset = attrByteOffset;
+
+	std::ostringstream idxStr;
+	idxStr << relationName << '.' << attrByteOffset << ".hash";
+	std::string indexName = idxStr.str(); // indexName is the name of the index file
+	outIndexName = indexName;
+
+	if (attrType != INTEGER && attrType != DOUBLE && attrType != STRING)
+	{
+		throw BadIndexInfoException(indexName);
+	}
+
+	// if indexName exists, then the file is opened. Else, a new index file is created.
+	try
+	{
+		file = new BlobFile(indexName, false);
+
+		// index file already exists: read meta info, check it against the parameters, and load the directory
+		headerPageNum = file->getFirstPageNo();
+
+		Page *metaPage;
+		bufMgr->readPage(file, headerPageNum, metaPage);
+		HashMetaInfo *metaInfo = reinterpret_cast<HashMetaInfo*>(metaPage);
+		bool matches = strncmp(metaInfo->relationName, relationName.c_str(), sizeof(metaInfo->relationName)) == 0
+			&& metaInfo->attrByteOffset == attrByteOffset
+			&& metaInfo->attrType == attrType;
+		globalDepth = metaInfo->globalDepth;
+		directoryPageNos.assign(metaInfo->directoryPageNos, metaInfo->directoryPageNos + metaInfo->numDirectoryPages);
+		bufMgr->unPinPage(file, headerPageNum, false);
+
+		if (!matches)
+		{
+			delete file;
+			throw BadIndexInfoException(indexName);
+		}
+
+		directory.resize(1 << globalDepth);
+		for (size_t p = 0; p < directoryPageNos.size(); p++)
+		{
+			Page *page;
+			bufMgr->readPage(file, directoryPageNos[p], page);
+			const size_t first = p * DIRECTORYPAGESIZE;
+			const size_t count = std::min(directory.size() - first, (size_t)DIRECTORYPAGESIZE);
+			memcpy(&directory[first], reinterpret_cast<const DirectoryEntry*>(page), count * sizeof(DirectoryEntry));
+			bufMgr->unPinPage(file, directoryPageNos[p], false);
+		}
+		return;
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+
+	// index file doesn't already exist: create it with a meta page and a directory of one slot and one bucket
+	file = new BlobFile(indexName, true);
+
+	Page *metaPage;
+	bufMgr->allocPage(file, headerPageNum, metaPage);
+	HashMetaInfo *metaInfo = reinterpret_cast<HashMetaInfo*>(metaPage);
+	memset(metaInfo->relationName, 0, sizeof(metaInfo->relationName));
+	relationName.copy(metaInfo->relationName, sizeof(metaInfo->relationName));
+	metaInfo->attrByteOffset = attrByteOffset;
+	metaInfo->attrType = attrType;
+	metaInfo->globalDepth = 0;
+	metaInfo->numDirectoryPages = 0;
+	bufMgr->unPinPage(file, headerPageNum, true);
+
+	DirectoryEntry slot;
+	switch (attrType)
+	{
+		case INTEGER:
+			slot.bucketPageNo = allocBucket<int>(bufMgr, file);
+			break;
+		case DOUBLE:
+			slot.bucketPageNo = allocBucket<double>(bufMgr, file);
+			break;
+		default:
+			slot.bucketPageNo = allocBucket<StringKey>(bufMgr, file);
+			break;
+	}
+	slot.localDepth = 0;
+	globalDepth = 0;
+	directory.assign(1, slot);
+	writeDirectory();
+
+	// insert entries for all of the tuples in the relation into the index
+	FileScan scan(relationName, bufMgr);
+	try
+	{
+		RecordId scanRid;
+		while(1)
+		{
+			scan.scanNext(scanRid);
+			std::string recordStr = scan.getRecord();
+			insertEntry(recordStr.c_str() + attrByteOffset, scanRid);
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+
+	writeDirectory();
+	bufMgr->flushFile(file);
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::~HashIndex -- destructor
+// -----------------------------------------------------------------------------
+
+HashIndex::~HashIndex()
+{
+	try
+	{
+		writeDirectory();
+		bufMgr->flushFile(file);
+	}
+	catch(const BadgerDbException &e)
+	{
+		std::cerr << "HashIndex: " << e.message() << std::endl;
+	}
+	delete file;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void HashIndex::insertEntry(const void *key, const RecordId rid)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	switch (attributeType)
+	{
+		case INTEGER:
+			insertEntryTyped<int>(KeyTraits<int>::read(key), rid);
+			break;
+		case DOUBLE:
+			insertEntryTyped<double>(KeyTraits<double>::read(key), rid);
+			break;
+		default:
+			insertEntryTyped<StringKey>(KeyTraits<StringKey>::read(key), rid);
+			break;
+	}
+}
+
+template <class T>
+void HashIndex::insertEntryTyped(const T& key, const RecordId rid)
+{
+	const std::uint64_t hash = hashKey(key);
+	while (true)
+	{
+		const DirectoryEntry slot = directory[hash & ((1ULL << globalDepth) - 1)];
+		if (insertIntoChain<T>(slot.bucketPageNo, key, rid, false))
+		{
+			return;
+		}
+
+		// splitting cannot help a bucket whose keys all hash alike, such as duplicates of one key
+		if (slot.localDepth >= MAXGLOBALDEPTH || bucketHashesAlike<T>(hash))
+		{
+			insertIntoChain<T>(slot.bucketPageNo, key, rid, true);
+			return;
+		}
+		splitBucket<T>(hash);
+	}
+}
+
+template <class T>
+bool HashIndex::insertIntoChain(PageId pageNo, const T& key, const RecordId rid, bool appendOverflow)
+{
+	while (true)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		LeafNode<T> *bucket = reinterpret_cast<LeafNode<T>*>(page);
+		if (bucket->insertAt(bucket->upperBound(key), key, rid))
+		{
+			bufMgr->unPinPage(file, pageNo, true);
+			return true;
+		}
+
+		const PageId nextPageNo = bucket->rightSibPageNo;
+		if (nextPageNo == Page::INVALID_NUMBER)
+		{
+			if (!appendOverflow)
+			{
+				bufMgr->unPinPage(file, pageNo, false);
+				return false;
+			}
+			PageId overflowPageNo;
+			Page *overflowPage;
+			bufMgr->allocPage(file, overflowPageNo, overflowPage);
+			LeafNode<T> *overflow = reinterpret_cast<LeafNode<T>*>(overflowPage);
+			overflow->init();
+			overflow->insertAt(0, key, rid);
+			bucket->rightSibPageNo = overflowPageNo;
+			bufMgr->unPinPage(file, overflowPageNo, true);
+			bufMgr->unPinPage(file, pageNo, true);
+			return true;
+		}
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+}
+
+template <class T>
+bool HashIndex::bucketHashesAlike(std::uint64_t hash)
+{
+	const std::uint64_t mask = (1ULL << MAXGLOBALDEPTH) - 1;
+	PageId pageNo = directory[hash & ((1ULL << globalDepth) - 1)].bucketPageNo;
+	bool alike = true;
+	while (alike && pageNo != Page::INVALID_NUMBER)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		const LeafNode<T> *bucket = reinterpret_cast<const LeafNode<T>*>(page);
+		for (int i = 0; alike && i < bucket->numKeys; i++)
+		{
+			alike = ((hashKey(bucket->keyAt(i)) ^ hash) & mask) == 0;
+		}
+		const PageId nextPageNo = bucket->rightSibPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+	return alike;
+}
+
+template <class T>
+void HashIndex::splitBucket(std::uint64_t hash)
+{
+	const DirectoryEntry old = directory[hash & ((1ULL << globalDepth) - 1)];
+	if (old.localDepth == globalDepth)
+	{
+		doubleDirectory();
+	}
+
+	// take every entry out of the bucket and its overflow pages; the bucket page stays, the overflow pages go
+	std::vector< std::pair<T, RecordId> > entries;
+	Page *page;
+	bufMgr->readPage(file, old.bucketPageNo, page);
+	LeafNode<T> *bucket = reinterpret_cast<LeafNode<T>*>(page);
+	PageId pageNo = bucket->rightSibPageNo;
+	for (int i = 0; i < bucket->numKeys; i++)
+	{
+		entries.push_back(std::make_pair(bucket->keyAt(i), bucket->ridAt(i)));
+	}
+	bucket->init();
+	while (pageNo != Page::INVALID_NUMBER)
+	{
+		Page *overflowPage;
+		bufMgr->readPage(file, pageNo, overflowPage);
+		const LeafNode<T> *overflow = reinterpret_cast<const LeafNode<T>*>(overflowPage);
+		for (int i = 0; i < overflow->numKeys; i++)
+		{
+			entries.push_back(std::make_pair(overflow->keyAt(i), overflow->ridAt(i)));
+		}
+		const PageId nextPageNo = overflow->rightSibPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		bufMgr->disposePage(file, pageNo);
+		pageNo = nextPageNo;
+	}
+
+	// the pages of the chain were each sorted, but not the chain as a whole
+	std::stable_sort(entries.begin(), entries.end(),
+	                 [](const std::pair<T, RecordId>& e1, const std::pair<T, RecordId>& e2) { return e1.first < e2.first; });
+
+	// entries whose next hash bit is set move to the new bucket; appending in key order keeps both sorted
+	PageId siblingPageNo;
+	Page *siblingPage;
+	bufMgr->allocPage(file, siblingPageNo, siblingPage);
+	LeafNode<T> *sibling = reinterpret_cast<LeafNode<T>*>(siblingPage);
+	sibling->init();
+	std::vector< std::pair<T, RecordId> > leftOver;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		LeafNode<T> *target = (hashKey(entries[i].first) >> old.localDepth) & 1 ? sibling : bucket;
+		if (!target->insertAt(target->numKeys, entries[i].first, entries[i].second))
+		{
+			leftOver.push_back(entries[i]);
+		}
+	}
+	bufMgr->unPinPage(file, siblingPageNo, true);
+	bufMgr->unPinPage(file, old.bucketPageNo, true);
+
+	// every slot that pointed to the bucket now looks at one more bit
+	const std::uint64_t step = 1ULL << old.localDepth;
+	for (std::uint64_t i = hash & (step - 1); i < directory.size(); i += step)
+	{
+		directory[i].localDepth = old.localDepth + 1;
+		if ((i >> old.localDepth) & 1)
+		{
+			directory[i].bucketPageNo = siblingPageNo;
+		}
+	}
+
+	// a bucket that had overflow pages may still not fit into one page per side
+	for (size_t i = 0; i < leftOver.size(); i++)
+	{
+		const PageId targetPageNo = (hashKey(leftOver[i].first) >> old.localDepth) & 1 ? siblingPageNo : old.bucketPageNo;
+		insertIntoChain<T>(targetPageNo, leftOver[i].first, leftOver[i].second, true);
+	}
+}
+
+void HashIndex::doubleDirectory()
+{
+	const size_t size = directory.size();
+	directory.resize(2 * size);
+	std::copy(directory.begin(), directory.begin() + size, directory.begin() + size);
+	globalDepth++;
+}
+
+void HashIndex::writeDirectory()
+{
+	const size_t numPages = (directory.size() + DIRECTORYPAGESIZE - 1) / DIRECTORYPAGESIZE;
+	for (size_t p = 0; p < numPages; p++)
+	{
+		Page *page;
+		if (p < directoryPageNos.size())
+		{
+			bufMgr->readPage(file, directoryPageNos[p], page);
+		}
+		else
+		{
+			PageId pageNo;
+			bufMgr->allocPage(file, pageNo, page);
+			directoryPageNos.push_back(pageNo);
+		}
+		const size_t first = p * DIRECTORYPAGESIZE;
+		const size_t count = std::min(directory.size() - first, (size_t)DIRECTORYPAGESIZE);
+		memcpy(reinterpret_cast<DirectoryEntry*>(page), &directory[first], count * sizeof(DirectoryEntry));
+		bufMgr->unPinPage(file, directoryPageNos[p], true);
+	}
+
+	Page *metaPage;
+	bufMgr->readPage(file, headerPageNum, metaPage);
+	HashMetaInfo *metaInfo = reinterpret_cast<HashMetaInfo*>(metaPage);
+	metaInfo->globalDepth = globalDepth;
+	metaInfo->numDirectoryPages = directoryPageNos.size();
+	std::copy(directoryPageNos.begin(), directoryPageNos.end(), metaInfo->directoryPageNos);
+	bufMgr->unPinPage(file, headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::deleteEntry
+// -----------------------------------------------------------------------------
+
+void HashIndex::deleteEntry(const void *key, const RecordId rid)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	bool found = false;
+	switch (attributeType)
+	{
+		case INTEGER:
+			found = deleteEntryTyped<int>(KeyTraits<int>::read(key), rid);
+			break;
+		case DOUBLE:
+			found = deleteEntryTyped<double>(KeyTraits<double>::read(key), rid);
+			break;
+		default:
+			found = deleteEntryTyped<StringKey>(KeyTraits<StringKey>::read(key), rid);
+			break;
+	}
+	if (!found)
+	{
+		throw NoSuchKeyFoundException();
+	}
+}
+
+template <class T>
+bool HashIndex::deleteEntryTyped(const T& key, const RecordId rid)
+{
+	PageId prevPageNo = Page::INVALID_NUMBER;
+	PageId pageNo = directory[hashKey(key) & ((1ULL << globalDepth) - 1)].bucketPageNo;
+	while (pageNo != Page::INVALID_NUMBER)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		LeafNode<T> *bucket = reinterpret_cast<LeafNode<T>*>(page);
+		const PageId nextPageNo = bucket->rightSibPageNo;
+		for (int pos = bucket->lowerBound(key); pos < bucket->numKeys && bucket->keyAt(pos) == key; pos++)
+		{
+			if (bucket->ridAt(pos) == rid)
+			{
+				bucket->removeAt(pos);
+				const bool emptyOverflow = bucket->numKeys == 0 && prevPageNo != Page::INVALID_NUMBER;
+				bufMgr->unPinPage(file, pageNo, true);
+
+				// an empty overflow page is unlinked from the chain and given back to the file
+				if (emptyOverflow)
+				{
+					Page *prevPage;
+					bufMgr->readPage(file, prevPageNo, prevPage);
+					reinterpret_cast<LeafNode<T>*>(prevPage)->rightSibPageNo = nextPageNo;
+					bufMgr->unPinPage(file, prevPageNo, true);
+					bufMgr->disposePage(file, pageNo);
+				}
+				return true;
+			}
+		}
+		bufMgr->unPinPage(file, pageNo, false);
+		prevPageNo = pageNo;
+		pageNo = nextPageNo;
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::lookupEntry
+// -----------------------------------------------------------------------------
+
+void HashIndex::lookupEntry(const void *key, RecordId& outRid)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	bool found = false;
+	switch (attributeType)
+	{
+		case INTEGER:
+			found = lookupEntryTyped<int>(KeyTraits<int>::read(key), outRid);
+			break;
+		case DOUBLE:
+			found = lookupEntryTyped<double>(KeyTraits<double>::read(key), outRid);
+			break;
+		default:
+			found = lookupEntryTyped<StringKey>(KeyTraits<StringKey>::read(key), outRid);
+			break;
+	}
+	if (!found)
+	{
+		throw NoSuchKeyFoundException();
+	}
+}
+
+template <class T>
+bool HashIndex::lookupEntryTyped(const T& key, RecordId& outRid)
+{
+	PageId pageNo = directory[hashKey(key) & ((1ULL << globalDepth) - 1)].bucketPageNo;
+	while (pageNo != Page::INVALID_NUMBER)
+	{
+		Page *page;
+		bufMgr->readPage(file, pageNo, page);
+		const LeafNode<T> *bucket = reinterpret_cast<const LeafNode<T>*>(page);
+		const int pos = bucket->lowerBound(key);
+		if (pos < bucket->numKeys && bucket->keyAt(pos) == key)
+		{
+			outRid = bucket->ridAt(pos);
+			bufMgr->unPinPage(file, pageNo, false);
+			return true;
+		}
+		const PageId nextPageNo = bucket->rightSibPageNo;
+		bufMgr->unPinPage(file, pageNo, false);
+		pageNo = nextPageNo;
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// HashIndex::computeShape
+// -----------------------------------------------------------------------------
+
+void HashIndex::computeShape(int& depth, int& buckets, int& overflowPages)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	depth = globalDepth;
+	buckets = 0;
+	overflowPages = 0;
+	switch (attributeType)
+	{
+		case INTEGER:
+			computeShapeTyped<int>(buckets, overflowPages);
+			break;
+		case DOUBLE:
+			computeShapeTyped<double>(buckets, overflowPages);
+			break;
+		default:
+			computeShapeTyped<StringKey>(buckets, overflowPages);
+			break;
+	}
+}
+
+template <class T>
+void HashIndex::computeShapeTyped(int& buckets, int& overflowPages)
+{
+	// a bucket of local depth d is counted at the first of its slots, the one below 2^d
+	for (size_t i = 0; i < directory.size(); i++)
+	{
+		if ((i >> directory[i].localDepth) != 0)
+		{
+			continue;
+		}
+		buckets++;
+
+		Page *page;
+		bufMgr->readPage(file, directory[i].bucketPageNo, page);
+		PageId pageNo = reinterpret_cast<const LeafNode<T>*>(page)->rightSibPageNo;
+		bufMgr->unPinPage(file, directory[i].bucketPageNo, false);
+		while (pageNo != Page::INVALID_NUMBER)
+		{
+			overflowPages++;
+			bufMgr->readPage(file, pageNo, page);
+			const PageId nextPageNo = reinterpret_cast<const LeafNode<T>*>(page)->rightSibPageNo;
+			bufMgr->unPinPage(file, pageNo, false);
+			pageNo = nextPageNo;
+		}
+	}
+}
+
+}
@@ -0,0 +1,274 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Largest global depth of the directory of a HashIndex, which then has 2^MAXGLOBALDEPTH slots.
+ * A bucket whose local depth reaches it is no longer split, and takes more entries in overflow pages.
+ */
+const  int MAXGLOBALDEPTH = 20;
+
+/**
+ * @brief Slot of the directory of a HashIndex.
+ */
+struct DirectoryEntry {
+  /**
+   * Page number of the bucket that the keys hashed to this slot go to.
+   */
+	PageId bucketPageNo;
+
+  /**
+   * Number of low bits of the hash that all keys in the bucket share. The bucket is pointed to by
+   * 2^(globalDepth - localDepth) slots.
+   */
+	int localDepth;
+};
+
+/**
+ * @brief Number of directory slots stored in one directory page.
+ */
+const  int DIRECTORYPAGESIZE = Page::SIZE / sizeof( DirectoryEntry );
+
+/**
+ * @brief The meta page of a hash index file, always its first page.
+ * Besides the attribute the index is built over, it lists the pages the directory is stored in.
+ */
+struct HashMetaInfo {
+  /**
+   * Name of base relation.
+   */
+	char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored in pages.
+   */
+	int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+	Datatype attrType;
+
+  /**
+   * Global depth of the directory, which has 2^globalDepth slots.
+   */
+	int globalDepth;
+
+  /**
+   * Number of directory pages in use.
+   */
+	int numDirectoryPages;
+
+  /**
+   * Page numbers of the directory pages, each holding DIRECTORYPAGESIZE slots in order.
+   */
+	PageId directoryPageNos[ ( 1 << MAXGLOBALDEPTH ) / DIRECTORYPAGESIZE ];
+};
+
+static_assert(sizeof(HashMetaInfo) <= Page::SIZE, "The hash index meta page must fit in a page.");
+
+/**
+ * @brief HashIndex class. It implements a disk-resident extendible hashing index on a single attribute of a
+ * relation, for equality lookups that read a single bucket page instead of a root-to-leaf path.
+ *
+ * A directory of 2^globalDepth slots, indexed by the low bits of the hash of a key, points to buckets. A bucket is a
+ * page laid out as a B+ tree leaf (LeafNode<T>), whose entries are kept sorted so that it is searched by bisection;
+ * its sibling pointer chains overflow pages, used only when a bucket cannot be split any further. A full bucket
+ * is split in two on the next bit of the hash, doubling the directory when its local depth equals the global depth.
+ * The directory is kept in memory while the index is open and written to its directory pages when it is closed.
+ *
+ * All public methods may be called from several threads; they take turns on a mutex.
+ */
+class HashIndex {
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Global depth of the directory.
+   */
+	int			globalDepth;
+
+  /**
+   * Slots of the directory, 2^globalDepth of them.
+   */
+	std::vector<DirectoryEntry>	directory;
+
+  /**
+   * Page numbers of the pages the directory is stored in.
+   */
+	std::vector<PageId>	directoryPageNos;
+
+  /**
+   * Serializes the public methods.
+   */
+	std::mutex	mutex;
+
+ public:
+
+  /**
+   * HashIndex Constructor.
+	 * Check to see if the corresponding index file exists. If so, open the file.
+	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+   * @param attrType						Datatype of attribute over which index is built: INTEGER, DOUBLE or STRING
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters,
+   *                                    or if attrType is COMPOSITE.
+   */
+	HashIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+
+
+  /**
+   * HashIndex Destructor.
+	 * Write the directory to its pages, flush index file from the buffer manager and delete file instance thereby
+	 * closing the index file. Does not throw any exceptions.
+	 * */
+	~HashIndex();
+
+
+  /**
+	 * Insert a new entry using the pair <value,rid>. A full bucket is split, or given an overflow page if all its
+	 * keys hash alike.
+   * @param key			Key to insert, pointer to integer/double/char string
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+	**/
+	void insertEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Delete the entry <key,rid>. Overflow pages left empty are given back to the index file; buckets are not merged.
+   * @param key			Key to delete, pointer to integer/double/char string
+   * @param rid			Record ID stored with the key
+	 * @throws  NoSuchKeyFoundException If the index has no entry <key,rid>.
+	**/
+	void deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Look up the first entry with the given key. Reads the key's bucket and, if it has any, its overflow pages.
+   * @param key			Key to look up, pointer to integer/double/char string
+   * @param outRid	Record ID stored with the key returned in this
+	 * @throws  NoSuchKeyFoundException If the index has no entry with this key.
+	**/
+	void lookupEntry(const void* key, RecordId& outRid);
+
+
+  /**
+	 * Reports the shape of the index. Takes time linear in the number of buckets; meant for tests and benchmarks.
+   * @param depth			Set to the global depth of the directory
+   * @param buckets			Set to the number of buckets
+   * @param overflowPages	Set to the number of overflow pages
+	**/
+	void computeShape(int& depth, int& buckets, int& overflowPages);
+
+ private:
+
+  /**
+   * Typed body of insertEntry().
+   */
+	template <class T>
+	void insertEntryTyped(const T& key, const RecordId rid);
+
+  /**
+   * Typed body of deleteEntry().
+   * @return False if the index has no such entry.
+   */
+	template <class T>
+	bool deleteEntryTyped(const T& key, const RecordId rid);
+
+  /**
+   * Typed body of lookupEntry().
+   * @return False if the index has no entry with this key.
+   */
+	template <class T>
+	bool lookupEntryTyped(const T& key, RecordId& outRid);
+
+  /**
+   * Splits the bucket that hash leads to on its next bit, doubling the directory first if
+   * the bucket's local depth equals the global depth. The entries of its overflow pages are redistributed as well,
+   * and the overflow pages given back.
+   */
+	template <class T>
+	void splitBucket(std::uint64_t hash);
+
+  /**
+   * Returns true if every entry in the bucket of the directory slot for hash has a hash equal to it in the low
+   * MAXGLOBALDEPTH bits, so that splitting the bucket cannot separate them.
+   */
+	template <class T>
+	bool bucketHashesAlike(std::uint64_t hash);
+
+  /**
+   * Inserts the entry into the first page with room of the bucket chain starting at pageNo.
+   * @param appendOverflow	True to append an overflow page to the chain if every page is full
+   * @return False if every page is full and appendOverflow is false.
+   */
+	template <class T>
+	bool insertIntoChain(PageId pageNo, const T& key, const RecordId rid, bool appendOverflow);
+
+  /**
+   * Doubles the directory: slot i + 2^globalDepth points to the same bucket as slot i.
+   */
+	void doubleDirectory();
+
+  /**
+   * Writes the directory to its pages, allocating more of them if it grew, and records them in the meta page.
+   */
+	void writeDirectory();
+
+  /**
+   * Typed body of computeShape().
+   */
+	template <class T>
+	void computeShapeTyped(int& buckets, int& overflowPages);
+};
+
+}
@@ -6,19 +6,38 @@
  */
 
 #include <vector>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include "btree.h"
+#include "hash_index.h"
+#include "trace_sim.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
 #include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_page_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/corrupt_page_exception.h"
+#include "exceptions/read_only_file_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/pool_not_found_exception.h"
+#include "exceptions/bad_trace_exception.h"
+#include "exceptions/log_io_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -42,7 +61,8 @@ using namespace badgerdb;
 const std::string relationName = "relA";
 //If the relation size is changed then the second parameter 2 chechPassFail may need to be changed to number of record that are expected to be found during the scan, else tests will erroneously be reported to have failed.
 const int	relationSize = 5000;
-std::string intIndexName, doubleIndexName, stringIndexName;
+std::string intIndexName, doubleIndexName, stringIndexName, compositeIndexName;
+std::string intHashIndexName, doubleHashIndexName, stringHashIndexName;
 
 // This is the structure for tuples in the base relation
 
@@ -68,6 +88,50 @@ void createRelationBackward();
 void createRelationRandom();
 void intTests();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void doubleTests();
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+void stringTests();
+void prefixStringTests();
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int countScan(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp);
+int batchLookup(BTreeIndex *index, Datatype type, int lowVal, int highVal, int step);
+void cursorTests();
+int interleavedCursorScan(BTreeIndex *index, int splitVal);
+int nestedCursorScan(BTreeIndex *index, int outerHigh, int innerHigh);
+int cursorScanWhileDeleting(BTreeIndex *index, int deleteFrom);
+int batchScan(BTreeIndex *index, int lowVal, int highVal, size_t batchSize);
+void batchTests();
+int batchMatchesScan(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp,
+	size_t batchSize);
+void statsTests();
+bool statsMatchShape(BTreeIndex *index);
+void reopenTests();
+void changeTests();
+void directChangeTests();
+void walTests();
+void checksumTests();
+void damagePage(const std::string &filename, PageId pageNo);
+void mapTests();
+void readIntoTests();
+void resizeTests();
+void resizeLoop(BufMgr *resizeBufMgr, std::atomic<bool> *done);
+void poolTests();
+void metricsTests();
+void frameTests();
+void traceTests();
+std::string makeRecord(int i);
+void deleteTests();
+void deleteEntries(BTreeIndex *index, int attrByteOffset, int parity);
+void concurrentTests();
+void concurrentInserts(BTreeIndex *index, int thread, std::atomic<int> *missing);
+void concurrentDeletes(BTreeIndex *index, int thread, std::atomic<int> *missing);
+int countConcurrentKeys(BTreeIndex *index);
+void coveringTests();
+int includedSum(BTreeIndex *index, int lowVal, int highVal);
+void compositeTests();
+int prefixScan(BTreeIndex *index, const void* const* values, int numValues);
+void hashTests();
+int hashLookups(HashIndex *index, Datatype type, int lowVal, int highVal);
 void indexTests();
 void test1();
 void test2();
@@ -353,43 +417,2170 @@ void indexTests()
   catch(const FileNotFoundException &e)
   {
   }
+
+  cursorTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  batchTests();
+	try
+	{
+		File::remove(intIndexName);
+		File::remove(doubleIndexName);
+		File::remove(stringIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  doubleTests();
+	try
+	{
+		File::remove(doubleIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  stringTests();
+	try
+	{
+		File::remove(stringIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  prefixStringTests();
+	try
+	{
+		File::remove(stringIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  deleteTests();
+	try
+	{
+		File::remove(intIndexName);
+		File::remove(stringIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  concurrentTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  statsTests();
+	try
+	{
+		File::remove(intIndexName);
+		File::remove(doubleIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  reopenTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  changeTests();
+  directChangeTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  walTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  checksumTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  mapTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  readIntoTests();
+
+  resizeTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  poolTests();
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  metricsTests();
+  frameTests();
+  traceTests();
+
+  coveringTests();
+	try
+	{
+		File::remove(intIndexName);
+		File::remove(stringIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  compositeTests();
+	try
+	{
+		File::remove(compositeIndexName);
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  hashTests();
+	try
+	{
+		File::remove(intHashIndexName);
+		File::remove(doubleHashIndexName);
+		File::remove(stringHashIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+}
+
+// -----------------------------------------------------------------------------
+// intTests
+// -----------------------------------------------------------------------------
+
+void intTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// run some tests
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(intScan(&index,0,GT,1,LT), 0)
+	checkPassFail(intScan(&index,300,GT,400,LT), 99)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(batchLookup(&index, INTEGER, -50, 5050, 3), 1667)
+}
+
+int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	return countScan(index, &lowVal, lowOp, &highVal, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// cursorTests
+// -----------------------------------------------------------------------------
+
+void cursorTests()
+{
+  std::cout << "Scan a B+ Tree index on the integer field with several cursors" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	checkPassFail(interleavedCursorScan(&index, 2500), relationSize)
+	checkPassFail(nestedCursorScan(&index, 10, 20), 200)
+	checkPassFail(cursorScanWhileDeleting(&index, 1000), 3000)
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(batchScan(&index, 300, 400, 7), 99)
+	checkPassFail(batchScan(&index, 0, relationSize, 1000), relationSize - 1)
+}
+
+// Counts the entries of (lowVal,highVal) fetched batchSize at a time, checking that only the last batch comes up
+// short and that the scan keeps reporting its end after
+int batchScan(BTreeIndex *index, int lowVal, int highVal, size_t batchSize)
+{
+	std::vector<RecordId> rids(batchSize);
+	int numResults = 0;
+	size_t numRids;
+	index->startScan(&lowVal, GT, &highVal, LT);
+	do
+	{
+		numRids = index->scanNextBatch(&rids[0], batchSize);
+		numResults += numRids;
+	} while (numRids == batchSize);
+
+	if (index->scanNextBatch(&rids[0], batchSize) != 0)
+	{
+		std::cout << "Batch returned after the end of the scan" << std::endl;
+		return -1;
+	}
+	index->endScan();
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// batchTests
+// -----------------------------------------------------------------------------
+
+void batchTests()
+{
+	// batches of one, of sizes that end just before, on and after multiples of 64 entries, and of a leaf's worth,
+	// so that batches end at every offset within a leaf and on the leaf boundaries
+	const size_t batchSizes[] = {1, 63, 64, 65, INTARRAYLEAFSIZE / 2, INTARRAYLEAFSIZE, INTARRAYLEAFSIZE + 1};
+	const int numBatchSizes = sizeof(batchSizes) / sizeof(batchSizes[0]);
+
+	{
+		std::cout << "Scan a B+ Tree index on the integer field in batches" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int low = 0, high = relationSize, mid = 300, midHigh = 400, none = 1;
+		for (int i = 0; i < numBatchSizes; i++)
+		{
+			checkPassFail(batchMatchesScan(&index, &low, GTE, &high, LT, batchSizes[i]), relationSize)
+			checkPassFail(batchMatchesScan(&index, &mid, GT, &midHigh, LTE, batchSizes[i]), 100)
+			checkPassFail(batchMatchesScan(&index, &low, GT, &none, LT, batchSizes[i]), 0)
+		}
+	}
+
+	{
+		std::cout << "Scan a B+ Tree index on the double field in batches" << std::endl;
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		double low = -1, high = relationSize, mid = 24.5, midHigh = 3000.5;
+		for (int i = 0; i < numBatchSizes; i++)
+		{
+			checkPassFail(batchMatchesScan(&index, &low, GT, &high, LTE, batchSizes[i]), relationSize)
+			checkPassFail(batchMatchesScan(&index, &mid, GTE, &midHigh, LT, batchSizes[i]), 2976)
+		}
+	}
+
+	{
+		std::cout << "Scan a B+ Tree index on the string field in batches" << std::endl;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		char low[100], high[100];
+		sprintf(low, "%05d string record", 1000);
+		sprintf(high, "%05d string record", 4000);
+		for (int i = 0; i < numBatchSizes; i++)
+		{
+			checkPassFail(batchMatchesScan(&index, low, GTE, high, LT, batchSizes[i]), 3000)
+		}
+	}
+}
+
+// Scans a range with scanNext and again batchSize record ids at a time with scanNextBatch, checking that both
+// return the same record ids in the same order, that only the last batch comes up short and that the batch scan
+// keeps reporting its end after. Returns the number of record ids, or -1 if the scans disagree.
+int batchMatchesScan(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp,
+	size_t batchSize)
+{
+	std::vector<RecordId> expected;
+	RecordId scanRid;
+	try
+	{
+		index->startScan(lowVal, lowOp, highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+		expected.push_back(scanRid);
+	}
+	index->endScan();
+
+	std::vector<RecordId> actual;
+	std::vector<RecordId> rids(batchSize);
+	size_t numRids;
+	index->startScan(lowVal, lowOp, highVal, highOp);
+	do
+	{
+		numRids = index->scanNextBatch(&rids[0], batchSize);
+		actual.insert(actual.end(), rids.begin(), rids.begin() + numRids);
+	} while (numRids == batchSize);
+	const size_t afterEnd = index->scanNextBatch(&rids[0], batchSize);
+	index->endScan();
+
+	if (afterEnd != 0)
+	{
+		std::cout << "Batch of " << batchSize << " returned after the end of the scan" << std::endl;
+		return -1;
+	}
+	if (actual.size() != expected.size())
+	{
+		std::cout << "Batches of " << batchSize << " returned " << actual.size() << " record ids, scanNext "
+			<< expected.size() << std::endl;
+		return -1;
+	}
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		if (actual[i] != expected[i])
+		{
+			std::cout << "Batches of " << batchSize << " disagree with scanNext at record id " << i << std::endl;
+			return -1;
+		}
+	}
+	return expected.size();
+}
+
+// Scans the keys below and from splitVal on two cursors in turns, checking that each stays in order
+int interleavedCursorScan(BTreeIndex *index, int splitVal)
+{
+	int zero = 0, high = relationSize;
+	IndexCursor low, upper;
+	index->startScan(low, &zero, GTE, &splitVal, LT);
+	index->startScan(upper, &splitVal, GTE, &high, LT);
+
+	int numResults = 0;
+	bool lowDone = false, upperDone = false;
+	std::vector<RecordId> lowRids, upperRids;
+	while (!lowDone || !upperDone)
+	{
+		RecordId scanRid;
+		try
+		{
+			if (!lowDone)
+			{
+				index->scanNext(low, scanRid);
+				lowRids.push_back(scanRid);
+				numResults++;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			lowDone = true;
+		}
+		try
+		{
+			if (!upperDone)
+			{
+				index->scanNext(upper, scanRid);
+				upperRids.push_back(scanRid);
+				numResults++;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			upperDone = true;
+		}
+	}
+	index->endScan(low);
+	index->endScan(upper);
+
+	// both cursors have to return their keys in order, as a single scan does
+	for (size_t i = 0; i < lowRids.size() + upperRids.size(); i++)
+	{
+		const RecordId &scanRid = i < lowRids.size() ? lowRids[i] : upperRids[i - lowRids.size()];
+		Page *curPage;
+		bufMgr->readPage(file1, scanRid.page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+		bufMgr->unPinPage(file1, scanRid.page_number, false);
+		if (myRec.i != (int)i)
+		{
+			std::cout << "Cursor returned key " << myRec.i << " in place of " << i << std::endl;
+			return -1;
+		}
+	}
+	return numResults;
+}
+
+// Counts the pairs of an outer scan over [0,outerHigh) and an inner scan over [0,innerHigh) started for each of
+// its entries, as a nested-loop join does
+int nestedCursorScan(BTreeIndex *index, int outerHigh, int innerHigh)
+{
+	int zero = 0;
+	IndexCursor outer, inner;
+	index->startScan(outer, &zero, GTE, &outerHigh, LT);
+
+	int numResults = 0;
+	try
+	{
+		while (1)
+		{
+			RecordId outerRid;
+			index->scanNext(outer, outerRid);
+
+			index->startScan(inner, &zero, GTE, &innerHigh, LT);
+			try
+			{
+				while (1)
+				{
+					RecordId innerRid;
+					index->scanNext(inner, innerRid);
+					numResults++;
+				}
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+			}
+		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index->endScan(inner);
+	index->endScan(outer);
+	return numResults;
+}
+
+// Scans the whole index, deleting the even keys from deleteFrom on once deleteFrom entries have been returned. The
+// deletes merge the leaves ahead of the cursor, which has to find its place again. The entries are put back after.
+int cursorScanWhileDeleting(BTreeIndex *index, int deleteFrom)
+{
+	int zero = 0, high = relationSize;
+	std::vector<RecordId> rids;
+	IndexCursor cursor;
+	index->startScan(cursor, &zero, GTE, &high, LT);
+	try
+	{
+		while (1)
+		{
+			RecordId scanRid;
+			index->scanNext(cursor, scanRid);
+			rids.push_back(scanRid);
+		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+
+	int numResults = 0;
+	index->startScan(cursor, &zero, GTE, &high, LT);
+	try
+	{
+		while (1)
+		{
+			RecordId scanRid;
+			index->scanNext(cursor, scanRid);
+			numResults++;
+
+			if (numResults == deleteFrom)
+			{
+				for (int key = deleteFrom; key < relationSize; key += 2)
+					index->deleteEntry(&key, rids[key]);
+			}
+		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index->endScan(cursor);
+
+	for (int key = deleteFrom; key < relationSize; key += 2)
+		index->insertEntry(&key, rids[key]);
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
+
+void doubleTests()
+{
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,300,GT,400,LT), 99)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(doubleScan(&index,24.5,GT,26.5,LT), 2)
+}
+
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
+{
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	return countScan(index, &lowVal, lowOp, &highVal, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests()
+{
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+// -----------------------------------------------------------------------------
+// prefixStringTests
+// -----------------------------------------------------------------------------
+
+void prefixStringTests()
+{
+  std::cout << "Create a prefix-compressed B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, true);
+
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(batchLookup(&index, STRING, -50, 5050, 3), 1667)
+
+	// an index with fixed-width slots on the same field has a file of its own
+	std::string fixedName;
+	{
+		BTreeIndex fixed(relationName, fixedName, bufMgr, offsetof(tuple,s), STRING);
+		checkPassFail((fixedName != stringIndexName), true)
+		checkPassFail(stringScan(&fixed,300,GT,400,LT), 99)
+	}
+	File::remove(fixedName);
+}
+
+// -----------------------------------------------------------------------------
+// deleteTests
+// -----------------------------------------------------------------------------
+
+void deleteTests()
+{
+	{
+		std::cout << "Delete entries from a B+ Tree index on the integer field" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		// removing the even keys merges and redistributes leaves
+		deleteEntries(&index, offsetof(tuple,i), 0);
+		checkPassFail(intScan(&index,25,GT,40,LT), 7)
+		checkPassFail(intScan(&index,-3,GT,3,LT), 1)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 500)
+
+		// compaction rewrites the tree into a fresh file without changing its contents
+		index.compact();
+		checkPassFail(intScan(&index,25,GT,40,LT), 7)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 500)
+
+		deleteEntries(&index, offsetof(tuple,i), 1);
+		checkPassFail(intScan(&index,-3,GT,5001,LT), 0)
+	}
+
+	{
+		std::cout << "Delete entries from a prefix-compressed B+ Tree index on the string field" << std::endl;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, true);
+		index.setMergeThreshold(0.1);
+
+		deleteEntries(&index, offsetof(tuple,s), 1);
+		checkPassFail(stringScan(&index,25,GT,40,LT), 7)
+		checkPassFail(stringScan(&index,300,GT,400,LT), 49)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT), 500)
+
+		index.compact();
+	}
+
+	{
+		std::cout << "Reopen a compacted B+ Tree index on the string field" << std::endl;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, true);
+		checkPassFail(stringScan(&index,25,GT,40,LT), 7)
+		checkPassFail(stringScan(&index,300,GT,400,LT), 49)
+	}
+
+	{
+		std::cout << "Delete a BlobFile page twice" << std::endl;
+		const std::string blobName = "blob.free";
+		try
+		{
+			File::remove(blobName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+		{
+			BlobFile blob = BlobFile::create(blobName);
+			PageId pageNos[3];
+			for (int i = 0; i < 3; i++)
+			{
+				blob.allocatePage(pageNos[i]);
+			}
+			blob.deletePage(pageNos[1]);
+
+			// the second free is refused, and leaves the free list as it was
+			int refused = 0;
+			try
+			{
+				blob.deletePage(pageNos[1]);
+			}
+			catch(const InvalidPageException &e)
+			{
+				refused++;
+			}
+			checkPassFail(refused, 1)
+			checkPassFail(blob.getNumFreePages(), 1)
+
+			PageId reused, appended;
+			blob.allocatePage(reused);
+			blob.allocatePage(appended);
+			checkPassFail(reused, pageNos[1])
+			checkPassFail((appended != reused), true)
+			checkPassFail(blob.getNumFreePages(), 0)
+
+			// a page allocated again may be freed again
+			blob.deletePage(reused);
+			checkPassFail(blob.isFreePage(reused), true)
+		}
+		File::remove(blobName);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// concurrentTests
+// -----------------------------------------------------------------------------
+
+const int concurrentThreads = 4;
+const int concurrentKeys = 2000;
+
+void concurrentTests()
+{
+	std::cout << "Insert, look up and delete entries of a B+ Tree index on the integer field from " << concurrentThreads
+		<< " threads" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	std::atomic<int> missing(0);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < concurrentThreads; t++)
+		threads.push_back(std::thread(concurrentInserts, &index, t, &missing));
+	for (int t = 0; t < concurrentThreads; t++)
+		threads[t].join();
+	checkPassFail(missing.load(), 0)
+	checkPassFail(countConcurrentKeys(&index), concurrentThreads * concurrentKeys)
+
+	threads.clear();
+	for (int t = 0; t < concurrentThreads; t++)
+		threads.push_back(std::thread(concurrentDeletes, &index, t, &missing));
+	for (int t = 0; t < concurrentThreads; t++)
+		threads[t].join();
+	checkPassFail(missing.load(), 0)
+	checkPassFail(countConcurrentKeys(&index), 0)
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+}
+
+// Inserts the keys above the relation's that belong to the thread, looking each one up again along with a key of the
+// relation. The keys of all threads interleave, so that they share leaves.
+void concurrentInserts(BTreeIndex *index, int thread, std::atomic<int> *missing)
+{
+	for (int k = 0; k < concurrentKeys; k++)
+	{
+		int key = relationSize + k * concurrentThreads + thread;
+		RecordId keyRid = { (PageId)(k + 1), (SlotId)thread, 0 };
+		index->insertEntry(&key, keyRid);
+
+		int relationKey = (k * 7 + thread) % relationSize;
+		RecordId outRid;
+		try
+		{
+			index->lookupEntry(&key, outRid);
+			if (!(outRid == keyRid))
+				(*missing)++;
+			index->lookupEntry(&relationKey, outRid);
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+			(*missing)++;
+		}
+	}
+}
+
+// Deletes the keys inserted by concurrentInserts() for the thread
+void concurrentDeletes(BTreeIndex *index, int thread, std::atomic<int> *missing)
+{
+	for (int k = 0; k < concurrentKeys; k++)
+	{
+		int key = relationSize + k * concurrentThreads + thread;
+		RecordId keyRid = { (PageId)(k + 1), (SlotId)thread, 0 };
+		try
+		{
+			index->deleteEntry(&key, keyRid);
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+			(*missing)++;
+		}
+	}
+}
+
+// Returns how many of the keys of concurrentInserts() are in the index. Their rids are made up, so they are
+// counted with lookups rather than a scan that fetches the records.
+int countConcurrentKeys(BTreeIndex *index)
+{
+	int found = 0;
+	for (int key = relationSize; key < relationSize + concurrentThreads * concurrentKeys; key++)
+	{
+		try
+		{
+			RecordId outRid;
+			index->lookupEntry(&key, outRid);
+			found++;
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+		}
+	}
+	return found;
+}
+
+// -----------------------------------------------------------------------------
+// statsTests
+// -----------------------------------------------------------------------------
+
+void statsTests()
+{
+	{
+		std::cout << "Create a B+ Tree index on the integer field and read its statistics" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		IndexStats stats = index.getStats();
+		checkPassFail(stats.formatVersion, INDEXFORMATVERSION)
+		checkPassFail(stats.numEntries, relationSize)
+		checkPassFail(stats.minKeyAs<int>(), 0)
+		checkPassFail(stats.maxKeyAs<int>(), relationSize - 1)
+		checkPassFail(statsMatchShape(&index), true)
+		checkPassFail((stats.leafFill > 0.5 && stats.leafFill <= 1), true)
+
+		// ranges outside [minKey,maxKey] are answered without reading the tree
+		checkPassFail(intScan(&index,relationSize - 1,GT,relationSize + 100,LT), 0)
+		checkPassFail(intScan(&index,-100,GT,0,LT), 0)
+		checkPassFail(intScan(&index,-100,GT,0,LTE), 1)
+		int key = relationSize;
+		RecordId outRid;
+		try
+		{
+			index.lookupEntry(&key, outRid);
+			std::cout << "lookupEntry found a key above the largest key" << std::endl;
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+		}
+	}
+
+	{
+		std::cout << "Reopen a B+ Tree index on the integer field and delete all of its entries" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		IndexStats stats = index.getStats();
+		checkPassFail(stats.numEntries, relationSize)
+		checkPassFail(stats.maxKeyAs<int>(), relationSize - 1)
+		checkPassFail(statsMatchShape(&index), true)
+
+		deleteEntries(&index, offsetof(tuple,i), 0);
+		checkPassFail(index.getStats().numEntries, relationSize / 2)
+		checkPassFail(statsMatchShape(&index), true)
+
+		// the root shrinks back to a single leaf, and the key bounds start over
+		deleteEntries(&index, offsetof(tuple,i), 1);
+		stats = index.getStats();
+		checkPassFail(stats.numEntries, 0)
+		checkPassFail(stats.height, 1)
+		checkPassFail(stats.hasKeyRange, false)
+		checkPassFail(statsMatchShape(&index), true)
+
+		int key = 42;
+		index.insertEntry(&key, rid);
+		stats = index.getStats();
+		checkPassFail(stats.minKeyAs<int>(), 42)
+		checkPassFail(stats.maxKeyAs<int>(), 42)
+		RecordId outRid;
+		index.lookupEntry(&key, outRid);
+		checkPassFail((outRid == rid), true)
+	}
+
+	{
+		std::cout << "Create a B+ Tree index on the double field and read its key range" << std::endl;
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		IndexStats stats = index.getStats();
+		checkPassFail(stats.minKeyAs<double>(), 0)
+		checkPassFail(stats.maxKeyAs<double>(), relationSize - 1)
+	}
+
+	{
+		std::cout << "Insert into a B+ Tree index whose buffer pool is full" << std::endl;
+		BufMgr fullBufMgr(16);
+		BTreeIndex index(relationName, intIndexName, &fullBufMgr, offsetof(tuple,i), INTEGER);
+		const std::int64_t numEntries = index.getStats().numEntries;
+
+		// every frame is pinned by a page of the relation, so the insert cannot read the root
+		std::vector<PageId> pageNos;
+		for (FileIterator iter = file1->begin(); iter != file1->end() && pageNos.size() < 16; ++iter)
+		{
+			Page *page;
+			fullBufMgr.readPage(file1, iter.page_number(), page);
+			pageNos.push_back(iter.page_number());
+		}
+		bool exceeded = false;
+		int key = relationSize + 1;
+		try
+		{
+			index.insertEntry(&key, rid);
+		}
+		catch(const BufferExceededException &e)
+		{
+			exceeded = true;
+		}
+		for (size_t i = 0; i < pageNos.size(); i++)
+		{
+			fullBufMgr.unPinPage(file1, pageNos[i], false);
+		}
+		checkPassFail(exceeded, true)
+		checkPassFail(index.getStats().numEntries, numEntries)
+	}
+}
+
+/**
+ * Returns true if the height and node counts of the index statistics agree with a walk of the tree.
+ */
+bool statsMatchShape(BTreeIndex *index)
+{
+	int height, nodes;
+	index->computeShape(height, nodes);
+	IndexStats stats = index->getStats();
+	return stats.height == height && stats.numLeaves + stats.numNonLeaves == nodes;
+}
+
+// -----------------------------------------------------------------------------
+// reopenTests
+// -----------------------------------------------------------------------------
+
+void reopenTests()
+{
+	{
+		std::cout << "Create a B+ Tree index on the integer field and delete half of its entries" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		deleteEntries(&index, offsetof(tuple,i), 0);
+		checkPassFail(index.getStats().numEntries, relationSize / 2)
+	}
+
+	{
+		// the relation has not changed, so the index is opened as it was left
+		std::cout << "Reopen a B+ Tree index on the integer field" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getStats().numEntries, relationSize / 2)
+		checkPassFail(intScan(&index,25,GT,40,LT), 7)
+	}
+
+	{
+		// a page added to the relation makes the index out of date, and it is built anew from the relation
+		std::cout << "Reopen a B+ Tree index on the integer field after the relation changed" << std::endl;
+		PageId pageNo;
+		file1->allocatePage(pageNo);
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getStats().numEntries, relationSize)
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	}
+
+	{
+		// a meta page that does not match its checksum is not trusted either
+		std::cout << "Reopen a B+ Tree index on the integer field with a damaged meta page" << std::endl;
+		{
+			BlobFile indexFile = BlobFile::open(intIndexName);
+			const PageId metaPageNo = indexFile.getFirstPageNo();
+			Page metaPage = indexFile.readPage(metaPageNo);
+			reinterpret_cast<IndexMetaInfo*>(&metaPage)->numEntries = 7;
+			indexFile.writePage(metaPageNo, metaPage);
+		}
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getStats().numEntries, relationSize)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	}
+}
+
+// -----------------------------------------------------------------------------
+// changeTests
+// -----------------------------------------------------------------------------
+
+void changeTests()
+{
+	std::cout << "Create a B+ Tree index on the integer field and change records of the relation" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// records inserted on a new page of the relation are added to the index before the page is written
+	PageId pageNo;
+	Page newPage = file1->allocatePage(pageNo);
+	std::vector<RecordId> rids;
+	for (int i = relationSize; i < relationSize + 50; i++)
+	{
+		rids.push_back(file1->insertRecord(newPage, makeRecord(i)));
+	}
+	checkPassFail(index.getStats().numEntries, relationSize + 50)
+	RecordId outRid;
+	int key = relationSize + 49;
+	index.lookupEntry(&key, outRid);
+	checkPassFail((outRid == rids[49]), true)
+	file1->writePage(pageNo, newPage);
+	checkPassFail(intScan(&index,relationSize - 1,GT,relationSize + 100,LT), 50)
+
+	// changes made in the buffer pool reach the index while the page is still pinned and dirty: an updated record
+	// moves to its new key, and deleted records leave the index
+	Page *page;
+	bufMgr->readPage(file1, pageNo, page);
+	file1->updateRecord(*page, rids[0], makeRecord(relationSize + 90));
+	for (size_t i = 1; i < 10; i++)
+	{
+		file1->deleteRecord(*page, rids[i]);
+	}
+	file1->insertRecord(*page, makeRecord(relationSize + 95));
+	checkPassFail(intScan(&index,relationSize - 1,GT,relationSize + 100,LT), 42)
+	checkPassFail(intScan(&index,relationSize - 1,GT,relationSize + 10,LT), 0)
+	checkPassFail(intScan(&index,relationSize + 89,GT,relationSize + 91,LT), 1)
+	key = relationSize + 90;
+	index.lookupEntry(&key, outRid);
+	checkPassFail((outRid == rids[0]), true)
+	bufMgr->unPinPage(file1, pageNo, true);
+
+	// writing the page back reports nothing more
+	bufMgr->flushFile(file1);
+	checkPassFail(intScan(&index,relationSize - 1,GT,relationSize + 100,LT), 42)
+
+	// deleting the page removes the entries of all of its records
+	file1->deletePage(pageNo);
+	checkPassFail(intScan(&index,relationSize - 1,GT,relationSize + 100,LT), 0)
+	checkPassFail(index.getStats().numEntries, relationSize)
+}
+
+// -----------------------------------------------------------------------------
+// directChangeTests
+// -----------------------------------------------------------------------------
+
+void directChangeTests()
+{
+	std::cout << "Append records through Page while a B+ Tree index is open, then reopen the index" << std::endl;
+	// the page written below may be one the buffer pool still holds from before it was deleted
+	bufMgr->flushFile(file1);
+	PageId pageNo;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		Page newPage = file1->allocatePage(pageNo);
+		for (int i = relationSize; i < relationSize + 50; i++)
+		{
+			newPage.insertRecord(makeRecord(i));
+		}
+		file1->writePage(pageNo, newPage);
+
+		// the open index is not told of records inserted through Page
+		checkPassFail(intScan(&index,relationSize - 1,GT,relationSize + 100,LT), 0)
+	}
+
+	// the index is not stamped as matching the relation when it closes, so it is rebuilt with the new records
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getStats().numEntries, relationSize + 50)
+		checkPassFail(intScan(&index,relationSize - 1,GT,relationSize + 100,LT), 50)
+		checkPassFail(batchLookup(&index, INTEGER, relationSize, relationSize + 49, 1), 50)
+	}
+
+	bufMgr->flushFile(file1);
+	file1->deletePage(pageNo);
+}
+
+// -----------------------------------------------------------------------------
+// walTests
+// -----------------------------------------------------------------------------
+
+void walTests()
+{
+	const std::string logName = relationName + ".log";
+	std::remove(logName.c_str());
+	bufMgr->flushFile(file1);
+
+	{
+		std::cout << "Create a B+ Tree index on the integer field with a logging buffer manager" << std::endl;
+		WriteAheadLog log(logName, 64);
+		BufMgr loggedBufMgr(100, &log);
+		BTreeIndex index(relationName, intIndexName, &loggedBufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getStats().numEntries, relationSize)
+	}
+
+	// a child process inserts keys above the relation's until it is killed, most likely in the middle of an insert
+	std::cout << "Kill a process inserting into the index, and recover the index from the log" << std::endl;
+	std::cout.flush();
+	const int committed = 1000;
+	int ready[2];
+	if (pipe(ready) != 0)
+	{
+		std::cout << "pipe failed" << std::endl;
+		exit(1);
+	}
+	const pid_t child = fork();
+	if (child == 0)
+	{
+		WriteAheadLog log(logName, 8);
+		BufMgr loggedBufMgr(100, &log);
+		BTreeIndex index(relationName, intIndexName, &loggedBufMgr, offsetof(tuple,i), INTEGER);
+		for (int i = relationSize; i < relationSize + 100 * committed; i++)
+		{
+			index.insertEntry(&i, rid);
+			if (i == relationSize + committed)
+			{
+				char c = 0;
+				if (write(ready[1], &c, 1) != 1)
+					_exit(1);
+			}
+		}
+		_exit(0);
+	}
+	char c;
+	if (read(ready[0], &c, 1) == 1)
+	{
+		usleep(20000);
+	}
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+	close(ready[0]);
+	close(ready[1]);
+
+	{
+		// the inserts up to the last sync of the log are redone, and the index is trusted without a rebuild
+		WriteAheadLog log(logName, 8);
+		checkPassFail((log.getStats().pagesRedone > 0), true)
+		BufMgr loggedBufMgr(100, &log);
+		BTreeIndex index(relationName, intIndexName, &loggedBufMgr, offsetof(tuple,i), INTEGER);
+		const int numEntries = index.getStats().numEntries;
+		checkPassFail((numEntries > relationSize + committed - 8), true)
+		checkPassFail(batchLookup(&index, INTEGER, 0, numEntries - 1, 1), numEntries)
+		checkPassFail(batchLookup(&index, INTEGER, numEntries, numEntries + 100, 1), 0)
+		checkPassFail(statsMatchShape(&index), true)
+	}
+
+	{
+		std::cout << "Open a write-ahead log in a directory that does not exist" << std::endl;
+		bool thrown = false;
+		try
+		{
+			WriteAheadLog missing(relationName + ".missing/" + logName);
+		}
+		catch(const LogIoException &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+	}
+
+	{
+		// a checkpoint that cannot sync a logged file leaves the log whole, and empties it once the sync succeeds
+		std::cout << "Checkpoint a log after removing a file it has records for" << std::endl;
+		const std::string goneName = relationName + ".gone";
+		std::remove(goneName.c_str());
+		WriteAheadLog log(logName);
+		BufMgr loggedBufMgr(100, &log);
+		{
+			PageFile gone = PageFile::create(goneName);
+			PageId pageNo;
+			Page* page;
+			loggedBufMgr.allocPage(&gone, pageNo, page);
+			page->insertRecord("logged");
+			loggedBufMgr.unPinPage(&gone, pageNo, true);
+			std::remove(goneName.c_str());
+
+			bool thrown = false;
+			try
+			{
+				loggedBufMgr.checkpoint();
+			}
+			catch(const LogIoException &e)
+			{
+				thrown = true;
+			}
+			checkPassFail(thrown, true)
+			struct stat st;
+			checkPassFail((stat(logName.c_str(), &st) == 0 && st.st_size > 0), true)
+			loggedBufMgr.flushFile(&gone);
+		}
+		{
+			PageFile again = PageFile::create(goneName);
+		}
+		loggedBufMgr.checkpoint();
+		struct stat st;
+		checkPassFail((stat(logName.c_str(), &st) == 0 && st.st_size == 0), true)
+		std::remove(goneName.c_str());
+	}
+	std::remove(logName.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// checksumTests
+// -----------------------------------------------------------------------------
+
+void checksumTests()
+{
+	{
+		std::cout << "Damage a page of a B+ Tree index file and read it back" << std::endl;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		}
+		BlobFile indexFile = BlobFile::open(intIndexName);
+		const PageId pageNo = indexFile.getNumPages() - 1;
+		damagePage(intIndexName, pageNo);
+		checkPassFail(indexFile.checkPage(pageNo), false)
+		checkPassFail(indexFile.checkPage(pageNo - 1), true)
+
+		// reads verify pages by default, and leave them alone with the checksum policy off
+		bool corrupt = false;
+		try
+		{
+			indexFile.readPage(pageNo);
+		}
+		catch(const CorruptPageException &e)
+		{
+			corrupt = true;
+		}
+		checkPassFail(corrupt, true)
+		File::setChecksumPolicy(CHECKSUM_OFF);
+		indexFile.readPage(pageNo);
+		File::setChecksumPolicy(CHECKSUM_VERIFY);
+
+		damagePage(intIndexName, indexFile.getFirstPageNo());
+	}
+
+	{
+		// an index whose meta page is corrupt is built anew
+		std::cout << "Reopen a B+ Tree index on the integer field with a corrupt meta page" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.getStats().numEntries, relationSize)
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	}
+
+	// the first change to a page logs the whole page, from which it can be rebuilt if it is damaged after it was written
+	std::cout << "Repair a damaged page of the relation from the log" << std::endl;
+	const std::string logName = relationName + ".log";
+	std::remove(logName.c_str());
+	bufMgr->flushFile(file1);
+	{
+		WriteAheadLog log(logName);
+		BufMgr loggedBufMgr(100, &log);
+		const PageId pageNo = file1->getFirstPageNo();
+		const RecordId changed = {pageNo, 1, 0};
+		Page *page;
+		loggedBufMgr.readPage(file1, pageNo, page);
+		const std::string original = page->getRecord(changed);
+		page->updateRecord(changed, makeRecord(relationSize));
+		loggedBufMgr.unPinPage(file1, pageNo, true);
+		loggedBufMgr.readPage(file1, pageNo, page);
+		page->updateRecord(changed, original);
+		loggedBufMgr.unPinPage(file1, pageNo, true);
+		loggedBufMgr.flushFile(file1);
+		damagePage(relationName, pageNo);
+
+		bool corrupt = false;
+		try
+		{
+			loggedBufMgr.readPage(file1, pageNo, page);
+		}
+		catch(const CorruptPageException &e)
+		{
+			corrupt = true;
+		}
+		checkPassFail(corrupt, true)
+
+		File::setChecksumPolicy(CHECKSUM_REPAIR);
+		loggedBufMgr.readPage(file1, pageNo, page);
+		checkPassFail((page->getRecord(changed) == original), true)
+		loggedBufMgr.unPinPage(file1, pageNo, false);
+		File::setChecksumPolicy(CHECKSUM_VERIFY);
+		checkPassFail(log.getStats().pagesRepaired, 1)
+		checkPassFail(file1->checkPage(pageNo), true)
+	}
+	std::remove(logName.c_str());
+}
+
+/**
+ * Flips a byte in the middle of a page of a file on disk, leaving the checksum stored with the page as it was.
+ */
+void damagePage(const std::string &filename, PageId pageNo)
+{
+	std::fstream stream(filename, std::ios::in | std::ios::out | std::ios::binary);
+	const std::streampos position = File::pagePosition(pageNo) + std::streamoff(Page::SIZE / 2);
+	char byte;
+	stream.seekg(position);
+	stream.read(&byte, 1);
+	byte = ~byte;
+	stream.seekp(position);
+	stream.write(&byte, 1);
+}
+
+// -----------------------------------------------------------------------------
+// mapTests
+// -----------------------------------------------------------------------------
+
+void mapTests()
+{
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+	bufMgr->flushFile(file1);
+	File::mapReadOnly(relationName);
+	File::mapReadOnly(intIndexName);
+
+	{
+		// the pages of the index are read where they are in the mapping, without going through buffer frames
+		std::cout << "Search a B+ Tree index on the integer field mapped read-only" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		const int diskreads = bufMgr->getBufStats().diskreads;
+		checkPassFail(batchLookup(&index, INTEGER, -50, 5050, 3), 1667)
+		checkPassFail(bufMgr->getBufStats().diskreads, diskreads)
+
+		bool readOnly = false;
+		try
+		{
+			int key = relationSize;
+			index.insertEntry(&key, rid);
+		}
+		catch(const ReadOnlyFileException &e)
+		{
+			readOnly = true;
+		}
+		checkPassFail(readOnly, true)
+	}
+
+	{
+		std::cout << "Scan a relation mapped read-only" << std::endl;
+		int numRecords = 0;
+		FileScan scan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while (1)
+			{
+				scan.scanNext(scanRid);
+				numRecords++;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+		checkPassFail(numRecords, relationSize)
+	}
+
+	File::unmap(relationName);
+	File::unmap(intIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// readIntoTests
+// -----------------------------------------------------------------------------
+
+void readIntoTests()
+{
+	// a page read into a frame that held another page is the same as one returned by value
+	std::cout << "Read the pages of the relation into a reused frame" << std::endl;
+	bufMgr->flushFile(file1);
+	Page frame;
+	int numPages = 0, numSame = 0;
+	for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+	{
+		file1->readPageInto(iter.page_number(), frame);
+		const Page page = file1->readPage(iter.page_number());
+		numPages++;
+		if (memcmp(reinterpret_cast<const char*>(&frame), reinterpret_cast<const char*>(&page), Page::SIZE) == 0)
+		{
+			numSame++;
+		}
+	}
+	const bool severalPages = numPages > 1;
+	checkPassFail(numSame, numPages)
+	checkPassFail(severalPages, true)
+}
+
+// -----------------------------------------------------------------------------
+// resizeTests
+// -----------------------------------------------------------------------------
+
+void resizeTests()
+{
+	{
+		// shrinking to a single frame leaves the page the scan has pinned where it is until the scan moves on
+		std::cout << "Scan a relation while its buffer pool is resized" << std::endl;
+		BufMgr resizeBufMgr(16);
+		const std::uint32_t sizes[] = { 1, 40, 3, 200, 8 };
+		int numRecords = 0;
+		{
+			FileScan scan(relationName, &resizeBufMgr);
+			try
+			{
+				RecordId scanRid;
+				while (1)
+				{
+					scan.scanNext(scanRid);
+					if (numRecords % 97 == 0)
+						resizeBufMgr.resize(sizes[numRecords / 97 % 5]);
+					numRecords++;
+				}
+			}
+			catch(const EndOfFileException &e)
+			{
+			}
+		}
+		checkPassFail(numRecords, relationSize)
+
+		bool exceeded = false;
+		try
+		{
+			resizeBufMgr.resize(0);
+		}
+		catch(const BufferExceededException &e)
+		{
+			exceeded = true;
+		}
+		checkPassFail(exceeded, true)
+	}
+
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+	bufMgr->flushFile(file1);
+	{
+		std::cout << "Search a B+ Tree index while another thread resizes its buffer pool" << std::endl;
+		BufMgr resizeBufMgr(64);
+		BTreeIndex index(relationName, intIndexName, &resizeBufMgr, offsetof(tuple,i), INTEGER);
+		std::atomic<bool> done(false);
+		std::thread resizer(resizeLoop, &resizeBufMgr, &done);
+		checkPassFail(batchLookup(&index, INTEGER, -50, 5050, 3), 1667)
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		done = true;
+		resizer.join();
+	}
+}
+
+// Resizes a buffer pool to between 16 and 128 frames over and over until done
+void resizeLoop(BufMgr *resizeBufMgr, std::atomic<bool> *done)
+{
+	unsigned int seed = 1;
+	while (!*done)
+	{
+		resizeBufMgr->resize(16 + rand_r(&seed) % 113);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// poolTests
+// -----------------------------------------------------------------------------
+
+void poolTests()
+{
+	// the index is built in a pool of its own, reading the relation through the default pool
+	std::cout << "Build a B+ Tree index on the integer field in a pool apart from the relation's" << std::endl;
+	bufMgr->flushFile(file1);
+	BufPools pools;
+	BufMgr *indexPool = pools.create("index", 64);
+	BufMgr *heapPool = pools.create(BufPools::DEFAULT, 4, REPLACE_FIFO);
+	std::ostringstream indexName;
+	indexName << relationName << '.' << offsetof(tuple,i);
+	pools.assign(indexName.str(), "index");
+	{
+		BTreeIndex index(relationName, intIndexName, &pools, offsetof(tuple,i), INTEGER);
+		checkPassFail(batchLookup(&index, INTEGER, -50, 5050, 3), 1667)
+	}
+	const bool indexPoolUsed = indexPool->getBufStats().diskreads > 0;
+	const bool heapPoolUsed = heapPool->getBufStats().diskreads > 0;
+	const bool relationInDefault = pools.poolFor(relationName) == heapPool;
+	checkPassFail(indexPoolUsed, true)
+	checkPassFail(heapPoolUsed, true)
+	checkPassFail(relationInDefault, true)
+
+	bool notFound = false;
+	try
+	{
+		pools.assign(relationName, "temp");
+	}
+	catch(const PoolNotFoundException &e)
+	{
+		notFound = true;
+	}
+	checkPassFail(notFound, true)
+}
+
+// -----------------------------------------------------------------------------
+// metricsTests
+// -----------------------------------------------------------------------------
+
+void metricsTests()
+{
+	std::cout << "Count the hits, misses and evictions of a small buffer pool" << std::endl;
+	bufMgr->flushFile(file1);
+	std::vector<PageId> pageNos;
+	for (FileIterator iter = file1->begin(); iter != file1->end() && pageNos.size() < 6; ++iter)
+	{
+		pageNos.push_back(iter.page_number());
+	}
+	BufMgr metricsBufMgr(4);
+	Page *page;
+	// six pages through four frames, the last of them three more times
+	for (size_t i = 0; i < pageNos.size(); i++)
+	{
+		metricsBufMgr.readPage(file1, pageNos[i], page);
+		metricsBufMgr.unPinPage(file1, pageNos[i], false);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		metricsBufMgr.readPage(file1, pageNos[5], page);
+		metricsBufMgr.unPinPage(file1, pageNos[5], false);
+	}
+	BufMetrics metrics = metricsBufMgr.getMetrics(2);
+	checkPassFail((int)metrics.misses, 6)
+	checkPassFail((int)metrics.hits, 3)
+	checkPassFail((int)metrics.cleanEvictions, 2)
+	checkPassFail((int)metrics.dirtyEvictions, 0)
+	checkPassFail((int)metrics.sweepLength.count, 6)
+	checkPassFail((int)metrics.pinWaitNanos.count, 9)
+	checkPassFail((int)metrics.files[relationName].readNanos.count, 6)
+	checkPassFail((int)metrics.hotPages.size(), 2)
+	checkPassFail((int)metrics.hotPages[0].pageNo, (int)pageNos[5])
+	checkPassFail((int)metrics.hotPages[0].accesses, 4)
+	checkPassFail(metricsBufMgr.getBufStats().accesses, 9)
+
+	std::cout << "Count a dirty page evicted, and export the metrics" << std::endl;
+	metricsBufMgr.clearMetrics();
+	metricsBufMgr.readPage(file1, pageNos[5], page);
+	metricsBufMgr.unPinPage(file1, pageNos[5], true);
+	{
+		MetricsReporter reporter(&metricsBufMgr, "metrics.json", std::chrono::milliseconds(3600000), METRICS_JSON, 1);
+		for (size_t i = 0; i < 4; i++)
+		{
+			metricsBufMgr.readPage(file1, pageNos[i], page);
+			metricsBufMgr.unPinPage(file1, pageNos[i], false);
+		}
+	}
+	metrics = metricsBufMgr.getMetrics(1);
+	checkPassFail((int)metrics.dirtyEvictions, 1)
+	checkPassFail((int)metrics.files[relationName].writeNanos.count, 1)
+	std::ostringstream text;
+	metrics.writeText(text);
+	const bool textHasMisses = text.str().find("misses 4\n") != std::string::npos;
+	checkPassFail(textHasMisses, true)
+	std::ifstream json("metrics.json");
+	std::string dumped((std::istreambuf_iterator<char>(json)), std::istreambuf_iterator<char>());
+	const bool jsonHasMisses = dumped.find("\"misses\": 4,") != std::string::npos;
+	const bool jsonHasFile = dumped.find("\"files\": {\"" + relationName + "\"") != std::string::npos;
+	checkPassFail(jsonHasMisses, true)
+	checkPassFail(jsonHasFile, true)
+	std::remove("metrics.json");
 }
 
 // -----------------------------------------------------------------------------
-// intTests
+// frameTests
 // -----------------------------------------------------------------------------
 
-void intTests()
+void frameTests()
 {
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	std::cout << "Take empty frames first, throw at once with every frame pinned, and reuse a disposed page's frame"
+		<< std::endl;
+	bufMgr->flushFile(file1);
+	std::vector<PageId> pageNos;
+	for (FileIterator iter = file1->begin(); iter != file1->end() && pageNos.size() < 4; ++iter)
+	{
+		pageNos.push_back(iter.page_number());
+	}
+	BufMgr frameBufMgr(3);
+	Page *pages[3];
+	for (int i = 0; i < 3; i++)
+	{
+		frameBufMgr.readPage(file1, pageNos[i], pages[i]);
+	}
+	bool exceeded = false;
+	Page *page;
+	try
+	{
+		frameBufMgr.readPage(file1, pageNos[3], page);
+	}
+	catch(const BufferExceededException &e)
+	{
+		exceeded = true;
+	}
+	BufMetrics metrics = frameBufMgr.getMetrics(0);
+	checkPassFail(exceeded, true)
+	checkPassFail((int)metrics.sweepLength.count, 4)
+	checkPassFail((int)metrics.sweepLength.sum, 0)
+
+	// the only unpinned page is evicted, whatever the clock passed before
+	frameBufMgr.unPinPage(file1, pageNos[1], false);
+	frameBufMgr.readPage(file1, pageNos[3], page);
+	checkPassFail((page == pages[1]), true)
+	frameBufMgr.unPinPage(file1, pageNos[0], false);
+	frameBufMgr.unPinPage(file1, pageNos[2], false);
+	frameBufMgr.unPinPage(file1, pageNos[3], false);
+
+	const std::string scratchName = "frames.scratch";
+	{
+		PageFile scratch = PageFile::create(scratchName);
+		PageId newPageNo;
+		Page *newPage;
+		frameBufMgr.allocPage(&scratch, newPageNo, newPage);
+		frameBufMgr.unPinPage(&scratch, newPageNo, true);
+		frameBufMgr.disposePage(&scratch, newPageNo);
+		frameBufMgr.clearMetrics();
+		frameBufMgr.readPage(file1, pageNos[1], page);
+		frameBufMgr.unPinPage(file1, pageNos[1], false);
+		metrics = frameBufMgr.getMetrics(0);
+		checkPassFail((page == newPage), true)
+		checkPassFail((int)(metrics.cleanEvictions + metrics.dirtyEvictions), 0)
+		frameBufMgr.flushFile(&scratch);
+	}
+	File::remove(scratchName);
+}
 
-	// run some tests
-	checkPassFail(intScan(&index,25,GT,40,LT), 14)
-	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
-	checkPassFail(intScan(&index,0,GT,1,LT), 0)
-	checkPassFail(intScan(&index,300,GT,400,LT), 99)
-	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+// -----------------------------------------------------------------------------
+// traceTests
+// -----------------------------------------------------------------------------
+
+void traceTests()
+{
+	std::cout << "Trace the page accesses of a small buffer pool" << std::endl;
+	bufMgr->flushFile(file1);
+	std::vector<PageId> pageNos;
+	for (FileIterator iter = file1->begin(); iter != file1->end() && pageNos.size() < 6; ++iter)
+	{
+		pageNos.push_back(iter.page_number());
+	}
+	const std::string traceName = "trace.bin";
+	const std::string scratchName = "trace.scratch";
+	BufMgr traceBufMgr(4);
+	Page *page;
+	{
+		PageFile scratch = PageFile::create(scratchName);
+		traceBufMgr.startTrace(traceName);
+		// three loops over six pages through four frames, the first page pinned all along
+		traceBufMgr.readPage(file1, pageNos[0], page);
+		for (int loop = 0; loop < 3; loop++)
+		{
+			for (size_t i = 0; i < pageNos.size(); i++)
+			{
+				traceBufMgr.readPage(file1, pageNos[i], page);
+				traceBufMgr.unPinPage(file1, pageNos[i], false);
+			}
+		}
+		traceBufMgr.unPinPage(file1, pageNos[0], false);
+		PageId newPageNos[2];
+		for (int i = 0; i < 2; i++)
+		{
+			traceBufMgr.allocPage(&scratch, newPageNos[i], page);
+			traceBufMgr.unPinPage(&scratch, newPageNos[i], true);
+		}
+		traceBufMgr.disposePage(&scratch, newPageNos[0]);
+		traceBufMgr.stopTrace();
+		traceBufMgr.flushFile(&scratch);
+	}
+	File::remove(scratchName);
+
+	int numEvents[TRACE_END] = {0};
+	std::string firstFile;
+	TraceReader reader(traceName);
+	ReplaySimulator clock(4, REPLACE_CLOCK);
+	StackDistanceCurve curve;
+	TraceRecord record;
+	while (reader.next(record))
+	{
+		const std::uint64_t pageId = (std::uint64_t(record.fileId) << 32) | record.pageNo;
+		numEvents[record.type]++;
+		if (firstFile.empty())
+		{
+			firstFile = reader.filename(record.fileId);
+		}
+		switch (record.type)
+		{
+			case TRACE_READ: clock.read(pageId); curve.read(pageId); break;
+			case TRACE_UNPIN: clock.unpin(pageId); break;
+			case TRACE_ALLOC: clock.alloc(pageId); curve.alloc(pageId); break;
+			case TRACE_DISPOSE: clock.dispose(pageId); curve.dispose(pageId); break;
+		}
+	}
+	checkPassFail(numEvents[TRACE_READ], 19)
+	checkPassFail(numEvents[TRACE_UNPIN], 21)
+	checkPassFail(numEvents[TRACE_ALLOC], 2)
+	checkPassFail(numEvents[TRACE_DISPOSE], 1)
+	checkPassFail((int)reader.dropped(), 0)
+	checkPassFail(firstFile, relationName)
+
+	std::cout << "Replay the trace against a simulated pool of the same size, and LRU pools of every size" << std::endl;
+	const BufMetrics metrics = traceBufMgr.getMetrics();
+	checkPassFail(clock.hits(), metrics.hits)
+	checkPassFail(clock.misses(), metrics.misses)
+	checkPassFail((int)clock.failures(), 0)
+	// after the first loop, the five other pages are read between two reads of a page
+	checkPassFail((int)curve.misses(4), 18)
+	checkPassFail((int)curve.misses(5), 18)
+	checkPassFail((int)curve.misses(6), 6)
+	checkPassFail((int)curve.misses(1000), 6)
+	File::remove(traceName);
+
+	bool badTrace = false;
+	try
+	{
+		TraceReader notATrace(relationName);
+	}
+	catch(const BadTraceException &e)
+	{
+		badTrace = true;
+	}
+	checkPassFail(badTrace, true)
 }
 
-int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+/**
+ * Returns a record of the relation for the key i.
+ */
+std::string makeRecord(int i)
 {
-  RecordId scanRid;
-	Page *curPage;
+	RECORD record;
+	memset(record.s, ' ', sizeof(record.s));
+	sprintf(record.s, "%05d string record", i);
+	record.i = i;
+	record.d = (double)i;
+	return std::string(reinterpret_cast<char*>(&record), sizeof(record));
+}
+
+// -----------------------------------------------------------------------------
+// coveringTests
+// -----------------------------------------------------------------------------
+
+void coveringTests()
+{
+	{
+		std::cout << "Create a covering B+ Tree index on the integer field, including the double field" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, false, offsetof(tuple,d), sizeof(double));
+
+		// the sums come from the index alone
+		checkPassFail(includedSum(&index,25,40), 455)
+		checkPassFail(includedSum(&index,3000,4000), 3496500)
+		checkPassFail(intScan(&index,300,GT,400,LT), 99)
+
+		deleteEntries(&index, offsetof(tuple,i), 0);
+		checkPassFail(includedSum(&index,25,40), 231)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 500)
+	}
+
+	{
+		std::cout << "Create a covering B+ Tree index with other included attributes, and a plain one, on the same field" << std::endl;
+		std::string otherName, plainName;
+		{
+			BTreeIndex other(relationName, otherName, bufMgr, offsetof(tuple,i), INTEGER, false, offsetof(tuple,s), 4);
+			BTreeIndex plain(relationName, plainName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail((otherName != intIndexName && plainName != intIndexName && otherName != plainName), true)
+			checkPassFail(intScan(&other,300,GT,400,LT), 99)
+			checkPassFail(intScan(&plain,300,GT,400,LT), 99)
+
+			// the first covering index kept its own file, with the entries left after the deletes
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, false, offsetof(tuple,d), sizeof(double));
+			checkPassFail(includedSum(&index,25,40), 231)
+		}
+		File::remove(otherName);
+		File::remove(intIndexName);
+	}
+
+	{
+		std::cout << "Create a covering B+ Tree index on the string field, including the integer field" << std::endl;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, false, offsetof(tuple,i), sizeof(int));
+		checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	}
+
+	{
+		std::cout << "Scan for included attributes of an index that is not covering" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int lowVal = 25, highVal = 40, errors = 0;
+		RecordId rids[8];
+		double payloads[8];
+		index.startScan(&lowVal, GT, &highVal, LT);
+		try
+		{
+			index.scanNextBatch(rids, payloads, 8);
+		}
+		catch(const BadScanParamException &e)
+		{
+			errors++;
+		}
+		index.endScan();
+		checkPassFail(errors, 1)
+	}
+}
+
+// Sums the double field included with the entries of (lowVal,highVal) without reading any record
+int includedSum(BTreeIndex *index, int lowVal, int highVal)
+{
+  std::cout << "Sum of included values for (" << lowVal << "," << highVal << ")" << std::endl;
+
+	RecordId rids[64];
+	double payloads[64];
+	double sum = 0;
+	size_t numRids;
+	try
+	{
+		index->startScan(&lowVal, GT, &highVal, LT);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+	while ((numRids = index->scanNextBatch(rids, payloads, 64)) > 0)
+	{
+		for (size_t i = 0; i < numRids; i++)
+			sum += payloads[i];
+	}
+	index->endScan();
+	return (int)sum;
+}
+
+// -----------------------------------------------------------------------------
+// compositeTests
+// -----------------------------------------------------------------------------
+
+void compositeTests()
+{
+	std::vector<KeyPart> parts(2);
+	parts[0].byteOffset = offsetof(tuple,s);
+	parts[0].type = STRING;
+	parts[0].length = 3;
+	parts[1].byteOffset = offsetof(tuple,i);
+	parts[1].type = INTEGER;
+	parts[1].length = 0;
+
+	{
+		std::cout << "Create a composite B+ Tree index on the first 3 bytes of the string field and the integer field" << std::endl;
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, parts);
+
+		// "012" starts the strings of the records 1200 to 1299
+		const char *group = "012";
+		const void *values[2] = { group, NULL };
+		checkPassFail(prefixScan(&index, values, 1), 100)
+
+		int val = 1234;
+		values[1] = &val;
+		checkPassFail(prefixScan(&index, values, 2), 1)
+		val = 1334;
+		checkPassFail(prefixScan(&index, values, 2), 0)
+
+		// ranges over whole keys run across groups
+		char lowKey[COMPOSITESIZE], highKey[COMPOSITESIZE];
+		val = 1250;
+		index.encodeKey(values, 2, lowKey);
+		const char *nextGroup = "013";
+		int nextVal = 1310;
+		const void *highValues[2] = { nextGroup, &nextVal };
+		index.encodeKey(highValues, 2, highKey);
+		checkPassFail(countScan(&index, lowKey, GTE, highKey, LT), 60)
+
+		// delete the entries of the even records, making their keys out of their attributes
+		{
+			FileScan scan(relationName, bufMgr);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					scan.scanNext(scanRid);
+					std::string recordStr = scan.getRecord();
+					const RECORD *record = reinterpret_cast<const RECORD*>(recordStr.c_str());
+					if (record->i % 2 == 0)
+					{
+						const void *recordValues[2] = { record->s, &record->i };
+						index.encodeKey(recordValues, 2, lowKey);
+						index.deleteEntry(lowKey, scanRid);
+					}
+				}
+			}
+			catch(const EndOfFileException &e)
+			{
+			}
+		}
+		values[1] = NULL;
+		checkPassFail(prefixScan(&index, values, 1), 50)
+	}
+
+	{
+		std::cout << "Create a composite B+ Tree index with other attribute lengths, and one on the integer field alone" << std::endl;
+		std::string otherName, singleName;
+		{
+			parts[0].length = 4;
+			BTreeIndex other(relationName, otherName, bufMgr, parts);
+			std::vector<KeyPart> single(parts.begin() + 1, parts.end());
+			BTreeIndex singlePart(relationName, singleName, bufMgr, single);
+			BTreeIndex plain(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			checkPassFail((otherName != compositeIndexName && singleName != intIndexName), true)
+			checkPassFail(other.getStats().numEntries, relationSize)
+			checkPassFail(singlePart.getStats().numEntries, relationSize)
+
+			// the first index kept its own file, with the entries left after the deletes
+			parts[0].length = 3;
+			BTreeIndex index(relationName, compositeIndexName, bufMgr, parts);
+			checkPassFail(index.getStats().numEntries, relationSize / 2)
+		}
+		File::remove(otherName);
+		File::remove(singleName);
+	}
+
+	{
+		std::cout << "Order of encoded negative and positive values" << std::endl;
+		File::remove(compositeIndexName);
+		parts[0].byteOffset = offsetof(tuple,d);
+		parts[0].type = DOUBLE;
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, parts);
+
+		// pairs of (double, int), each smaller than the next
+		const double doubles[] = { -1e300, -2.5, -1, -1, 0, 0, 1.5, 1.5, 3e300 };
+		const int ints[] = { 0, 7, -40000, 5, -1, 3, -2, 2, -9 };
+		const int numPairs = sizeof(ints) / sizeof(ints[0]);
+		char prevKey[COMPOSITESIZE], key[COMPOSITESIZE];
+		int ordered = 0;
+		for (int i = 0; i < numPairs; i++)
+		{
+			const void *values[2] = { &doubles[i], &ints[i] };
+			index.encodeKey(values, 2, key);
+			if (i > 0 && memcmp(prevKey, key, COMPOSITESIZE) < 0)
+				ordered++;
+			memcpy(prevKey, key, COMPOSITESIZE);
+		}
+		checkPassFail(ordered, numPairs - 1)
+
+		// -0.0 and 0.0 make the same key
+		const double zero = 0, negativeZero = -0.0;
+		const void *zeroValues[1] = { &zero }, *negativeZeroValues[1] = { &negativeZero };
+		index.encodeKey(zeroValues, 1, prevKey);
+		index.encodeKey(negativeZeroValues, 1, key);
+		checkPassFail(memcmp(prevKey, key, COMPOSITESIZE), 0)
+
+		const double val = 4321;
+		const void *values[1] = { &val };
+		checkPassFail(prefixScan(&index, values, 1), 1)
+	}
+
+	{
+		std::cout << "Prefix scan of an index that is not composite" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int val = 25, errors = 0;
+		const void *values[1] = { &val };
+		try
+		{
+			index.startPrefixScan(values, 1);
+		}
+		catch(const BadScanParamException &e)
+		{
+			errors++;
+		}
+		checkPassFail(errors, 1)
+	}
+}
+
+// Counts the entries whose leading attributes have the given values, checking that they come in order of the
+// integer field. Returns -1 if they do not.
+int prefixScan(BTreeIndex *index, const void* const* values, int numValues)
+{
+  std::cout << "Prefix scan of " << numValues << " attributes" << std::endl;
+
+	RecordId rids[64];
+	size_t numRids;
+	int numResults = 0, lastVal = -1;
+	bool ordered = true;
+	try
+	{
+		index->startPrefixScan(values, numValues);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+	while ((numRids = index->scanNextBatch(rids, 64)) > 0)
+	{
+		for (size_t i = 0; i < numRids; i++)
+		{
+			Page *curPage;
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			ordered = ordered && myRec.i > lastVal;
+			lastVal = myRec.i;
+			numResults++;
+		}
+	}
+	index->endScan();
+	return ordered ? numResults : -1;
+}
+
+// -----------------------------------------------------------------------------
+// hashTests
+// -----------------------------------------------------------------------------
+
+void hashTests()
+{
+	{
+		std::cout << "Create a hash index on the integer field" << std::endl;
+		HashIndex index(relationName, intHashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(hashLookups(&index, INTEGER, -10, relationSize + 10), relationSize)
+
+		// delete the entries of the even records, with the record ids the lookups return
+		for (int val = 0; val < relationSize; val += 2)
+		{
+			RecordId outRid;
+			index.lookupEntry(&val, outRid);
+			index.deleteEntry(&val, outRid);
+		}
+		checkPassFail(hashLookups(&index, INTEGER, 0, relationSize - 1), relationSize / 2)
+
+		int val = 2, errors = 0;
+		try
+		{
+			index.deleteEntry(&val, rid);
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+			errors++;
+		}
+		checkPassFail(errors, 1)
+
+		// copies of one key cannot be split apart, so they go to overflow pages that deleting them gives back
+		int depth, buckets, overflowPages;
+		const int numCopies = 3 * INTARRAYLEAFSIZE;
+		val = 7;
+		RecordId copyRid;
+		copyRid.slot_number = 0;
+		for (int i = 0; i < numCopies; i++)
+		{
+			copyRid.page_number = i + 1;
+			index.insertEntry(&val, copyRid);
+		}
+		index.computeShape(depth, buckets, overflowPages);
+		checkPassFail((overflowPages >= 2), true)
+		for (int i = 0; i < numCopies; i++)
+		{
+			copyRid.page_number = i + 1;
+			index.deleteEntry(&val, copyRid);
+		}
+		index.computeShape(depth, buckets, overflowPages);
+		checkPassFail(overflowPages, 0)
+		checkPassFail(hashLookups(&index, INTEGER, 0, relationSize - 1), relationSize / 2)
+	}
+
+	{
+		std::cout << "Reopen the hash index on the integer field" << std::endl;
+		HashIndex index(relationName, intHashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(hashLookups(&index, INTEGER, 0, relationSize - 1), relationSize / 2)
+
+		int mismatches = 0;
+		try
+		{
+			HashIndex other(relationName, intHashIndexName, bufMgr, offsetof(tuple,i), DOUBLE);
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			mismatches++;
+		}
+		checkPassFail(mismatches, 1)
+	}
+
+	{
+		std::cout << "Create hash indexes on the double and string fields" << std::endl;
+		HashIndex doubleIndex(relationName, doubleHashIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		checkPassFail(hashLookups(&doubleIndex, DOUBLE, -10, relationSize + 10), relationSize)
+		HashIndex stringIndex(relationName, stringHashIndexName, bufMgr, offsetof(tuple,s), STRING);
+		checkPassFail(hashLookups(&stringIndex, STRING, -10, relationSize + 10), relationSize)
+	}
+}
+
+// Looks up every key in [lowVal,highVal] and returns the number found, or -1 if a record id does not lead to a
+// record with that key.
+int hashLookups(HashIndex *index, Datatype type, int lowVal, int highVal)
+{
+	std::cout << "Hash lookups of the keys in [" << lowVal << "," << highVal << "]" << std::endl;
+
+	int numFound = 0;
+	for (int val = lowVal; val <= highVal; val++)
+	{
+		RECORD key;
+		key.i = val;
+		key.d = val;
+		sprintf(key.s, "%05d string record", val);
+		const void *keyPtr = type == INTEGER ? (const void*)&key.i : type == DOUBLE ? (const void*)&key.d : (const void*)key.s;
+		RecordId outRid;
+		try
+		{
+			index->lookupEntry(keyPtr, outRid);
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+			continue;
+		}
+
+		Page *curPage;
+		bufMgr->readPage(file1, outRid.page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(outRid).data()));
+		bufMgr->unPinPage(file1, outRid.page_number, false);
+		if (myRec.i != val)
+		{
+			return -1;
+		}
+		numFound++;
+	}
+	return numFound;
+}
+
+// Deletes the index entries of all records whose integer field has the given parity
+void deleteEntries(BTreeIndex *index, int attrByteOffset, int parity)
+{
+	FileScan scan(relationName, bufMgr);
+	try
+	{
+		RecordId scanRid;
+		while(1)
+		{
+			scan.scanNext(scanRid);
+			std::string recordStr = scan.getRecord();
+			const RECORD *record = reinterpret_cast<const RECORD*>(recordStr.c_str());
+			if (record->i % 2 == parity)
+			{
+				index->deleteEntry(recordStr.c_str() + attrByteOffset, scanRid);
+			}
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+}
+
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	char lowValStr[100];
+	char highValStr[100];
+	sprintf(lowValStr,"%05d string record",lowVal);
+	sprintf(highValStr,"%05d string record",highVal);
 
   std::cout << "Scan for ";
   if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
-  std::cout << lowVal << "," << highVal;
+  std::cout << lowValStr << "," << highValStr;
   if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
   std::cout << std::endl;
 
+	return countScan(index, lowValStr, lowOp, highValStr, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// batchLookup
+// -----------------------------------------------------------------------------
+
+// Looks up the keys from highVal down to lowVal, step apart, in one batch, checking each answer against lookupEntry.
+// Returns the number of keys found.
+int batchLookup(BTreeIndex *index, Datatype type, int lowVal, int highVal, int step)
+{
+  std::cout << "Batch lookup of every " << step << "th key in [" << lowVal << "," << highVal << "]" << std::endl;
+
+	std::vector<RECORD> keys;
+	for (int val = highVal; val >= lowVal; val -= step)
+	{
+		RECORD key;
+		key.i = val;
+		sprintf(key.s, "%05d string record", val);
+		keys.push_back(key);
+	}
+	std::vector<const void*> keyPtrs;
+	for (size_t i = 0; i < keys.size(); i++)
+		keyPtrs.push_back(type == INTEGER ? (const void*)&keys[i].i : (const void*)keys[i].s);
+
+	std::vector<RecordId> rids(keys.size());
+	bool *found = new bool[keys.size()];
+	int numFound = index->lookupBatch(&keyPtrs[0], keys.size(), &rids[0], found);
+
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		RecordId outRid;
+		bool expected = true;
+		try
+		{
+			index->lookupEntry(keyPtrs[i], outRid);
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+			expected = false;
+		}
+		if (found[i] != expected || (expected && !(rids[i] == outRid)))
+		{
+			std::cout << "Batch lookup of " << keys[i].i << " disagrees with lookupEntry" << std::endl;
+			numFound = -1;
+		}
+	}
+	delete [] found;
+	return numFound;
+}
+
+// -----------------------------------------------------------------------------
+// countScan
+// -----------------------------------------------------------------------------
+
+int countScan(BTreeIndex * index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
   int numResults = 0;
 	
 	try
 	{
-  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+  	index->startScan(lowVal, lowOp, highVal, highOp);
 	}
 	catch(const NoSuchKeyFoundException &e)
 	{
@@ -548,6 +2739,18 @@ void errorTests()
 			std::cout << "BadScanrangeException Test 1 Passed." << std::endl;
 		}
 
+		std::cout << "Delete an entry that is not in the index" << std::endl;
+		try
+		{
+			RecordId missingRid = { Page::INVALID_NUMBER, 0, 0 };
+			index.deleteEntry(&int5, missingRid);
+			std::cout << "NoSuchKeyFoundException Test 1 Failed." << std::endl;
+		}
+		catch(const NoSuchKeyFoundException &e)
+		{
+			std::cout << "NoSuchKeyFoundException Test 1 Passed." << std::endl;
+		}
+
 		deleteRelation();
 	}
 
@@ -133,6 +133,18 @@ class Page {
    */
   Page();
 
+  /**
+   * Tag of the constructor below.
+   */
+  struct Uninitialized {};
+
+  /**
+   * Constructs a page whose bytes are left as they are, for a page about to
+   * be overwritten whole, e.g. by File::readPageInto().  This skips clearing
+   * the data area, as Page() does.
+   */
+  explicit Page(Uninitialized) {}
+
   /**
    * Inserts a new record into the page.
    *
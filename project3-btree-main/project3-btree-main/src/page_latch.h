@@ -0,0 +1,109 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace badgerdb {
+
+/**
+ * @brief Optimistic latch of a buffer frame, used for optimistic lock coupling.
+ *
+ * The latch is a version counter. Readers do not write to it: they note the version, read the page and then
+ * check that the version is unchanged, starting over otherwise. Writers lock the latch, and unlocking bumps the
+ * version. Bit 1 of the version is set while the latch is locked, bit 0 once the page has been freed.
+ */
+class PageLatch {
+ public:
+	PageLatch()
+		: version(0)
+	{
+	}
+
+	/**
+	 * Resets the latch for a page newly brought into the frame.
+	 */
+	void reset()
+	{
+		version = 0;
+	}
+
+	/**
+	 * Notes the version before an optimistic read.
+	 *
+	 * @param outVersion	Set to the current version
+	 * @return False if the page is locked or freed, in which case the reader has to start over.
+	 */
+	bool readLock(std::uint64_t& outVersion) const
+	{
+		outVersion = version;
+		return (outVersion & 3) == 0;
+	}
+
+	/**
+	 * Checks after an optimistic read that no writer has locked the page since readLock().
+	 *
+	 * @param readVersion	Version returned by readLock()
+	 * @return True if what was read is consistent.
+	 */
+	bool validate(std::uint64_t readVersion) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return version.load(std::memory_order_relaxed) == readVersion;
+	}
+
+	/**
+	 * Locks the page if it is still at the version noted by readLock().
+	 *
+	 * @param readVersion	Version returned by readLock()
+	 * @return False if the page has changed since, in which case the writer has to start over.
+	 */
+	bool upgrade(std::uint64_t readVersion)
+	{
+		return version.compare_exchange_strong(readVersion, readVersion + 2);
+	}
+
+	/**
+	 * Locks the page, waiting for another writer to unlock it. Must not be called for a freed page.
+	 */
+	void lock()
+	{
+		while (true)
+		{
+			std::uint64_t current = version;
+			if ((current & 2) == 0 && version.compare_exchange_weak(current, current + 2))
+			{
+				return;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	/**
+	 * Unlocks the page and bumps its version.
+	 */
+	void unlock()
+	{
+		version += 2;
+	}
+
+	/**
+	 * Unlocks a page that is about to be freed. Readers that reach it afterwards start over.
+	 */
+	void unlockObsolete()
+	{
+		version += 3;
+	}
+
+ private:
+	std::atomic<std::uint64_t> version;
+};
+
+}
@@ -0,0 +1,207 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstring>
+#include "page_trace.h"
+#include "exceptions/bad_trace_exception.h"
+
+namespace badgerdb {
+
+/**
+ * First bytes of a trace file
+ */
+static const char TRACE_MAGIC[8] = {'B', 'D', 'B', 'T', 'R', 'A', 'C', 'E'};
+
+/**
+ * Number of file ids a trace has room for
+ */
+static const std::size_t MAX_TRACE_FILES = 1 << 16;
+
+PageTracer::PageTracer(const std::string& path, std::size_t capacity)
+	: path(path), out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc), head(0), tail(0),
+	  numDropped(0), start(std::chrono::steady_clock::now()), stopping(false)
+{
+	std::size_t size = 1;
+	while (size < capacity)
+	{
+		size *= 2;
+	}
+	ring.resize(size);
+	mask = size - 1;
+
+	const std::uint32_t header[2] = {VERSION, 0};
+	out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	if (!out)
+	{
+		throw BadTraceException(path);
+	}
+	thread = std::thread(&PageTracer::run, this);
+}
+
+PageTracer::~PageTracer()
+{
+	stopping.store(true);
+	thread.join();
+
+	TraceRecord end;
+	memset(&end, 0, sizeof(end));
+	end.type = TRACE_END;
+	end.nanos = numDropped.load();
+	out.write(reinterpret_cast<const char*>(&end), sizeof(end));
+}
+
+void PageTracer::record(TraceEvent type, const std::string& filename, PageId pageNo, std::uint8_t flags)
+{
+	const std::uint64_t position = head.load(std::memory_order_relaxed);
+	if (position - tail.load(std::memory_order_acquire) == ring.size())
+	{
+		numDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	std::unordered_map<std::string, std::uint16_t>::const_iterator it = fileIds.find(filename);
+	std::uint16_t fileId;
+	if (it != fileIds.end())
+	{
+		fileId = it->second;
+	}
+	else if (fileIds.size() < MAX_TRACE_FILES)
+	{
+		// the name is handed to the writer before any record that uses the id
+		fileId = fileIds.size();
+		fileIds[filename] = fileId;
+		std::lock_guard<std::mutex> guard(namesMutex);
+		newNames.push_back(std::make_pair(fileId, filename));
+	}
+	else
+	{
+		numDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	TraceRecord& slot = ring[position & mask];
+	slot.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	slot.pageNo = pageNo;
+	slot.fileId = fileId;
+	slot.type = type;
+	slot.flags = flags;
+	head.store(position + 1, std::memory_order_release);
+}
+
+void PageTracer::run()
+{
+	// the producer never waits for the writer, so the writer polls
+	while (!stopping.load())
+	{
+		if (!drain())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	drain();
+	out.flush();
+}
+
+bool PageTracer::drain()
+{
+	// head is read before the new names are taken, so that the files of all the records up to it are named first
+	const std::uint64_t last = head.load(std::memory_order_acquire);
+	const std::uint64_t first = tail.load(std::memory_order_relaxed);
+	std::vector< std::pair<std::uint16_t, std::string> > names;
+	{
+		std::lock_guard<std::mutex> guard(namesMutex);
+		names.swap(newNames);
+	}
+	for (std::size_t i = 0; i < names.size(); i++)
+	{
+		TraceRecord file;
+		memset(&file, 0, sizeof(file));
+		file.type = TRACE_FILE;
+		file.fileId = names[i].first;
+		file.pageNo = names[i].second.size();
+		out.write(reinterpret_cast<const char*>(&file), sizeof(file));
+		std::vector<char> padded((names[i].second.size() + sizeof(TraceRecord) - 1) / sizeof(TraceRecord)
+			* sizeof(TraceRecord), 0);
+		if (!padded.empty())
+		{
+			memcpy(&padded[0], names[i].second.data(), names[i].second.size());
+			out.write(&padded[0], padded.size());
+		}
+	}
+	if (last == first)
+	{
+		return !names.empty();
+	}
+
+	// the records wrap around the end of the ring at most once
+	const std::size_t from = first & mask;
+	const std::size_t count = last - first;
+	const std::size_t untilEnd = ring.size() - from < count ? ring.size() - from : count;
+	out.write(reinterpret_cast<const char*>(&ring[from]), untilEnd * sizeof(TraceRecord));
+	if (untilEnd < count)
+	{
+		out.write(reinterpret_cast<const char*>(&ring[0]), (count - untilEnd) * sizeof(TraceRecord));
+	}
+	tail.store(last, std::memory_order_release);
+	return true;
+}
+
+TraceReader::TraceReader(const std::string& path)
+	: path(path), in(path.c_str(), std::ios::in | std::ios::binary), numDropped(0)
+{
+	char magic[sizeof(TRACE_MAGIC)];
+	std::uint32_t header[2];
+	in.read(magic, sizeof(magic));
+	in.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!in || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 || header[0] != PageTracer::VERSION)
+	{
+		throw BadTraceException(path);
+	}
+}
+
+bool TraceReader::next(TraceRecord& record)
+{
+	for (;;)
+	{
+		in.read(reinterpret_cast<char*>(&record), sizeof(record));
+		if (in.gcount() == 0)
+		{
+			return false;
+		}
+		if (in.gcount() != sizeof(record))
+		{
+			throw BadTraceException(path);
+		}
+		if (record.type == TRACE_END)
+		{
+			numDropped = record.nanos;
+			return false;
+		}
+		if (record.type != TRACE_FILE)
+		{
+			return true;
+		}
+
+		std::vector<char> padded((record.pageNo + sizeof(TraceRecord) - 1) / sizeof(TraceRecord) * sizeof(TraceRecord));
+		if (!padded.empty())
+		{
+			in.read(&padded[0], padded.size());
+			if (in.gcount() != (std::streamsize)padded.size())
+			{
+				throw BadTraceException(path);
+			}
+		}
+		if (names.size() <= record.fileId)
+		{
+			names.resize(record.fileId + 1);
+		}
+		names[record.fileId].assign(padded.begin(), padded.begin() + record.pageNo);
+	}
+}
+
+}
@@ -0,0 +1,249 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* Kind of a record of a page access trace
+*/
+enum TraceEvent
+{
+	/**
+	 * readPage() pinned a page
+	 */
+	TRACE_READ = 1,
+
+	/**
+	 * unPinPage() released a pin of a page; flags holds TRACE_DIRTY if it was unpinned dirty
+	 */
+	TRACE_UNPIN = 2,
+
+	/**
+	 * allocPage() allocated a page, pinned
+	 */
+	TRACE_ALLOC = 3,
+
+	/**
+	 * disposePage() deleted a page
+	 */
+	TRACE_DISPOSE = 4,
+
+	/**
+	 * Names the file of a file id. pageNo is the length of the name, whose bytes follow the record, padded to a
+	 * whole record.
+	 */
+	TRACE_FILE = 5,
+
+	/**
+	 * Last record of a trace. nanos is the number of records dropped because the ring buffer was full.
+	 */
+	TRACE_END = 6
+};
+
+/**
+* Flag of a TRACE_UNPIN record of a page unpinned dirty
+*/
+static const std::uint8_t TRACE_DIRTY = 1;
+
+/**
+* @brief One record of a page access trace, as it is written to the trace file
+*/
+struct TraceRecord
+{
+	/**
+	 * Nanoseconds since the trace started
+	 */
+	std::uint64_t nanos;
+
+	/**
+	 * Page number in the file
+	 */
+	PageId pageNo;
+
+	/**
+	 * Id of the file, named by a TRACE_FILE record before it is used
+	 */
+	std::uint16_t fileId;
+
+	/**
+	 * TraceEvent of the record
+	 */
+	std::uint8_t type;
+
+	/**
+	 * Flags of the event, e.g. TRACE_DIRTY
+	 */
+	std::uint8_t flags;
+};
+
+/**
+* @brief Writes the page accesses of a buffer manager to a compact binary trace file.
+*
+* The buffer manager records an event with the mutex of its calls held, so there is one producer at a time. It
+* copies the record into a ring buffer and moves on, without a lock or a system call; a thread of the tracer writes
+* the ring buffer out to the file in the background. If the writer falls behind and the ring buffer is full, events
+* are dropped rather than held up, and the number dropped is written at the end of the trace.
+*
+* The file starts with the 8 bytes "BDBTRACE" and a 32-bit version and 32 bits of zeros, and goes on with 16-byte
+* TraceRecords, in the byte order of the machine that wrote it.
+*/
+class PageTracer
+{
+ public:
+	/**
+	 * Version of the trace format
+	 */
+	static const std::uint32_t VERSION = 1;
+
+	/**
+	 * Creates the trace file and starts the thread writing it.
+	 *
+	 * @param path			Trace file, replaced if it exists
+	 * @param capacity	Number of records the ring buffer holds, rounded up to a power of two
+	 * @throws  BadTraceException If the file cannot be created
+	 */
+	PageTracer(const std::string& path, std::size_t capacity);
+
+	/**
+	 * Writes out the events recorded, ends the trace and closes the file.
+	 */
+	~PageTracer();
+
+	/**
+	 * Records an event. Only one thread at a time may call it.
+	 *
+	 * @param type			TraceEvent
+	 * @param filename	Name of the file of the page
+	 * @param pageNo		Page number
+	 * @param flags			Flags of the event
+	 */
+	void record(TraceEvent type, const std::string& filename, PageId pageNo, std::uint8_t flags = 0);
+
+	/**
+	 * Returns the number of events dropped so far because the ring buffer was full.
+	 */
+	std::uint64_t dropped() const
+	{
+		return numDropped.load(std::memory_order_relaxed);
+	}
+
+ private:
+	PageTracer(const PageTracer&);
+	PageTracer& operator=(const PageTracer&);
+
+	/**
+	 * Body of the thread writing the file
+	 */
+	void run();
+
+	/**
+	 * Writes the names of new files and the records in the ring buffer to the file.
+	 *
+	 * @return True if there was anything to write.
+	 */
+	bool drain();
+
+	/**
+	 * Name of the trace file
+	 */
+	std::string path;
+
+	std::ofstream out;
+
+	/**
+	 * Ring buffer of records; head is where the next one goes and tail the next one the writer takes
+	 */
+	std::vector<TraceRecord> ring;
+	std::size_t mask;
+	std::atomic<std::uint64_t> head;
+	std::atomic<std::uint64_t> tail;
+	std::atomic<std::uint64_t> numDropped;
+
+	/**
+	 * Time the trace started
+	 */
+	std::chrono::steady_clock::time_point start;
+
+	/**
+	 * Id of each file seen, by name. Only the producer uses it.
+	 */
+	std::unordered_map<std::string, std::uint16_t> fileIds;
+
+	/**
+	 * Names of the files given an id that the writer has not written yet, guarded by namesMutex. A file gets an id
+	 * once, so this is taken once per file.
+	 */
+	std::vector< std::pair<std::uint16_t, std::string> > newNames;
+	std::mutex namesMutex;
+
+	std::atomic<bool> stopping;
+	std::thread thread;
+};
+
+/**
+* @brief Reads a trace written by PageTracer, record by record.
+*/
+class TraceReader
+{
+ public:
+	/**
+	 * Opens a trace file.
+	 *
+	 * @param path		Trace file
+	 * @throws  BadTraceException If the file cannot be opened or is not a trace
+	 */
+	explicit TraceReader(const std::string& path);
+
+	/**
+	 * Reads the next page event, taking in the file names on the way.
+	 *
+	 * @param record	The event read
+	 * @return False at the end of the trace.
+	 * @throws  BadTraceException If the trace ends in the middle of a record
+	 */
+	bool next(TraceRecord& record);
+
+	/**
+	 * Returns the name of the file of a file id.
+	 *
+	 * @param fileId	File id of a record read
+	 */
+	const std::string& filename(std::uint16_t fileId) const
+	{
+		return names[fileId];
+	}
+
+	/**
+	 * Returns the number of events the tracer dropped, known once the end of the trace is read. A trace that was
+	 * cut short has no end and counts none.
+	 */
+	std::uint64_t dropped() const
+	{
+		return numDropped;
+	}
+
+ private:
+	std::string path;
+	std::ifstream in;
+	std::vector<std::string> names;
+	std::uint64_t numDropped;
+};
+
+}
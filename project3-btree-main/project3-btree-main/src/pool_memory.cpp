@@ -0,0 +1,125 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "pool_memory.h"
+
+namespace badgerdb {
+
+/**
+ * Memory policy of mbind() that spreads pages round-robin over a set of nodes, from the kernel's uapi mempolicy.h
+ */
+static const int MPOL_INTERLEAVE_POLICY = 3;
+
+PoolMemory::PoolMemory(const std::size_t bytes, const int flags)
+	: address_(NULL), size_(0), flags_(0)
+{
+	size_ = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	if (size_ == 0)
+	{
+		size_ = HUGE_PAGE_SIZE;
+	}
+
+	// map one huge page more than needed, and trim the mapping to a huge page boundary. Swap space is not reserved
+	// for it, as most of a pool that may grow is never touched.
+	const std::size_t mapped = size_ + HUGE_PAGE_SIZE;
+	void* start = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (start == MAP_FAILED)
+	{
+		throw std::bad_alloc();
+	}
+	const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(start);
+	const std::uintptr_t aligned = (first + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	if (aligned > first)
+	{
+		munmap(start, aligned - first);
+	}
+	if (first + mapped > aligned + size_)
+	{
+		munmap(reinterpret_cast<void*>(aligned + size_), first + mapped - (aligned + size_));
+	}
+	address_ = reinterpret_cast<void*>(aligned);
+
+	// both are hints: the pool works the same without them
+	if ((flags & POOL_HUGE_PAGES) && madvise(address_, size_, MADV_HUGEPAGE) == 0)
+	{
+		flags_ |= POOL_HUGE_PAGES;
+	}
+	if ((flags & POOL_INTERLEAVE) && interleave())
+	{
+		flags_ |= POOL_INTERLEAVE;
+	}
+}
+
+PoolMemory::~PoolMemory()
+{
+	munmap(address_, size_);
+}
+
+void PoolMemory::release(void* start, const std::size_t length)
+{
+	if (length > 0)
+	{
+		madvise(start, length, MADV_DONTNEED);
+	}
+}
+
+bool PoolMemory::interleave()
+{
+#ifdef SYS_mbind
+	// the online nodes are listed as ranges, e.g. "0-1,3"
+	std::ifstream online("/sys/devices/system/node/online");
+	std::string list;
+	if (!(online >> list))
+	{
+		return false;
+	}
+	const std::size_t bitsPerWord = 8 * sizeof(unsigned long);
+	std::vector<unsigned long> mask;
+	int numNodes = 0;
+	std::size_t pos = 0;
+	while (pos < list.size())
+	{
+		std::size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+		{
+			end = list.size();
+		}
+		const std::string range = list.substr(pos, end - pos);
+		const std::size_t dash = range.find('-');
+		const unsigned long low = std::stoul(range.substr(0, dash));
+		const unsigned long high = dash == std::string::npos ? low : std::stoul(range.substr(dash + 1));
+		for (unsigned long node = low; node <= high; node++)
+		{
+			if (mask.size() <= node / bitsPerWord)
+			{
+				mask.resize(node / bitsPerWord + 1, 0);
+			}
+			mask[node / bitsPerWord] |= 1UL << (node % bitsPerWord);
+			numNodes++;
+		}
+		pos = end + 1;
+	}
+	if (numNodes < 2)
+	{
+		return false;
+	}
+	// the kernel reads one bit fewer than maxnode
+	return syscall(SYS_mbind, address_, size_, MPOL_INTERLEAVE_POLICY, &mask[0], mask.size() * bitsPerWord + 1, 0) == 0;
+#else
+	return false;
+#endif
+}
+
+}
@@ -0,0 +1,112 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace badgerdb {
+
+/**
+ * Placement of the memory of a buffer pool, as a combination of flags
+ */
+enum PoolFlags
+{
+	/**
+	 * Ask the kernel to back the pool with 2 MB huge pages, which cuts the TLB misses of a large pool
+	 */
+	POOL_HUGE_PAGES = 1,
+
+	/**
+	 * Interleave the pages of the pool across the NUMA nodes, so that no one node serves every frame
+	 */
+	POOL_INTERLEAVE = 2
+};
+
+/**
+* @brief Anonymous memory of a buffer pool.
+*
+* The memory is mapped at a 2 MB boundary in a multiple of 2 MB, so that with POOL_HUGE_PAGES the kernel can back all
+* of it with transparent huge pages. Where it will not, or the memory cannot be interleaved, the pool falls back to
+* what the kernel gives, and flags() tells which of the requested flags took effect. The memory is zero-filled and
+* only backed once it is first touched, so more can be mapped than is needed at first; release() gives a range back
+* to the kernel, after which it reads as zeros again.
+*/
+class PoolMemory
+{
+ public:
+	/**
+	 * Size and alignment of a huge page
+	 */
+	static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	/**
+	 * Maps the memory.
+	 *
+	 * @param bytes		Number of bytes needed
+	 * @param flags		Combination of PoolFlags
+	 * @throws std::bad_alloc If the memory cannot be mapped
+	 */
+	PoolMemory(const std::size_t bytes, const int flags);
+
+	/**
+	 * Unmaps the memory.
+	 */
+	~PoolMemory();
+
+	/**
+	 * Returns the first byte of the memory, aligned to HUGE_PAGE_SIZE.
+	 */
+	void* address() const
+	{
+		return address_;
+	}
+
+	/**
+	 * Gives the memory of a range back to the kernel. The range stays mapped, zero-filled.
+	 *
+	 * @param start		First byte of the range, at a page boundary
+	 * @param length	Number of bytes, a multiple of the page size
+	 */
+	void release(void* start, const std::size_t length);
+
+	/**
+	 * Returns the PoolFlags that took effect.
+	 */
+	int flags() const
+	{
+		return flags_;
+	}
+
+ private:
+	PoolMemory(const PoolMemory&);
+	PoolMemory& operator=(const PoolMemory&);
+
+	/**
+	 * Interleaves the memory across the online NUMA nodes.
+	 *
+	 * @return True if there are several nodes and the kernel took the policy.
+	 */
+	bool interleave();
+
+	/**
+	 * First byte of the memory
+	 */
+	void* address_;
+
+	/**
+	 * Number of bytes mapped
+	 */
+	std::size_t size_;
+
+	/**
+	 * PoolFlags that took effect
+	 */
+	int flags_;
+};
+
+}
@@ -0,0 +1,140 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "page_trace.h"
+#include "trace_sim.h"
+#include "exceptions/badgerdb_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Replays a page access trace written by BufMgr::startTrace against buffer
+// pools of several sizes, and prints the miss ratio of each: for LRU from the
+// stack distances of one pass, for every size at once, and for the CLOCK and
+// FIFO policies of BufMgr by simulating a pool of each size, with the pins of
+// the trace. The failures are the reads and allocations that found every frame
+// of the CLOCK pool pinned.
+//
+// usage: badgerdb_replay trace [frames...]
+// Without frames, the sizes are the powers of two up to the number of pages
+// in the trace. Exits with 2 if the trace cannot be read.
+// -----------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " trace [frames...]" << std::endl;
+		return 2;
+	}
+	const std::string name = argv[1];
+	std::vector<std::uint32_t> sizes;
+	for (int i = 2; i < argc; i++)
+	{
+		const long frames = std::atol(argv[i]);
+		if (frames <= 0)
+		{
+			std::cerr << argv[i] << ": not a number of frames" << std::endl;
+			return 2;
+		}
+		sizes.push_back(frames);
+	}
+
+	try
+	{
+		// the page counts are needed for the default sizes, so the trace is read twice then
+		if (sizes.empty())
+		{
+			TraceReader reader(name);
+			StackDistanceCurve curve;
+			TraceRecord record;
+			while (reader.next(record))
+			{
+				const std::uint64_t page = (std::uint64_t(record.fileId) << 32) | record.pageNo;
+				if (record.type == TRACE_READ)
+				{
+					curve.read(page);
+				}
+				else if (record.type == TRACE_ALLOC)
+				{
+					curve.alloc(page);
+				}
+			}
+			if (curve.pages() == 0)
+			{
+				sizes.push_back(1);
+			}
+			for (std::uint64_t frames = 1; curve.pages() > 0; frames *= 2)
+			{
+				sizes.push_back(frames < curve.pages() ? frames : curve.pages());
+				if (frames >= curve.pages())
+				{
+					break;
+				}
+			}
+		}
+
+		TraceReader reader(name);
+		StackDistanceCurve curve;
+		std::vector<ReplaySimulator> clocks, fifos;
+		for (size_t i = 0; i < sizes.size(); i++)
+		{
+			clocks.push_back(ReplaySimulator(sizes[i], REPLACE_CLOCK));
+			fifos.push_back(ReplaySimulator(sizes[i], REPLACE_FIFO));
+		}
+		std::uint64_t events = 0;
+		TraceRecord record;
+		while (reader.next(record))
+		{
+			const std::uint64_t page = (std::uint64_t(record.fileId) << 32) | record.pageNo;
+			events++;
+			for (size_t i = 0; i < sizes.size(); i++)
+			{
+				ReplaySimulator* simulators[2] = {&clocks[i], &fifos[i]};
+				for (int j = 0; j < 2; j++)
+				{
+					switch (record.type)
+					{
+						case TRACE_READ: simulators[j]->read(page); break;
+						case TRACE_UNPIN: simulators[j]->unpin(page); break;
+						case TRACE_ALLOC: simulators[j]->alloc(page); break;
+						case TRACE_DISPOSE: simulators[j]->dispose(page); break;
+					}
+				}
+			}
+			switch (record.type)
+			{
+				case TRACE_READ: curve.read(page); break;
+				case TRACE_ALLOC: curve.alloc(page); break;
+				case TRACE_DISPOSE: curve.dispose(page); break;
+			}
+		}
+
+		std::cout << name << ": " << events << " events, " << curve.reads() << " reads, " << reader.dropped()
+			<< " events dropped" << std::endl;
+		std::cout << std::setw(10) << "frames" << std::setw(10) << "lru" << std::setw(10) << "clock" << std::setw(10)
+			<< "fifo" << std::setw(12) << "failures" << std::endl;
+		std::cout << std::fixed << std::setprecision(4);
+		for (size_t i = 0; i < sizes.size(); i++)
+		{
+			std::cout << std::setw(10) << sizes[i] << std::setw(10) << curve.missRatio(sizes[i]) << std::setw(10)
+				<< clocks[i].missRatio() << std::setw(10) << fifos[i].missRatio() << std::setw(12)
+				<< clocks[i].failures() << std::endl;
+		}
+	}
+	catch(const BadgerDbException &e)
+	{
+		std::cerr << name << ": " << e.message() << std::endl;
+		return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,255 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "trace_sim.h"
+
+namespace badgerdb {
+
+StackDistanceCurve::StackDistanceCurve()
+	: tree(1, 0), now(0), numReads(0), numColdReads(0)
+{
+}
+
+void StackDistanceCurve::read(std::uint64_t page)
+{
+	std::uint64_t distance;
+	numReads++;
+	if (!access(page, distance))
+	{
+		numColdReads++;
+		return;
+	}
+	if (distances.size() <= distance)
+	{
+		distances.resize(distance + 1, 0);
+	}
+	distances[distance]++;
+}
+
+void StackDistanceCurve::alloc(std::uint64_t page)
+{
+	std::uint64_t distance;
+	access(page, distance);
+}
+
+void StackDistanceCurve::dispose(std::uint64_t page)
+{
+	std::unordered_map<std::uint64_t, std::uint64_t>::iterator it = lastAccess.find(page);
+	if (it != lastAccess.end())
+	{
+		add(it->second, -1);
+		lastAccess.erase(it);
+	}
+}
+
+bool StackDistanceCurve::access(std::uint64_t page, std::uint64_t& distance)
+{
+	// the tree doubles when it is full, rebuilt from the marks in linear time
+	if (now + 1 >= tree.size())
+	{
+		const std::size_t size = tree.size() * 2;
+		tree.assign(size, 0);
+		marked.resize(size, false);
+		for (std::size_t i = 1; i < size; i++)
+		{
+			tree[i] += marked[i - 1] ? 1 : 0;
+			const std::size_t parent = i + (i & -i);
+			if (parent < size)
+			{
+				tree[parent] += tree[i];
+			}
+		}
+	}
+
+	std::unordered_map<std::uint64_t, std::uint64_t>::iterator it = lastAccess.find(page);
+	const bool onStack = it != lastAccess.end();
+	if (onStack)
+	{
+		// the pages accessed after it are the ones above it on the stack
+		distance = countBefore(now) - countBefore(it->second + 1);
+		add(it->second, -1);
+		it->second = now;
+	}
+	else
+	{
+		lastAccess[page] = now;
+	}
+	add(now, 1);
+	now++;
+	return onStack;
+}
+
+void StackDistanceCurve::add(std::uint64_t time, int delta)
+{
+	marked[time] = delta > 0;
+	for (std::size_t i = time + 1; i < tree.size(); i += i & -i)
+	{
+		tree[i] += delta;
+	}
+}
+
+std::uint64_t StackDistanceCurve::countBefore(std::uint64_t time) const
+{
+	std::uint64_t count = 0;
+	for (std::size_t i = time; i > 0; i -= i & -i)
+	{
+		count += tree[i];
+	}
+	return count;
+}
+
+std::uint64_t StackDistanceCurve::misses(std::uint64_t frames) const
+{
+	std::uint64_t count = numColdReads;
+	for (std::size_t distance = frames; distance < distances.size(); distance++)
+	{
+		count += distances[distance];
+	}
+	return count;
+}
+
+ReplaySimulator::ReplaySimulator(std::uint32_t bufs, ReplacementPolicy policy)
+	: frames(bufs), policy(policy), numHits(0), numMisses(0), numFailures(0)
+{
+	candidates.reserve(bufs);
+	for (std::size_t i = 0; i < frames.size(); i++)
+	{
+		frames[i].page = 0;
+		frames[i].pinCnt = 0;
+		frames[i].valid = false;
+		frames[i].refbit = false;
+		frames[i].disposed = false;
+		freeFrames.push_back(bufs - 1 - i);
+	}
+}
+
+bool ReplaySimulator::allocFrame(FrameId& frame)
+{
+	if (!freeFrames.empty())
+	{
+		frame = freeFrames.back();
+		freeFrames.pop_back();
+		return true;
+	}
+	if (candidates.empty())
+	{
+		return false;
+	}
+	// every frame of the ring is unpinned, so the clock stops at the latest once it cleared all the refbits
+	while (policy == REPLACE_CLOCK && frames[candidates.current()].refbit)
+	{
+		frames[candidates.current()].refbit = false;
+		candidates.advance();
+	}
+	frame = candidates.current();
+	candidates.remove(frame);
+	buffered.erase(frames[frame].page);
+	frames[frame].valid = false;
+	return true;
+}
+
+void ReplaySimulator::setFrame(FrameId frame, std::uint64_t page)
+{
+	frames[frame].page = page;
+	frames[frame].pinCnt = 1;
+	frames[frame].valid = true;
+	frames[frame].refbit = true;
+	frames[frame].disposed = false;
+	buffered[page] = frame;
+}
+
+void ReplaySimulator::freeFrame(FrameId frame)
+{
+	candidates.remove(frame);
+	frames[frame].valid = false;
+	freeFrames.push_back(frame);
+}
+
+void ReplaySimulator::read(std::uint64_t page)
+{
+	std::unordered_map<std::uint64_t, FrameId>::const_iterator it = buffered.find(page);
+	if (it != buffered.end())
+	{
+		numHits++;
+		frames[it->second].refbit = true;
+		frames[it->second].pinCnt++;
+		candidates.remove(it->second);
+		return;
+	}
+	numMisses++;
+	FrameId frame;
+	if (!allocFrame(frame))
+	{
+		numFailures++;
+		return;
+	}
+	setFrame(frame, page);
+}
+
+void ReplaySimulator::alloc(std::uint64_t page)
+{
+	FrameId frame;
+	if (!allocFrame(frame))
+	{
+		numFailures++;
+		return;
+	}
+	// a page disposed of while pinned, and allocated again, keeps its frame, as in BufMgr::allocPage(), and the frame
+	// picked goes back on the free stack
+	std::unordered_map<std::uint64_t, FrameId>::const_iterator it = buffered.find(page);
+	if (it != buffered.end())
+	{
+		freeFrames.push_back(frame);
+		frames[it->second].disposed = false;
+		frames[it->second].pinCnt++;
+		frames[it->second].refbit = true;
+		candidates.remove(it->second);
+		return;
+	}
+	setFrame(frame, page);
+}
+
+void ReplaySimulator::unpin(std::uint64_t page)
+{
+	std::unordered_map<std::uint64_t, FrameId>::iterator it = buffered.find(page);
+	if (it == buffered.end() || frames[it->second].pinCnt == 0)
+	{
+		return;
+	}
+	Frame& frame = frames[it->second];
+	frame.pinCnt--;
+	if (frame.pinCnt > 0)
+	{
+		return;
+	}
+	if (frame.disposed)
+	{
+		freeFrame(it->second);
+		buffered.erase(it);
+		return;
+	}
+	candidates.add(it->second);
+}
+
+void ReplaySimulator::dispose(std::uint64_t page)
+{
+	std::unordered_map<std::uint64_t, FrameId>::iterator it = buffered.find(page);
+	if (it == buffered.end())
+	{
+		return;
+	}
+	Frame& frame = frames[it->second];
+	if (frame.pinCnt > 0)
+	{
+		frame.disposed = true;
+		return;
+	}
+	freeFrame(it->second);
+	buffered.erase(it);
+}
+
+}
@@ -0,0 +1,248 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+* @brief Miss ratio of an LRU buffer pool of every size at once, from one pass over a page access trace.
+*
+* For each read, the stack distance is the number of distinct pages accessed since the page was last; an LRU
+* pool of n frames hits exactly the reads whose distance is less than n. The distances are counted with a Fenwick
+* tree over the time of the last access of each page, so each access costs O(log accesses), and the histogram of
+* the distances gives the miss ratio for any number of frames. Pins are not taken into account.
+*
+* Pages are identified by a number, e.g. the file id of a trace record in the high 32 bits and the page number in
+* the low ones.
+*/
+class StackDistanceCurve
+{
+ public:
+	/**
+	 * Constructor of StackDistanceCurve class, with no accesses
+	 */
+	StackDistanceCurve();
+
+	/**
+	 * Counts a read of a page.
+	 */
+	void read(std::uint64_t page);
+
+	/**
+	 * Puts a page newly allocated at the top of the stack, without counting a read.
+	 */
+	void alloc(std::uint64_t page);
+
+	/**
+	 * Takes a deleted page off the stack.
+	 */
+	void dispose(std::uint64_t page);
+
+	/**
+	 * Returns the number of reads counted.
+	 */
+	std::uint64_t reads() const
+	{
+		return numReads;
+	}
+
+	/**
+	 * Returns the number of pages on the stack, which a pool of that many frames holds all of.
+	 */
+	std::uint64_t pages() const
+	{
+		return lastAccess.size();
+	}
+
+	/**
+	 * Returns the number of reads an LRU pool of a number of frames would have missed.
+	 *
+	 * @param frames	Number of frames
+	 */
+	std::uint64_t misses(std::uint64_t frames) const;
+
+	/**
+	 * Returns the fraction of the reads an LRU pool of a number of frames would have missed, or 0 if there were none.
+	 *
+	 * @param frames	Number of frames
+	 */
+	double missRatio(std::uint64_t frames) const
+	{
+		return numReads == 0 ? 0 : (double)misses(frames) / numReads;
+	}
+
+ private:
+	/**
+	 * Moves a page to the top of the stack.
+	 *
+	 * @param page		Page accessed
+	 * @param distance	Stack distance of the access, if the page was on the stack
+	 * @return True if the page was on the stack.
+	 */
+	bool access(std::uint64_t page, std::uint64_t& distance);
+
+	/**
+	 * Adds delta at a time in the Fenwick tree.
+	 */
+	void add(std::uint64_t time, int delta);
+
+	/**
+	 * Returns the number of pages whose last access is before a time.
+	 */
+	std::uint64_t countBefore(std::uint64_t time) const;
+
+	/**
+	 * Fenwick tree with a 1 at the time of the last access of each page on the stack, indexed from 1
+	 */
+	std::vector<std::uint32_t> tree;
+
+	/**
+	 * Whether each time is the last access of a page on the stack, to rebuild the tree when it grows
+	 */
+	std::vector<bool> marked;
+
+	/**
+	 * Time of the next access
+	 */
+	std::uint64_t now;
+
+	/**
+	 * Time of the last access of each page on the stack
+	 */
+	std::unordered_map<std::uint64_t, std::uint64_t> lastAccess;
+
+	/**
+	 * Number of reads at each stack distance
+	 */
+	std::vector<std::uint64_t> distances;
+
+	/**
+	 * Number of reads, and of reads of pages not on the stack, which every pool misses
+	 */
+	std::uint64_t numReads;
+	std::uint64_t numColdReads;
+};
+
+/**
+* @brief Buffer pool of a fixed size and replacement policy, replaying a page access trace.
+*
+* Frames are picked for eviction as BufMgr::allocBuf() does, from a stack of free frames and then from a
+* CandidateRing of the unpinned ones, and pinned pages are not evicted: a page is pinned by a read or an allocation
+* and stays so until it is unpinned as many times. Where every frame is pinned, BufMgr would have thrown
+* BufferExceededException; such a read or allocation is counted as failed, and the page not buffered.
+*/
+class ReplaySimulator
+{
+ public:
+	/**
+	 * Constructor of ReplaySimulator class, with every frame empty
+	 *
+	 * @param bufs		Number of frames
+	 * @param policy	Policy by which frames are picked for eviction
+	 */
+	ReplaySimulator(std::uint32_t bufs, ReplacementPolicy policy);
+
+	/**
+	 * Reads a page, pinning it.
+	 */
+	void read(std::uint64_t page);
+
+	/**
+	 * Allocates a page, pinning it.
+	 */
+	void alloc(std::uint64_t page);
+
+	/**
+	 * Releases a pin of a page. A page that is not buffered is ignored.
+	 */
+	void unpin(std::uint64_t page);
+
+	/**
+	 * Deletes a page, which leaves the pool once it is no longer pinned.
+	 */
+	void dispose(std::uint64_t page);
+
+	/**
+	 * Returns the number of reads that found the page buffered.
+	 */
+	std::uint64_t hits() const
+	{
+		return numHits;
+	}
+
+	/**
+	 * Returns the number of reads that did not.
+	 */
+	std::uint64_t misses() const
+	{
+		return numMisses;
+	}
+
+	/**
+	 * Returns the number of reads and allocations that found every frame pinned.
+	 */
+	std::uint64_t failures() const
+	{
+		return numFailures;
+	}
+
+	/**
+	 * Returns the fraction of the reads that missed, or 0 if there were none.
+	 */
+	double missRatio() const
+	{
+		return numHits + numMisses == 0 ? 0 : (double)numMisses / (numHits + numMisses);
+	}
+
+ private:
+	/**
+	 * State of a frame
+	 */
+	struct Frame
+	{
+		std::uint64_t page;
+		std::int32_t pinCnt;
+		bool valid;
+		bool refbit;
+		bool disposed;
+	};
+
+	/**
+	 * Picks a frame, evicting its page if it holds one.
+	 *
+	 * @param frame		The frame picked
+	 * @return False if every frame is pinned.
+	 */
+	bool allocFrame(FrameId& frame);
+
+	/**
+	 * Assigns a frame to a page, pinned once.
+	 */
+	void setFrame(FrameId frame, std::uint64_t page);
+
+	/**
+	 * Empties a frame whose page left the pool, and puts it on the stack of free frames.
+	 */
+	void freeFrame(FrameId frame);
+
+	std::vector<Frame> frames;
+	std::unordered_map<std::uint64_t, FrameId> buffered;
+	std::vector<FrameId> freeFrames;
+	CandidateRing candidates;
+	ReplacementPolicy policy;
+	std::uint64_t numHits;
+	std::uint64_t numMisses;
+	std::uint64_t numFailures;
+};
+
+}
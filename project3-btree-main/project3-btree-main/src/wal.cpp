@@ -0,0 +1,504 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "wal.h"
+#include "checksum.h"
+#include "exceptions/corrupt_page_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/log_io_exception.h"
+
+namespace badgerdb {
+
+/**
+ * Equal runs of bytes shorter than this do not split a changed range in two, as a range header costs about as much.
+ */
+static const std::size_t MINRANGEGAP = 8;
+
+/**
+ * Checksum of a byte range of the log.
+ */
+static std::uint32_t checksum(const char* data, std::size_t length)
+{
+	return crc32c(data, length);
+}
+
+/**
+ * Syncs a file to disk by name. Files are written through streams, which do not expose a descriptor.
+ */
+static void syncFile(const std::string& filename)
+{
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw LogIoException(filename, "open", errno);
+	}
+	if (::fsync(fd) != 0)
+	{
+		const int error = errno;
+		::close(fd);
+		throw LogIoException(filename, "sync", error);
+	}
+	::close(fd);
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& filename, int commitsPerSync)
+	: name(filename),
+		commitsPerSync(commitsPerSync < 1 ? 1 : commitsPerSync),
+		endLsn(0),
+		syncedLsn(0),
+		unsyncedCommits(0)
+{
+	fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		throw LogIoException(filename, "open", errno);
+	}
+	try
+	{
+		recover();
+	}
+	catch(...)
+	{
+		::close(fd);
+		throw;
+	}
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+	// a destructor cannot throw; the operations left unsynced are lost as if by a crash
+	try
+	{
+		sync();
+	}
+	catch(const LogIoException &e)
+	{
+		std::cerr << e.message() << std::endl;
+	}
+	::close(fd);
+}
+
+std::uint64_t WriteAheadLog::logPage(const File* file, const PageId pageNo, Page& logged, const Page& page)
+{
+	const char* before = reinterpret_cast<const char*>(&logged);
+	const char* after = reinterpret_cast<const char*>(&page);
+	char* image = reinterpret_cast<char*>(&logged);
+
+	// pages mostly change in a few places, such as the entries shifted by an insert, so whole blocks are skipped first
+	ranges.clear();
+	std::size_t i = 0;
+	while (i < Page::SIZE)
+	{
+		if (i % 64 == 0 && memcmp(before + i, after + i, 64) == 0)
+		{
+			i += 64;
+			continue;
+		}
+		if (before[i] == after[i])
+		{
+			i++;
+			continue;
+		}
+		std::size_t end = i + 1;
+		for (std::size_t j = end; j < Page::SIZE && j < end + MINRANGEGAP; j++)
+		{
+			if (before[j] != after[j])
+			{
+				end = j + 1;
+			}
+		}
+		RangeHeader range;
+		range.offset = i;
+		range.length = end - i;
+		ranges.insert(ranges.end(), reinterpret_cast<const char*>(&range), reinterpret_cast<const char*>(&range + 1));
+		ranges.insert(ranges.end(), after + i, after + end);
+		memcpy(image + i, after + i, end - i);
+		i = end;
+	}
+	if (ranges.empty())
+	{
+		return 0;
+	}
+
+	// the first change since the last checkpoint logs the whole page, so that a page torn or damaged on disk can be
+	// rebuilt from the log alone
+	if (imagedPages.insert(PageKey(file->filename(), pageNo)).second)
+	{
+		RangeHeader range;
+		range.offset = 0;
+		range.length = Page::SIZE;
+		ranges.clear();
+		ranges.insert(ranges.end(), reinterpret_cast<const char*>(&range), reinterpret_cast<const char*>(&range + 1));
+		ranges.insert(ranges.end(), after, after + Page::SIZE);
+	}
+	return append(PAGE, file, pageNo, &ranges[0], ranges.size());
+}
+
+std::uint64_t WriteAheadLog::logDispose(const File* file, const PageId pageNo)
+{
+	// a page allocated again starts over with a whole image
+	imagedPages.erase(PageKey(file->filename(), pageNo));
+	return append(DISPOSE, file, pageNo, NULL, 0);
+}
+
+std::uint64_t WriteAheadLog::commit()
+{
+	const std::uint64_t lsn = append(COMMIT, NULL, Page::INVALID_NUMBER, NULL, 0);
+	stats.commits++;
+	if (++unsyncedCommits >= commitsPerSync)
+	{
+		sync();
+	}
+	return lsn;
+}
+
+void WriteAheadLog::flush(const std::uint64_t lsn)
+{
+	if (lsn > syncedLsn)
+	{
+		sync();
+	}
+}
+
+void WriteAheadLog::checkpoint()
+{
+	// the log is emptied only once every file it covers is on disk; a failed sync leaves it whole for redo
+	sync();
+	for (std::set<std::string>::const_iterator it = loggedFiles.begin(); it != loggedFiles.end(); ++it)
+	{
+		syncFile(*it);
+	}
+	if (::ftruncate(fd, 0) != 0)
+	{
+		throw LogIoException(name, "truncate", errno);
+	}
+	if (::fsync(fd) != 0)
+	{
+		throw LogIoException(name, "sync", errno);
+	}
+	loggedFiles.clear();
+	imagedPages.clear();
+	endLsn = syncedLsn = 0;
+}
+
+std::uint64_t WriteAheadLog::append(const std::uint8_t type, const File* file, const PageId pageNo, const char* body,
+	const std::size_t bodyLength)
+{
+	std::string name;
+	RecordHeader header;
+	header.type = type;
+	header.fileKind = 0;
+	if (file != NULL)
+	{
+		name = file->filename();
+		header.fileKind = dynamic_cast<const PageFile*>(file) != NULL ? PAGEFILE : BLOBFILE;
+		loggedFiles.insert(name);
+	}
+	header.nameLength = name.size();
+	header.pageNo = pageNo;
+	header.length = sizeof(RecordHeader) + name.size() + bodyLength;
+
+	const std::size_t start = buffer.size();
+	buffer.resize(start + header.length);
+	char* record = &buffer[start];
+	memcpy(record, &header, sizeof(RecordHeader));
+	memcpy(record + sizeof(RecordHeader), name.data(), name.size());
+	if (bodyLength > 0)
+	{
+		memcpy(record + sizeof(RecordHeader) + name.size(), body, bodyLength);
+	}
+	const std::size_t checked = offsetof(RecordHeader, checksum) + sizeof(header.checksum);
+	header.checksum = checksum(record + checked, header.length - checked);
+	memcpy(record + offsetof(RecordHeader, checksum), &header.checksum, sizeof(header.checksum));
+
+	endLsn += header.length;
+	stats.bytes += header.length;
+	return endLsn;
+}
+
+void WriteAheadLog::sync()
+{
+	if (buffer.empty())
+	{
+		return;
+	}
+	std::size_t written = 0;
+	while (written < buffer.size())
+	{
+		const ssize_t n = ::pwrite(fd, &buffer[written], buffer.size() - written, syncedLsn + written);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw LogIoException(name, "write", errno);
+		}
+		written += n;
+	}
+	if (::fdatasync(fd) != 0)
+	{
+		throw LogIoException(name, "sync", errno);
+	}
+	stats.syncs++;
+	syncedLsn = endLsn;
+	unsyncedCommits = 0;
+	buffer.clear();
+}
+
+void WriteAheadLog::readLog(std::vector<char>& log, const std::uint64_t length) const
+{
+	log.resize(length);
+	std::size_t read = 0;
+	while (read < log.size())
+	{
+		const ssize_t n = ::pread(fd, &log[read], log.size() - read, read);
+		if (n <= 0)
+		{
+			break;
+		}
+		read += n;
+	}
+	log.resize(read);
+}
+
+std::size_t WriteAheadLog::parseRecords(const std::vector<char>& log, std::vector<std::size_t>& records) const
+{
+	// records past the last commit belong to an operation cut short by the crash, and so does a torn record
+	std::size_t committed = 0;
+	std::size_t pos = 0;
+	while (pos + sizeof(RecordHeader) <= log.size())
+	{
+		RecordHeader header;
+		memcpy(&header, &log[pos], sizeof(RecordHeader));
+		const std::size_t checked = offsetof(RecordHeader, checksum) + sizeof(header.checksum);
+		if (header.length < sizeof(RecordHeader) + header.nameLength || pos + header.length > log.size()
+			|| header.checksum != checksum(&log[pos + checked], header.length - checked))
+		{
+			break;
+		}
+		records.push_back(pos);
+		if (header.type == COMMIT)
+		{
+			committed = records.size();
+		}
+		pos += header.length;
+	}
+	return committed;
+}
+
+bool WriteAheadLog::isPageImage(const std::vector<char>& log, const std::size_t record)
+{
+	RecordHeader header;
+	memcpy(&header, &log[record], sizeof(RecordHeader));
+	RangeHeader range;
+	const std::size_t offset = record + sizeof(RecordHeader) + header.nameLength;
+	if (offset + sizeof(RangeHeader) > record + header.length)
+	{
+		return false;
+	}
+	memcpy(&range, &log[offset], sizeof(RangeHeader));
+	return range.offset == 0 && range.length == Page::SIZE;
+}
+
+void WriteAheadLog::applyRanges(const std::vector<char>& log, const std::size_t record, Page& page)
+{
+	RecordHeader header;
+	memcpy(&header, &log[record], sizeof(RecordHeader));
+	char* image = reinterpret_cast<char*>(&page);
+	std::size_t offset = record + sizeof(RecordHeader) + header.nameLength;
+	const std::size_t end = record + header.length;
+	while (offset + sizeof(RangeHeader) <= end)
+	{
+		RangeHeader range;
+		memcpy(&range, &log[offset], sizeof(RangeHeader));
+		offset += sizeof(RangeHeader);
+		memcpy(image + range.offset, &log[offset], range.length);
+		offset += range.length;
+	}
+}
+
+bool WriteAheadLog::repairPage(const File* file, const PageId pageNo, Page& page)
+{
+	// the records not yet synced are still in the buffer
+	std::vector<char> log;
+	readLog(log, syncedLsn);
+	log.insert(log.end(), buffer.begin(), buffer.end());
+	std::vector<std::size_t> records;
+	parseRecords(log, records);
+
+	// the page is rebuilt from its last whole image and the changes logged after it; a page written to its file had
+	// all its changes logged first
+	const std::string& name = file->filename();
+	bool imaged = false;
+	for (std::size_t r = 0; r < records.size(); r++)
+	{
+		RecordHeader header;
+		memcpy(&header, &log[records[r]], sizeof(RecordHeader));
+		if (header.type == COMMIT || header.pageNo != pageNo
+			|| name.compare(0, std::string::npos, &log[records[r] + sizeof(RecordHeader)], header.nameLength) != 0)
+		{
+			continue;
+		}
+		if (header.type == DISPOSE)
+		{
+			imaged = false;
+		}
+		else if (isPageImage(log, records[r]))
+		{
+			imaged = true;
+			applyRanges(log, records[r], page);
+		}
+		else if (imaged)
+		{
+			applyRanges(log, records[r], page);
+		}
+	}
+	if (imaged)
+	{
+		stats.pagesRepaired++;
+	}
+	return imaged;
+}
+
+void WriteAheadLog::recover()
+{
+	struct stat st;
+	std::vector<char> log;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		readLog(log, st.st_size);
+	}
+	std::vector<std::size_t> records;
+	const std::size_t committed = parseRecords(log, records);
+
+	// a page deleted by a committed operation keeps nothing logged before its deletion
+	std::map<PageKey, std::size_t> lastDispose;
+	std::map<PageKey, std::size_t> lastPage;
+	for (std::size_t r = 0; r < committed; r++)
+	{
+		RecordHeader header;
+		memcpy(&header, &log[records[r]], sizeof(RecordHeader));
+		if (header.type == COMMIT)
+		{
+			continue;
+		}
+		const PageKey key(std::string(&log[records[r] + sizeof(RecordHeader)], header.nameLength), header.pageNo);
+		if (header.type == DISPOSE)
+			lastDispose[key] = r;
+		else if (header.type == PAGE)
+			lastPage[key] = r;
+	}
+
+	std::map<std::string, std::shared_ptr<File> > files;
+	std::map<PageKey, Page> pages;
+	for (std::size_t r = 0; r < committed; r++)
+	{
+		RecordHeader header;
+		memcpy(&header, &log[records[r]], sizeof(RecordHeader));
+		if (header.type == COMMIT)
+		{
+			continue;
+		}
+		const PageKey key(std::string(&log[records[r] + sizeof(RecordHeader)], header.nameLength), header.pageNo);
+		std::map<PageKey, std::size_t>::const_iterator disposed = lastDispose.find(key);
+		if (header.type == PAGE && disposed != lastDispose.end() && disposed->second > r)
+		{
+			continue;
+		}
+
+		std::shared_ptr<File>& file = files[key.first];
+		if (!file)
+		{
+			if (!File::exists(key.first))
+			{
+				continue;
+			}
+			if (header.fileKind == PAGEFILE)
+				file.reset(new PageFile(key.first, false));
+			else
+				file.reset(new BlobFile(key.first, false));
+		}
+
+		if (header.type == DISPOSE)
+		{
+			// the deletion may or may not have reached the file before the crash; a page used again later is left alone
+			std::map<PageKey, std::size_t>::const_iterator reused = lastPage.find(key);
+			if (disposed->second != r || (reused != lastPage.end() && reused->second > r))
+			{
+				continue;
+			}
+			try
+			{
+				if (header.fileKind == PAGEFILE)
+				{
+					file->readPage(key.second);
+					file->deletePage(key.second);
+				}
+				else if (!static_cast<BlobFile*>(file.get())->isFreePage(key.second))
+				{
+					file->deletePage(key.second);
+				}
+			}
+			catch(const InvalidPageException &e)
+			{
+			}
+			continue;
+		}
+
+		// a whole image replaces the page, which may have been torn by the crash
+		std::map<PageKey, Page>::iterator page = pages.find(key);
+		if (page == pages.end())
+		{
+			try
+			{
+				page = pages.insert(std::make_pair(key, isPageImage(log, records[r]) ? Page() : file->readPage(key.second))).first;
+			}
+			catch(const InvalidPageException &e)
+			{
+				continue;
+			}
+			catch(const CorruptPageException &e)
+			{
+				continue;
+			}
+		}
+		applyRanges(log, records[r], page->second);
+	}
+
+	for (std::map<PageKey, Page>::const_iterator it = pages.begin(); it != pages.end(); ++it)
+	{
+		try
+		{
+			files[it->first.first]->writePage(it->first.second, it->second);
+		}
+		catch(const InvalidPageException &e)
+		{
+		}
+	}
+	stats.pagesRedone = pages.size();
+	for (std::map<std::string, std::shared_ptr<File> >::const_iterator it = files.begin(); it != files.end(); ++it)
+	{
+		if (it->second)
+		{
+			loggedFiles.insert(it->first);
+		}
+	}
+	files.clear();
+	checkpoint();
+}
+
+}
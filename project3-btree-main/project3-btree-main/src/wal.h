@@ -0,0 +1,342 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+* @brief Statistics of a write-ahead log
+*/
+struct LogStats
+{
+	/**
+   * Number of operations committed
+	 */
+  std::uint64_t commits;
+
+	/**
+   * Number of times the log was forced to disk
+	 */
+  std::uint64_t syncs;
+
+	/**
+   * Number of bytes appended to the log
+	 */
+  std::uint64_t bytes;
+
+	/**
+   * Number of pages written by the redo pass when the log was opened
+	 */
+  std::uint64_t pagesRedone;
+
+	/**
+   * Number of corrupt pages rebuilt from the log by repairPage()
+	 */
+  std::uint64_t pagesRepaired;
+
+	/**
+   * Clear all values
+	 */
+  void clear()
+  {
+		commits = syncs = bytes = pagesRedone = pagesRepaired = 0;
+  }
+
+	/**
+   * Constructor of LogStats class
+	 */
+  LogStats()
+  {
+		clear();
+  }
+};
+
+/**
+* @brief Write-ahead log of the changes a buffer manager makes to the pages of its files.
+*
+* A change to a page is logged as the byte ranges in which the page differs from its last logged image, so redoing
+* the records of a page in order leaves it as it was at the last of them, whatever state the file was in. The first
+* change of a page since the last checkpoint, or since the page was deleted, logs the whole page instead, which lets
+* redo and repairPage() rebuild a page that is torn or damaged on disk. The
+* records of one operation are followed by a commit record, and only operations whose commit record reached the log
+* are redone. The log sequence number (LSN) of a record is the offset just past it in the log; a page is written to
+* its file only once the log is on disk up to the LSN of its last record.
+*
+* By default every commit syncs the log before it returns. With commitsPerSync above 1, only every commitsPerSync-th
+* commit syncs it, taking the commits before it along, and the others return before their records are on disk: a crash
+* may lose up to commitsPerSync - 1 committed operations, though never part of one.
+*
+* A log that cannot be opened, written or synced throws LogIoException, and a failed checkpoint leaves the log whole.
+*
+* Opening a log redoes the operations committed in it into their files, after which the log starts out empty. A
+* checkpoint, once every page has been written, syncs the files and empties the log again.
+*
+* The log is not threadsafe; the buffer manager calls it with its mutex held.
+*/
+class WriteAheadLog
+{
+ public:
+	/**
+   * Size in bytes beyond which the buffer manager takes a checkpoint once the operation in progress is committed
+	 */
+  static const std::uint64_t CHECKPOINTSIZE = 64 * 1024 * 1024;
+
+	/**
+	 * Opens the log, creating it if it does not exist, and redoes the operations committed in it.
+	 *
+	 * @param filename					Name of the log file
+	 * @param commitsPerSync		Number of commits between syncs of the log; a crash may lose all but the last of them
+	 * @throws LogIoException if the log cannot be opened, or redoing it fails to write or sync a file.
+	 */
+  WriteAheadLog(const std::string& filename, int commitsPerSync = 1);
+
+	/**
+	 * Forces the log to disk and closes it. A failure to do so is reported on stderr.
+	 */
+  ~WriteAheadLog();
+
+	/**
+	 * Logs the bytes in which a page differs from its last logged image, and brings that image up to date.
+	 *
+	 * @param file				File of the page
+	 * @param pageNo			Page number in the file
+	 * @param logged			Last logged image of the page, or the page as read from its file
+	 * @param page				Current contents of the page
+	 * @return LSN of the record, or 0 if the page is unchanged and nothing was logged.
+	 */
+  std::uint64_t logPage(const File* file, const PageId pageNo, Page& logged, const Page& page);
+
+	/**
+	 * Logs that a page was deleted from its file, so that changes logged for it before are not redone.
+	 *
+	 * @param file				File of the page
+	 * @param pageNo			Page number in the file
+	 * @return LSN of the record.
+	 */
+  std::uint64_t logDispose(const File* file, const PageId pageNo);
+
+	/**
+	 * Ends the operation whose records were logged since the last commit, syncing the log on every
+	 * commitsPerSync-th commit.
+	 *
+	 * @return LSN of the commit record.
+	 * @throws LogIoException if the log is synced and cannot be written or synced.
+	 */
+  std::uint64_t commit();
+
+	/**
+	 * Forces the log to disk up to a given LSN. Called before a page is written to its file.
+	 *
+	 * @param lsn					LSN of the last record of the page
+	 * @throws LogIoException if the log cannot be written or synced.
+	 */
+  void flush(const std::uint64_t lsn);
+
+	/**
+	 * Rebuilds a page from the log, for a page found corrupt in its file. This takes the last whole image of the page
+	 * logged since the last checkpoint and the changes logged after it, which is the page as last written to its file.
+	 *
+	 * @param file				File of the page
+	 * @param pageNo			Page number in the file
+	 * @param page				Set to the rebuilt page
+	 * @return True if the page was rebuilt, false if the log has no whole image of it.
+	 */
+  bool repairPage(const File* file, const PageId pageNo, Page& page);
+
+	/**
+	 * Tells whether the log has grown beyond CHECKPOINTSIZE.
+	 */
+  bool needsCheckpoint() const
+  {
+		return endLsn >= CHECKPOINTSIZE;
+  }
+
+	/**
+	 * Syncs the files that have records in the log, and empties it. The caller must have written every changed page
+	 * to its file first.
+	 *
+	 * @throws LogIoException if the log or a file cannot be synced, in which case the log is not emptied.
+	 */
+  void checkpoint();
+
+	/**
+   * Get log statistics
+	 */
+  const LogStats& getStats() const
+  {
+		return stats;
+  }
+
+ private:
+	/**
+	 * Header of a log record, followed by the name of the file and, for a page record, the changed byte ranges.
+	 */
+  struct RecordHeader
+  {
+		/**
+		 * Length of the whole record in bytes
+		 */
+		std::uint32_t length;
+
+		/**
+		 * Checksum of the record following this field, to tell a complete record from one torn by a crash
+		 */
+		std::uint32_t checksum;
+
+		/**
+		 * One of PAGE, DISPOSE and COMMIT
+		 */
+		std::uint8_t type;
+
+		/**
+		 * One of PAGEFILE and BLOBFILE
+		 */
+		std::uint8_t fileKind;
+
+		/**
+		 * Length of the file name
+		 */
+		std::uint16_t nameLength;
+
+		/**
+		 * Page number in the file
+		 */
+		PageId pageNo;
+  };
+
+	/**
+	 * A byte range of a page record is stored as its offset and length, followed by the bytes.
+	 */
+  struct RangeHeader
+  {
+		std::uint16_t offset;
+		std::uint16_t length;
+  };
+
+  static const std::uint8_t PAGE = 1;
+  static const std::uint8_t DISPOSE = 2;
+  static const std::uint8_t COMMIT = 3;
+
+  static const std::uint8_t PAGEFILE = 1;
+  static const std::uint8_t BLOBFILE = 2;
+
+  typedef std::pair<std::string, PageId> PageKey;
+
+	/**
+	 * Appends a record to the log buffer.
+	 *
+	 * @return LSN of the record.
+	 */
+  std::uint64_t append(const std::uint8_t type, const File* file, const PageId pageNo, const char* body,
+		const std::size_t bodyLength);
+
+	/**
+	 * Writes the log buffer to the log file and syncs it.
+	 *
+	 * @throws LogIoException if the log cannot be written or synced.
+	 */
+  void sync();
+
+	/**
+	 * Reads the log file from its start.
+	 *
+	 * @param log					Set to the bytes read
+	 * @param length			Number of bytes to read
+	 */
+  void readLog(std::vector<char>& log, const std::uint64_t length) const;
+
+	/**
+	 * Finds the complete records in the bytes of a log, up to the first torn one.
+	 *
+	 * @param log					Bytes of the log
+	 * @param records			Set to the offset of each record
+	 * @return Number of records up to and including the last commit record.
+	 */
+  std::size_t parseRecords(const std::vector<char>& log, std::vector<std::size_t>& records) const;
+
+	/**
+	 * Tells whether a page record holds the whole page.
+	 */
+  static bool isPageImage(const std::vector<char>& log, const std::size_t record);
+
+	/**
+	 * Copies the byte ranges of a page record into a page.
+	 */
+  static void applyRanges(const std::vector<char>& log, const std::size_t record, Page& page);
+
+	/**
+	 * Redoes the operations committed in the log file into their files, then empties the log.
+	 */
+  void recover();
+
+	/**
+	 * Name of the log file
+	 */
+  std::string name;
+
+	/**
+	 * Descriptor of the log file
+	 */
+  int fd;
+
+	/**
+	 * Number of commits between syncs of the log
+	 */
+  int commitsPerSync;
+
+	/**
+	 * Records appended since the last sync
+	 */
+  std::vector<char> buffer;
+
+	/**
+	 * Byte ranges of the page record being built by logPage()
+	 */
+  std::vector<char> ranges;
+
+	/**
+	 * LSN just past the last record appended
+	 */
+  std::uint64_t endLsn;
+
+	/**
+	 * LSN up to which the log is on disk
+	 */
+  std::uint64_t syncedLsn;
+
+	/**
+	 * Commits appended since the last sync
+	 */
+  int unsyncedCommits;
+
+	/**
+	 * Files that have records in the log, synced by checkpoint()
+	 */
+  std::set<std::string> loggedFiles;
+
+	/**
+	 * Pages with a whole image in the log
+	 */
+  std::set<PageKey> imagedPages;
+
+	/**
+	 * Log statistics
+	 */
+  LogStats stats;
+};
+
+}